@@ -8,15 +8,19 @@
  */
 
 #include <argp.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 
 #include <dxwifi/rx/cli.h>
 
 #include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/trace.h>
 
 
 #define PRIMARY_GROUP           0
 #define DIRECTORY_MODE_GROUP    500
+#define DEPACKETIZER_GROUP      750
 #define PCAP_SETTINGS_GROUP     1000
 #define HELP_GROUP              1500
 
@@ -33,6 +37,13 @@ typedef enum {
     NO_OPTIMIZE,
 } pcap_settings_t;
 
+typedef enum {
+    NAL_FLAG,
+    JPEG_FLAG,
+    COMPRESS_FLAG,
+    DELTA_FLAG,
+} depacketizer_settings_t;
+
 // Description of key arguments 
 static char args_doc[] = "output-file/directory";
 
@@ -54,6 +65,12 @@ static struct argp_option opts[] = {
     { "prefix",         'p', "<file-prefix>",       0, "What to name each created file",            DIRECTORY_MODE_GROUP },
     { "extension",      'e', "<file-extension>",    0, "Extension for each created file",           DIRECTORY_MODE_GROUP },
 
+    { 0, 0, 0, 0, "Depacketizer Options (the transmitter must use the matching option)", DEPACKETIZER_GROUP },
+    { "nal",            GET_KEY(NAL_FLAG,       DEPACKETIZER_GROUP),     0,              OPTION_NO_USAGE,    "Reassemble H.264 NAL units, dropping incomplete units", DEPACKETIZER_GROUP },
+    { "jpeg",           GET_KEY(JPEG_FLAG,      DEPACKETIZER_GROUP),     0,              OPTION_NO_USAGE,    "Rebuild JPEGs, replacing lost restart intervals with gray strips", DEPACKETIZER_GROUP },
+    { "compress",       GET_KEY(COMPRESS_FLAG,  DEPACKETIZER_GROUP),     0,              OPTION_NO_USAGE,    "Decompress groups, lost groups are filled with noise if --add-noise is set", DEPACKETIZER_GROUP },
+    { "delta",          GET_KEY(DELTA_FLAG,     DEPACKETIZER_GROUP),     0,              OPTION_NO_USAGE,    "Rebuild each file from the previous one, lost data keeps the previous file's bytes", DEPACKETIZER_GROUP },
+
     { 0, 0, 0, 0, "Packet Capture Settings (https://www.tcpdump.org/manpages/pcap.3pcap.html)", PCAP_SETTINGS_GROUP },
     { "snaplen",        GET_KEY(SNAPLEN,        PCAP_SETTINGS_GROUP),    "<bytes>",      OPTION_NO_USAGE,    "Snapshot length in bytes",             PCAP_SETTINGS_GROUP },
     { "buffer-timeout", GET_KEY(BUFFER_TIMEOUT, PCAP_SETTINGS_GROUP),    "<ms>",         OPTION_NO_USAGE,    "Packet buffer timeout",                PCAP_SETTINGS_GROUP },
@@ -63,17 +80,59 @@ static struct argp_option opts[] = {
     { 0, 0, 0, 0, "Help options", HELP_GROUP },
     { "verbose", 'v', 0, 0, "Verbosity level",              HELP_GROUP },
     { "syslog",  's', 0, 0, "Use SysLog for messages",      HELP_GROUP }, 
+    { "async-log", GET_KEY(1, HELP_GROUP), 0, 0, "Write messages from a background thread", HELP_GROUP },
+    { "log-sample", GET_KEY(2, HELP_GROUP), "<n>",       0, "Only log 1 in n per-frame debug messages",         HELP_GROUP },
+    { "log-rate",   GET_KEY(3, HELP_GROUP), "<per-sec>", 0, "Cap per-frame debug messages per second per site", HELP_GROUP },
+    { "trace",          GET_KEY(4, HELP_GROUP), "<file>",    0, "Record every captured frame into a binary trace",  HELP_GROUP },
+    { "trace-bytes",    GET_KEY(5, HELP_GROUP), "<bytes>",   0, "Bytes of each frame kept in the trace",            HELP_GROUP },
+    { "trace-records",  GET_KEY(6, HELP_GROUP), "<records>", 0, "Frames the trace holds before it wraps around",    HELP_GROUP },
+    { "metrics",        GET_KEY(7, HELP_GROUP), "<name>",    0, "Publish live metrics for dxwifi-stat under this name", HELP_GROUP },
+    { "latency",        GET_KEY(8, HELP_GROUP), 0,           0, "Time each stage and log latency percentiles at exit", HELP_GROUP },
+    { "link-report",    GET_KEY(9, HELP_GROUP), "<seconds>", 0, "Log the link quality this often, 0 to never (default: 10)", HELP_GROUP },
+    { "link-summary",   GET_KEY(10, HELP_GROUP), "<file>",   0, "Write the link quality of the whole session to this file at exit", HELP_GROUP },
     { "quiet",   'q', 0, 0, "Silence any output",           HELP_GROUP },
 
 #if defined(DXWIFI_TESTS)
     { 0, 0, 0, 0, "WARNING! You are running a test build!", TEST_GROUP },
     { "savefile", GET_KEY(1, TEST_GROUP), "<filename>", 0, "Dump packetized data into this file", TEST_GROUP },
+    { "event-loop", GET_KEY(2, TEST_GROUP), 0, 0, "Drive the capture from an epoll loop with the step API", TEST_GROUP },
+    { "sink-events", GET_KEY(3, TEST_GROUP), 0, 0, "Capture into a custom sink that logs every callback", TEST_GROUP },
 #endif
 
     { 0 } // Final zero field is required by arg
 };
 
 
+/**
+ *  DESCRIPTION:    Parses a whole number, exits with a usage error if the 
+ *                  argument isn't one or it's out of range
+ * 
+ *  ARGUMENTS:
+ * 
+ *      state:      Parser state, for the error
+ * 
+ *      arg:        Option argument
+ * 
+ *      name:       What the option sets, for the error
+ * 
+ *      min, max:   Inclusive range the value must be in
+ * 
+ *  RETURNS:
+ * 
+ *      long:       The parsed value
+ * 
+ */
+static long parse_ranged(struct argp_state* state, const char* arg, const char* name, long min, long max) {
+    char* end = NULL;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if(errno != 0 || end == arg || *end != '\0' || value < min || value > max) {
+        argp_error(state, "%s must be in the range(%ld, %ld)", name, min, max);
+    }
+    return value;
+}
+
+
 static error_t parse_opt(int key, char* arg, struct argp_state *state) {
 
     error_t status = 0;
@@ -167,6 +226,68 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
         args->use_syslog = true;
         break;
 
+    case GET_KEY(1, HELP_GROUP):
+        args->async_log = true;
+        break;
+
+    case GET_KEY(2, HELP_GROUP):
+        args->log_sample = parse_ranged(state, arg, "Log sampling", 0, INT_MAX);
+        break;
+
+    case GET_KEY(3, HELP_GROUP):
+        args->log_rate = parse_ranged(state, arg, "Log rate", 0, INT_MAX);
+        break;
+
+    case GET_KEY(4, HELP_GROUP):
+        args->trace = arg;
+        break;
+
+    case GET_KEY(5, HELP_GROUP):
+        if(strtol(arg, NULL, 10) < 0 || strtol(arg, NULL, 10) > DXWIFI_TRACE_SNAPLEN_MAX) {
+            argp_error(state, "Trace bytes must be in the range(0, %d)", DXWIFI_TRACE_SNAPLEN_MAX);
+        }
+        args->trace_snaplen = strtol(arg, NULL, 10);
+        break;
+
+    case GET_KEY(6, HELP_GROUP):
+        if(strtol(arg, NULL, 10) < 1 || strtol(arg, NULL, 10) > DXWIFI_TRACE_CAPACITY_MAX) {
+            argp_error(state, "Trace records must be in the range(1, %d)", DXWIFI_TRACE_CAPACITY_MAX);
+        }
+        args->trace_capacity = strtol(arg, NULL, 10);
+        break;
+
+    case GET_KEY(7, HELP_GROUP):
+        args->metrics = arg;
+        break;
+
+    case GET_KEY(8, HELP_GROUP):
+        args->latency = true;
+        break;
+
+    case GET_KEY(9, HELP_GROUP):
+        args->rx.link_report_interval = parse_ranged(state, arg, "Link report interval", 0, INT_MAX);
+        break;
+
+    case GET_KEY(10, HELP_GROUP):
+        args->link_summary = arg;
+        break;
+
+    case GET_KEY(NAL_FLAG, DEPACKETIZER_GROUP):
+        args->depacketizer = RX_DEPACKETIZER_NAL;
+        break;
+
+    case GET_KEY(JPEG_FLAG, DEPACKETIZER_GROUP):
+        args->depacketizer = RX_DEPACKETIZER_JPEG;
+        break;
+
+    case GET_KEY(COMPRESS_FLAG, DEPACKETIZER_GROUP):
+        args->depacketizer = RX_DEPACKETIZER_COMPRESS;
+        break;
+
+    case GET_KEY(DELTA_FLAG, DEPACKETIZER_GROUP):
+        args->depacketizer = RX_DEPACKETIZER_DELTA;
+        break;
+
     case GET_KEY(SNAPLEN, PCAP_SETTINGS_GROUP):
         args->rx.snaplen = atoi(arg);
         break;
@@ -186,11 +307,21 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
 #if defined(DXWIFI_TESTS)
     case ARGP_KEY_INIT:
         args->rx.savefile = NULL;
+        args->event_loop = false;
+        args->sink_events = false;
         break;
 
     case GET_KEY(1, TEST_GROUP):
         args->rx.savefile = arg;
         break;
+
+    case GET_KEY(2, TEST_GROUP):
+        args->event_loop = true;
+        break;
+
+    case GET_KEY(3, TEST_GROUP):
+        args->sink_events = true;
+        break;
 #endif 
 
     default:
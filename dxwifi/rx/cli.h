@@ -17,6 +17,14 @@ typedef enum {
     RX_DIRECTORY_MODE,
 } rx_mode_t;
 
+typedef enum {
+    RX_DEPACKETIZER_NONE,
+    RX_DEPACKETIZER_NAL,
+    RX_DEPACKETIZER_JPEG,
+    RX_DEPACKETIZER_COMPRESS,
+    RX_DEPACKETIZER_DELTA,
+} rx_depacketizer_t;
+
 
 typedef struct {
     rx_mode_t       rx_mode;
@@ -24,11 +32,25 @@ typedef struct {
     bool            quiet;
     bool            append;
     bool            use_syslog;
+    bool            async_log;
+    unsigned        log_sample;
+    unsigned        log_rate;
+    const char*     trace;
+    size_t          trace_snaplen;
+    size_t          trace_capacity;
+    const char*     metrics;
+    bool            latency;
+    const char*     link_summary;
     const char*     device;
     const char*     output_path;
     const char*     file_prefix;
     const char*     file_extension;
+    rx_depacketizer_t depacketizer;
     dxwifi_receiver rx;
+#if defined(DXWIFI_TESTS)
+    bool            event_loop;
+    bool            sink_events;
+#endif
 } cli_args;
 
 
@@ -7,40 +7,99 @@
  * 
  */
 
+#define DXWIFI_LOG_MODULE DXWIFI_LOG_RX
+
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <sys/epoll.h>
 #include <linux/limits.h>
 
 #include <dxwifi/rx/cli.h>
 
 #include <libdxwifi/dxwifi.h>
 #include <libdxwifi/receiver.h>
+#include <libdxwifi/details/jpeg.h>
+#include <libdxwifi/details/compress.h>
+#include <libdxwifi/details/delta.h>
+#include <libdxwifi/details/nalu.h>
 #include <libdxwifi/details/logging.h>
 #include <libdxwifi/details/syslogger.h>
+#include <libdxwifi/details/asynclog.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+#include <libdxwifi/details/linkquality.h>
+
+
+// Receiver SIGINT stops, only set while a handler is installed
+static dxwifi_receiver* interrupt_target = NULL;
+
+// Link quality of every capture in the session
+static dxwifi_link_stats link_totals = { 0 };
+
+// Frames recorded with --trace
+static dxwifi_trace frame_trace = { .fd = -1 };
+
+// Counters published with --metrics
+static dxwifi_metrics live_metrics = { 0 };
+
+// Stages timed with --latency
+static dxwifi_latency stage_latency;
+
+#if defined(DXWIFI_TESTS)
+bool event_loop = false;
+bool sink_events = false;
+#endif
 
 
-dxwifi_receiver* receiver = NULL;
+// Storage for whichever depacketizer is selected
+typedef union {
+    nalu_depacketizer nalu;
+    jpeg_depacketizer jpeg;
+    compress_depacketizer comp;
+    delta_depacketizer delta;
+} depacketizer_state;
 
 
 void receive(cli_args* args, dxwifi_receiver* rx);
+void log_link_stats(const dxwifi_link_stats* stats);
+void attach_depacketizer(cli_args* args, dxwifi_receiver* rx, depacketizer_state* state);
+void detach_depacketizer(cli_args* args, dxwifi_receiver* rx, depacketizer_state* state);
+void close_trace(void);
+void close_live_metrics(void);
 
 
 int main(int argc, char** argv) {
+    depacketizer_state depacketizer;
+
     cli_args args = {
         .rx_mode        = RX_STREAM_MODE,
         .verbosity      = DXWIFI_LOG_INFO,
         .quiet          = false,
         .append         = false,
         .use_syslog     = false,
+        .async_log      = false,
+        .log_sample     = 0,
+        .log_rate       = 0,
+        .trace          = NULL,
+        .trace_snaplen  = DXWIFI_TRACE_SNAPLEN_DFLT,
+        .trace_capacity = DXWIFI_TRACE_CAPACITY_DFLT,
+        .metrics        = NULL,
+        .latency        = false,
+        .link_summary   = NULL,
         .device         = "mon0",
         .output_path    = ".",
         .file_prefix    = "rx",
         .file_extension = "cap",
+        .depacketizer   = RX_DEPACKETIZER_NONE,
         .rx = {
             .dispatch_count     = 1,
             .capture_timeout    = -1, // No timeout
@@ -51,29 +110,107 @@ int main(int argc, char** argv) {
             .filter             = "wlan addr2 aa:aa:aa:aa:aa:aa",
             .optimize           = true,
             .snaplen            = DXWIFI_SNAPLEN_MAX,
-            .pb_timeout         = DXWIFI_DFLT_PACKET_BUFFER_TIMEOUT
+            .pb_timeout         = DXWIFI_DFLT_PACKET_BUFFER_TIMEOUT,
+            .link_report_interval = 10
         }
     };
-    receiver = &args.rx;
+    dxwifi_receiver* receiver = &args.rx;
 
     parse_args(argc, argv, &args);
 
-    if(args.use_syslog) {
+#if defined(DXWIFI_TESTS)
+    event_loop = args.event_loop;
+    sink_events = args.sink_events;
+#endif
+
+    if(args.async_log) {
+        // Flushed by the atexit handler, whichever way the program exits
+        if(init_async_logger(args.use_syslog ? ASYNC_LOG_SYSLOG : ASYNC_LOG_STDERR, ASYNC_LOG_CAPACITY_DFLT)) {
+            set_logger(DXWIFI_LOG_ALL_MODULES, async_logger);
+            atexit(teardown_async_logger);
+        }
+    }
+    else if(args.use_syslog) {
         set_logger(DXWIFI_LOG_ALL_MODULES, syslogger);
     }
 
     set_log_level(DXWIFI_LOG_ALL_MODULES, args.verbosity);
+    set_log_sampling(DXWIFI_LOG_ALL_MODULES, args.log_sample);
+    set_log_rate_limit(DXWIFI_LOG_ALL_MODULES, args.log_rate);
+
+    if(args.trace) {
+        if(!open_frame_trace(&frame_trace, args.trace, args.trace_capacity, args.trace_snaplen)) {
+            exit(1);
+        }
+        receiver->trace = &frame_trace;
+        atexit(close_trace);
+    }
+    if(args.metrics) {
+        if(!open_metrics(&live_metrics, args.metrics, DXWIFI_METRICS_RX)) {
+            exit(1);
+        }
+        receiver->metrics = &live_metrics;
+        atexit(close_live_metrics);
+    }
+    if(args.latency) {
+        init_latency(&stage_latency, receiver->metrics);
+        receiver->latency = &stage_latency;
+    }
 
     init_receiver(receiver, args.device);
 
+    attach_depacketizer(&args, receiver, &depacketizer);
+
     receive(&args, receiver);
 
+    detach_depacketizer(&args, receiver, &depacketizer);
+
     close_receiver(receiver);
 
+    if(args.latency) {
+        log_latency_summary(&stage_latency);
+    }
+
+    log_link_stats(&link_totals);
+    if(args.link_summary && !write_link_summary(&link_totals, args.link_summary)) {
+        exit(1);
+    }
+
+    uint64_t suppressed = get_log_suppressed(DXWIFI_LOG_ALL_MODULES);
+    if(suppressed > 0) {
+        log_info("%" PRIu64 " debug messages suppressed by sampling or rate limits", suppressed);
+    }
+    if(args.async_log) {
+        // Written out first, so this can't be dropped as well
+        async_logger_flush();
+        async_log_stats log_stats = async_logger_get_stats();
+        if(log_stats.dropped > 0) {
+            log_warning("%" PRIu64 " of %" PRIu64 " messages dropped by the async logger", log_stats.dropped, log_stats.logged + log_stats.dropped);
+        }
+    }
+
     exit(0);
 }
 
 
+/**
+ *  DESCRIPTION:    Closes the frame trace, registered with atexit
+ * 
+ */
+void close_trace(void) {
+    close_frame_trace(&frame_trace);
+}
+
+
+/**
+ *  DESCRIPTION:    Stops publishing metrics, registered with atexit
+ * 
+ */
+void close_live_metrics(void) {
+    close_metrics(&live_metrics);
+}
+
+
 /**
  *  DESCRIPTION:    Logs info about the current capture session
  * 
@@ -85,12 +222,12 @@ int main(int argc, char** argv) {
 void log_rx_stats(dxwifi_rx_stats stats) {
     log_debug(
         "Receiver Capture Stats\n"
-        "\tTotal Payload Size:          %d\n"
-        "\tTotal Write length:          %d\n"
-        "\tTotal Capture Size:          %d\n"
-        "\tTotal Blocks Lost:           %d\n"
-        "\tTotal Noise Added:           %d\n"
-        "\tPackets Processed:           %d\n"
+        "\tTotal Payload Size:          %" PRIu64 "\n"
+        "\tTotal Write length:          %" PRIu64 "\n"
+        "\tTotal Capture Size:          %" PRIu64 "\n"
+        "\tTotal Blocks Lost:           %" PRIu64 "\n"
+        "\tTotal Noise Added:           %" PRIu64 "\n"
+        "\tPackets Processed:           %" PRIu64 "\n"
         "\tPackets Received:            %d\n"
         "\tPackets Dropped (Kernel):    %d\n"
         "\tPackets Dropped (NIC):       %d\n"
@@ -109,6 +246,32 @@ void log_rx_stats(dxwifi_rx_stats stats) {
 }
 
 
+/**
+ *  DESCRIPTION:    Logs the link quality of the whole session
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Link stats of every capture merged together
+ * 
+ */
+void log_link_stats(const dxwifi_link_stats* stats) {
+    if(stats->frames == 0) {
+        return;
+    }
+    log_info(
+        "Link quality: frames=%" PRIu64 " lost=%" PRIu64 " loss=%.2f%% bursts=%" PRIu64 " burst_max=%" PRIu64 " dup=%.2f%% goodput=%.0fB/s jitter=%.1fus",
+        stats->frames,
+        stats->lost,
+        link_loss_rate(stats) * 100,
+        stats->bursts,
+        stats->burst_max,
+        link_duplicate_rate(stats) * 100,
+        link_goodput(stats),
+        stats->jitter
+    );
+}
+
+
 /**
  *  DESCRIPTION:    Signals to the receiver to stop capture
  * 
@@ -118,10 +281,141 @@ void log_rx_stats(dxwifi_rx_stats stats) {
  * 
  */
 void sigint_handler(int signum) {
-    receiver_stop_capture(receiver);
+    receiver_stop_capture(interrupt_target);
+}
+
+
+#if defined(DXWIFI_TESTS)
+/**
+ *  DESCRIPTION:    Drives a capture with the step API from an epoll loop, 
+ *                  the way a program juggling other event sources would embed
+ *                  the receiver
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      rx:         Initialized receiver
+ * 
+ *      fd:         Opened file descriptor to output capture data
+ * 
+ *      stats:      Filled in once the capture ends
+ * 
+ */
+static void capture_from_event_loop(dxwifi_receiver* rx, int fd, dxwifi_rx_stats* stats) {
+    int epfd = epoll_create1(0);
+    if(epfd < 0) {
+        log_error("Failed to create epoll instance: %s", strerror(errno));
+        exit(1);
+    }
+
+    receiver_begin_capture(rx, fd);
+
+    // Savefiles are regular files, they can't be watched but are always ready
+    struct epoll_event event = { .events = EPOLLIN };
+    bool watched = epoll_ctl(epfd, EPOLL_CTL_ADD, receiver_capture_fd(rx), &event) == 0;
+
+    dxwifi_rx_step_t status = DXWIFI_RX_STEP_READY;
+    while((status = receiver_step_capture(rx)) != DXWIFI_RX_STEP_DONE) {
+        if(status == DXWIFI_RX_STEP_WAIT && watched && epoll_wait(epfd, &event, 1, rx->capture_timeout * 1000) == 0) {
+            log_info("Reciever timeout occured");
+            receiver_stop_capture(rx);
+        }
+    }
+    receiver_end_capture(rx, stats);
+
+    close(epfd);
 }
 
 
+/**
+ *  DESCRIPTION:    Custom sink, writes the payload out as is and logs it
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h, @user points to the
+ *      output file descriptor
+ * 
+ */
+static ssize_t event_sink_block(const uint8_t* payload, size_t size, void* user) {
+    log_info("Sink block: %zu bytes", size);
+
+    ssize_t nbytes = write(*(int*) user, payload, size);
+    return nbytes < 0 ? 0 : nbytes;
+}
+
+
+/**
+ *  DESCRIPTION:    Custom sink, logs missing blocks without filling them in
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static ssize_t event_sink_gap(uint32_t missing, size_t block_size, void* user) {
+    log_info("Sink gap: %u blocks", missing);
+    return 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Custom sink, logs the start of a transmission and where a
+ *                  resumed one picks up
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static void event_sink_file_start(const dxwifi_resume_manifest* resume, void* user) {
+    if(resume) {
+        log_info("Sink file start: resume at block %u (byte %lu)", resume->block, resume->offset);
+    }
+    else {
+        log_info("Sink file start: preamble");
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Custom sink, logs the end of the capture
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static ssize_t event_sink_file_end(void* user) {
+    log_info("Sink file end");
+    return 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Captures into a custom sink the way a program consuming 
+ *                  the payloads itself would embed the receiver
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      rx:         Initialized receiver
+ * 
+ *      fd:         Opened file descriptor to output capture data
+ * 
+ *      stats:      Filled in once the capture ends
+ * 
+ */
+static void capture_into_event_sink(dxwifi_receiver* rx, int fd, dxwifi_rx_stats* stats) {
+    dxwifi_rx_sink sink = {
+        .on_block       = event_sink_block,
+        .on_gap         = event_sink_gap,
+        .on_file_start  = event_sink_file_start,
+        .on_file_end    = event_sink_file_end,
+        .user_args      = &fd
+    };
+    receiver_activate_capture_sink(rx, &sink, stats);
+}
+#endif
+
+
 /**
  *  DESCRIPTION:    Setups and tearsdown SIGINT handlers to control capture
  * 
@@ -131,6 +425,10 @@ void sigint_handler(int signum) {
  * 
  *      fd:         Opened file descriptor to output capture data
  * 
+ *  RETURNS:
+ *     
+ *      dxwifi_rx_state_t:  Last reported state of the receiver
+ * 
  */
 dxwifi_rx_state_t setup_handlers_and_capture(dxwifi_receiver* rx, int fd) {
     dxwifi_rx_stats stats;
@@ -140,11 +438,26 @@ dxwifi_rx_state_t setup_handlers_and_capture(dxwifi_receiver* rx, int fd) {
     sigaddset(&action.sa_mask, SIGINT);
     action.sa_handler = sigint_handler;
 
+    interrupt_target = rx;
     sigaction(SIGINT, &action, &prev_action);
+#if defined(DXWIFI_TESTS)
+    if(event_loop) {
+        capture_from_event_loop(rx, fd, &stats);
+    }
+    else if(sink_events) {
+        capture_into_event_sink(rx, fd, &stats);
+    }
+    else {
+        receiver_activate_capture(rx, fd, &stats);
+    }
+#else
     receiver_activate_capture(rx, fd, &stats);
+#endif
     sigaction(SIGINT, &prev_action, NULL);
+    interrupt_target = NULL;
     
     log_rx_stats(stats);
+    merge_link_stats(&link_totals, &stats.link);
     return stats.capture_state;
 }
 
@@ -205,6 +518,196 @@ void capture_in_directory(cli_args* args, dxwifi_receiver* rx) {
 }
 
 
+/**
+ *  DESCRIPTION:    Logs info about the depacketized units
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated reassembly statistics
+ * 
+ */
+void log_reassembly_stats(unit_reassembler_stats stats) {
+    log_debug(
+        "Unit Reassembly Stats\n"
+        "\tUnits Complete:              %d\n"
+        "\tUnits Dropped:               %d\n"
+        "\tDuplicate Fragments:         %d\n"
+        "\tOrphaned Fragments:          %d\n",
+        stats.units_complete,
+        stats.units_dropped,
+        stats.duplicates,
+        stats.orphans
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Logs info about the rebuilt JPEGs
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated depacketizer statistics
+ * 
+ */
+void log_jpeg_stats(jpeg_depacketizer_stats stats) {
+    log_debug(
+        "JPEG Depacketizer Stats\n"
+        "\tImages Written:              %d\n"
+        "\tIntervals Received:          %d\n"
+        "\tIntervals Substituted:       %d\n"
+        "\tHeaders Lost:                %d\n",
+        stats.images,
+        stats.intervals_received,
+        stats.intervals_substituted,
+        stats.headers_lost
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Logs info about the decompressed groups
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated depacketizer statistics
+ * 
+ */
+void log_compress_stats(compress_depacketizer_stats stats) {
+    log_debug(
+        "Decompression Stats\n"
+        "\tGroups Written:              %d\n"
+        "\tGroups Lost:                 %d\n"
+        "\tCorrupt Groups:              %d\n"
+        "\tNoise Added:                 %lu\n",
+        stats.groups,
+        stats.groups_lost,
+        stats.corrupt,
+        stats.bytes_filled
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Logs info about the files rebuilt from deltas
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated depacketizer statistics
+ * 
+ */
+void log_delta_stats(delta_depacketizer_stats stats) {
+    log_debug(
+        "Delta Stats\n"
+        "\tFiles Written:               %d\n"
+        "\tFiles Rebuilt From Deltas:   %d\n"
+        "\tFiles Verified:              %d\n"
+        "\tMissing References:          %d\n",
+        stats.files,
+        stats.delta_files,
+        stats.verified,
+        stats.missing_refs
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Attaches the depacketizer selected on the command line
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      rx:         Initialized reciever
+ * 
+ *      state:      Storage for the selected depacketizer
+ * 
+ */
+void attach_depacketizer(cli_args* args, dxwifi_receiver* rx, depacketizer_state* state) {
+    switch (args->depacketizer)
+    {
+    case RX_DEPACKETIZER_NAL:
+        init_nalu_depacketizer(&state->nalu);
+
+        rx->depacketizer.write_block    = nalu_depacketize;
+        rx->depacketizer.flush          = nalu_depacketizer_flush;
+        rx->depacketizer.user_args      = &state->nalu;
+        break;
+
+    case RX_DEPACKETIZER_JPEG:
+        init_jpeg_depacketizer(&state->jpeg);
+
+        rx->depacketizer.write_block    = jpeg_depacketize;
+        rx->depacketizer.flush          = jpeg_depacketizer_flush;
+        rx->depacketizer.user_args      = &state->jpeg;
+        break;
+
+    case RX_DEPACKETIZER_COMPRESS:
+        init_compress_depacketizer(&state->comp, rx->add_noise, rx->noise_value);
+
+        rx->depacketizer.write_block    = compress_depacketize;
+        rx->depacketizer.flush          = compress_depacketizer_flush;
+        rx->depacketizer.user_args      = &state->comp;
+        break;
+
+    case RX_DEPACKETIZER_DELTA:
+        init_delta_depacketizer(&state->delta, rx->noise_value);
+
+        rx->depacketizer.write_block    = delta_depacketize;
+        rx->depacketizer.flush          = delta_depacketizer_flush;
+        rx->depacketizer.user_args      = &state->delta;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Logs and tearsdown the attached depacketizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      rx:         Initialized reciever
+ * 
+ *      state:      Storage for the selected depacketizer
+ * 
+ */
+void detach_depacketizer(cli_args* args, dxwifi_receiver* rx, depacketizer_state* state) {
+    switch (args->depacketizer)
+    {
+    case RX_DEPACKETIZER_NAL:
+        log_reassembly_stats(state->nalu.reassembler.stats);
+        teardown_nalu_depacketizer(&state->nalu);
+        break;
+
+    case RX_DEPACKETIZER_JPEG:
+        log_reassembly_stats(state->jpeg.reassembler.stats);
+        log_jpeg_stats(state->jpeg.stats);
+        teardown_jpeg_depacketizer(&state->jpeg);
+        break;
+
+    case RX_DEPACKETIZER_COMPRESS:
+        log_reassembly_stats(state->comp.reassembler.stats);
+        log_compress_stats(state->comp.stats);
+        teardown_compress_depacketizer(&state->comp);
+        break;
+
+    case RX_DEPACKETIZER_DELTA:
+        log_reassembly_stats(state->delta.reassembler.stats);
+        log_delta_stats(state->delta.stats);
+        teardown_delta_depacketizer(&state->delta);
+        break;
+
+    default:
+        break;
+    }
+    memset(&rx->depacketizer, 0x00, sizeof(dxwifi_rx_depacketizer));
+}
+
+
 /**
  *  DESCRIPTION:    Determine receive mode and activate packet capture
  * 
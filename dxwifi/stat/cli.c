@@ -0,0 +1,121 @@
+/**
+ *  cli.c
+ *  
+ *  DESCRIPTION: Command line interface for stat.c
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <argp.h>
+#include <stdlib.h>
+
+#include <dxwifi/stat/cli.h>
+
+
+#define PRIMARY_GROUP           0
+#define HELP_GROUP              500
+
+// Description of key arguments 
+static char args_doc[] = "name [interval [count]]";
+
+// Program description
+static char doc[] = 
+    "Report the live metrics a tx or rx started with --metrics <name> publishes. "
+    "Counters are shown per second, the first line since the program started. "
+    "Stage latencies are the mean over each interval, in microseconds. "
+    "Reports every interval seconds, count times or until the program exits.";
+
+// Available command line options 
+static struct argp_option opts[] = { 
+    { "all",        'a', 0, 0, "Print every metric's current value once, one per line", PRIMARY_GROUP },
+    { "latency",    'l', 0, 0, "Show stage latencies from a program run with --latency", PRIMARY_GROUP },
+
+    { 0, 0, 0, 0, "Help options", HELP_GROUP },
+    { "verbose",    'v', 0, 0, "Verbosity level",       HELP_GROUP },
+    { "quiet",      'q', 0, 0, "Silence any output",    HELP_GROUP },
+
+    { 0 } // Final zero field is required by arg
+};
+
+
+static error_t parse_opt(int key, char* arg, struct argp_state *state) {
+
+    error_t status = 0;
+    cli_args* args = (cli_args*) state->input;
+
+    switch (key)
+    {
+    case ARGP_KEY_ARG:
+        switch (state->arg_num)
+        {
+        case 0:
+            args->name = arg;
+            break;
+
+        case 1:
+            args->interval = atoi(arg);
+            if(args->interval == 0) {
+                argp_error(state, "Interval must be at least one second");
+            }
+            break;
+
+        case 2:
+            args->count = atoi(arg);
+            break;
+
+        default:
+            argp_usage(state);
+            break;
+        }
+        break;
+
+    case ARGP_KEY_END:
+        if(state->arg_num < 1) {
+            argp_usage(state);
+        }
+        if(args->quiet) {
+            args->verbosity = 0;
+        }
+        break;
+
+    case 'a':
+        args->all = true;
+        break;
+
+    case 'l':
+        args->latency = true;
+        break;
+
+    case 'v':
+        ++args->verbosity;
+        break;
+
+    case 'q':
+        args->quiet = true;
+        break;
+
+    default:
+        status = ARGP_ERR_UNKNOWN;
+        break;
+    }
+    return status;
+}
+
+
+static struct argp argparser = { 
+    .options        = opts, 
+    .parser         = parse_opt, 
+    .args_doc       = args_doc, 
+    .doc            = doc, 
+    .children       = 0, 
+    .help_filter    = 0,
+    .argp_domain    = 0
+};
+
+
+int parse_args(int argc, char** argv, cli_args* out) {
+
+    return argp_parse(&argparser, argc, argv, 0, 0, out);
+
+}
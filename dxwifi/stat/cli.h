@@ -0,0 +1,42 @@
+/**
+ *  cli.h
+ *  
+ *  DESCRIPTION: Command line interface for stat.c
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+
+#include <stdbool.h>
+
+
+typedef struct {
+    const char*     name;
+    unsigned        interval;
+    int             count;
+    bool            all;
+    bool            latency;
+    int             verbosity;
+    bool            quiet;
+} cli_args;
+
+
+/**
+ *  DESCRIPTION:    Parse command line arguments into the cli_args struct
+ * 
+ *  ARGUMENTS:
+ * 
+ *      argc:       Number of command line arguments
+ * 
+ *      argv:       list of arguments
+ * 
+ *      out:        Pointer to allocated cli_args structure.
+ * 
+ *  RETURNS:
+ *      
+ *      int:        0 if arguments were parsed successfully
+ *     
+ *  
+ */
+int parse_args(int argc, char** argv, cli_args* out);
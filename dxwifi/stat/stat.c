@@ -0,0 +1,206 @@
+/**
+ *  stat.c
+ * 
+ *  DESCRIPTION: Reports the live metrics of a running tx or rx, like vmstat
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <inttypes.h>
+
+#include <dxwifi/stat/cli.h>
+
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/metrics.h>
+
+
+#define COLUMN_WIDTH    10
+#define HEADER_REPEAT   20  /* Rows between repeated column headers */
+
+
+typedef struct {
+    uint64_t    time;                           /* Monotonic, nanoseconds   */
+    uint64_t    values[DXWIFI_METRIC_COUNT];
+} metrics_sample;
+
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/**
+ *  DESCRIPTION:    Metrics this build and the publisher both know, that
+ *                  belong to the publisher's program
+ * 
+ */
+static bool is_published(const dxwifi_metrics_segment* segment, dxwifi_metric_t metric) {
+    return metric < segment->metric_count && metric_info(metric)->role == segment->role;
+}
+
+
+/**
+ *  DESCRIPTION:    Columns of the view, stage latencies or everything else
+ * 
+ */
+static bool is_shown(const dxwifi_metrics_segment* segment, dxwifi_metric_t metric, bool latency) {
+    dxwifi_metric_kind_t kind = metric_info(metric)->kind;
+    if(latency) {
+        return is_published(segment, metric) && kind == DXWIFI_METRIC_TIME;
+    }
+    return is_published(segment, metric) && (kind == DXWIFI_METRIC_COUNTER || kind == DXWIFI_METRIC_GAUGE);
+}
+
+
+static void take_sample(const dxwifi_metrics_segment* segment, metrics_sample* sample) {
+    sample->time = monotonic_ns();
+    for(size_t i = 0; i < DXWIFI_METRIC_COUNT; ++i) {
+        sample->values[i] = (i < segment->metric_count ? metrics_read(segment, i) : 0);
+    }
+}
+
+
+static bool publisher_exited(const dxwifi_metrics_segment* segment) {
+    return kill(segment->pid, 0) < 0 && errno == ESRCH;
+}
+
+
+static void print_header(const dxwifi_metrics_segment* segment, bool latency) {
+    for(size_t i = 0; i < DXWIFI_METRIC_COUNT; ++i) {
+        if(is_shown(segment, i, latency)) {
+            printf("%*s", COLUMN_WIDTH, metric_info(i)->column);
+        }
+    }
+    putchar('\n');
+}
+
+
+/**
+ *  DESCRIPTION:    Prints a row of counter rates over the time between two
+ *                  samples, and the gauges as of the latest one
+ * 
+ */
+static void print_row(const dxwifi_metrics_segment* segment, const metrics_sample* prev, const metrics_sample* curr) {
+    double elapsed = (curr->time - prev->time) / 1e9;
+
+    for(size_t i = 0; i < DXWIFI_METRIC_COUNT; ++i) {
+        if(!is_shown(segment, i, false)) {
+            continue;
+        }
+        uint64_t value = curr->values[i];
+        if(metric_info(i)->kind == DXWIFI_METRIC_COUNTER) {
+            value = (elapsed > 0 ? (curr->values[i] - prev->values[i]) / elapsed + 0.5 : 0);
+        }
+        printf("%*" PRIu64, COLUMN_WIDTH, value);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+
+/**
+ *  DESCRIPTION:    Prints a row of the mean time each stage took between two
+ *                  samples, in microseconds
+ * 
+ *  NOTES: Every time slot follows the slot counting the stage's samples
+ * 
+ */
+static void print_latency_row(const dxwifi_metrics_segment* segment, const metrics_sample* prev, const metrics_sample* curr) {
+    for(size_t i = 0; i < DXWIFI_METRIC_COUNT; ++i) {
+        if(!is_shown(segment, i, true)) {
+            continue;
+        }
+        uint64_t samples    = curr->values[i - 1] - prev->values[i - 1];
+        uint64_t time       = curr->values[i] - prev->values[i];
+        printf("%*.1f", COLUMN_WIDTH, samples > 0 ? (double) time / samples / 1e3 : 0.0);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+
+static void print_all(const dxwifi_metrics_segment* segment) {
+    for(size_t i = 0; i < DXWIFI_METRIC_COUNT; ++i) {
+        if(is_published(segment, i)) {
+            printf("%s %" PRIu64 "\n", metric_info(i)->name, metrics_read(segment, i));
+        }
+    }
+}
+
+
+int main(int argc, char** argv) {
+
+    cli_args args = {
+        .name       = NULL,
+        .interval   = 1,
+        .count      = -1, // Until the publisher exits
+        .all        = false,
+        .latency    = false,
+        .verbosity  = DXWIFI_LOG_INFO,
+        .quiet      = false,
+    };
+
+    parse_args(argc, argv, &args);
+
+    set_log_level(DXWIFI_LOG_ALL_MODULES, args.verbosity);
+
+    const dxwifi_metrics_segment* segment = attach_metrics(args.name);
+    if(!segment) {
+        exit(1);
+    }
+
+    if(args.all) {
+        print_all(segment);
+        detach_metrics(segment);
+        exit(0);
+    }
+
+    metrics_sample samples[2];
+    metrics_sample* prev = &samples[0];
+    metrics_sample* curr = &samples[1];
+
+    // The first row covers the time since the publisher started
+    memset(prev, 0x00, sizeof(metrics_sample));
+    prev->time = segment->start_time;
+
+    for(int row = 0; args.count < 0 || row < args.count; ++row) {
+        if(row > 0) {
+            msleep(args.interval * 1000, true);
+        }
+        bool exited = publisher_exited(segment);
+
+        take_sample(segment, curr);
+        if(row % HEADER_REPEAT == 0) {
+            print_header(segment, args.latency);
+        }
+        if(args.latency) {
+            print_latency_row(segment, prev, curr);
+        }
+        else {
+            print_row(segment, prev, curr);
+        }
+
+        metrics_sample* swap = prev;
+        prev = curr;
+        curr = swap;
+
+        if(exited) {
+            log_info("Process %d exited", segment->pid);
+            break;
+        }
+    }
+
+    detach_metrics(segment);
+
+    exit(0);
+}
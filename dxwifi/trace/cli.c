@@ -0,0 +1,113 @@
+/**
+ *  cli.c
+ *  
+ *  DESCRIPTION: Command line interface for trace.c
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <argp.h>
+#include <stdlib.h>
+
+#include <dxwifi/trace/cli.h>
+
+
+#define PRIMARY_GROUP           0
+#define HELP_GROUP              500
+
+#define GET_KEY(x, group) (x + group)
+
+// Description of key arguments 
+static char args_doc[] = "trace-file";
+
+// Program description
+static char doc[] = 
+    "Decode a frame trace recorded by tx or rx with --trace into text or pcapng";
+
+// Available command line options 
+static struct argp_option opts[] = { 
+    { "output",     'o', "<file>",  0, "Write to this file instead of stdout",                  PRIMARY_GROUP },
+    { "pcapng",     'p', 0,         0, "Write a pcapng capture of the recorded frame bytes",    PRIMARY_GROUP },
+    { "hexdump",    'x', 0,         0, "Dump the recorded bytes of each frame with the text",   PRIMARY_GROUP },
+
+    { 0, 0, 0, 0, "Help options", HELP_GROUP },
+    { "verbose",    'v', 0, 0, "Verbosity level",       HELP_GROUP },
+    { "quiet",      'q', 0, 0, "Silence any output",    HELP_GROUP },
+
+    { 0 } // Final zero field is required by arg
+};
+
+
+static error_t parse_opt(int key, char* arg, struct argp_state *state) {
+
+    error_t status = 0;
+    cli_args* args = (cli_args*) state->input;
+
+    switch (key)
+    {
+    case ARGP_KEY_ARG:
+        if(state->arg_num >= 1) {
+            argp_usage(state);
+        }
+        else {
+            args->trace_path = arg;
+        }
+        break;
+
+    case ARGP_KEY_END:
+        if(state->arg_num < 1) {
+            argp_usage(state);
+        }
+        if(args->hexdump && args->format == TRACE_FORMAT_PCAPNG) {
+            argp_error(state, "--hexdump only applies to text output");
+        }
+        if(args->quiet) {
+            args->verbosity = 0;
+        }
+        break;
+
+    case 'o':
+        args->output_path = arg;
+        break;
+
+    case 'p':
+        args->format = TRACE_FORMAT_PCAPNG;
+        break;
+
+    case 'x':
+        args->hexdump = true;
+        break;
+
+    case 'v':
+        ++args->verbosity;
+        break;
+
+    case 'q':
+        args->quiet = true;
+        break;
+
+    default:
+        status = ARGP_ERR_UNKNOWN;
+        break;
+    }
+    return status;
+}
+
+
+static struct argp argparser = { 
+    .options        = opts, 
+    .parser         = parse_opt, 
+    .args_doc       = args_doc, 
+    .doc            = doc, 
+    .children       = 0, 
+    .help_filter    = 0,
+    .argp_domain    = 0
+};
+
+
+int parse_args(int argc, char** argv, cli_args* out) {
+
+    return argp_parse(&argparser, argc, argv, 0, 0, out);
+
+}
@@ -0,0 +1,47 @@
+/**
+ *  cli.h
+ *  
+ *  DESCRIPTION: Command line interface for trace.c
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+
+#include <stdbool.h>
+
+
+typedef enum {
+    TRACE_FORMAT_TEXT,
+    TRACE_FORMAT_PCAPNG,
+} trace_format_t;
+
+
+typedef struct {
+    const char*     trace_path;
+    const char*     output_path;
+    trace_format_t  format;
+    bool            hexdump;
+    int             verbosity;
+    bool            quiet;
+} cli_args;
+
+
+/**
+ *  DESCRIPTION:    Parse command line arguments into the cli_args struct
+ * 
+ *  ARGUMENTS:
+ * 
+ *      argc:       Number of command line arguments
+ * 
+ *      argv:       list of arguments
+ * 
+ *      out:        Pointer to allocated cli_args structure.
+ * 
+ *  RETURNS:
+ *      
+ *      int:        0 if arguments were parsed successfully
+ *     
+ *  
+ */
+int parse_args(int argc, char** argv, cli_args* out);
@@ -0,0 +1,237 @@
+/**
+ *  trace.c
+ * 
+ *  DESCRIPTION: Decodes frame traces recorded by tx and rx
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <dxwifi/trace/cli.h>
+
+#include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define PCAPNG_SECTION_HEADER_BLOCK     0x0A0D0D0A
+#define PCAPNG_INTERFACE_BLOCK          0x00000001
+#define PCAPNG_ENHANCED_PACKET_BLOCK    0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC         0x1A2B3C4D
+#define PCAPNG_OPT_ENDOFOPT             0
+#define PCAPNG_OPT_COMMENT              1
+#define PCAPNG_OPT_IF_TSRESOL           9
+#define LINKTYPE_IEEE802_11_RADIOTAP    127
+
+#define PAD4(n) (((n) + 3) & ~3u)
+
+
+typedef void (*record_writer)(FILE* out, uint64_t event, const dxwifi_trace_record* record, const cli_args* args);
+
+
+/**
+ *  DESCRIPTION:    Describes what the frame number of a record holds
+ * 
+ */
+static void describe_record(const dxwifi_trace_record* record, char* buffer, size_t size) {
+    switch (record->stage)
+    {
+    case DXWIFI_TRACE_TX_CONTROL:
+    case DXWIFI_TRACE_RX_CONTROL:
+        snprintf(buffer, size, "%s %s", trace_stage_to_str(record->stage), control_frame_type_to_str(record->frame_no));
+        break;
+
+    default:
+        snprintf(buffer, size, "%s frame=%" PRId32, trace_stage_to_str(record->stage), record->frame_no);
+        break;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a record as a line of text, optionally followed by
+ *                  a hexdump of the recorded bytes
+ * 
+ */
+static void write_text_record(FILE* out, uint64_t event, const dxwifi_trace_record* record, const cli_args* args) {
+    char timestamp[64];
+    char description[64];
+    struct tm time;
+
+    time_t seconds = record->timestamp / 1000000000;
+    gmtime_r(&seconds, &time);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &time);
+    describe_record(record, description, sizeof(description));
+
+    fprintf(out, "%" PRIu64 " %s.%09" PRIu64 " %s length=%" PRIu32 " status=%" PRId32 "\n",
+        event,
+        timestamp,
+        record->timestamp % 1000000000,
+        description,
+        record->length,
+        record->status
+    );
+
+    if(args->hexdump) {
+        for(size_t i = 0; i < record->captured; i += 16) {
+            fprintf(out, "%08zx", i);
+            for(size_t j = i; j < i + 16 && j < record->captured; ++j) {
+                fprintf(out, " %02x", record->data[j]);
+            }
+            fputc('\n', out);
+        }
+    }
+}
+
+
+static void write_u32(FILE* out, uint32_t value) {
+    fwrite(&value, sizeof(value), 1, out);
+}
+
+
+static void write_u16(FILE* out, uint16_t value) {
+    fwrite(&value, sizeof(value), 1, out);
+}
+
+
+static void write_padded(FILE* out, const void* data, size_t size) {
+    static const uint8_t zeros[4] = { 0 };
+    fwrite(data, 1, size, out);
+    fwrite(zeros, 1, PAD4(size) - size, out);
+}
+
+
+/**
+ *  DESCRIPTION:    Starts a pcapng section with one radiotap interface,
+ *                  timestamps in nanoseconds
+ * 
+ */
+static void write_pcapng_header(FILE* out, uint32_t snaplen) {
+    const uint32_t shb_length = 28;
+    write_u32(out, PCAPNG_SECTION_HEADER_BLOCK);
+    write_u32(out, shb_length);
+    write_u32(out, PCAPNG_BYTE_ORDER_MAGIC);
+    write_u16(out, 1);  // Major version
+    write_u16(out, 0);  // Minor version
+    write_u32(out, 0xffffffff); // Section length isn't known up front
+    write_u32(out, 0xffffffff);
+    write_u32(out, shb_length);
+
+    const uint8_t tsresol = 9;
+    const uint32_t idb_length = 32;
+    write_u32(out, PCAPNG_INTERFACE_BLOCK);
+    write_u32(out, idb_length);
+    write_u16(out, LINKTYPE_IEEE802_11_RADIOTAP);
+    write_u16(out, 0);
+    write_u32(out, snaplen);
+    write_u16(out, PCAPNG_OPT_IF_TSRESOL);
+    write_u16(out, sizeof(tsresol));
+    write_padded(out, &tsresol, sizeof(tsresol));
+    write_u16(out, PCAPNG_OPT_ENDOFOPT);
+    write_u16(out, 0);
+    write_u32(out, idb_length);
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a record as an enhanced packet block, the stage and
+ *                  frame number go in the packet's comment
+ * 
+ */
+static void write_pcapng_record(FILE* out, uint64_t event, const dxwifi_trace_record* record, const cli_args* args) {
+    char comment[64];
+    describe_record(record, comment, sizeof(comment));
+    size_t comment_length = strlen(comment);
+
+    uint32_t block_length = 28 + PAD4(record->captured) + 4 + PAD4(comment_length) + 4 + 4;
+
+    write_u32(out, PCAPNG_ENHANCED_PACKET_BLOCK);
+    write_u32(out, block_length);
+    write_u32(out, 0); // Interface
+    write_u32(out, record->timestamp >> 32);
+    write_u32(out, record->timestamp & 0xffffffff);
+    write_u32(out, record->captured);
+    write_u32(out, record->length);
+    write_padded(out, record->data, record->captured);
+    write_u16(out, PCAPNG_OPT_COMMENT);
+    write_u16(out, comment_length);
+    write_padded(out, comment, comment_length);
+    write_u16(out, PCAPNG_OPT_ENDOFOPT);
+    write_u16(out, 0);
+    write_u32(out, block_length);
+}
+
+
+int main(int argc, char** argv) {
+
+    cli_args args = {
+        .trace_path     = NULL,
+        .output_path    = NULL,
+        .format         = TRACE_FORMAT_TEXT,
+        .hexdump        = false,
+        .verbosity      = DXWIFI_LOG_INFO,
+        .quiet          = false,
+    };
+
+    parse_args(argc, argv, &args);
+
+    set_log_level(DXWIFI_LOG_ALL_MODULES, args.verbosity);
+
+    dxwifi_trace trace;
+    if(!load_frame_trace(&trace, args.trace_path)) {
+        exit(1);
+    }
+
+    FILE* out = stdout;
+    if(args.output_path) {
+        out = fopen(args.output_path, "wb");
+        if(!out) {
+            log_error("Failed to open %s: %s", args.output_path, strerror(errno));
+            unload_frame_trace(&trace);
+            exit(1);
+        }
+    }
+
+    record_writer write_record = write_text_record;
+    if(args.format == TRACE_FORMAT_PCAPNG) {
+        write_pcapng_header(out, trace.header->snaplen);
+        write_record = write_pcapng_record;
+    }
+
+    uint64_t first      = frame_trace_first(&trace);
+    uint64_t head       = trace.header->head;
+    uint64_t skipped    = 0;
+
+    for(uint64_t event = first; event < head; ++event) {
+        const dxwifi_trace_record* record = frame_trace_record(&trace, event);
+        if(record) {
+            write_record(out, event, record, &args);
+        }
+        else {
+            ++skipped;
+        }
+    }
+
+    log_info("Decoded %" PRIu64 " of %" PRIu64 " frame events", head - first - skipped, head);
+    if(first > 0) {
+        log_info("%" PRIu64 " older events were overwritten", first);
+    }
+    if(skipped > 0) {
+        log_warning("%" PRIu64 " events were incomplete", skipped);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+    unload_frame_trace(&trace);
+
+    exit(0);
+}
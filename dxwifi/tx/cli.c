@@ -9,18 +9,27 @@
 
 
 #include <argp.h>
+#include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include <dxwifi/tx/cli.h>
 
 #include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/lz.h>
+#include <libdxwifi/details/framecache.h>
 #include <libdxwifi/details/utils.h>
 #include <libdxwifi/details/ieee80211.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/blockpool.h>
 
 
 #define PRIMARY_GROUP           0
 #define DIRECTORY_MODE_GROUP    500
+#define HISTORY_GROUP           600
+#define RETRANSMIT_GROUP        700
+#define PACKETIZER_GROUP        750
 #define MAC_HEADER_GROUP        1000
 #define RTAP_CONF_GROUP         1500
 #define RTAP_FLAGS_GROUP        2000
@@ -39,9 +48,36 @@ typedef enum {
     INCLUDE_ALL_FLAG,
     NO_LISTEN_FLAG,
     WATCHDIR_TIMEOUT,
+    RECURSIVE_FLAG,
+    QUEUE_SIZE,
+    FOLLOW_FLAG,
 } directory_mode_settings_t;
 
 
+typedef enum {
+    SENT_INDEX,
+    RESEND_FLAG,
+    CHECKPOINT,
+    CHECKPOINT_INTERVAL,
+} history_settings_t;
+
+
+typedef enum {
+    FRAME_CACHE,
+} retransmit_settings_t;
+
+
+typedef enum {
+    NAL_FLAG,
+    JPEG_FLAG,
+    KEY_REPEAT,
+    COMPRESS,
+    GROUP_BLOCKS,
+    DELTA,
+    DELTA_KEYFRAME,
+} packetizer_settings_t;
+
+
 // Description of key arguments 
 static char args_doc[] = "input-file(s)/directory(s)";
 
@@ -58,12 +94,35 @@ static struct argp_option opts[] = {
     { "file-delay",     'f', "<mseconds>",          0, "Length of time in milliseconds to delay between file transmissions",    PRIMARY_GROUP },
     { "redundancy",     'r', "<number>",            0, "Number of extra control frames to send",                                PRIMARY_GROUP },
     { "retransmit",     'c', "<number>",            0, "Number of times to retransmit a file, -1 for infinity",                 PRIMARY_GROUP },
+    { "workers",        'j', "<number>",            0, "Number of threads preparing frames ahead of injection, 0 for none",     PRIMARY_GROUP },
+    { "mmap",           'm', 0,                     0, "Map input files into memory and send from there instead of reading them", PRIMARY_GROUP },
 
     { 0, 0, 0, 0, "The following settings are only applicable when reading from a directory", DIRECTORY_MODE_GROUP },
     { "filter",         GET_KEY(FILE_FILTER,        DIRECTORY_MODE_GROUP),  "<glob>",       OPTION_NO_USAGE,  "Only transmit files that match filter",      DIRECTORY_MODE_GROUP },
     { "include-all",    GET_KEY(INCLUDE_ALL_FLAG,   DIRECTORY_MODE_GROUP),  0,              OPTION_NO_USAGE,  "include files currently in the directory",   DIRECTORY_MODE_GROUP },
     { "no-listen",      GET_KEY(NO_LISTEN_FLAG,     DIRECTORY_MODE_GROUP),  0,              OPTION_NO_USAGE,  "Don't listen for new files in the directory",DIRECTORY_MODE_GROUP },
     { "watch-timeout",  GET_KEY(WATCHDIR_TIMEOUT,   DIRECTORY_MODE_GROUP),  "<seconds>",    OPTION_NO_USAGE,  "Number of seconds to listen for new files",  DIRECTORY_MODE_GROUP },
+    { "recursive",      GET_KEY(RECURSIVE_FLAG,     DIRECTORY_MODE_GROUP),  0,              OPTION_NO_USAGE,  "Also listen for new files in subdirectories",DIRECTORY_MODE_GROUP },
+    { "follow",         GET_KEY(FOLLOW_FLAG,        DIRECTORY_MODE_GROUP),  0,              OPTION_NO_USAGE,  "Start sending new files while they're still being written",DIRECTORY_MODE_GROUP },
+    { "queue-size",     GET_KEY(QUEUE_SIZE,         DIRECTORY_MODE_GROUP),  "<files>",      OPTION_NO_USAGE,  "Number of new files that can wait for transmission",DIRECTORY_MODE_GROUP },
+
+    { 0, 0, 0, 0, "Keep track of what was sent across restarts, in file and directory mode", HISTORY_GROUP },
+    { "sent-index",     GET_KEY(SENT_INDEX,         HISTORY_GROUP),         "<file>",       OPTION_NO_USAGE,  "Skip files whose contents are recorded as sent in this index",HISTORY_GROUP },
+    { "resend",         GET_KEY(RESEND_FLAG,        HISTORY_GROUP),         0,              OPTION_NO_USAGE,  "Send files already in the index after the others instead of skipping them",HISTORY_GROUP },
+    { "checkpoint",     GET_KEY(CHECKPOINT,         HISTORY_GROUP),         "<file>",       OPTION_NO_USAGE,  "Journal the current file's progress, an interrupted file resumes where it stopped",HISTORY_GROUP },
+    { "checkpoint-interval", GET_KEY(CHECKPOINT_INTERVAL, HISTORY_GROUP), "<blocks>", OPTION_NO_USAGE,  "Number of blocks sent between journal writes",HISTORY_GROUP },
+
+    { 0, 0, 0, 0, "Retransmission Options", RETRANSMIT_GROUP },
+    { "frame-cache",    GET_KEY(FRAME_CACHE,        RETRANSMIT_GROUP),      "<MiB>",        OPTION_ARG_OPTIONAL | OPTION_NO_USAGE, "Keep a file's frames in memory between retransmissions, up to this size",RETRANSMIT_GROUP },
+
+    { 0, 0, 0, 0, "Packetizer Options (the receiver must use the matching option)", PACKETIZER_GROUP },
+    { "nal",            GET_KEY(NAL_FLAG,           PACKETIZER_GROUP),      0,              OPTION_NO_USAGE,  "Align frames to Annex-B H.264 NAL units",    PACKETIZER_GROUP },
+    { "jpeg",           GET_KEY(JPEG_FLAG,          PACKETIZER_GROUP),      0,              OPTION_NO_USAGE,  "Align frames to JPEG restart intervals",     PACKETIZER_GROUP },
+    { "key-repeat",     GET_KEY(KEY_REPEAT,         PACKETIZER_GROUP),      "<number>",     OPTION_NO_USAGE,  "Extra copies of key units (parameter sets, IDR slices, JPEG headers)", PACKETIZER_GROUP },
+    { "compress",       GET_KEY(COMPRESS,           PACKETIZER_GROUP),      "<level>",      OPTION_ARG_OPTIONAL | OPTION_NO_USAGE, "Compress groups of blocks, level 1 (fastest) to 9 (smallest)", PACKETIZER_GROUP },
+    { "group-blocks",   GET_KEY(GROUP_BLOCKS,       PACKETIZER_GROUP),      "<number>",     OPTION_NO_USAGE,  "Number of blocks compressed together",       PACKETIZER_GROUP },
+    { "delta",          GET_KEY(DELTA,              PACKETIZER_GROUP),      "<percent>",    OPTION_ARG_OPTIONAL | OPTION_NO_USAGE, "Send the changes from the previous file when they save at least this percent", PACKETIZER_GROUP },
+    { "delta-keyframe", GET_KEY(DELTA_KEYFRAME,     PACKETIZER_GROUP),      "<number>",     OPTION_NO_USAGE,  "Send every Nth file in full, 0 to disable",  PACKETIZER_GROUP },
 
     { 0, 0, 0, 0, "IEEE80211 MAC Header Configuration Options", MAC_HEADER_GROUP },
     { "address",        GET_KEY(1, MAC_HEADER_GROUP), "<macaddr>", OPTION_NO_USAGE, "MAC address of the transmitter", MAC_HEADER_GROUP },
@@ -82,11 +141,23 @@ static struct argp_option opts[] = {
     { 0, 0, 0, 0, "Help Options", HELP_GROUP },
     { "verbose",    'v', 0, 0, "Verbosity level",           HELP_GROUP },
     { "syslog",     's', 0, 0, "Use SysLog for messages",   HELP_GROUP }, 
+    { "async-log",  GET_KEY(1, HELP_GROUP), 0, 0, "Write messages from a background thread", HELP_GROUP },
+    { "log-sample", GET_KEY(2, HELP_GROUP), "<n>",          0, "Only log 1 in n per-frame debug messages",          HELP_GROUP },
+    { "log-rate",   GET_KEY(3, HELP_GROUP), "<per-sec>",    0, "Cap per-frame debug messages per second per site",  HELP_GROUP },
+    { "trace",          GET_KEY(4, HELP_GROUP), "<file>",       0, "Record every injected frame into a binary trace",   HELP_GROUP },
+    { "trace-bytes",    GET_KEY(5, HELP_GROUP), "<bytes>",      0, "Bytes of each frame kept in the trace",             HELP_GROUP },
+    { "trace-records",  GET_KEY(6, HELP_GROUP), "<records>",    0, "Frames the trace holds before it wraps around",     HELP_GROUP },
+    { "metrics",        GET_KEY(7, HELP_GROUP), "<name>",       0, "Publish live metrics for dxwifi-stat under this name", HELP_GROUP },
+    { "latency",        GET_KEY(8, HELP_GROUP), 0,              0, "Time each stage and log latency percentiles at exit", HELP_GROUP },
+    { "send-times",     GET_KEY(9, HELP_GROUP), "<n>",          0, "Pack the time every nth frame is sent into it, for rx --latency", HELP_GROUP },
     { "quiet",      'q', 0, 0, "Silence any output",        HELP_GROUP },
 
 #if defined(DXWIFI_TESTS)
     { 0, 0, 0, 0, "WARNING! You are running a test build!", TEST_GROUP },
     { "savefile", GET_KEY(1, TEST_GROUP), "<filename>", 0, "Dump packetized data into this file", TEST_GROUP },
+    { "busy-work", GET_KEY(2, TEST_GROUP), "<rounds>", 0, "Hash each payload this many times before it's sent, for benchmarks", TEST_GROUP },
+    { "event-loop", GET_KEY(3, TEST_GROUP), 0, 0, "Drive the transmission from an epoll loop with the step API", TEST_GROUP },
+    { "instances", GET_KEY(4, TEST_GROUP), "<count>", 0, "Send the files from this many transmitters on their own threads, each to <savefile>.<n>", TEST_GROUP },
 #endif
 
     { 0 } // Final zero field is required by argp
@@ -98,6 +169,36 @@ static bool parse_mac_address(const char* arg, uint8_t* mac) {
 }
 
 
+/**
+ *  DESCRIPTION:    Parses a whole number, exits with a usage error if the 
+ *                  argument isn't one or it's out of range
+ * 
+ *  ARGUMENTS:
+ * 
+ *      state:      Parser state, for the error
+ * 
+ *      arg:        Option argument
+ * 
+ *      name:       What the option sets, for the error
+ * 
+ *      min, max:   Inclusive range the value must be in
+ * 
+ *  RETURNS:
+ * 
+ *      long:       The parsed value
+ * 
+ */
+static long parse_ranged(struct argp_state* state, const char* arg, const char* name, long min, long max) {
+    char* end = NULL;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if(errno != 0 || end == arg || *end != '\0' || value < min || value > max) {
+        argp_error(state, "%s must be in the range(%ld, %ld)", name, min, max);
+    }
+    return value;
+}
+
+
 // TODO all these atois() need error handling
 static error_t parse_opt(int key, char* arg, struct argp_state *state) {
 
@@ -121,6 +222,32 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
         if(args->quiet) {
             args->verbosity = 0;
         }
+        if(args->follow_files && args->packetizer != TX_PACKETIZER_NONE) {
+            argp_error(state, "--follow only works with fixed size blocks");
+        }
+        if(args->checkpoint && args->packetizer != TX_PACKETIZER_NONE) {
+            argp_error(state, "--checkpoint only works with fixed size blocks");
+        }
+        if(args->frame_cache && args->packetizer == TX_PACKETIZER_DELTA) {
+            argp_error(state, "--frame-cache can't be used with --delta");
+        }
+        if(args->map_files && args->packetizer != TX_PACKETIZER_NONE) {
+            argp_error(state, "--mmap only works with fixed size blocks");
+        }
+        if(args->map_files && args->frame_cache) {
+            argp_error(state, "--frame-cache can't be used with --mmap");
+        }
+        if(args->map_files && args->tx_mode == TX_DIRECTORY_MODE) {
+            argp_error(state, "--mmap can't be used in directory mode, files there may still be written");
+        }
+#if defined(DXWIFI_TESTS)
+        if(args->instances > 0 && (args->tx_mode != TX_FILE_MODE || !args->tx.savefile)) {
+            argp_error(state, "--instances sends files to a --savefile");
+        }
+        if(args->instances > 0 && (args->packetizer != TX_PACKETIZER_NONE || args->sent_index || args->checkpoint || args->frame_cache || args->map_files)) {
+            argp_error(state, "--instances only sends fixed size blocks");
+        }
+#endif
         break; 
 
     case ARGP_KEY_INIT:
@@ -181,10 +308,60 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
         args->retransmit_count = atoi(arg);
         break;
 
+    case 'j':
+        args->tx.block_workers = parse_ranged(state, arg, "Number of workers", 0, BLOCK_POOL_THREADS_MAX);
+        break;
+
+    case 'm':
+        args->map_files = true;
+        break;
+
     case 's':
         args->use_syslog = true;
         break;
 
+    case GET_KEY(1, HELP_GROUP):
+        args->async_log = true;
+        break;
+
+    case GET_KEY(2, HELP_GROUP):
+        args->log_sample = parse_ranged(state, arg, "Log sampling", 0, INT_MAX);
+        break;
+
+    case GET_KEY(3, HELP_GROUP):
+        args->log_rate = parse_ranged(state, arg, "Log rate", 0, INT_MAX);
+        break;
+
+    case GET_KEY(4, HELP_GROUP):
+        args->trace = arg;
+        break;
+
+    case GET_KEY(5, HELP_GROUP):
+        if(strtol(arg, NULL, 10) < 0 || strtol(arg, NULL, 10) > DXWIFI_TRACE_SNAPLEN_MAX) {
+            argp_error(state, "Trace bytes must be in the range(0, %d)", DXWIFI_TRACE_SNAPLEN_MAX);
+        }
+        args->trace_snaplen = strtol(arg, NULL, 10);
+        break;
+
+    case GET_KEY(6, HELP_GROUP):
+        if(strtol(arg, NULL, 10) < 1 || strtol(arg, NULL, 10) > DXWIFI_TRACE_CAPACITY_MAX) {
+            argp_error(state, "Trace records must be in the range(1, %d)", DXWIFI_TRACE_CAPACITY_MAX);
+        }
+        args->trace_capacity = strtol(arg, NULL, 10);
+        break;
+
+    case GET_KEY(7, HELP_GROUP):
+        args->metrics = arg;
+        break;
+
+    case GET_KEY(8, HELP_GROUP):
+        args->latency = true;
+        break;
+
+    case GET_KEY(9, HELP_GROUP):
+        args->send_times = parse_ranged(state, arg, "Send time interval", 0, INT_MAX);
+        break;
+
     case GET_KEY(FILE_FILTER, DIRECTORY_MODE_GROUP):
         args->file_filter = arg;
         break;
@@ -197,10 +374,100 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
         args->listen_for_new_files = false;
         break;
 
+    case GET_KEY(RECURSIVE_FLAG, DIRECTORY_MODE_GROUP):
+        args->recursive_watch = true;
+        break;
+
     case GET_KEY(WATCHDIR_TIMEOUT, DIRECTORY_MODE_GROUP):
         args->dirwatch_timeout = atoi(arg);
         break;
 
+    case GET_KEY(FOLLOW_FLAG, DIRECTORY_MODE_GROUP):
+        args->follow_files = true;
+        break;
+
+    case GET_KEY(QUEUE_SIZE, DIRECTORY_MODE_GROUP):
+        if(atoi(arg) < 1) {
+            argp_error(state, "Queue size must be at least 1");
+        }
+        args->queue_size = atoi(arg);
+        break;
+
+    case GET_KEY(SENT_INDEX, HISTORY_GROUP):
+        args->sent_index = arg;
+        break;
+
+    case GET_KEY(RESEND_FLAG, HISTORY_GROUP):
+        args->resend_sent = true;
+        break;
+
+    case GET_KEY(CHECKPOINT, HISTORY_GROUP):
+        args->checkpoint = arg;
+        break;
+
+    case GET_KEY(CHECKPOINT_INTERVAL, HISTORY_GROUP):
+        if(atoi(arg) < 1) {
+            argp_error(state, "Checkpoint interval must be at least 1");
+        }
+        args->checkpoint_interval = atoi(arg);
+        break;
+
+    case GET_KEY(FRAME_CACHE, RETRANSMIT_GROUP):
+        args->frame_cache = FRAME_CACHE_LIMIT_DFLT;
+        if(arg) {
+            if(atoi(arg) < 1) {
+                argp_error(state, "Frame cache size must be at least 1 MiB");
+            }
+            args->frame_cache = (size_t) atoi(arg) * 1024 * 1024;
+        }
+        break;
+
+    case GET_KEY(NAL_FLAG, PACKETIZER_GROUP):
+        args->packetizer = TX_PACKETIZER_NAL;
+        break;
+
+    case GET_KEY(JPEG_FLAG, PACKETIZER_GROUP):
+        args->packetizer = TX_PACKETIZER_JPEG;
+        break;
+
+    case GET_KEY(KEY_REPEAT, PACKETIZER_GROUP):
+        args->key_repeats = atoi(arg);
+        break;
+
+    case GET_KEY(COMPRESS, PACKETIZER_GROUP):
+        args->packetizer = TX_PACKETIZER_COMPRESS;
+        if(arg) {
+            args->compress_level = atoi(arg);
+            if(args->compress_level < LZ_LEVEL_MIN || args->compress_level > LZ_LEVEL_MAX) {
+                argp_error(state, "Compression level must be in the range(%d, %d)", LZ_LEVEL_MIN, LZ_LEVEL_MAX);
+            }
+        }
+        break;
+
+    case GET_KEY(GROUP_BLOCKS, PACKETIZER_GROUP):
+        if(atoi(arg) < 1) {
+            argp_error(state, "Group blocks must be at least 1");
+        }
+        args->group_blocks = atoi(arg);
+        break;
+
+    case GET_KEY(DELTA, PACKETIZER_GROUP):
+        args->packetizer = TX_PACKETIZER_DELTA;
+        if(arg) {
+            if(atoi(arg) < 0 || atoi(arg) > 100) {
+                argp_error(state, "Delta threshold must be in the range(0, 100)");
+            }
+            args->delta_threshold = atoi(arg);
+        }
+        break;
+
+    case GET_KEY(DELTA_KEYFRAME, PACKETIZER_GROUP):
+        if(atoi(arg) < 0) {
+            argp_error(state, "Delta keyframe interval must be positive");
+        }
+        args->delta_keyframe = atoi(arg);
+        break;
+
     case GET_KEY(1, MAC_HEADER_GROUP):
         if( !parse_mac_address(arg, args->tx.address) )
         {
@@ -251,6 +518,18 @@ static error_t parse_opt(int key, char* arg, struct argp_state *state) {
     case GET_KEY(1, TEST_GROUP):
         args->tx.savefile = arg;
         break;
+
+    case GET_KEY(2, TEST_GROUP):
+        args->busy_work = atoi(arg);
+        break;
+
+    case GET_KEY(3, TEST_GROUP):
+        args->event_loop = true;
+        break;
+
+    case GET_KEY(4, TEST_GROUP):
+        args->instances = atoi(arg);
+        break;
 #endif 
 
     default:
@@ -17,6 +17,14 @@ typedef enum {
     TX_DIRECTORY_MODE,
 } tx_mode_t;
 
+typedef enum {
+    TX_PACKETIZER_NONE,
+    TX_PACKETIZER_NAL,
+    TX_PACKETIZER_JPEG,
+    TX_PACKETIZER_COMPRESS,
+    TX_PACKETIZER_DELTA,
+} tx_packetizer_t;
+
 // TODO this is defined arbitrarily, is there an upper limit to the number of 
 // Files to transmit at a time? 
 #define TX_CLI_FILE_MAX 1024
@@ -29,14 +37,43 @@ typedef struct {
     int                 retransmit_count;
     bool                transmit_current_files;
     bool                listen_for_new_files;
+    bool                recursive_watch;
+    bool                follow_files;
     int                 dirwatch_timeout; 
+    unsigned            queue_size;
+    const char*         sent_index;
+    bool                resend_sent;
+    const char*         checkpoint;
+    unsigned            checkpoint_interval;
+    size_t              frame_cache;
+    bool                map_files;
     int                 verbosity;
     bool                quiet;
     bool                use_syslog;
+    bool                async_log;
+    unsigned            log_sample;
+    unsigned            log_rate;
+    const char*         trace;
+    size_t              trace_snaplen;
+    size_t              trace_capacity;
+    const char*         metrics;
+    bool                latency;
+    unsigned            send_times;
     unsigned            tx_delay;
     unsigned            file_delay;
     const char*         device;
+    tx_packetizer_t     packetizer;
+    unsigned            key_repeats;
+    int                 compress_level;
+    unsigned            group_blocks;
+    unsigned            delta_threshold;
+    unsigned            delta_keyframe;
     dxwifi_transmitter  tx;
+#if defined(DXWIFI_TESTS)
+    unsigned            busy_work;
+    bool                event_loop;
+    unsigned            instances;
+#endif
 } cli_args;
 
 
@@ -7,7 +7,11 @@
  * 
  */
 
+#define DXWIFI_LOG_MODULE DXWIFI_LOG_TX
+
+#include <time.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -16,49 +20,168 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
-#include <dirent.h>
-#include <fnmatch.h>
+#include <pthread.h>
 
 #include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
 #include <linux/limits.h>
 
 #include <dxwifi/tx/cli.h>
 
 #include <libdxwifi/dxwifi.h>
 #include <libdxwifi/transmitter.h>
+#include <libdxwifi/details/jpeg.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/checkpoint.h>
+#include <libdxwifi/details/compress.h>
+#include <libdxwifi/details/delta.h>
+#include <libdxwifi/details/follow.h>
+#include <libdxwifi/details/framecache.h>
+#include <libdxwifi/details/nalu.h>
 #include <libdxwifi/details/utils.h>
 #include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/dirscan.h>
 #include <libdxwifi/details/dirwatch.h>
+#include <libdxwifi/details/jobqueue.h>
+#include <libdxwifi/details/sentindex.h>
 #include <libdxwifi/details/syslogger.h>
+#include <libdxwifi/details/asynclog.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+
+
+// Directory mode transmits from a worker so the watch keeps reading events
+typedef struct {
+    job_queue               queue;      /* Files waiting to be transmitted      */
+    file_follower           follower;   /* Files still being written            */
+    pthread_t               thread;     /* Transmit worker                      */
+    cli_args*               args;       /* Parsed command line arguments        */
+    volatile sig_atomic_t   interrupts; /* Number of SIGINTs received           */
+} tx_worker;
+
+
+// Remembers which files were sent across runs, see sentindex.h
+typedef struct {
+    sent_index      index;          /* Opened sent index                        */
+    bool            resend;         /* Send sent files last, don't skip them    */
+    bool            hash_payloads;  /* Payloads are the raw bytes of the file   */
+    bool            hashing;        /* A tracked transmission is in progress    */
+    content_hash    hash;           /* Hash of the payloads sent so far         */
+} sent_tracker;
+
+
+// Lets an interrupted file resume where it stopped, see checkpoint.h
+typedef struct {
+    checkpoint_journal  journal;        /* Opened checkpoint journal            */
+    bool                recording;      /* Frames go towards the journal        */
+} resume_tracker;
 
 
 dirwatch* dirwatch_handle = NULL;
-dxwifi_transmitter* transmitter = NULL;
+tx_worker* worker_handle = NULL;
+sent_tracker* sent_files = NULL;
+resume_tracker* checkpoints = NULL;
+frame_cache* frames = NULL;
+bool map_files = false;
+
+#if defined(DXWIFI_TESTS)
+bool event_loop = false;
+#endif
+
+// Transmitter SIGINT stops, only set while a handler is installed
+static dxwifi_transmitter* interrupt_target = NULL;
+
+// Frames recorded with --trace
+static dxwifi_trace frame_trace = { .fd = -1 };
+
+// Counters published with --metrics
+static dxwifi_metrics live_metrics = { 0 };
+
+// Stages timed with --latency
+static dxwifi_latency stage_latency;
+
+
+// Storage for whichever packetizer is selected
+typedef union {
+    nalu_packetizer nalu;
+    jpeg_packetizer jpeg;
+    compress_packetizer comp;
+    delta_packetizer delta;
+} packetizer_state;
 
 
 // Forward declare
 void transmit(cli_args* args, dxwifi_transmitter* tx);
+void attach_packetizer(cli_args* args, dxwifi_transmitter* tx, packetizer_state* state);
+void detach_packetizer(cli_args* args, dxwifi_transmitter* tx, packetizer_state* state);
+uint32_t* packetizer_unit_seq(cli_args* args, packetizer_state* state);
+void log_sent_index_stats(sent_index_stats stats);
+void log_checkpoint_stats(checkpoint_stats stats);
+void log_frame_cache_stats(frame_cache_stats stats);
+void close_trace(void);
+void close_live_metrics(void);
+#if defined(DXWIFI_TESTS)
+void transmit_instances(cli_args* args);
+#endif
 
 
 int main(int argc, char** argv) {
 
+    packetizer_state packetizer;
+    sent_tracker tracker;
+    resume_tracker resume;
+    frame_cache cache;
+
     cli_args args = {
         .tx_mode                    = TX_STREAM_MODE,
         .verbosity                  = DXWIFI_LOG_INFO,
         .quiet                      = false,
         .use_syslog                 = false,
+        .async_log                  = false,
+        .log_sample                 = 0,
+        .log_rate                   = 0,
+        .trace                      = NULL,
+        .trace_snaplen              = DXWIFI_TRACE_SNAPLEN_DFLT,
+        .trace_capacity             = DXWIFI_TRACE_CAPACITY_DFLT,
+        .metrics                    = NULL,
+        .latency                    = false,
+        .send_times                 = 0,
         .file_count                 = 0,
         .file_filter                = "*",
         .retransmit_count           = 0,
         .transmit_current_files     = false,
         .listen_for_new_files       = true,
+        .recursive_watch            = false,
+        .follow_files               = false,
         .dirwatch_timeout           = -1,
+        .queue_size                 = JOB_QUEUE_CAPACITY_DFLT,
+        .sent_index                 = NULL,
+        .resend_sent                = false,
+        .checkpoint                 = NULL,
+        .checkpoint_interval        = CHECKPOINT_INTERVAL_DFLT,
+        .frame_cache                = 0,
+        .map_files                  = false,
         .tx_delay                   = 0,
         .file_delay                 = 0,
         .device                     = "mon0",
+        .packetizer                 = TX_PACKETIZER_NONE,
+        .key_repeats                = 0,
+        .compress_level             = LZ_LEVEL_DFLT,
+        .group_blocks               = COMPRESS_GROUP_BLOCKS_DFLT,
+        .delta_threshold            = DELTA_THRESHOLD_DFLT,
+        .delta_keyframe             = DELTA_KEYFRAME_DFLT,
+
+#if defined(DXWIFI_TESTS)
+        .busy_work                  = 0,
+        .event_loop                 = false,
+        .instances                  = 0,
+#endif
 
         .tx = {
             .blocksize              = 1024,
+            .block_workers          = 0,
             .transmit_timeout       = -1, 
             .redundant_ctrl_frames  = 0,
             .rtap_flags             = IEEE80211_RADIOTAP_F_FCS,
@@ -82,26 +205,145 @@ int main(int argc, char** argv) {
             .address = {0xAA, 0xAA ,0xAA, 0xAA, 0xAA, 0xAA },
         }
     };
-    transmitter = &args.tx;
+    dxwifi_transmitter* transmitter = &args.tx;
 
     parse_args(argc, argv, &args);
 
-    if(args.use_syslog) {
+    map_files = args.map_files;
+#if defined(DXWIFI_TESTS)
+    event_loop = args.event_loop;
+#endif
+
+    if(args.async_log) {
+        // Flushed by the atexit handler, whichever way the program exits
+        if(init_async_logger(args.use_syslog ? ASYNC_LOG_SYSLOG : ASYNC_LOG_STDERR, ASYNC_LOG_CAPACITY_DFLT)) {
+            set_logger(DXWIFI_LOG_ALL_MODULES, async_logger);
+            atexit(teardown_async_logger);
+        }
+    }
+    else if(args.use_syslog) {
         set_logger(DXWIFI_LOG_ALL_MODULES, syslogger);
     }
 
     set_log_level(DXWIFI_LOG_ALL_MODULES, args.verbosity);
+    set_log_sampling(DXWIFI_LOG_ALL_MODULES, args.log_sample);
+    set_log_rate_limit(DXWIFI_LOG_ALL_MODULES, args.log_rate);
+
+    if(args.trace) {
+        if(!open_frame_trace(&frame_trace, args.trace, args.trace_capacity, args.trace_snaplen)) {
+            exit(1);
+        }
+        transmitter->trace = &frame_trace;
+        atexit(close_trace);
+    }
+    if(args.metrics) {
+        if(!open_metrics(&live_metrics, args.metrics, DXWIFI_METRICS_TX)) {
+            exit(1);
+        }
+        transmitter->metrics = &live_metrics;
+        atexit(close_live_metrics);
+    }
+    if(args.latency) {
+        init_latency(&stage_latency, transmitter->metrics);
+        transmitter->latency = &stage_latency;
+    }
+
+#if defined(DXWIFI_TESTS)
+    if(args.instances > 0) {
+        transmit_instances(&args);
+        exit(0);
+    }
+#endif
+
+    if(args.sent_index) {
+        if(!open_sent_index(&tracker.index, args.sent_index)) {
+            exit(1);
+        }
+        tracker.resend  = args.resend_sent;
+        tracker.hashing = false;
+
+        // Packetizers rewrite the payloads, those files are hashed separately
+        tracker.hash_payloads = (args.packetizer == TX_PACKETIZER_NONE);
+        sent_files = &tracker;
+    }
+    if(args.checkpoint) {
+        if(!open_checkpoint_journal(&resume.journal, args.checkpoint, args.checkpoint_interval)) {
+            exit(1);
+        }
+        resume.recording = false;
+        checkpoints = &resume;
+    }
 
     init_transmitter(transmitter, args.device);
 
+    attach_packetizer(&args, transmitter, &packetizer);
+
+    if(args.frame_cache) {
+        init_frame_cache(&cache, args.frame_cache, packetizer_unit_seq(&args, &packetizer));
+        frames = &cache;
+    }
+
     transmit(&args, transmitter);
 
+    detach_packetizer(&args, transmitter, &packetizer);
+
+    if(sent_files) {
+        log_sent_index_stats(sent_files->index.stats);
+        close_sent_index(&sent_files->index);
+        sent_files = NULL;
+    }
+    if(checkpoints) {
+        log_checkpoint_stats(checkpoints->journal.stats);
+        close_checkpoint_journal(&checkpoints->journal);
+        checkpoints = NULL;
+    }
+    if(frames) {
+        log_frame_cache_stats(frames->stats);
+        teardown_frame_cache(frames);
+        frames = NULL;
+    }
+
     close_transmitter(transmitter);
 
+    if(args.latency) {
+        log_latency_summary(&stage_latency);
+    }
+
+    uint64_t suppressed = get_log_suppressed(DXWIFI_LOG_ALL_MODULES);
+    if(suppressed > 0) {
+        log_info("%" PRIu64 " debug messages suppressed by sampling or rate limits", suppressed);
+    }
+    if(args.async_log) {
+        // Written out first, so this can't be dropped as well
+        async_logger_flush();
+        async_log_stats log_stats = async_logger_get_stats();
+        if(log_stats.dropped > 0) {
+            log_warning("%" PRIu64 " of %" PRIu64 " messages dropped by the async logger", log_stats.dropped, log_stats.logged + log_stats.dropped);
+        }
+    }
+
     exit(0);
 }
 
 
+/**
+ *  DESCRIPTION:    Closes the frame trace, registered with atexit
+ * 
+ */
+void close_trace(void) {
+    close_frame_trace(&frame_trace);
+}
+
+
+/**
+ *  DESCRIPTION:    Stops publishing metrics, registered with atexit
+ * 
+ */
+void close_live_metrics(void) {
+    close_metrics(&live_metrics);
+}
+
+
 /**
  *  DESCRIPTION:    Signals to the transmitter to stop transmission
  * 
@@ -111,12 +353,14 @@ int main(int argc, char** argv) {
  * 
  */
 void tx_sigint_handler(int signum) {
-    stop_transmission(transmitter);
+    stop_transmission(interrupt_target);
 }
 
 
 /**
- *  DESCRIPTION:    Signals to the watch loop to close out
+ *  DESCRIPTION:    Signals to the watch loop to close out. The first SIGINT
+ *                  lets the worker drain the files already queued, a second
+ *                  one stops the current transmission and discards the rest.
  * 
  *  ARGUMENTS: 
  *      
@@ -124,7 +368,12 @@ void tx_sigint_handler(int signum) {
  * 
  */
 void watchdir_sigint_handler(int signum) {
-    dirwatch_stop(dirwatch_handle);
+    if(worker_handle->interrupts++ == 0) {
+        dirwatch_stop(dirwatch_handle);
+    }
+    else {
+        stop_transmission(interrupt_target);
+    }
 }
 
 
@@ -139,8 +388,8 @@ void watchdir_sigint_handler(int signum) {
 void log_tx_stats(dxwifi_tx_stats stats) {
     log_debug(
         "Transmission Stats\n"
-        "\tTotal Bytes Read:    %d\n"
-        "\tTotal Bytes Sent:    %d\n"
+        "\tTotal Bytes Read:    %" PRIu64 "\n"
+        "\tTotal Bytes Sent:    %" PRIu64 "\n"
         "\tTotal Frames Sent:   %d\n",
         stats.total_bytes_read,
         stats.total_bytes_sent,
@@ -186,7 +435,8 @@ size_t delay_transmission(dxwifi_tx_frame* frame, size_t payload_size, dxwifi_tx
 /**
  *  DESCRIPTION:    Called before every frame is injected, packs the current 
  *                  frame count into the last four bytes of the MAC headers 
- *                  addr1 field
+ *                  addr1 field. Only depends on the frame count so it's 
+ *                  attached as a pure handler.
  * 
  *  ARGUMENTS: 
  * 
@@ -203,215 +453,1360 @@ size_t attach_frame_number(dxwifi_tx_frame* frame, size_t payload_size, dxwifi_t
 
 
 /**
- *  DESCRIPTION:    Setups and tearsdown SIGINT handlers to control transmission
+ *  DESCRIPTION:    Called before every frame is injected, packs the wall clock
+ *                  time into the MAC header's addr3 field of every nth frame,
+ *                  see DXWIFI_SEND_TIME_BITS. Attached after any delay so the
+ *                  time is taken right before the frame goes out.
  * 
  *  ARGUMENTS: 
- *      
- *      tx:         Initialized transmitter
  * 
- *      fd:         Opened file descriptor of the file to be transmitted
+ *      See definition of dxwifi_tx_frame_cb in transmitter.h
  * 
  */
-dxwifi_tx_state_t setup_handlers_and_transmit(dxwifi_transmitter* tx, int fd) {
-    dxwifi_tx_stats stats;
+size_t attach_send_time(dxwifi_tx_frame* frame, size_t payload_size, dxwifi_tx_stats stats, void* user) {
+    unsigned every = *(unsigned*) user;
+    uint8_t* addr3 = frame->mac_hdr->addr3;
+
+    if(stats.frame_count % every != 0) {
+        // Frames are reused, clear the time of whatever went out in this one
+        memset(addr3, 0xff, IEEE80211_MAC_ADDR_LEN);
+        return payload_size;
+    }
 
-    struct sigaction action = { 0 }, prev_action = { 0 };
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
 
-    sigemptyset(&action.sa_mask);
-    sigaddset(&action.sa_mask, SIGINT);
-    action.sa_handler = tx_sigint_handler;
+    uint64_t micros = (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    for(int i = IEEE80211_MAC_ADDR_LEN - 1; i >= 0; --i) {
+        addr3[i] = micros & 0xff;
+        micros >>= 8;
+    }
+    return payload_size;
+}
 
-    sigaction(SIGINT, &action, &prev_action);
-    start_transmission(tx, fd, &stats);
-    sigaction(SIGINT, &prev_action, NULL);
 
-    log_tx_stats(stats);
-    return stats.tx_state;
+#if defined(DXWIFI_TESTS)
+/**
+ *  DESCRIPTION:    Stand in for a CPU heavy pure handler, hashes the payload
+ *                  over and over without changing the frame
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      See definition of dxwifi_tx_frame_cb in transmitter.h
+ * 
+ */
+size_t hash_payload_busily(dxwifi_tx_frame* frame, size_t payload_size, dxwifi_tx_stats stats, void* user) {
+    unsigned rounds = *(unsigned*) user;
+
+    volatile uint64_t sink = 0;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned i = 0; i < rounds; ++i) {
+        for(size_t j = 0; j < payload_size; ++j) {
+            hash ^= frame->payload[j];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    sink = hash;
+    (void) sink;
+
+    return payload_size;
 }
+#endif
 
 
 /**
- *  DESCRIPTION:    Iterates through a list of file names, opens them, and 
- *                  transmits them
+ *  DESCRIPTION:    Called after every batch of frames is injected, adds the 
+ *                  transmitted bytes to the content hash of the file being sent
  * 
  *  ARGUMENTS: 
- *      
- *      tx:         Initialized transmitter
  * 
- *      files:      List of files to transmit
+ *      See definition of dxwifi_tx_batch_cb in transmitter.h
  * 
- *      delay:      Millisecond delay to add between file transmission. 
+ */
+void hash_transmitted_data(dxwifi_tx_batch* batch, void* user) {
+    sent_tracker* tracker = (sent_tracker*) user;
+
+    if(tracker->hashing) {
+        for(size_t i = 0; i < batch->count; ++i) {
+            content_hash_update(&tracker->hash, batch->frames[i].payload, batch->stats[i].prev_bytes_read);
+        }
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Called after every batch of frames is injected, advances 
+ *                  the checkpoint journal past the last frame of the batch
  * 
- *      retransmit_count:
- *                  Number of times to retransmit the file. If the count is -1
- *                  then the file will be retransmitted forever or until the 
- *                  transmitter reports a timeout or error
+ *  ARGUMENTS: 
  * 
- *  RETURNS:
+ *      See definition of dxwifi_tx_batch_cb in transmitter.h
+ * 
+ */
+void record_checkpoint(dxwifi_tx_batch* batch, void* user) {
+    resume_tracker* tracker = (resume_tracker*) user;
+
+    if(tracker->recording) {
+        checkpoint_advance(&tracker->journal, batch->stats[batch->count - 1].frame_count);
+    }
+}
+
+
+#if defined(DXWIFI_TESTS)
+/**
+ *  DESCRIPTION:    Drives a transmission with the step API from an epoll 
+ *                  loop, the way a program juggling other event sources 
+ *                  would embed the transmitter
+ * 
+ *  ARGUMENTS: 
  *      
- *      dxwifi_tx_state_t: The last reported state of the transmitter
+ *      tx:         Initialized transmitter
+ * 
+ *      fd:         Opened file descriptor of the file to be transmitted
+ * 
+ *      resume:     Where an interrupted transmission left off, or NULL
+ * 
+ *      stats:      Filled in once the transmission ends
  * 
  */
-dxwifi_tx_state_t transmit_files(dxwifi_transmitter* tx, char** files, size_t num_files, unsigned delay, int retransmit_count) {
-    int fd = 0;
-    dxwifi_tx_state_t state = DXWIFI_TX_NORMAL;
+static void transmit_from_event_loop(dxwifi_transmitter* tx, int fd, const dxwifi_resume_manifest* resume, dxwifi_tx_stats* stats) {
+    int epfd = epoll_create1(0);
+    assert_M(epfd >= 0, "Failed to create epoll instance: %s", strerror(errno));
 
-    for(size_t i = 0; i < num_files && state == DXWIFI_TX_NORMAL; ++i) {
-        if((fd = open(files[i], O_RDONLY)) < 0) {
-            log_error("Failed to open file: %s - %s", files[i], strerror(errno));
-        }
-        else {
-            log_info("Opened %s for transmission", files[i]);
+    begin_transmission(tx, fd, resume);
 
-            int count = retransmit_count;
-            bool transmit_forever = (retransmit_count == -1);
-            while((count >= 0 || transmit_forever) && state == DXWIFI_TX_NORMAL) {
-                int status = lseek(fd, 0, SEEK_SET);
-
-                if(status == -1) {
-                    log_error("Failed to seek to beginning of file: %s", strerror(errno));
-                    state = DXWIFI_TX_ERROR;
-                }
-                else {
-                    state = setup_handlers_and_transmit(tx, fd);
-                    msleep(delay, false);
-                }
-                --count;
-            }
-            close(fd);
+    // Regular files can't be watched, but they're always ready anyways
+    struct epoll_event event = { .events = EPOLLIN };
+    bool watched = epoll_ctl(epfd, EPOLL_CTL_ADD, transmission_fd(tx), &event) == 0;
+
+    dxwifi_tx_step_t status = DXWIFI_TX_STEP_READY;
+    while((status = step_transmission(tx)) != DXWIFI_TX_STEP_DONE) {
+        if(status == DXWIFI_TX_STEP_WAIT && watched && epoll_wait(epfd, &event, 1, tx->transmit_timeout * 1000) == 0) {
+            log_info("Transmitter timeout occured");
+            stop_transmission(tx);
         }
     }
-    return state;
+    end_transmission(tx, stats);
+
+    close(epfd);
+}
+#endif
+
+
+static void transmit_or_resume(dxwifi_transmitter* tx, int fd, const struct iovec* map, const dxwifi_resume_manifest* resume, dxwifi_tx_stats* stats) {
+#if defined(DXWIFI_TESTS)
+    if(event_loop && !map) {
+        transmit_from_event_loop(tx, fd, resume, stats);
+        return;
+    }
+#endif
+    if(resume) {
+        resume_transmission(tx, fd, resume, stats);
+    }
+    else if(map) {
+        start_transmission_iov(tx, map, 1, stats);
+    }
+    else {
+        start_transmission(tx, fd, stats);
+    }
 }
 
 
 /**
- *  DESCRIPTION:    Transmit all files in a directory that matches a filter
+ *  DESCRIPTION:    Setups and tearsdown SIGINT handlers to control transmission
  * 
  *  ARGUMENTS: 
  *      
  *      tx:         Initialized transmitter
  * 
- *      filter:     Glob pattern to filter which files should be transmitted
+ *      fd:         Opened file descriptor of the file to be transmitted
  * 
- *      dirname:    Name of target directory
+ *      map:        The file mapped into memory to send from instead of 
+ *                  reading fd, or NULL
  * 
- *      delay:      Inter-file transmission delay in milliseconds
+ *      resume:     Where an interrupted transmission left off, or NULL to 
+ *                  start from the beginning
  * 
  */
-void transmit_directory_contents(dxwifi_transmitter* tx, const char* filter, const char* dirname, unsigned delay, int retransmit_count) {
-    DIR* dir;
-    struct dirent* file;
-    dxwifi_tx_state_t state = DXWIFI_TX_NORMAL;
-    char* path_buffer = calloc(PATH_MAX, sizeof(char));
+dxwifi_tx_state_t setup_handlers_and_transmit(dxwifi_transmitter* tx, int fd, const struct iovec* map, const dxwifi_resume_manifest* resume) {
+    dxwifi_tx_stats stats;
 
-    if((dir = opendir(dirname)) == NULL) {
-        log_error("Failed to open directory: %s - %s", dirname, strerror(errno));
+    // The directory watch owns SIGINT while its worker is transmitting
+    if(worker_handle) {
+        transmit_or_resume(tx, fd, map, resume, &stats);
     }
     else {
-        while((file = readdir(dir)) && state == DXWIFI_TX_NORMAL) {
-            if(fnmatch(filter, file->d_name, 0) == 0) {
-                combine_path(path_buffer, PATH_MAX, dirname, file->d_name);
-                if(is_regular_file(path_buffer)) {
-                    state = transmit_files(tx, &path_buffer, 1, delay, retransmit_count);
-                }
-            }
-        }
-        closedir(dir);
+        struct sigaction action = { 0 }, prev_action = { 0 };
+
+        sigemptyset(&action.sa_mask);
+        sigaddset(&action.sa_mask, SIGINT);
+        action.sa_handler = tx_sigint_handler;
+
+        interrupt_target = tx;
+        sigaction(SIGINT, &action, &prev_action);
+        transmit_or_resume(tx, fd, map, resume, &stats);
+        sigaction(SIGINT, &prev_action, NULL);
+        interrupt_target = NULL;
     }
-    free(path_buffer);
+
+    log_tx_stats(stats);
+    return stats.tx_state;
 }
 
 
 /**
- *  DESCRIPTION:    Dirwatch callback, transmits newly created file
+ *  DESCRIPTION:    Checks the sent index for a file
  * 
  *  ARGUMENTS: 
  *      
- *      event:      Creation and close event
+ *      fd:         Opened file descriptor of the file
  * 
- *      user:       Command line arguments
+ *      path:       Path of the file
+ * 
+ *  RETURNS:
+ *      
+ *      bool:       true if the file, or a copy of it, was already sent
  * 
  */
-static void transmit_new_file(const dirwatch_event* event, void* user) {
-    cli_args* args = (cli_args*) user;
+static bool was_sent(int fd, const char* path) {
+    struct stat st;
+    uint32_t count = 0;
 
-    char* path_buffer = calloc(PATH_MAX, sizeof(char));
+    if(!sent_files || fstat(fd, &st) < 0) {
+        return false;
+    }
 
-    combine_path(path_buffer, PATH_MAX, event->dirname, event->filename);
+    switch (sent_index_lookup(&sent_files->index, fd, &st, &count))
+    {
+    case SENT_UNCHANGED:
+        log_info("%s was already sent %d times", path, count);
+        return true;
 
-    transmit_files(&args->tx, &path_buffer, 1, args->file_delay, args->retransmit_count);
+    case SENT_DUPLICATE:
+        log_info("%s has the same contents as a file sent %d times", path, count);
+        return true;
 
-    free(path_buffer);
+    default:
+        return false;
+    }
 }
 
 
 /**
- *  DESCRIPTION:    Transmits current directory contents and listens for newly
- *                  created files to transmit
+ *  DESCRIPTION:    Records the file in the sent index once it was transmitted
+ *                  in full
  * 
  *  ARGUMENTS: 
  *      
- *      args:       Parsed command line arguments
+ *      fd:         Opened file descriptor of the transmitted file
  * 
- *      tx:         Initialized transmitter
+ *      state:      State the transmission ended in
+ * 
+ *      resumed:    Only the end of the file was sent this time
  * 
  */
-void transmit_directory(cli_args* args, dxwifi_transmitter* tx) {
+static void record_sent(int fd, dxwifi_tx_state_t state, bool resumed) {
+    struct stat st;
 
-    const char* dirname = args->files[0];
+    sent_files->hashing = false;
 
-    if(args->transmit_current_files) {
-        transmit_directory_contents(tx, args->file_filter, dirname, args->file_delay, args->retransmit_count);
+    if(state != DXWIFI_TX_NORMAL || fstat(fd, &st) < 0) {
+        return;
     }
-    if(args->listen_for_new_files) {
-
-        dirwatch_handle = dirwatch_init();
-
-        dirwatch_add(dirwatch_handle, dirname, args->file_filter, DW_CREATE_AND_CLOSE, true);
 
-        // Setup handlers for exiting loop
-        struct sigaction action = { 0 }, prev_action = { 0 };
-        memset(&prev_action, 0x00, sizeof(sigaction));
-        sigemptyset(&action.sa_mask);
-        sigaddset(&action.sa_mask, SIGINT);
-        action.sa_handler = watchdir_sigint_handler;
-        sigaction(SIGINT, &action, &prev_action);
+    content_hash hash = sent_files->hash;
+    if((resumed || !sent_files->hash_payloads) && !content_hash_file(fd, &hash)) {
+        log_error("Failed to hash file for the sent index: %s", strerror(errno));
+        return;
+    }
+    sent_index_record(&sent_files->index, &hash, &st);
+}
 
-        dirwatch_listen(dirwatch_handle, args->dirwatch_timeout * 1000, transmit_new_file, args);
 
-        sigaction(SIGINT, &prev_action, NULL);
+/**
+ *  DESCRIPTION:    Maps a regular file into memory so it can be sent without
+ *                  reading it
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      fd:         Opened file descriptor of the file
+ * 
+ *      map:        Set to the mapping
+ * 
+ *  RETURNS:
+ *      
+ *      bool:       false if the file can't be mapped and has to be read
+ * 
+ */
+static bool map_file(int fd, struct iovec* map) {
+    struct stat st;
+    if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return false;
+    }
 
-        dirwatch_close(dirwatch_handle);
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) {
+        log_warning("Failed to map file, reading it instead: %s", strerror(errno));
+        return false;
     }
+    posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    map->iov_base   = data;
+    map->iov_len    = st.st_size;
+    return true;
 }
 
+
 /**
- *  DESCRIPTION:    Determine the transmission mode and transmit files
+ *  DESCRIPTION:    Transmits an opened file, then retransmits it if requested.
+ *                  With a checkpoint journal, a transmission of the file that 
+ *                  was interrupted is resumed where it stopped. With a frame
+ *                  cache, retransmissions reuse the payloads of the first pass.
  * 
  *  ARGUMENTS: 
  *      
- *      args:       Parsed command line arguments
- * 
  *      tx:         Initialized transmitter
  * 
+ *      fd:         Opened file descriptor of the file to be transmitted
+ * 
+ *      path:       Path of the file
+ * 
+ *      delay:      Millisecond delay to add after each transmission
+ * 
+ *      retransmit_count:
+ *                  Number of times to retransmit the file, -1 for forever
+ * 
+ *      track:      Record the first transmission in the sent index
+ * 
+ *  RETURNS:
+ *      
+ *      dxwifi_tx_state_t: The last reported state of the transmitter
+ * 
  */
-void transmit(cli_args* args, dxwifi_transmitter* tx) {
+static dxwifi_tx_state_t transmit_fd(dxwifi_transmitter* tx, int fd, const char* path, unsigned delay, int retransmit_count, bool track) {
+    dxwifi_tx_state_t state = DXWIFI_TX_NORMAL;
 
-    if(args->tx_delay > 0 ) {
-        attach_preinject_handler(transmitter, delay_transmission, &args->tx_delay);
+    track = track && sent_files;
+
+    // Blocks only line up with file offsets when they're read straight from the file
+    struct stat st;
+    bool journaled = checkpoints && !tx->packetizer.read_block && fstat(fd, &st) == 0;
+
+    uint32_t block = 0;
+    int iteration = 0;
+    if(journaled && checkpoint_find(&checkpoints->journal, &st, tx->blocksize, &block, &iteration)) {
+        log_info("Resuming %s from block %d, transmission %d", path, block, iteration + 1);
     }
-    if(args->tx.rtap_tx_flags & IEEE80211_RADIOTAP_F_TX_ORDER) {
-        attach_preinject_handler(transmitter, attach_frame_number, NULL);
+
+    bool transmit_forever = (retransmit_count == -1);
+    int count = transmit_forever ? -1 : retransmit_count - iteration;
+
+    // Only worth it when the file is sent more than once
+    bool cached = frames && (transmit_forever || count > 0);
+    if(cached) {
+        frame_cache_attach(frames, tx);
     }
-    if(args->verbosity > DXWIFI_LOG_INFO ) {
-        attach_postinject_handler(transmitter, log_frame_stats, NULL);
+
+    // Passes from the start are sent out of memory, resumed ones read the file
+    struct iovec map = { 0 };
+    bool mapped = map_files && !tx->packetizer.read_block && map_file(fd, &map);
+
+    while((count >= 0 || transmit_forever) && state == DXWIFI_TX_NORMAL) {
+        off_t offset = (off_t) block * tx->blocksize;
+
+        if(lseek(fd, offset, SEEK_SET) == -1) {
+            log_error("Failed to seek to block %d of file: %s", block, strerror(errno));
+            state = DXWIFI_TX_ERROR;
+        }
+        else {
+            if(track) {
+                init_content_hash(&sent_files->hash);
+                sent_files->hashing = true;
+            }
+            if(journaled) {
+                checkpoint_begin(&checkpoints->journal, path, &st, tx->blocksize, block, iteration);
+                checkpoints->recording = true;
+            }
+            if(cached) {
+                frame_cache_begin_pass(frames, block == 0);
+            }
+
+            if(block > 0) {
+                dxwifi_resume_manifest manifest = {
+                    .file_id    = checkpoint_file_id(&checkpoints->journal),
+                    .offset     = offset,
+                    .block      = block
+                };
+                state = setup_handlers_and_transmit(tx, fd, NULL, &manifest);
+            }
+            else {
+                state = setup_handlers_and_transmit(tx, fd, mapped ? &map : NULL, NULL);
+            }
+
+            if(cached) {
+                frame_cache_end_pass(frames, state == DXWIFI_TX_NORMAL);
+            }
+            if(journaled) {
+                checkpoints->recording = false;
+                checkpoint_sync(&checkpoints->journal);
+            }
+            if(track) {
+                record_sent(fd, state, block > 0);
+                track = false;
+            }
+            msleep(delay, false);
+        }
+        block = 0;
+        ++iteration;
+        --count;
+    }
+
+    if(mapped) {
+        munmap(map.iov_base, map.iov_len);
+    }
+    if(cached) {
+        frame_cache_detach(frames, tx);
+    }
+    if(journaled && state == DXWIFI_TX_NORMAL) {
+        checkpoint_clear(&checkpoints->journal);
+    }
+    return state;
+}
+
+
+/**
+ *  DESCRIPTION:    Iterates through a list of file names, opens them, and 
+ *                  transmits them. With a sent index, files that were already
+ *                  sent are skipped, or sent after the others when resending.
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      tx:         Initialized transmitter
+ * 
+ *      files:      List of files to transmit
+ * 
+ *      delay:      Millisecond delay to add between file transmission. 
+ * 
+ *      retransmit_count:
+ *                  Number of times to retransmit the file. If the count is -1
+ *                  then the file will be retransmitted forever or until the 
+ *                  transmitter reports a timeout or error
+ * 
+ *  RETURNS:
+ *      
+ *      dxwifi_tx_state_t: The last reported state of the transmitter
+ * 
+ */
+dxwifi_tx_state_t transmit_files(dxwifi_transmitter* tx, char** files, size_t num_files, unsigned delay, int retransmit_count) {
+    int fd = 0;
+    dxwifi_tx_state_t state = DXWIFI_TX_NORMAL;
+
+    bool* held_back = NULL;
+    if(sent_files && sent_files->resend && num_files > 1) {
+        held_back = calloc(num_files, sizeof(bool));
+        assert_M(held_back, "Failed to allocate %ld flags", num_files);
+    }
+
+    for(size_t i = 0; i < num_files && state == DXWIFI_TX_NORMAL; ++i) {
+        if((fd = open(files[i], O_RDONLY)) < 0) {
+            log_error("Failed to open file: %s - %s", files[i], strerror(errno));
+        }
+        else {
+            bool sent = was_sent(fd, files[i]);
+
+            if(sent && held_back) {
+                log_info("Sending %s again after the other files", files[i]);
+                held_back[i] = true;
+            }
+            else if(sent && !sent_files->resend) {
+                log_info("Skipping %s", files[i]);
+            }
+            else {
+                log_info("Opened %s for transmission", files[i]);
+                state = transmit_fd(tx, fd, files[i], delay, retransmit_count, true);
+            }
+            close(fd);
+        }
+    }
+
+    for(size_t i = 0; held_back && i < num_files && state == DXWIFI_TX_NORMAL; ++i) {
+        if(!held_back[i]) {
+            continue;
+        }
+        if((fd = open(files[i], O_RDONLY)) < 0) {
+            log_error("Failed to open file: %s - %s", files[i], strerror(errno));
+        }
+        else {
+            log_info("Opened %s for transmission", files[i]);
+            state = transmit_fd(tx, fd, files[i], delay, retransmit_count, true);
+            close(fd);
+        }
+    }
+    free(held_back);
+
+    return state;
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about a directory scan
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Directory scan statistics
+ * 
+ */
+void log_dirscan_stats(dirscan_stats stats) {
+    log_debug(
+        "Directory Scan Stats\n"
+        "\tEntries Read:        %d\n"
+        "\tRead Batches:        %d\n"
+        "\tFiltered Out:        %d\n"
+        "\tEntries Stat'd:      %d\n",
+        stats.entries,
+        stats.batches,
+        stats.filtered,
+        stats.stat_calls
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Transmit all files in a directory that matches a filter, in
+ *                  order of their names
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      tx:         Initialized transmitter
+ * 
+ *      filter:     Glob pattern to filter which files should be transmitted
+ * 
+ *      dirname:    Name of target directory
+ * 
+ *      delay:      Inter-file transmission delay in milliseconds
+ * 
+ */
+void transmit_directory_contents(dxwifi_transmitter* tx, const char* filter, const char* dirname, unsigned delay, int retransmit_count) {
+    char path[PATH_MAX];
+
+    dirscan_list files;
+    init_dirscan_list(&files);
+
+    if(dirscan(&files, dirname, filter)) {
+        log_info("Found %ld files to transmit in %s", files.count, dirname);
+        log_dirscan_stats(files.stats);
+
+        // Transmitted as one list so files that were already sent can be moved
+        char** paths = calloc(files.count + 1, sizeof(char*));
+        assert_M(paths, "Failed to allocate %ld file paths", files.count);
+
+        for(size_t i = 0; i < files.count; ++i) {
+            combine_path(path, PATH_MAX, dirname, dirscan_name(&files, i));
+            paths[i] = strdup(path);
+            assert_M(paths[i], "Failed to copy file path: %s", path);
+        }
+        transmit_files(tx, paths, files.count, delay, retransmit_count);
+
+        for(size_t i = 0; i < files.count; ++i) {
+            free(paths[i]);
+        }
+        free(paths);
+    }
+    teardown_dirscan_list(&files);
+}
+
+
+/**
+ *  DESCRIPTION:    Dirwatch callback, queues newly created file for the 
+ *                  transmit worker
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      event:      Creation and close event
+ * 
+ *      user:       Transmit worker
+ * 
+ */
+static void queue_new_file(const dirwatch_event* event, void* user) {
+    tx_worker* worker = (tx_worker*) user;
+
+    char path[PATH_MAX];
+
+    combine_path(path, PATH_MAX, event->dirname, event->filename);
+
+    switch (event->event)
+    {
+    case DW_MODIFIED:
+        follow_modified(&worker->follower, path);
+        return;
+
+    case DW_CREATED:
+        follow_created(&worker->follower, path);
+        break;
+
+    default:
+        // Followed files were queued when they were created
+        if(follow_closed(&worker->follower, path)) {
+            return;
+        }
+        break;
+    }
+
+    switch (job_queue_push(&worker->queue, path))
+    {
+    case JOB_QUEUED:
+        log_debug("Queued %s, %ld files waiting", path, job_queue_depth(&worker->queue));
+        break;
+
+    case JOB_DUPLICATE:
+        log_debug("%s is already queued", path);
+        break;
+
+    case JOB_REJECTED:
+        log_warning("Dropped %s, transmission was interrupted", path);
+        break;
+    }
+}
+
+
+// Read state for a file that's transmitted while it's still being written
+typedef struct {
+    file_follower*  follower;   /* Reports when the file grows or closes    */
+    const char*     path;       /* Path of the file                         */
+    off_t           offset;     /* Bytes read so far                        */
+} growing_file;
+
+
+/**
+ *  DESCRIPTION:    Stands in for the packetizer while following a file. Only
+ *                  full blocks are read until the file is closed so the file
+ *                  is cut into the same frames as a normal transmission.
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      See definition of dxwifi_tx_packetizer in transmitter.h
+ * 
+ */
+static ssize_t read_growing_file(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    growing_file* file = (growing_file*) user;
+
+    return follow_read(file->follower, file->path, fd, payload, blocksize, &file->offset);
+}
+
+
+/**
+ *  DESCRIPTION:    Transmits a file while it's still being written, then 
+ *                  retransmits the finished file if requested
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      worker:     Transmit worker
+ * 
+ *      path:       Path of the file
+ * 
+ */
+static void transmit_growing_file(tx_worker* worker, char* path) {
+    cli_args* args = worker->args;
+
+    growing_file file = {
+        .follower   = &worker->follower,
+        .path       = path,
+        .offset     = 0
+    };
+
+    // Not checked against the sent index, what's there so far isn't the file
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        log_error("Failed to open file: %s - %s", path, strerror(errno));
+        return;
+    }
+
+    dxwifi_tx_packetizer packetizer = args->tx.packetizer;
+    args->tx.packetizer = (dxwifi_tx_packetizer) { 
+        .read_block     = read_growing_file, 
+        .has_pending    = NULL, 
+        .user_args      = &file 
+    };
+
+    log_info("Following %s while it's written", path);
+    dxwifi_tx_state_t state = transmit_fd(&args->tx, fd, path, args->file_delay, 0, true);
+
+    args->tx.packetizer = packetizer;
+
+    if(state == DXWIFI_TX_NORMAL && args->retransmit_count != 0) {
+        int remaining = (args->retransmit_count == -1) ? -1 : args->retransmit_count - 1;
+        transmit_fd(&args->tx, fd, path, args->file_delay, remaining, false);
+    }
+    close(fd);
+}
+
+
+/**
+ *  DESCRIPTION:    Transmit worker, transmits queued files until the queue is
+ *                  closed and empty
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      user:       Transmit worker
+ * 
+ */
+static void* transmit_queued_files(void* user) {
+    tx_worker* worker = (tx_worker*) user;
+    cli_args* args = worker->args;
+
+    char* path = NULL;
+    while((path = job_queue_pop(&worker->queue))) {
+
+        if(follow_is_growing(&worker->follower, path)) {
+            transmit_growing_file(worker, path);
+        }
+        else {
+            transmit_files(&args->tx, &path, 1, args->file_delay, args->retransmit_count);
+        }
+
+        free(path);
+
+        if(worker->interrupts > 1) {
+            job_queue_close(&worker->queue);
+            size_t discarded = job_queue_discard(&worker->queue);
+            if(discarded > 0) {
+                log_warning("Transmission interrupted, discarded %ld queued files", discarded);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the directory watch
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Dirwatch statistics
+ * 
+ */
+void log_dirwatch_stats(dirwatch_stats stats) {
+    log_info(
+        "Dirwatch Stats\n"
+        "\tEvents Read:         %lu\n"
+        "\tFiles Reported:      %lu\n"
+        "\tQueue Overflows:     %d\n"
+        "\tFiles Rescanned:     %d\n"
+        "\tDirectories:         %d\n"
+        "\tMost Files Pending:  %d\n",
+        stats.events,
+        stats.reported,
+        stats.overflows,
+        stats.rescanned,
+        stats.directories,
+        stats.pending_max
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the transmit backlog
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Job queue statistics
+ * 
+ */
+void log_job_queue_stats(job_queue_stats stats) {
+    log_info(
+        "Job Queue Stats\n"
+        "\tFiles Queued:        %lu\n"
+        "\tDuplicates Dropped:  %lu\n"
+        "\tFiles Dequeued:      %lu\n"
+        "\tFiles Discarded:     %lu\n"
+        "\tDeepest Backlog:     %d\n"
+        "\tBlocked Pushes:      %d\n",
+        stats.enqueued,
+        stats.duplicates,
+        stats.dequeued,
+        stats.discarded,
+        stats.depth_max,
+        stats.producer_waits
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about files transmitted while being written
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Follower statistics
+ * 
+ */
+void log_follow_stats(file_follower_stats stats) {
+    log_info(
+        "Follow Stats\n"
+        "\tFiles Followed:      %d\n"
+        "\tWrites Seen:         %lu\n"
+        "\tWaits On Writer:     %lu\n",
+        stats.followed,
+        stats.modified,
+        stats.catch_ups
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the sent index
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Sent index statistics
+ * 
+ */
+void log_sent_index_stats(sent_index_stats stats) {
+    log_info(
+        "Sent Index Stats\n"
+        "\tFiles Looked Up:     %d\n"
+        "\tUnchanged Files:     %d\n"
+        "\tDuplicate Files:     %d\n"
+        "\tFiles Hashed:        %d\n"
+        "\tFiles Recorded:      %d\n",
+        stats.lookups,
+        stats.unchanged,
+        stats.duplicates,
+        stats.full_hashes,
+        stats.recorded
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the checkpoint journal
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Checkpoint journal statistics
+ * 
+ */
+void log_checkpoint_stats(checkpoint_stats stats) {
+    log_info(
+        "Checkpoint Stats\n"
+        "\tJournal Writes:      %d\n"
+        "\tFiles Resumed:       %d\n",
+        stats.syncs,
+        stats.resumed
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the frame cache
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Frame cache statistics
+ * 
+ */
+void log_frame_cache_stats(frame_cache_stats stats) {
+    log_info(
+        "Frame Cache Stats\n"
+        "\tFrames Cached:       %d\n"
+        "\tBytes Cached:        %lu\n"
+        "\tPasses Replayed:     %d\n"
+        "\tFrames Replayed:     %lu\n"
+        "\tFiles Too Large:     %d\n",
+        stats.frames_cached,
+        stats.bytes_cached,
+        stats.replays,
+        stats.frames_replayed,
+        stats.overflows
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Transmits current directory contents and listens for newly
+ *                  created files to transmit
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ */
+void transmit_directory(cli_args* args, dxwifi_transmitter* tx) {
+
+    const char* dirname = args->files[0];
+
+    if(args->transmit_current_files) {
+        transmit_directory_contents(tx, args->file_filter, dirname, args->file_delay, args->retransmit_count);
+    }
+    if(args->listen_for_new_files) {
+
+        dirwatch_handle = dirwatch_init();
+
+        dirwatch_events_t events = DW_CREATE_AND_CLOSE | DW_MOVED_TO 
+                                 | (args->recursive_watch ? DW_RECURSIVE : 0) 
+                                 | (args->follow_files ? DW_CREATED | DW_MODIFIED : 0);
+
+        if(dirwatch_add(dirwatch_handle, dirname, args->file_filter, events, true) < 0) {
+            dirwatch_close(dirwatch_handle);
+            return;
+        }
+
+        tx_worker worker = { .args = args, .interrupts = 0 };
+        init_job_queue(&worker.queue, args->queue_size);
+        init_file_follower(&worker.follower);
+
+        // Keep SIGINT on this thread so it interrupts the watch, the worker
+        // inherits the blocked mask
+        sigset_t sigint_mask, prev_mask;
+        sigemptyset(&sigint_mask);
+        sigaddset(&sigint_mask, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &sigint_mask, &prev_mask);
+
+        worker_handle = &worker;
+        int status = pthread_create(&worker.thread, NULL, transmit_queued_files, &worker);
+
+        pthread_sigmask(SIG_SETMASK, &prev_mask, NULL);
+
+        if(status != 0) {
+            log_error("Failed to start transmit worker: %s", strerror(status));
+            worker_handle = NULL;
+            teardown_file_follower(&worker.follower);
+            teardown_job_queue(&worker.queue);
+            dirwatch_close(dirwatch_handle);
+            return;
+        }
+
+        // Setup handlers for exiting loop
+        struct sigaction action = { 0 }, prev_action = { 0 };
+        memset(&prev_action, 0x00, sizeof(sigaction));
+        sigemptyset(&action.sa_mask);
+        sigaddset(&action.sa_mask, SIGINT);
+        action.sa_handler = watchdir_sigint_handler;
+        interrupt_target = tx;
+        sigaction(SIGINT, &action, &prev_action);
+
+        dirwatch_listen(dirwatch_handle, args->dirwatch_timeout * 1000, queue_new_file, &worker);
+
+        // Closes won't be reported anymore, send what's been written so far
+        follow_stop(&worker.follower);
+
+        size_t backlog = job_queue_depth(&worker.queue);
+        if(backlog > 0) {
+            log_info("Stopped watching, transmitting %ld queued files", backlog);
+        }
+        job_queue_close(&worker.queue);
+        pthread_join(worker.thread, NULL);
+
+        sigaction(SIGINT, &prev_action, NULL);
+        interrupt_target = NULL;
+        worker_handle = NULL;
+
+        log_dirwatch_stats(dirwatch_get_stats(dirwatch_handle));
+        log_job_queue_stats(job_queue_get_stats(&worker.queue));
+        if(args->follow_files) {
+            log_follow_stats(follow_get_stats(&worker.follower));
+        }
+
+        teardown_file_follower(&worker.follower);
+        teardown_job_queue(&worker.queue);
+        dirwatch_close(dirwatch_handle);
+    }
+}
+
+/**
+ *  DESCRIPTION:    Log info about the NAL unit packetizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated packetizer statistics
+ * 
+ *      frag_stats: Accumulated fragmenter statistics
+ * 
+ */
+void log_nalu_stats(nalu_packetizer_stats stats, unit_fragmenter_stats frag_stats) {
+    log_debug(
+        "NAL Packetizer Stats\n"
+        "\tNAL Units:           %d\n"
+        "\tKey Units:           %d\n"
+        "\tFragments:           %d\n"
+        "\tRepeated Fragments:  %d\n"
+        "\tForced Splits:       %d\n",
+        stats.units,
+        stats.key_units,
+        frag_stats.fragments,
+        frag_stats.repeats,
+        stats.forced_splits
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the JPEG packetizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated packetizer statistics
+ * 
+ *      frag_stats: Accumulated fragmenter statistics
+ * 
+ */
+void log_jpeg_stats(jpeg_packetizer_stats stats, unit_fragmenter_stats frag_stats) {
+    log_debug(
+        "JPEG Packetizer Stats\n"
+        "\tImages:              %d\n"
+        "\tRaw Files:           %d\n"
+        "\tRestart Intervals:   %d\n"
+        "\tUnits:               %d\n"
+        "\tFragments:           %d\n"
+        "\tRepeated Fragments:  %d\n",
+        stats.images,
+        stats.raw_images,
+        stats.intervals,
+        stats.units,
+        frag_stats.fragments,
+        frag_stats.repeats
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the compression packetizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated packetizer statistics
+ * 
+ *      frag_stats: Accumulated fragmenter statistics
+ * 
+ */
+void log_compress_stats(compress_packetizer_stats stats, unit_fragmenter_stats frag_stats) {
+    log_debug(
+        "Compression Packetizer Stats\n"
+        "\tGroups:              %d\n"
+        "\tStored Groups:       %d\n"
+        "\tBytes In:            %lu\n"
+        "\tBytes Out:           %lu\n"
+        "\tRatio:               %.2f\n"
+        "\tFragments:           %d\n",
+        stats.groups,
+        stats.stored_groups,
+        stats.bytes_in,
+        stats.bytes_out,
+        stats.bytes_out ? (double) stats.bytes_in / stats.bytes_out : 0.0,
+        frag_stats.fragments
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Log info about the delta packetizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      stats:      Accumulated packetizer statistics
+ * 
+ *      frag_stats: Accumulated fragmenter statistics
+ * 
+ */
+void log_delta_stats(delta_packetizer_stats stats, unit_fragmenter_stats frag_stats) {
+    log_debug(
+        "Delta Packetizer Stats\n"
+        "\tFull Files:          %d\n"
+        "\tDelta Files:         %d\n"
+        "\tBytes In:            %lu\n"
+        "\tBytes Matched:       %lu\n"
+        "\tBytes Out:           %lu\n"
+        "\tFragments:           %d\n",
+        stats.full_files,
+        stats.delta_files,
+        stats.bytes_in,
+        stats.bytes_matched,
+        stats.bytes_out,
+        frag_stats.fragments
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Attaches the packetizer selected on the command line
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      state:      Storage for the selected packetizer
+ * 
+ */
+void attach_packetizer(cli_args* args, dxwifi_transmitter* tx, packetizer_state* state) {
+    switch (args->packetizer)
+    {
+    case TX_PACKETIZER_NAL:
+        init_nalu_packetizer(&state->nalu, args->key_repeats);
+
+        tx->packetizer.read_block   = nalu_packetize;
+        tx->packetizer.has_pending  = nalu_packetizer_pending;
+        tx->packetizer.user_args    = &state->nalu;
+        break;
+
+    case TX_PACKETIZER_JPEG:
+        init_jpeg_packetizer(&state->jpeg, args->key_repeats);
+
+        tx->packetizer.read_block   = jpeg_packetize;
+        tx->packetizer.has_pending  = jpeg_packetizer_pending;
+        tx->packetizer.user_args    = &state->jpeg;
+        break;
+
+    case TX_PACKETIZER_COMPRESS:
+        init_compress_packetizer(&state->comp, args->compress_level, (size_t)args->group_blocks * tx->blocksize);
+
+        tx->packetizer.read_block   = compress_packetize;
+        tx->packetizer.has_pending  = compress_packetizer_pending;
+        tx->packetizer.user_args    = &state->comp;
+        break;
+
+    case TX_PACKETIZER_DELTA:
+        init_delta_packetizer(&state->delta, args->delta_threshold, args->delta_keyframe);
+
+        tx->packetizer.read_block   = delta_packetize;
+        tx->packetizer.has_pending  = delta_packetizer_pending;
+        tx->packetizer.user_args    = &state->delta;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Logs and tearsdown the attached packetizer
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      state:      Storage for the selected packetizer
+ * 
+ */
+void detach_packetizer(cli_args* args, dxwifi_transmitter* tx, packetizer_state* state) {
+    switch (args->packetizer)
+    {
+    case TX_PACKETIZER_NAL:
+        log_nalu_stats(state->nalu.stats, state->nalu.fragmenter.stats);
+        teardown_nalu_packetizer(&state->nalu);
+        break;
+
+    case TX_PACKETIZER_JPEG:
+        log_jpeg_stats(state->jpeg.stats, state->jpeg.fragmenter.stats);
+        teardown_jpeg_packetizer(&state->jpeg);
+        break;
+
+    case TX_PACKETIZER_COMPRESS:
+        log_compress_stats(state->comp.stats, state->comp.fragmenter.stats);
+        teardown_compress_packetizer(&state->comp);
+        break;
+
+    case TX_PACKETIZER_DELTA:
+        log_delta_stats(state->delta.stats, state->delta.fragmenter.stats);
+        teardown_delta_packetizer(&state->delta);
+        break;
+
+    default:
+        break;
+    }
+    memset(&tx->packetizer, 0x00, sizeof(dxwifi_tx_packetizer));
+}
+
+
+/**
+ *  DESCRIPTION:    Finds the fragment sequence counter of the selected 
+ *                  packetizer, replayed frames are numbered from it
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      state:      Storage for the selected packetizer
+ * 
+ *  RETURNS:
+ *      
+ *      uint32_t*:  Next sequence number, NULL if the packetizer doesn't 
+ *                  number its frames
+ * 
+ */
+uint32_t* packetizer_unit_seq(cli_args* args, packetizer_state* state) {
+    switch (args->packetizer)
+    {
+    case TX_PACKETIZER_NAL:
+        return &state->nalu.fragmenter.seq;
+
+    case TX_PACKETIZER_JPEG:
+        return &state->jpeg.fragmenter.seq;
+
+    case TX_PACKETIZER_COMPRESS:
+        return &state->comp.fragmenter.seq;
+
+    case TX_PACKETIZER_DELTA:
+        return &state->delta.fragmenter.seq;
+
+    default:
+        return NULL;
+    }
+}
+
+
+#if defined(DXWIFI_TESTS)
+// One of several independent transmitters sending the same files
+typedef struct {
+    cli_args*           args;       /* Parsed command line arguments        */
+    dxwifi_transmitter  tx;         /* Copy of the configured transmitter   */
+    dxwifi_log_context  log;        /* Tags this instance's log messages    */
+    char                name[32];   /* Instance name used in the logs       */
+    char                savefile[PATH_MAX];
+                                    /* Where this instance's frames go      */
+    pthread_t           thread;     /* Thread running the instance          */
+    bool                started;    /* Thread was created                   */
+} tx_instance;
+
+
+/**
+ *  DESCRIPTION:    Thread running a single transmitter instance, sends every 
+ *                  file once plus the retransmit count
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      user:       tx_instance
+ * 
+ */
+static void* run_tx_instance(void* user) {
+    tx_instance* instance = (tx_instance*) user;
+    cli_args* args = instance->args;
+    dxwifi_transmitter* tx = &instance->tx;
+
+    init_transmitter(tx, args->device);
+
+    if(args->tx_delay > 0 ) {
+        attach_preinject_handler(tx, delay_transmission, &args->tx_delay);
+    }
+    if(args->tx.rtap_tx_flags & IEEE80211_RADIOTAP_F_TX_ORDER) {
+        attach_pure_preinject_handler(tx, attach_frame_number, NULL);
+    }
+    if(args->send_times > 0) {
+        attach_preinject_handler(tx, attach_send_time, &args->send_times);
+    }
+    if(args->busy_work > 0) {
+        attach_pure_preinject_handler(tx, hash_payload_busily, &args->busy_work);
+    }
+
+    dxwifi_tx_stats stats;
+    for(int pass = 0; pass <= args->retransmit_count; ++pass) {
+        for(size_t i = 0; i < args->file_count; ++i) {
+            int fd = open(args->files[i], O_RDONLY);
+            if(fd < 0) {
+                log_error("Failed to open file: %s - %s", args->files[i], strerror(errno));
+                continue;
+            }
+            start_transmission(tx, fd, &stats);
+            close(fd);
+
+            log_tx_stats(stats);
+        }
+    }
+    close_transmitter(tx);
+
+    return NULL;
+}
+
+
+/**
+ *  DESCRIPTION:    Sends the files from several transmitters at once, each 
+ *                  on its own thread with its own savefile and log context
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ */
+void transmit_instances(cli_args* args) {
+    tx_instance* instances = calloc(args->instances, sizeof(tx_instance));
+    assert_M(instances, "Failed to allocate %d transmitters", args->instances);
+
+    for(unsigned i = 0; i < args->instances; ++i) {
+        tx_instance* instance = &instances[i];
+
+        instance->args  = args;
+        instance->tx    = args->tx;
+
+        snprintf(instance->name, sizeof(instance->name), "tx %d", i);
+        snprintf(instance->savefile, sizeof(instance->savefile), "%s.%d", args->tx.savefile, i);
+
+        init_log_context(&instance->log, instance->name, NULL);
+        instance->tx.log_context    = &instance->log;
+        instance->tx.savefile       = instance->savefile;
+
+        int status = pthread_create(&instance->thread, NULL, run_tx_instance, instance);
+        if(status != 0) {
+            log_error("Failed to start transmitter %d: %s", i, strerror(status));
+            break;
+        }
+        instance->started = true;
+    }
+    for(unsigned i = 0; i < args->instances; ++i) {
+        if(instances[i].started) {
+            pthread_join(instances[i].thread, NULL);
+        }
+    }
+    free(instances);
+}
+#endif
+
+
+/**
+ *  DESCRIPTION:    Determine the transmission mode and transmit files
+ * 
+ *  ARGUMENTS: 
+ *      
+ *      args:       Parsed command line arguments
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ */
+void transmit(cli_args* args, dxwifi_transmitter* tx) {
+
+    if(args->tx_delay > 0 ) {
+        attach_preinject_handler(tx, delay_transmission, &args->tx_delay);
+    }
+    if(args->tx.rtap_tx_flags & IEEE80211_RADIOTAP_F_TX_ORDER) {
+        attach_pure_preinject_handler(tx, attach_frame_number, NULL);
+    }
+    if(args->send_times > 0) {
+        attach_preinject_handler(tx, attach_send_time, &args->send_times);
+    }
+#if defined(DXWIFI_TESTS)
+    if(args->busy_work > 0) {
+        attach_pure_preinject_handler(tx, hash_payload_busily, &args->busy_work);
+    }
+#endif
+    if(args->verbosity > DXWIFI_LOG_INFO ) {
+        attach_postinject_handler(tx, log_frame_stats, NULL);
+    }
+    if(sent_files && sent_files->hash_payloads) {
+        attach_postinject_batch_handler(tx, hash_transmitted_data, sent_files);
+    }
+    if(checkpoints) {
+        attach_postinject_batch_handler(tx, record_checkpoint, checkpoints);
     }
 
     switch (args->tx_mode)
     {
     case TX_STREAM_MODE:
-        setup_handlers_and_transmit(tx, STDIN_FILENO);
+        setup_handlers_and_transmit(tx, STDIN_FILENO, NULL, NULL);
         break;
 
     case TX_FILE_MODE:
@@ -53,7 +53,7 @@
         if (expr)                                                               \
             ; /* empty */                                                       \
         else                                                                    \
-            __assert_M (true, #expr, __FILE__, __LINE__, msg, ##__VA_ARGS__);   \
+            __assert_M (true, #expr, __FILE__, __LINE__, DXWIFI_LOG_MODULE, msg, ##__VA_ARGS__);   \
     }))
 
 
@@ -63,7 +63,7 @@
         if (expr)                                                               \
             ; /* empty */                                                       \
         else                                                                    \
-            __assert_M (false, #expr, __FILE__, __LINE__, msg, ##__VA_ARGS__);  \
+            __assert_M (false, #expr, __FILE__, __LINE__, DXWIFI_LOG_MODULE, msg, ##__VA_ARGS__);  \
     }))
 
 
@@ -73,7 +73,8 @@
 #define assert_always(msg, ...) assert_M(0, msg, ##__VA_ARGS__)
 
 
-static void __assert_M(bool exit, const char* expr, const char* file, int line, const char* msg, ...) {
+// Inline so headers can include this for compiler_assert without unused warnings
+static inline void __assert_M(bool exit, const char* expr, const char* file, int line, dxwifi_log_module_t module, const char* msg, ...) {
 
     char* path  = strdup(file);
     char* bname = basename(path);
@@ -88,7 +89,7 @@ static void __assert_M(bool exit, const char* expr, const char* file, int line,
     vsnprintf(fmt + chars, DXWIFI_ASSERT_MSG_MAX_LEN - chars, msg, args);
     va_end(args);
 
-    __log(DXWIFI_LOG_FATAL, file, "%s", fmt);
+    __log(DXWIFI_LOG_FATAL, module, "%s", fmt);
 
     free(path);
     if( exit ) {
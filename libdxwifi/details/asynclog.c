@@ -0,0 +1,411 @@
+/**
+ *  asynclog.c
+ * 
+ *  DESCRIPTION: See asynclog.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: The ring is a bounded multi-producer single-consumer queue. Every
+ *  slot carries a sequence number, producers claim a slot by advancing the
+ *  tail with a compare and swap and publish it by bumping its sequence. The
+ *  flusher is the only consumer so the head needs no atomic update.
+ * 
+ */
+
+#define _GNU_SOURCE // memrchr
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/uio.h>
+
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/asynclog.h>
+#include <libdxwifi/details/syslogger.h>
+
+
+typedef struct {
+    atomic_size_t       sequence;   /* Publication state of the slot        */
+    dxwifi_log_level_t  log_level;  /* Priority of the message              */
+    size_t              length;     /* Bytes of text used                   */
+    char                text[ASYNC_LOG_RECORD_MAX];
+} async_log_record;
+
+
+typedef struct {
+    async_log_record*   ring;       /* Records waiting on the flusher       */
+    size_t              mask;       /* Capacity of the ring less one        */
+    atomic_size_t       tail;       /* Next slot a producer claims          */
+    atomic_size_t       head;       /* Next slot the flusher reads          */
+    async_log_output_t  output;     /* Where messages are written           */
+    atomic_bool         running;    /* Flusher should keep going            */
+    atomic_bool         started;    /* Backend accepts messages             */
+    pthread_t           flusher;    /* Background thread                    */
+    pthread_mutex_t     lock;       /* Only guards the flusher's idle wait  */
+    pthread_cond_t      wakeup;     /* Signalled on teardown                */
+
+    atomic_uint_fast64_t logged;    /* Messages pushed into the ring        */
+    atomic_uint_fast64_t dropped;   /* Messages lost to a full ring         */
+    atomic_uint_fast64_t written;   /* Messages written by the flusher      */
+    atomic_uint_fast64_t batches;   /* Batches written by the flusher       */
+    uint64_t            reported;   /* Drops already reported               */
+} async_log_backend;
+
+
+static async_log_backend backend = { 
+    .ring   = NULL,
+    .lock   = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER
+};
+
+
+// Messages are formatted here before they're copied into the ring
+static __thread char format_buffer[ASYNC_LOG_MESSAGE_MAX];
+
+
+/**
+ *  DESCRIPTION:    Sleeps for a number of milliseconds
+ * 
+ */
+static void nap(unsigned ms) {
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+
+/**
+ *  DESCRIPTION:    Flusher waits for more messages, or for the backend to be
+ *                  torn down
+ * 
+ */
+static void wait_for_records(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += ASYNC_LOG_FLUSH_INTERVAL_MS * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec  += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&backend.lock);
+    if(atomic_load_explicit(&backend.running, memory_order_acquire)) {
+        pthread_cond_timedwait(&backend.wakeup, &backend.lock, &deadline);
+    }
+    pthread_mutex_unlock(&backend.lock);
+}
+
+
+/**
+ *  DESCRIPTION:    Claims a slot and copies a formatted message into it
+ * 
+ *  ARGUMENTS:
+ * 
+ *      log_level:  Priority of the message
+ * 
+ *      text:       Formatted message
+ * 
+ *      length:     Bytes of text
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Position of the claimed slot, or SIZE_MAX if the ring was
+ *                  full and the message was dropped
+ * 
+ */
+static size_t push_record(dxwifi_log_level_t log_level, const char* text, size_t length) {
+    async_log_record* record = NULL;
+
+    size_t pos = atomic_load_explicit(&backend.tail, memory_order_relaxed);
+    while(true) {
+        record = &backend.ring[pos & backend.mask];
+
+        size_t seq = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+        if(diff == 0) {
+            if(atomic_compare_exchange_weak_explicit(&backend.tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if(diff < 0) {
+            atomic_fetch_add_explicit(&backend.dropped, 1, memory_order_relaxed);
+            return SIZE_MAX;
+        }
+        else {
+            pos = atomic_load_explicit(&backend.tail, memory_order_relaxed);
+        }
+    }
+
+    record->log_level   = log_level;
+    record->length      = length;
+    memcpy(record->text, text, length);
+
+    atomic_store_explicit(&record->sequence, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&backend.logged, 1, memory_order_relaxed);
+
+    return pos;
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a batch of records out
+ * 
+ *  ARGUMENTS:
+ * 
+ *      records:    Records taken out of the ring
+ * 
+ *      count:      Number of records
+ * 
+ */
+static void write_records(async_log_record** records, size_t count) {
+    if(backend.output == ASYNC_LOG_SYSLOG) {
+        for(size_t i = 0; i < count; ++i) {
+            int priority = LOG_MAKEPRI(LOG_USER, dxwifi_log_level_to_syslog(records[i]->log_level));
+            syslog(priority, "%.*s", (int) records[i]->length, records[i]->text);
+        }
+    }
+    else {
+        struct iovec iov[ASYNC_LOG_BATCH_MAX];
+        for(size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = records[i]->text;
+            iov[i].iov_len  = records[i]->length;
+        }
+        // Nowhere to report a failed write to, the messages are lost
+        ssize_t nbytes = writev(STDERR_FILENO, iov, count);
+        __DXWIFI_UTILS_UNUSED(nbytes);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Takes published records off the head of the ring and
+ *                  writes them in batches
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Number of records written
+ * 
+ */
+static size_t drain_records(void) {
+    async_log_record* batch[ASYNC_LOG_BATCH_MAX];
+    size_t total = 0;
+
+    size_t head = atomic_load_explicit(&backend.head, memory_order_relaxed);
+    while(true) {
+        size_t count = 0;
+        while(count < ASYNC_LOG_BATCH_MAX) {
+            async_log_record* record = &backend.ring[(head + count) & backend.mask];
+            if(atomic_load_explicit(&record->sequence, memory_order_acquire) != head + count + 1) {
+                break; // Not published yet
+            }
+            batch[count++] = record;
+        }
+        if(count == 0) {
+            break;
+        }
+
+        write_records(batch, count);
+
+        // Hand the slots back to the producers a lap later
+        for(size_t i = 0; i < count; ++i) {
+            atomic_store_explicit(&batch[i]->sequence, head + i + backend.mask + 1, memory_order_release);
+        }
+        head += count;
+        atomic_store_explicit(&backend.head, head, memory_order_release);
+
+        atomic_fetch_add_explicit(&backend.written, count, memory_order_relaxed);
+        atomic_fetch_add_explicit(&backend.batches, 1, memory_order_relaxed);
+        total += count;
+    }
+    return total;
+}
+
+
+/**
+ *  DESCRIPTION:    Reports messages dropped since the last report, straight
+ *                  from the flusher so the report itself can't be dropped
+ * 
+ */
+static void report_dropped(void) {
+    uint64_t dropped = atomic_load_explicit(&backend.dropped, memory_order_relaxed);
+    if(dropped == backend.reported) {
+        return;
+    }
+
+    async_log_record report = { .log_level = DXWIFI_LOG_WARN };
+    async_log_record* records[] = { &report };
+
+    if(backend.output == ASYNC_LOG_SYSLOG) {
+        report.length = snprintf(report.text, sizeof(report.text), "Log ring full, dropped %lu messages", dropped - backend.reported);
+    }
+    else {
+        report.length = snprintf(report.text, sizeof(report.text), "[ %s ][ %s ] : Log ring full, dropped %lu messages\n",
+            log_level_to_str(DXWIFI_LOG_WARN), log_module_to_str(DXWIFI_LOG_GENERIC), dropped - backend.reported);
+    }
+    write_records(records, 1);
+
+    backend.reported = dropped;
+}
+
+
+/**
+ *  DESCRIPTION:    Background thread, drains the ring until the backend is
+ *                  torn down
+ * 
+ */
+static void* flush_records(void* user) {
+    __DXWIFI_UTILS_UNUSED(user);
+
+    while(atomic_load_explicit(&backend.running, memory_order_acquire)) {
+        size_t written = drain_records();
+        report_dropped();
+        if(written == 0) {
+            wait_for_records();
+        }
+    }
+    drain_records();
+    report_dropped();
+    return NULL;
+}
+
+
+//
+// See asynclog.h for description of non-static functions
+//
+
+bool init_async_logger(async_log_output_t output, size_t capacity) {
+    if(atomic_load(&backend.started)) {
+        return false;
+    }
+
+    size_t size = 1;
+    while(size < capacity) {
+        size <<= 1;
+    }
+
+    backend.ring = calloc(size, sizeof(async_log_record));
+    assert_M(backend.ring, "Failed to allocate %ld log records", size);
+
+    for(size_t i = 0; i < size; ++i) {
+        atomic_init(&backend.ring[i].sequence, i);
+    }
+    backend.mask        = size - 1;
+    backend.output      = output;
+    backend.reported    = 0;
+    atomic_init(&backend.tail, 0);
+    atomic_init(&backend.head, 0);
+    atomic_init(&backend.logged, 0);
+    atomic_init(&backend.dropped, 0);
+    atomic_init(&backend.written, 0);
+    atomic_init(&backend.batches, 0);
+
+    if(output == ASYNC_LOG_SYSLOG) {
+        open_syslog();
+    }
+
+    atomic_store(&backend.running, true);
+    int status = pthread_create(&backend.flusher, NULL, flush_records, NULL);
+    if(status != 0) {
+        atomic_store(&backend.running, false);
+        free(backend.ring);
+        backend.ring = NULL;
+        return false;
+    }
+    atomic_store(&backend.started, true);
+    return true;
+}
+
+
+void teardown_async_logger(void) {
+    if(!atomic_exchange(&backend.started, false)) {
+        return;
+    }
+    pthread_mutex_lock(&backend.lock);
+    atomic_store_explicit(&backend.running, false, memory_order_release);
+    pthread_cond_signal(&backend.wakeup);
+    pthread_mutex_unlock(&backend.lock);
+
+    pthread_join(backend.flusher, NULL);
+
+    free(backend.ring);
+    backend.ring = NULL;
+}
+
+
+void async_logger_flush(void) {
+    if(!atomic_load(&backend.started)) {
+        return;
+    }
+    size_t tail = atomic_load_explicit(&backend.tail, memory_order_acquire);
+    while(atomic_load_explicit(&backend.head, memory_order_acquire) < tail
+        && atomic_load_explicit(&backend.running, memory_order_acquire)) {
+        nap(1);
+    }
+}
+
+
+async_log_stats async_logger_get_stats(void) {
+    async_log_stats stats = {
+        .logged     = atomic_load(&backend.logged),
+        .dropped    = atomic_load(&backend.dropped),
+        .written    = atomic_load(&backend.written),
+        .batches    = atomic_load(&backend.batches)
+    };
+    return stats;
+}
+
+
+void async_logger(dxwifi_log_module_t module, dxwifi_log_level_t log_level, const char* fmt, va_list args) {
+    if(!atomic_load_explicit(&backend.started, memory_order_acquire)) {
+        default_logger(module, log_level, fmt, args);
+        return;
+    }
+
+    int length = 0;
+    size_t size = sizeof(format_buffer) - 1; // Room for the newline
+
+    // Syslog tags messages with their priority, stderr needs the prefix
+    const char* name = current_log_context()->name;
+    if(backend.output == ASYNC_LOG_STDERR) {
+        length = name
+            ? snprintf(format_buffer, size, "[ %s ][ %s ][ %s ] : ", log_level_to_str(log_level), log_module_to_str(module), name)
+            : snprintf(format_buffer, size, "[ %s ][ %s ] : ", log_level_to_str(log_level), log_module_to_str(module));
+    }
+    else if(name) {
+        length = snprintf(format_buffer, size, "[ %s ] ", name);
+    }
+    length += vsnprintf(format_buffer + length, size - length, fmt, args);
+
+    if(length > (int) size - 1) {
+        length = size - 1; // Truncated
+    }
+    if(backend.output == ASYNC_LOG_STDERR) {
+        format_buffer[length++] = '\n';
+    }
+
+    // Long messages like hexdumps are split over several records by line
+    size_t pos = SIZE_MAX;
+    const char* text = format_buffer;
+    size_t remaining = length;
+    while(remaining > 0) {
+        size_t chunk = remaining;
+        if(chunk > ASYNC_LOG_RECORD_MAX) {
+            const char* newline = memrchr(text, '\n', ASYNC_LOG_RECORD_MAX);
+            chunk = newline ? (size_t) (newline - text) + 1 : ASYNC_LOG_RECORD_MAX;
+        }
+        pos = push_record(log_level, text, chunk);
+        text      += chunk;
+        remaining -= chunk;
+    }
+
+    if(log_level == DXWIFI_LOG_FATAL && pos != SIZE_MAX) {
+        async_logger_flush();
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ *  asynclog.h
+ * 
+ *  DESCRIPTION: Asynchronous backend for the DxWiFi logging facade. Messages
+ *  are formatted on the calling thread into a thread local buffer, pushed
+ *  into a bounded lock-free ring and written out in batches by a background
+ *  thread. Logging a message never blocks on I/O, when the ring is full the
+ *  message is dropped and counted instead.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: There's one backend per process, async_logger fulfills the
+ *  dxwifi_logger interface so it's installed with set_logger like any other
+ *  logger. Messages longer than ASYNC_LOG_RECORD_MAX take up several records,
+ *  split at line breaks where possible, and are truncated past 
+ *  ASYNC_LOG_MESSAGE_MAX. Fatal messages wait for the ring to drain so 
+ *  they're out before an abort. Threads must be done logging before the 
+ *  backend is torn down.
+ * 
+ */
+
+#ifndef LIBDXWIFI_ASYNCLOG_H
+#define LIBDXWIFI_ASYNCLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libdxwifi/details/logging.h>
+
+
+#define ASYNC_LOG_CAPACITY_DFLT     4096    /* Records the ring holds           */
+#define ASYNC_LOG_RECORD_MAX        512     /* Bytes of text per record         */
+#define ASYNC_LOG_MESSAGE_MAX       16384   /* Longest formatted message        */
+#define ASYNC_LOG_BATCH_MAX         64      /* Records written per batch        */
+#define ASYNC_LOG_FLUSH_INTERVAL_MS 10      /* Idle wait of the flusher         */
+
+
+typedef enum {
+    ASYNC_LOG_STDERR,   /* Formatted like the default logger                    */
+    ASYNC_LOG_SYSLOG    /* Sent over a syslog connection that stays open        */
+} async_log_output_t;
+
+
+typedef struct {
+    uint64_t    logged;         /* Messages pushed into the ring            */
+    uint64_t    dropped;        /* Messages lost to a full ring             */
+    uint64_t    written;        /* Messages written out                     */
+    uint64_t    batches;        /* Batches the flusher wrote                */
+} async_log_stats;
+
+
+/**
+ *  DESCRIPTION:    Starts the background flusher
+ * 
+ *  ARGUMENTS:
+ * 
+ *      output:     Where messages are written
+ * 
+ *      capacity:   Records the ring holds, rounded up to a power of two
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the backend is already running or the flusher
+ *                  couldn't be started
+ * 
+ */
+bool init_async_logger(async_log_output_t output, size_t capacity);
+
+
+/**
+ *  DESCRIPTION:    Writes out whatever is left in the ring, reports dropped
+ *                  messages and stops the flusher. Safe to call more than
+ *                  once, so it can be registered with atexit.
+ * 
+ */
+void teardown_async_logger(void);
+
+
+/**
+ *  DESCRIPTION:    Waits until every message pushed so far has been written
+ * 
+ */
+void async_logger_flush(void);
+
+
+/**
+ *  DESCRIPTION:    Snapshot of the backend's counters
+ * 
+ */
+async_log_stats async_logger_get_stats(void);
+
+
+/**
+ *  DESCRIPTION:    Logger that hands messages to the background flusher.
+ *                  Falls back to the default logger while the backend isn't
+ *                  running. See logging.h for description of arguments.
+ * 
+ */
+void async_logger(dxwifi_log_module_t module, dxwifi_log_level_t log_level, const char* fmt, va_list args);
+
+
+#endif // LIBDXWIFI_ASYNCLOG_H
@@ -0,0 +1,160 @@
+/**
+ *  blockpool.c
+ * 
+ *  DESCRIPTION: See blockpool.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <libdxwifi/details/blockpool.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+/**
+ *  DESCRIPTION:    Worker thread, claims the oldest unclaimed item until the
+ *                  pool is torn down
+ * 
+ *  ARGUMENTS:
+ * 
+ *      user:       Block pool
+ * 
+ */
+static void* process_blocks(void* user) {
+    block_pool* pool = (block_pool*) user;
+
+    bind_log_context(pool->log_context);
+
+    pthread_mutex_lock(&pool->lock);
+    while(true) {
+        while(!pool->closing && pool->next == pool->tail) {
+            ++pool->stats.idle_waits;
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if(pool->next == pool->tail) {
+            break; // Closing and nothing left to finish
+        }
+        size_t slot = pool->next++ % pool->capacity;
+        void* item = pool->items[slot];
+
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->process(item, pool->user);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->done[slot] = true;
+        pthread_cond_broadcast(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+//
+// See blockpool.h for description of non-static functions
+//
+
+bool init_block_pool(block_pool* pool, unsigned nthreads, size_t capacity, block_pool_fn process, void* user) {
+    debug_assert(pool && process && capacity > 0);
+
+    memset(pool, 0x00, sizeof(block_pool));
+
+    pool->process   = process;
+    pool->user      = user;
+    pool->log_context = current_log_context();
+    pool->capacity  = capacity;
+    pool->items     = calloc(capacity, sizeof(void*));
+    pool->done      = calloc(capacity, sizeof(bool));
+
+    assert_M(pool->items && pool->done, "Failed to allocate a window of %ld blocks", capacity);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    if(nthreads > BLOCK_POOL_THREADS_MAX) {
+        log_warning("Limiting block workers to %d", BLOCK_POOL_THREADS_MAX);
+        nthreads = BLOCK_POOL_THREADS_MAX;
+    }
+    for(unsigned i = 0; i < nthreads; ++i) {
+        int status = pthread_create(&pool->threads[i], NULL, process_blocks, pool);
+        if(status != 0) {
+            log_warning("Failed to start block worker: %s", strerror(status));
+            break;
+        }
+        ++pool->nthreads;
+    }
+    if(pool->nthreads == 0) {
+        teardown_block_pool(pool);
+        return false;
+    }
+    return true;
+}
+
+
+void teardown_block_pool(block_pool* pool) {
+    debug_assert(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->closing = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(unsigned i = 0; i < pool->nthreads; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->nthreads = 0;
+
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->items);
+    free(pool->done);
+    pool->items = NULL;
+    pool->done  = NULL;
+}
+
+
+void block_pool_submit(block_pool* pool, void* item) {
+    debug_assert(pool && !block_pool_full(pool));
+
+    pthread_mutex_lock(&pool->lock);
+
+    size_t slot = pool->tail++ % pool->capacity;
+    pool->items[slot]   = item;
+    pool->done[slot]    = false;
+    ++pool->stats.submitted;
+
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+void* block_pool_collect(block_pool* pool) {
+    debug_assert(pool);
+
+    if(block_pool_depth(pool) == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    size_t slot = pool->head % pool->capacity;
+    if(!pool->done[slot]) {
+        ++pool->stats.collect_waits;
+        while(!pool->done[slot]) {
+            pthread_cond_wait(&pool->work_done, &pool->lock);
+        }
+    }
+    void* item = pool->items[slot];
+    ++pool->head;
+    ++pool->stats.collected;
+
+    pthread_mutex_unlock(&pool->lock);
+    return item;
+}
@@ -0,0 +1,154 @@
+/**
+ *  blockpool.h
+ * 
+ *  DESCRIPTION: Small pool of worker threads that processes a window of
+ *  blocks ahead of their consumer and hands them back in the order they were
+ *  submitted. Lets the transmitter spread CPU heavy per-block work over more
+ *  than one core while frames still go out in sequence.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: A single thread submits and collects, any number of workers
+ *  process. Items are owned by the caller, the pool only passes pointers
+ *  around. A worker may finish a later block first, collecting always waits
+ *  on the oldest one.
+ * 
+ */
+
+#ifndef LIBDXWIFI_BLOCKPOOL_H
+#define LIBDXWIFI_BLOCKPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <pthread.h>
+
+#include <libdxwifi/details/logging.h>
+
+
+#define BLOCK_POOL_THREADS_MAX  16
+#define BLOCK_POOL_WINDOW_DFLT  4   /* Blocks in flight per worker          */
+
+
+/**
+ *  Called on a worker thread for every submitted item. Must only touch the
+ *  item and state that's safe to share between threads.
+ */
+typedef void (*block_pool_fn)(void* item, void* user);
+
+
+typedef struct {
+    uint64_t    submitted;      /* Items handed to the workers              */
+    uint64_t    collected;      /* Items handed back in order               */
+    uint64_t    collect_waits;  /* Collects that waited on a worker         */
+    uint64_t    idle_waits;     /* Times a worker found nothing to do       */
+} block_pool_stats;
+
+
+typedef struct {
+    pthread_t       threads[BLOCK_POOL_THREADS_MAX];
+    unsigned        nthreads;   /* Number of running workers                */
+    block_pool_fn   process;    /* Work done on each item                   */
+    void*           user;       /* Passed to process                        */
+    dxwifi_log_context* log_context;
+                                /* Workers log through the creator's context*/
+    void**          items;      /* Ring of submitted items                  */
+    bool*           done;       /* Item in the same slot was processed      */
+    size_t          capacity;   /* Size of the ring                         */
+    size_t          head;       /* Oldest item not collected yet            */
+    size_t          next;       /* Oldest item not claimed by a worker      */
+    size_t          tail;       /* Where the next item is submitted         */
+    bool            closing;    /* Workers should exit                      */
+    block_pool_stats stats;     /* Accumulated statistics                   */
+    pthread_mutex_t lock;       /* Guards all of the above                  */
+    pthread_cond_t  work_ready; /* Signalled when an item is submitted      */
+    pthread_cond_t  work_done;  /* Signalled when an item is processed      */
+} block_pool;
+
+
+/**
+ *  DESCRIPTION:    Initializes the pool and starts its workers
+ * 
+ *  ARGUMENTS:
+ * 
+ *      pool:       Pool to initialize
+ * 
+ *      nthreads:   Number of workers, at most BLOCK_POOL_THREADS_MAX
+ * 
+ *      capacity:   Most items in flight at once
+ * 
+ *      process:    Work done on each item
+ * 
+ *      user:       Passed to process
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if no worker could be started
+ * 
+ */
+bool init_block_pool(block_pool* pool, unsigned nthreads, size_t capacity, block_pool_fn process, void* user);
+
+
+/**
+ *  DESCRIPTION:    Stops and joins the workers. Items still in flight are
+ *                  finished first but never collected.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      pool:       Initialized pool
+ * 
+ */
+void teardown_block_pool(block_pool* pool);
+
+
+/**
+ *  DESCRIPTION:    Hands an item to the workers, the pool must not be full
+ * 
+ *  ARGUMENTS:
+ * 
+ *      pool:       Initialized pool
+ * 
+ *      item:       Item to process
+ * 
+ */
+void block_pool_submit(block_pool* pool, void* item);
+
+
+/**
+ *  DESCRIPTION:    Waits for the oldest item to be processed and takes it out
+ *                  of the pool
+ * 
+ *  ARGUMENTS:
+ * 
+ *      pool:       Initialized pool
+ * 
+ *  RETURNS:
+ * 
+ *      void*:      Oldest item, NULL if nothing is in flight
+ * 
+ */
+void* block_pool_collect(block_pool* pool);
+
+
+/**
+ *  DESCRIPTION:    Number of items submitted but not collected yet. Only the
+ *                  submitting thread changes it so no lock is needed.
+ * 
+ */
+static inline size_t block_pool_depth(const block_pool* pool) {
+    return pool->tail - pool->head;
+}
+
+
+/**
+ *  DESCRIPTION:    Another item can be submitted without overwriting one
+ *                  that's in flight
+ * 
+ */
+static inline bool block_pool_full(const block_pool* pool) {
+    return block_pool_depth(pool) >= pool->capacity;
+}
+
+
+#endif // LIBDXWIFI_BLOCKPOOL_H
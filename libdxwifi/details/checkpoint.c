@@ -0,0 +1,195 @@
+/**
+ *  checkpoint.c
+ * 
+ *  DESCRIPTION: See checkpoint.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include <libdxwifi/details/checkpoint.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define FNV64_OFFSET    0xcbf29ce484222325ULL
+#define FNV64_PRIME     0x100000001b3ULL
+
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t nbytes) {
+    const uint8_t* bytes = data;
+    for(size_t i = 0; i < nbytes; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+
+static uint64_t record_checksum(const checkpoint_record* record) {
+    uint64_t hash = fnv1a(FNV64_OFFSET, record, offsetof(checkpoint_record, checksum));
+    return fnv1a(hash, record->path, sizeof(record->path));
+}
+
+
+static inline int64_t mtime_ns(const struct stat* st) {
+    return (int64_t) st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+static void reset_record(checkpoint_record* record) {
+    memset(record, 0x00, sizeof(checkpoint_record));
+    memcpy(record->magic, CHECKPOINT_MAGIC, sizeof(record->magic));
+    record->version = CHECKPOINT_VERSION;
+}
+
+
+bool open_checkpoint_journal(checkpoint_journal* journal, const char* path, unsigned interval) {
+    debug_assert(journal && path && interval > 0);
+
+    memset(journal, 0x00, sizeof(checkpoint_journal));
+    journal->interval = interval;
+
+    journal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(journal->fd < 0) {
+        log_error("Failed to open checkpoint journal %s: %s", path, strerror(errno));
+        return false;
+    }
+    // Two transmitters resuming from the same journal would fight over it
+    if(flock(journal->fd, LOCK_EX | LOCK_NB) < 0) {
+        log_error("Checkpoint journal %s is in use: %s", path, strerror(errno));
+        close(journal->fd);
+        return false;
+    }
+
+    struct stat st;
+    fstat(journal->fd, &st);
+
+    bool valid = (st.st_size == sizeof(checkpoint_record));
+    if(!valid && ftruncate(journal->fd, sizeof(checkpoint_record)) < 0) {
+        log_error("Failed to create checkpoint journal %s: %s", path, strerror(errno));
+        close(journal->fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, sizeof(checkpoint_record), PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+    assert_M(map != MAP_FAILED, "Failed to map checkpoint journal: %s", strerror(errno));
+    journal->record = map;
+
+    const checkpoint_record* record = journal->record;
+    valid = valid
+        && memcmp(record->magic, CHECKPOINT_MAGIC, sizeof(record->magic)) == 0
+        && record->version == CHECKPOINT_VERSION
+        && record->checksum == record_checksum(record);
+
+    if(!valid) {
+        if(st.st_size > 0) {
+            log_warning("Checkpoint journal %s is damaged, starting over", path);
+        }
+        reset_record(journal->record);
+        checkpoint_sync(journal);
+    }
+    else if(record->active) {
+        log_info("Checkpoint journal %s holds an unfinished transmission of %s at block %d", path, record->path, record->block);
+    }
+    journal->synced = journal->record->block;
+    return true;
+}
+
+
+void close_checkpoint_journal(checkpoint_journal* journal) {
+    debug_assert(journal);
+
+    if(journal->record) {
+        checkpoint_sync(journal);
+        munmap(journal->record, sizeof(checkpoint_record));
+    }
+    if(journal->fd >= 0) {
+        close(journal->fd);
+    }
+    journal->record = NULL;
+    journal->fd     = -1;
+}
+
+
+bool checkpoint_find(checkpoint_journal* journal, const struct stat* st, size_t blocksize, uint32_t* block, int* iteration) {
+    debug_assert(journal && journal->record && st && block && iteration);
+
+    const checkpoint_record* record = journal->record;
+
+    if(!record->active
+        || record->dev != (uint64_t) st->st_dev
+        || record->ino != (uint64_t) st->st_ino
+        || record->size != (uint64_t) st->st_size
+        || record->mtime_ns != mtime_ns(st)
+        || record->blocksize != blocksize)
+    {
+        return false;
+    }
+    *block      = record->block;
+    *iteration  = record->iteration;
+    ++journal->stats.resumed;
+    return true;
+}
+
+
+void checkpoint_begin(checkpoint_journal* journal, const char* path, const struct stat* st, size_t blocksize, uint32_t block, int iteration) {
+    debug_assert(journal && journal->record && path && st);
+
+    checkpoint_record* record = journal->record;
+
+    reset_record(record);
+    record->active      = 1;
+    record->dev         = st->st_dev;
+    record->ino         = st->st_ino;
+    record->size        = st->st_size;
+    record->mtime_ns    = mtime_ns(st);
+    record->blocksize   = blocksize;
+    record->block       = block;
+    record->iteration   = iteration;
+    strncpy(record->path, path, sizeof(record->path) - 1);
+
+    checkpoint_sync(journal);
+}
+
+
+void checkpoint_sync(checkpoint_journal* journal) {
+    debug_assert(journal && journal->record);
+
+    journal->record->checksum = record_checksum(journal->record);
+
+    if(msync(journal->record, sizeof(checkpoint_record), MS_SYNC) < 0) {
+        log_warning("Failed to write checkpoint: %s", strerror(errno));
+    }
+    journal->synced = journal->record->block;
+    ++journal->stats.syncs;
+}
+
+
+void checkpoint_clear(checkpoint_journal* journal) {
+    debug_assert(journal && journal->record);
+
+    journal->record->active = 0;
+    checkpoint_sync(journal);
+}
+
+
+uint64_t checkpoint_file_id(const checkpoint_journal* journal) {
+    debug_assert(journal && journal->record);
+
+    const checkpoint_record* record = journal->record;
+
+    uint64_t hash = fnv1a(FNV64_OFFSET, &record->dev, sizeof(record->dev));
+    hash = fnv1a(hash, &record->ino, sizeof(record->ino));
+    hash = fnv1a(hash, &record->size, sizeof(record->size));
+    return fnv1a(hash, &record->mtime_ns, sizeof(record->mtime_ns));
+}
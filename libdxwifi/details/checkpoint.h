@@ -0,0 +1,196 @@
+/**
+ *  checkpoint.h
+ * 
+ *  DESCRIPTION: Journal of how far the current file transmission got, so a
+ *  transmitter that's restarted or loses power part way through a file can
+ *  pick up where it left off instead of sending the file from the start.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: The journal is a single record in a memory mapped file. Advancing
+ *  it after every frame is a store to memory, the record is only written to
+ *  disk every `interval` blocks and when a transmission starts or ends, so
+ *  checkpoints never add a system call per frame. After a power loss the
+ *  transmission resumes from the last synced block, the blocks sent after it
+ *  go out again. A record that was torn by a power loss fails its checksum
+ *  and is ignored.
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_CHECKPOINT_H
+#define LIBDXWIFI_CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+#define CHECKPOINT_MAGIC            "DXCHKPNT"
+#define CHECKPOINT_VERSION          1
+#define CHECKPOINT_INTERVAL_DFLT    64
+#define CHECKPOINT_PATH_SIZE        256
+
+
+typedef struct {
+    char        magic[8];       /* CHECKPOINT_MAGIC, not null terminated    */
+    uint32_t    version;        /* CHECKPOINT_VERSION                       */
+    uint32_t    active;         /* A transmission is in progress            */
+    uint64_t    dev;            /* Device of the file being transmitted     */
+    uint64_t    ino;            /* Inode of the file                        */
+    uint64_t    size;           /* Size of the file                         */
+    int64_t     mtime_ns;       /* Modification time of the file            */
+    uint32_t    blocksize;      /* Block size the file is sent with         */
+    uint32_t    block;          /* Blocks injected so far                   */
+    int32_t     iteration;      /* Retransmission the blocks belong to      */
+    uint32_t    reserved;
+    uint64_t    checksum;       /* Hash of everything above and the path    */
+    char        path[CHECKPOINT_PATH_SIZE]; /* File name, for the logs      */
+} checkpoint_record;
+
+
+typedef struct {
+    uint32_t    syncs;          /* Times the record was written to disk     */
+    uint32_t    resumed;        /* Transmissions picked up from the journal */
+} checkpoint_stats;
+
+
+typedef struct {
+    int                 fd;         /* Journal file                         */
+    checkpoint_record*  record;     /* Mapped record                        */
+    unsigned            interval;   /* Blocks between syncs                 */
+    uint32_t            synced;     /* Block in the record on disk          */
+    checkpoint_stats    stats;      /* Counters since the journal opened    */
+} checkpoint_journal;
+
+
+/**
+ *  DESCRIPTION:    Opens a journal, creating it if the file doesn't exist
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Journal to open
+ * 
+ *      path:       Path of the journal file
+ * 
+ *      interval:   Number of blocks between writes to disk
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the file couldn't be opened or is in use
+ * 
+ *  NOTES: A file that isn't a valid journal is logged and started over.
+ * 
+ */
+bool open_checkpoint_journal(checkpoint_journal* journal, const char* path, unsigned interval);
+
+
+/**
+ *  DESCRIPTION:    Writes out and closes the journal
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ */
+void close_checkpoint_journal(checkpoint_journal* journal);
+
+
+/**
+ *  DESCRIPTION:    Looks for an interrupted transmission of a file
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ *      st:         Status of the file about to be transmitted
+ * 
+ *      blocksize:  Block size the file will be sent with
+ * 
+ *      block:      Set to the block to resume from
+ * 
+ *      iteration:  Set to the retransmission to resume
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the journal holds an unfinished transmission of
+ *                  this exact file at the same block size
+ * 
+ */
+bool checkpoint_find(checkpoint_journal* journal, const struct stat* st, size_t blocksize, uint32_t* block, int* iteration);
+
+
+/**
+ *  DESCRIPTION:    Records the start of a transmission and writes it to disk
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ *      path:       Path of the file
+ * 
+ *      st:         Status of the file
+ * 
+ *      blocksize:  Block size the file is sent with
+ * 
+ *      block:      First block of this transmission
+ * 
+ *      iteration:  Retransmission about to start
+ * 
+ */
+void checkpoint_begin(checkpoint_journal* journal, const char* path, const struct stat* st, size_t blocksize, uint32_t block, int iteration);
+
+
+/**
+ *  DESCRIPTION:    Writes the record to disk
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ */
+void checkpoint_sync(checkpoint_journal* journal);
+
+
+/**
+ *  DESCRIPTION:    Records that another block was injected, only written to
+ *                  disk every interval blocks
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ *      block:      Number of blocks injected so far
+ * 
+ */
+static inline void checkpoint_advance(checkpoint_journal* journal, uint32_t block) {
+    journal->record->block = block;
+    if(block - journal->synced >= journal->interval) {
+        checkpoint_sync(journal);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Records that the transmission finished and writes it to
+ *                  disk, nothing is resumed after this
+ * 
+ *  ARGUMENTS:
+ * 
+ *      journal:    Opened journal
+ * 
+ */
+void checkpoint_clear(checkpoint_journal* journal);
+
+
+/**
+ *  DESCRIPTION:    Identifies the file in the record, sent to the receiver
+ *                  when a transmission is resumed
+ * 
+ */
+uint64_t checkpoint_file_id(const checkpoint_journal* journal);
+
+
+#endif // LIBDXWIFI_CHECKPOINT_H
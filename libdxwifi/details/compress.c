@@ -0,0 +1,333 @@
+/**
+ *  compress.c
+ * 
+ *  DESCRIPTION: See compress.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include <libdxwifi/details/compress.h>
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+/**
+ *  DESCRIPTION:    Compresses the buffered group into the unit buffer, or
+ *                  copies it as is if compression doesn't help
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Packetizer with a complete group buffered
+ * 
+ */
+static void build_unit(compress_packetizer* comp) {
+    compress_group_hdr* hdr = (compress_group_hdr*) comp->unit_buffer;
+    uint8_t* data           = comp->unit_buffer + sizeof(compress_group_hdr);
+
+    hdr->raw_size   = htonl(comp->length);
+    hdr->group_size = htonl(comp->group_size);
+
+    // Only keep the compressed group if it's actually smaller
+    size_t size = 0;
+    if(comp->length > 1) {
+        size = lz_compress(comp->ctx, comp->input, comp->length, data, comp->length - 1, comp->level);
+    }
+    if(size > 0) {
+        comp->unit_type = COMPRESS_UNIT_LZ;
+    }
+    else {
+        memcpy(data, comp->input, comp->length);
+        size            = comp->length;
+        comp->unit_type = COMPRESS_UNIT_STORED;
+        ++comp->stats.stored_groups;
+    }
+    comp->unit_len  = sizeof(compress_group_hdr) + size;
+    comp->in_unit   = true;
+
+    ++comp->stats.groups;
+    comp->stats.bytes_in    += comp->length;
+    comp->stats.bytes_out   += comp->unit_len;
+}
+
+
+static void reset_compress_packetizer(compress_packetizer* comp) {
+    comp->length    = 0;
+    comp->eof       = false;
+    comp->in_unit   = false;
+    comp->group     = 0;
+    reset_unit_fragmenter(&comp->fragmenter);
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a run of noise in place of lost data
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Initialized depacketizer
+ * 
+ *      fd:         Output file
+ * 
+ *      size:       Number of bytes to fill
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Number of bytes written
+ * 
+ */
+static ssize_t fill_lost(compress_depacketizer* comp, int fd, size_t size) {
+    uint8_t noise[4096];
+    memset(noise, comp->fill_value, sizeof(noise));
+
+    ssize_t total = 0;
+    while(size > 0) {
+        size_t len      = (size < sizeof(noise)) ? size : sizeof(noise);
+        ssize_t nbytes  = write(fd, noise, len);
+        if(nbytes <= 0) {
+            log_error("Failed to write noise: %s", strerror(errno));
+            break;
+        }
+        total   += nbytes;
+        size    -= nbytes;
+    }
+    comp->stats.bytes_filled += total;
+    return total;
+}
+
+
+/**
+ *  DESCRIPTION:    Decompresses a complete group and writes it out
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Initialized depacketizer
+ * 
+ *      fd:         Output file
+ * 
+ *      group:      Index of the group
+ * 
+ *      type:       Stored or compressed
+ * 
+ *      unit:       Group header followed by group data
+ * 
+ *      size:       Size of the unit
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Number of bytes written, including any noise
+ * 
+ */
+static ssize_t write_group(compress_depacketizer* comp, int fd, uint32_t group, uint8_t type, const uint8_t* unit, size_t size) {
+    ssize_t nbytes = 0;
+
+    if(size < sizeof(compress_group_hdr)) {
+        ++comp->stats.corrupt;
+        return 0;
+    }
+    const compress_group_hdr* hdr = (const compress_group_hdr*) unit;
+    size_t raw_size     = ntohl(hdr->raw_size);
+    size_t group_size   = ntohl(hdr->group_size);
+    const uint8_t* data = unit + sizeof(compress_group_hdr);
+    size -= sizeof(compress_group_hdr);
+
+    if(raw_size > COMPRESS_GROUP_SIZE_MAX || group_size > COMPRESS_GROUP_SIZE_MAX) {
+        log_warning("Group %u is too large: %ld bytes", group, raw_size);
+        ++comp->stats.corrupt;
+        return 0;
+    }
+
+    // A lower index means the transmitter started over with a new file
+    if(group > comp->next_group) {
+        log_debug("Lost groups %u through %u", comp->next_group, group - 1);
+        comp->stats.groups_lost += group - comp->next_group;
+        if(comp->fill_lost) {
+            nbytes += fill_lost(comp, fd, (size_t)(group - comp->next_group) * group_size);
+        }
+    }
+    comp->next_group = group + 1;
+
+    if(raw_size > comp->capacity) {
+        uint8_t* output = realloc(comp->output, raw_size);
+        assert_M(output, "Failed to grow group buffer to %ld bytes", raw_size);
+
+        comp->output    = output;
+        comp->capacity  = raw_size;
+    }
+
+    ssize_t decompressed = -1;
+    if(type == COMPRESS_UNIT_LZ) {
+        decompressed = lz_decompress(data, size, comp->output, raw_size);
+    }
+    else if(type == COMPRESS_UNIT_STORED && size == raw_size) {
+        memcpy(comp->output, data, size);
+        decompressed = size;
+    }
+
+    if(decompressed != (ssize_t)raw_size) {
+        log_warning("Group %u is corrupt", group);
+        ++comp->stats.corrupt;
+        if(comp->fill_lost) {
+            nbytes += fill_lost(comp, fd, raw_size);
+        }
+        return nbytes;
+    }
+
+    ssize_t written = write(fd, comp->output, raw_size);
+    debug_assert_continue(written == (ssize_t)raw_size, "Partial write: %ld - %s", written, strerror(errno));
+
+    ++comp->stats.groups;
+    return nbytes + (written > 0 ? written : 0);
+}
+
+
+//
+// See compress.h for description of non-static functions
+//
+
+void init_compress_packetizer(compress_packetizer* comp, int level, size_t group_size) {
+    debug_assert(comp && group_size > 0);
+
+    memset(comp, 0x00, sizeof(compress_packetizer));
+
+    if(group_size > COMPRESS_GROUP_SIZE_MAX) {
+        log_warning("Group size %ld exceeds %d bytes, clamping", group_size, COMPRESS_GROUP_SIZE_MAX);
+        group_size = COMPRESS_GROUP_SIZE_MAX;
+    }
+
+    comp->level         = level;
+    comp->group_size    = group_size;
+    comp->unit_capacity = sizeof(compress_group_hdr) + group_size;
+
+    comp->ctx           = malloc(sizeof(lz_context));
+    comp->input         = malloc(comp->group_size);
+    comp->unit_buffer   = malloc(comp->unit_capacity);
+    assert_M(comp->ctx && comp->input && comp->unit_buffer, "Failed to allocate compression buffers for group size: %ld", group_size);
+
+    reset_compress_packetizer(comp);
+}
+
+
+void teardown_compress_packetizer(compress_packetizer* comp) {
+    debug_assert(comp);
+
+    free(comp->ctx);
+    free(comp->input);
+    free(comp->unit_buffer);
+    comp->ctx           = NULL;
+    comp->input         = NULL;
+    comp->unit_buffer   = NULL;
+    reset_compress_packetizer(comp);
+}
+
+
+ssize_t compress_packetize(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    compress_packetizer* comp = (compress_packetizer*) user;
+    debug_assert(comp && payload && blocksize > sizeof(dxwifi_unit_hdr));
+
+    if(!comp->in_unit) {
+        if(!comp->eof && comp->length < comp->group_size) {
+            ssize_t nbytes = read(fd, comp->input + comp->length, comp->group_size - comp->length);
+            if(nbytes < 0) {
+                return -1;
+            }
+            comp->length += nbytes;
+            comp->eof     = (nbytes == 0);
+
+            if(!comp->eof && comp->length < comp->group_size) {
+                errno = EAGAIN; // Group isn't full yet, wait for more
+                return -1;
+            }
+        }
+        if(comp->length == 0) {
+            reset_compress_packetizer(comp);
+            return 0;
+        }
+        build_unit(comp);
+    }
+
+    bool unit_done = false;
+
+    size_t size = unit_fragmenter_next(
+        &comp->fragmenter,
+        comp->unit_buffer,
+        comp->unit_len,
+        comp->group,
+        comp->unit_type,
+        0,
+        0,
+        payload,
+        blocksize,
+        &unit_done
+        );
+
+    if(unit_done) {
+        comp->in_unit   = false;
+        comp->length    = 0;
+        ++comp->group;
+    }
+    return size;
+}
+
+
+bool compress_packetizer_pending(void* user) {
+    compress_packetizer* comp = (compress_packetizer*) user;
+    debug_assert(comp);
+
+    return comp->in_unit || comp->eof;
+}
+
+
+void init_compress_depacketizer(compress_depacketizer* comp, bool fill_lost, uint8_t fill_value) {
+    debug_assert(comp);
+
+    memset(comp, 0x00, sizeof(compress_depacketizer));
+
+    comp->fill_lost     = fill_lost;
+    comp->fill_value    = fill_value;
+
+    init_unit_reassembler(&comp->reassembler, sizeof(compress_group_hdr) + COMPRESS_GROUP_BLOCKS_DFLT * 1024, sizeof(compress_group_hdr) + COMPRESS_GROUP_SIZE_MAX);
+}
+
+
+void teardown_compress_depacketizer(compress_depacketizer* comp) {
+    debug_assert(comp);
+
+    teardown_unit_reassembler(&comp->reassembler);
+
+    free(comp->output);
+    comp->output    = NULL;
+    comp->capacity  = 0;
+}
+
+
+ssize_t compress_depacketize(int fd, const uint8_t* payload, size_t size, void* user) {
+    compress_depacketizer* comp = (compress_depacketizer*) user;
+    debug_assert(comp && payload);
+
+    unit_reassembler* r = &comp->reassembler;
+
+    if(!unit_reassembler_push(r, payload, size)) {
+        return 0;
+    }
+    return write_group(comp, fd, r->unit, r->type, r->buffer, r->length);
+}
+
+
+ssize_t compress_depacketizer_flush(int fd, void* user) {
+    compress_depacketizer* comp = (compress_depacketizer*) user;
+    debug_assert(comp);
+
+    __DXWIFI_UTILS_UNUSED(fd);
+
+    reset_unit_reassembler(&comp->reassembler);
+    comp->next_group = 0;
+    return 0;
+}
@@ -0,0 +1,196 @@
+/**
+ *  compress.h
+ * 
+ *  DESCRIPTION: Compression packetizer and depacketizer. The packetizer reads
+ *  the input in groups of blocks, compresses each group on its own with the
+ *  LZ codec in lz.h, and fragments the result over as many frames as needed.
+ *  Since no group depends on another, a lost frame only costs the group it
+ *  belonged to. The depacketizer decompresses each complete group and writes
+ *  it out.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Groups that don't shrink are sent stored. When asked to, the
+ *  depacketizer writes a run of noise in place of each lost group so the
+ *  output keeps the same layout as the input. Groups lost at the very end of
+ *  a transmission can't be detected and are not filled.
+ * 
+ */
+
+#ifndef LIBDXWIFI_COMPRESS_H
+#define LIBDXWIFI_COMPRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/lz.h>
+#include <libdxwifi/details/units.h>
+
+
+/************************
+ *  Constants
+ ***********************/
+
+#define COMPRESS_GROUP_BLOCKS_DFLT  16
+#define COMPRESS_GROUP_SIZE_MAX     (1024 * 1024 * 4)
+
+#define COMPRESS_UNIT_STORED        0   /* Group data as read               */
+#define COMPRESS_UNIT_LZ            1   /* Group data compressed            */
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct __attribute__((packed)) {
+    uint32_t    raw_size;       /* Size of this group uncompressed          */
+    uint32_t    group_size;     /* Size of every group but the last         */
+} compress_group_hdr;           /* Fields are in network byte order         */
+
+
+typedef struct {
+    uint32_t    groups;         /* Number of groups sent                    */
+    uint32_t    stored_groups;  /* Groups that didn't compress              */
+    uint64_t    bytes_in;       /* Total size of the input                  */
+    uint64_t    bytes_out;      /* Total size of the group units            */
+} compress_packetizer_stats;
+
+
+typedef struct {
+    lz_context* ctx;            /* Match finder scratch space               */
+    int         level;          /* Compression level                        */
+
+    uint8_t*    input;          /* Raw group data                           */
+    size_t      group_size;     /* Raw bytes per group                      */
+    size_t      length;         /* Bytes of the current group read          */
+    bool        eof;            /* Input source is exhausted?               */
+
+    uint8_t*    unit_buffer;    /* Group header followed by group data      */
+    size_t      unit_capacity;  /* Size of the unit buffer                  */
+    size_t      unit_len;       /* Size of the current unit                 */
+    uint8_t     unit_type;      /* Stored or compressed                     */
+    bool        in_unit;        /* Current unit not yet completely sent?    */
+    uint32_t    group;          /* Index of the current group               */
+
+    unit_fragmenter fragmenter; /* Splits units into payloads               */
+    compress_packetizer_stats stats;
+} compress_packetizer;
+
+
+typedef struct {
+    uint32_t    groups;         /* Groups decompressed and written          */
+    uint32_t    groups_lost;    /* Groups skipped over                      */
+    uint32_t    corrupt;        /* Groups that failed to decompress         */
+    uint64_t    bytes_filled;   /* Noise written in place of lost groups    */
+} compress_depacketizer_stats;
+
+
+typedef struct {
+    unit_reassembler reassembler;   /* Collects the fragments of each unit  */
+
+    uint8_t*    output;             /* Decompressed group                   */
+    size_t      capacity;           /* Size of the output buffer            */
+
+    bool        fill_lost;          /* Write noise in place of lost groups? */
+    uint8_t     fill_value;         /* Noise byte                           */
+    uint32_t    next_group;         /* Index of the group expected next     */
+
+    compress_depacketizer_stats stats;
+} compress_depacketizer;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Initializes the compression packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Pointer to an allocated packetizer
+ * 
+ *      level:      Compression level, see lz.h
+ * 
+ *      group_size: Number of input bytes compressed together
+ * 
+ */
+void init_compress_packetizer(compress_packetizer* comp, int level, size_t group_size);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Initialized packetizer
+ * 
+ */
+void teardown_compress_packetizer(compress_packetizer* comp);
+
+
+/**
+ *  DESCRIPTION:    Packetizer read_block callback, see transmitter.h. Fills
+ *                  the payload with a unit header and the next fragment of
+ *                  the current group
+ * 
+ *  NOTES: The packetizer resets itself once the end of input is reached so it
+ *  can be reused for the next transmission.
+ * 
+ */
+ssize_t compress_packetize(int fd, uint8_t* payload, size_t blocksize, void* comp);
+
+
+/**
+ *  DESCRIPTION:    Packetizer has_pending callback, see transmitter.h.
+ * 
+ */
+bool compress_packetizer_pending(void* comp);
+
+
+/**
+ *  DESCRIPTION:    Initializes the compression depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Pointer to an allocated depacketizer
+ * 
+ *      fill_lost:  Write noise in place of lost groups?
+ * 
+ *      fill_value: Noise byte
+ * 
+ */
+void init_compress_depacketizer(compress_depacketizer* comp, bool fill_lost, uint8_t fill_value);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      comp:       Initialized depacketizer
+ * 
+ */
+void teardown_compress_depacketizer(compress_depacketizer* comp);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer write_block callback, see receiver.h. Writes
+ *                  out a group once its last fragment has been received
+ * 
+ */
+ssize_t compress_depacketize(int fd, const uint8_t* payload, size_t size, void* comp);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer flush callback, see receiver.h. Drops any
+ *                  partially received group and resets for the next capture
+ * 
+ */
+ssize_t compress_depacketizer_flush(int fd, void* comp);
+
+
+#endif // LIBDXWIFI_COMPRESS_H
@@ -0,0 +1,763 @@
+/**
+ *  delta.c
+ * 
+ *  DESCRIPTION: See delta.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include <libdxwifi/details/delta.h>
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define DELTA_INDEX_NONE        UINT32_MAX
+#define DELTA_OP_LEN_MAX        UINT16_MAX
+#define DELTA_LITERAL_HDR_SIZE  3
+#define DELTA_COPY_SIZE         7
+
+
+/**
+ *  DESCRIPTION:    Grows the data buffer of a file to at least the size needed
+ * 
+ *  ARGUMENTS:
+ * 
+ *      file:       File to grow
+ * 
+ *      needed:     Minimum size of the data buffer
+ * 
+ */
+static void grow_file(delta_file* file, size_t needed) {
+    if(needed <= file->capacity) {
+        return;
+    }
+    size_t new_capacity = (file->capacity > 0 ? file->capacity : DELTA_BUFFER_SIZE_DFLT);
+    while(new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    uint8_t* data = realloc(file->data, new_capacity);
+    assert_M(data, "Failed to grow delta buffer to %ld bytes", new_capacity);
+
+    file->data      = data;
+    file->capacity  = new_capacity;
+}
+
+
+static void swap_files(delta_file* a, delta_file* b) {
+    delta_file tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+
+/**
+ *  DESCRIPTION:    FNV-1a checksum identifying a file. Zero is reserved to
+ *                  mean no reference.
+ * 
+ */
+static uint32_t file_checksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+
+/**
+ *  DESCRIPTION:    rsync style rolling checksum of a block. The two 16-bit
+ *                  sums are kept unmasked, only the low 16 bits of each are
+ *                  used, so rolling forward is a handful of additions.
+ * 
+ */
+static void block_checksum(const uint8_t* block, uint32_t* a, uint32_t* b) {
+    uint32_t sa = 0, sb = 0;
+    for(size_t i = 0; i < DELTA_BLOCK_SIZE; ++i) {
+        sa += block[i];
+        sb += (DELTA_BLOCK_SIZE - i) * block[i];
+    }
+    *a = sa;
+    *b = sb;
+}
+
+
+static inline uint32_t weak_checksum(uint32_t a, uint32_t b) {
+    return (a & 0xffff) | (b << 16);
+}
+
+
+static inline size_t index_bucket(const delta_packetizer* delta, uint32_t weak) {
+    return ((weak ^ (weak >> 15)) * 2654435761u) & (delta->index_buckets - 1);
+}
+
+
+/**
+ *  DESCRIPTION:    Indexes every whole block of the reference by its rolling
+ *                  checksum
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Packetizer with a reference loaded
+ * 
+ */
+static void build_index(delta_packetizer* delta) {
+    size_t blocks   = delta->reference.length / DELTA_BLOCK_SIZE;
+    size_t buckets  = 16;
+    while(buckets < blocks * 2) {
+        buckets *= 2;
+    }
+
+    if(buckets > delta->index_buckets) {
+        free(delta->index_heads);
+        delta->index_heads = malloc(buckets * sizeof(uint32_t));
+        assert_M(delta->index_heads, "Failed to allocate %ld index buckets", buckets);
+    }
+    if(blocks > delta->index_blocks) {
+        free(delta->index_next);
+        free(delta->index_weak);
+        delta->index_next = malloc(blocks * sizeof(uint32_t));
+        delta->index_weak = malloc(blocks * sizeof(uint32_t));
+        assert_M(delta->index_next && delta->index_weak, "Failed to allocate index for %ld blocks", blocks);
+    }
+    delta->index_buckets    = buckets;
+    delta->index_blocks     = blocks;
+
+    memset(delta->index_heads, 0xff, buckets * sizeof(uint32_t));
+
+    // Inserted back to front so the chains are in file order
+    for(size_t i = blocks; i > 0; --i) {
+        uint32_t a, b;
+        block_checksum(delta->reference.data + (i - 1) * DELTA_BLOCK_SIZE, &a, &b);
+
+        uint32_t weak   = weak_checksum(a, b);
+        size_t bucket   = index_bucket(delta, weak);
+
+        delta->index_weak[i - 1]    = weak;
+        delta->index_next[i - 1]    = delta->index_heads[bucket];
+        delta->index_heads[bucket]  = i - 1;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Looks up a block of the file in the reference
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Packetizer with the reference indexed
+ * 
+ *      weak:       Rolling checksum of the block
+ * 
+ *      block:      DELTA_BLOCK_SIZE bytes of the file
+ * 
+ *  RETURNS:
+ * 
+ *      uint32_t:   Index of the matching reference block, DELTA_INDEX_NONE if
+ *                  the block isn't in the reference
+ * 
+ */
+static uint32_t find_block(const delta_packetizer* delta, uint32_t weak, const uint8_t* block) {
+    uint32_t i = delta->index_heads[index_bucket(delta, weak)];
+    while(i != DELTA_INDEX_NONE) {
+        if(delta->index_weak[i] == weak && memcmp(delta->reference.data + (size_t)i * DELTA_BLOCK_SIZE, block, DELTA_BLOCK_SIZE) == 0) {
+            return i;
+        }
+        i = delta->index_next[i];
+    }
+    return DELTA_INDEX_NONE;
+}
+
+
+static void push_op(delta_packetizer* delta, uint8_t type, size_t src, size_t len) {
+    if(len == 0) {
+        return;
+    }
+
+    // Consecutive reference blocks collapse into a single copy
+    if(type == DELTA_OP_COPY && delta->num_ops > 0) {
+        delta_op* last = &delta->ops[delta->num_ops - 1];
+        if(last->type == DELTA_OP_COPY && last->src + last->len == src) {
+            last->len += len;
+            return;
+        }
+    }
+
+    if(delta->num_ops == delta->ops_capacity) {
+        size_t new_capacity = (delta->ops_capacity > 0 ? delta->ops_capacity * 2 : 64);
+        delta_op* ops = realloc(delta->ops, new_capacity * sizeof(delta_op));
+        assert_M(ops, "Failed to grow delta to %ld operations", new_capacity);
+
+        delta->ops          = ops;
+        delta->ops_capacity = new_capacity;
+    }
+    delta->ops[delta->num_ops++] = (delta_op){ .type = type, .src = src, .len = len };
+}
+
+
+/**
+ *  DESCRIPTION:    Diffs the file against the reference. Slides a block sized
+ *                  window over the file one byte at a time until it lands on
+ *                  a block from the reference, so matches are found even if
+ *                  the data shifted.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Packetizer with the file loaded and the reference indexed
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Encoded size of the delta
+ * 
+ */
+static size_t diff_file(delta_packetizer* delta) {
+    const uint8_t* in   = delta->file.data;
+    size_t size         = delta->file.length;
+    size_t literal      = 0;
+    size_t pos          = 0;
+    size_t encoded      = 0;
+
+    delta->num_ops = 0;
+
+    if(delta->index_blocks > 0 && size >= DELTA_BLOCK_SIZE) {
+        uint32_t a, b;
+        block_checksum(in, &a, &b);
+
+        while(true) {
+            uint32_t block = find_block(delta, weak_checksum(a, b), in + pos);
+
+            if(block != DELTA_INDEX_NONE) {
+                push_op(delta, DELTA_OP_LITERAL, literal, pos - literal);
+                push_op(delta, DELTA_OP_COPY, (size_t)block * DELTA_BLOCK_SIZE, DELTA_BLOCK_SIZE);
+                delta->stats.bytes_matched += DELTA_BLOCK_SIZE;
+
+                pos     += DELTA_BLOCK_SIZE;
+                literal  = pos;
+                if(pos + DELTA_BLOCK_SIZE > size) {
+                    break;
+                }
+                block_checksum(in + pos, &a, &b);
+            }
+            else {
+                if(pos + DELTA_BLOCK_SIZE >= size) {
+                    break;
+                }
+                uint8_t out = in[pos];
+                uint8_t nxt = in[pos + DELTA_BLOCK_SIZE];
+                a  += nxt - out;
+                b  += a - DELTA_BLOCK_SIZE * out;
+                ++pos;
+            }
+        }
+    }
+    push_op(delta, DELTA_OP_LITERAL, literal, size - literal);
+
+    for(size_t i = 0; i < delta->num_ops; ++i) {
+        size_t len      = delta->ops[i].len;
+        size_t chunks   = (len + DELTA_OP_LEN_MAX - 1) / DELTA_OP_LEN_MAX;
+        if(delta->ops[i].type == DELTA_OP_COPY) {
+            encoded += chunks * DELTA_COPY_SIZE;
+        }
+        else {
+            encoded += chunks * DELTA_LITERAL_HDR_SIZE + len;
+        }
+    }
+    return encoded;
+}
+
+
+/**
+ *  DESCRIPTION:    Decides how to send the file that was just read
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Packetizer with the entire file loaded
+ * 
+ */
+static void start_file(delta_packetizer* delta) {
+    delta->file.id      = file_checksum(delta->file.data, delta->file.length);
+    delta->send_delta   = false;
+
+    bool keyframe = delta->keyframe > 0 && delta->since_keyframe + 1 >= delta->keyframe;
+
+    if(delta->reference.length > 0 && !keyframe) {
+        size_t encoded  = diff_file(delta);
+        size_t savings  = (encoded < delta->file.length) ? delta->file.length - encoded : 0;
+
+        delta->send_delta = (savings * 100 >= delta->file.length * delta->threshold) && savings > 0;
+
+        log_info("Delta against %08x is %ld of %ld bytes (%ld%% savings), sending %s",
+            delta->reference.id, encoded, delta->file.length, (savings * 100) / delta->file.length,
+            delta->send_delta ? "delta" : "full file");
+    }
+
+    if(delta->send_delta) {
+        ++delta->stats.delta_files;
+        ++delta->since_keyframe;
+    }
+    else {
+        ++delta->stats.full_files;
+        delta->since_keyframe = 0;
+    }
+    delta->stats.bytes_in += delta->file.length;
+}
+
+
+/**
+ *  DESCRIPTION:    Makes the file just sent the reference for the next one
+ * 
+ */
+static void finish_file(delta_packetizer* delta) {
+    swap_files(&delta->file, &delta->reference);
+    build_index(delta);
+
+    delta->file.length  = 0;
+    delta->loaded       = false;
+    delta->op           = 0;
+    delta->op_offset    = 0;
+    delta->out_offset   = 0;
+    delta->frame        = 0;
+    reset_unit_fragmenter(&delta->fragmenter);
+}
+
+
+static void reset_delta_packetizer(delta_packetizer* delta) {
+    delta->file.length  = 0;
+    delta->loaded       = false;
+    delta->num_ops      = 0;
+    delta->op           = 0;
+    delta->op_offset    = 0;
+    delta->out_offset   = 0;
+    delta->frame        = 0;
+    reset_unit_fragmenter(&delta->fragmenter);
+}
+
+
+static inline void put_u16(uint8_t* dst, uint16_t value) {
+    value = htons(value);
+    memcpy(dst, &value, sizeof(value));
+}
+
+
+static inline void put_u32(uint8_t* dst, uint32_t value) {
+    value = htonl(value);
+    memcpy(dst, &value, sizeof(value));
+}
+
+
+static inline uint16_t get_u16(const uint8_t* src) {
+    uint16_t value;
+    memcpy(&value, src, sizeof(value));
+    return ntohs(value);
+}
+
+
+static inline uint32_t get_u32(const uint8_t* src) {
+    uint32_t value;
+    memcpy(&value, src, sizeof(value));
+    return ntohl(value);
+}
+
+
+/**
+ *  DESCRIPTION:    Builds the next frame of the file into the unit buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Packetizer with a file loaded
+ * 
+ *      capacity:   Maximum size of the frame
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Size of the frame
+ * 
+ */
+static size_t build_frame(delta_packetizer* delta, size_t capacity) {
+    delta_frame_hdr* hdr    = (delta_frame_hdr*) delta->unit_buffer;
+    uint8_t* data           = delta->unit_buffer + sizeof(delta_frame_hdr);
+    size_t room             = capacity - sizeof(delta_frame_hdr);
+    size_t used             = 0;
+
+    hdr->file_id    = htonl(delta->file.id);
+    hdr->ref_id     = htonl(delta->send_delta ? delta->reference.id : 0);
+    hdr->offset     = htonl(delta->out_offset);
+    hdr->file_size  = htonl(delta->file.length);
+
+    if(!delta->send_delta) {
+        used = delta->file.length - delta->out_offset;
+        used = (used < room) ? used : room;
+        memcpy(data, delta->file.data + delta->out_offset, used);
+        delta->out_offset += used;
+        return sizeof(delta_frame_hdr) + used;
+    }
+
+    while(delta->op < delta->num_ops) {
+        const delta_op* op  = &delta->ops[delta->op];
+        size_t left         = op->len - delta->op_offset;
+        size_t len          = (left < DELTA_OP_LEN_MAX) ? left : DELTA_OP_LEN_MAX;
+
+        if(op->type == DELTA_OP_COPY) {
+            if(room - used < DELTA_COPY_SIZE) {
+                break;
+            }
+            data[used] = DELTA_OP_COPY;
+            put_u32(data + used + 1, op->src + delta->op_offset);
+            put_u16(data + used + 5, len);
+            used += DELTA_COPY_SIZE;
+        }
+        else {
+            if(room - used <= DELTA_LITERAL_HDR_SIZE) {
+                break;
+            }
+            size_t avail = room - used - DELTA_LITERAL_HDR_SIZE;
+            len = (len < avail) ? len : avail;
+
+            data[used] = DELTA_OP_LITERAL;
+            put_u16(data + used + 1, len);
+            memcpy(data + used + DELTA_LITERAL_HDR_SIZE, delta->file.data + op->src + delta->op_offset, len);
+            used += DELTA_LITERAL_HDR_SIZE + len;
+        }
+
+        delta->op_offset    += len;
+        delta->out_offset   += len;
+        if(delta->op_offset == op->len) {
+            delta->op_offset = 0;
+            ++delta->op;
+        }
+    }
+    return sizeof(delta_frame_hdr) + used;
+}
+
+
+/**
+ *  DESCRIPTION:    Sets up the depacketizer to rebuild a new file
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Initialized depacketizer
+ * 
+ *      file_id:    Checksum of the file
+ * 
+ *      ref_id:     Reference the file was sent against
+ * 
+ *      file_size:  Size of the file
+ * 
+ *      type:       Unit type of the first frame received
+ * 
+ */
+static void begin_file(delta_depacketizer* delta, uint32_t file_id, uint32_t ref_id, size_t file_size, uint8_t type) {
+    delta_file* file = &delta->file;
+
+    grow_file(file, file_size);
+    file->length    = file_size;
+    file->id        = file_id;
+    delta->is_delta = (type == DELTA_UNIT_DELTA);
+    delta->active   = true;
+
+    // Anything lost from a delta keeps what the reference had there
+    size_t from_ref = 0;
+    if(delta->is_delta) {
+        if(delta->have_ref && delta->reference.id == ref_id) {
+            from_ref = (delta->reference.length < file_size) ? delta->reference.length : file_size;
+            memcpy(file->data, delta->reference.data, from_ref);
+        }
+        else {
+            log_warning("File %08x is a delta against %08x which was never received", file_id, ref_id);
+            ++delta->stats.missing_refs;
+        }
+    }
+    memset(file->data + from_ref, delta->fill_value, file_size - from_ref);
+}
+
+
+/**
+ *  DESCRIPTION:    Writes out the rebuilt file and keeps it as the reference
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Depacketizer with a file being rebuilt
+ * 
+ *      fd:         Output file
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Number of bytes written
+ * 
+ */
+static ssize_t write_file(delta_depacketizer* delta, int fd) {
+    delta_file* file = &delta->file;
+
+    ssize_t written = write(fd, file->data, file->length);
+    debug_assert_continue(written == (ssize_t)file->length, "Partial write: %ld - %s", written, strerror(errno));
+
+    if(file_checksum(file->data, file->length) == file->id) {
+        ++delta->stats.verified;
+    }
+    else {
+        log_warning("File %08x does not match its checksum, some of it was lost", file->id);
+    }
+    ++delta->stats.files;
+    if(delta->is_delta) {
+        ++delta->stats.delta_files;
+    }
+
+    // Even a damaged file is the best reference we have for the next delta
+    swap_files(&delta->file, &delta->reference);
+    delta->have_ref     = true;
+    delta->active       = false;
+    delta->file.length  = 0;
+
+    return (written > 0) ? written : 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Applies a delta frame to the file being rebuilt
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Depacketizer with a file being rebuilt
+ * 
+ *      ref_id:     Reference the delta was made against
+ * 
+ *      offset:     Output offset the operations start at
+ * 
+ *      data:       Operations
+ * 
+ *      size:       Size of the operations
+ * 
+ */
+static void apply_delta(delta_depacketizer* delta, uint32_t ref_id, size_t offset, const uint8_t* data, size_t size) {
+    delta_file* file        = &delta->file;
+    const delta_file* ref   = &delta->reference;
+    bool have_ref           = delta->have_ref && ref->id == ref_id;
+    size_t pos              = 0;
+
+    while(pos < size) {
+        uint8_t type = data[pos];
+
+        if(type == DELTA_OP_COPY && pos + DELTA_COPY_SIZE <= size) {
+            size_t src = get_u32(data + pos + 1);
+            size_t len = get_u16(data + pos + 5);
+            pos += DELTA_COPY_SIZE;
+
+            if(offset + len > file->length) {
+                break;
+            }
+            if(have_ref && src + len <= ref->length) {
+                memcpy(file->data + offset, ref->data + src, len);
+            }
+            offset += len;
+        }
+        else if(type == DELTA_OP_LITERAL && pos + DELTA_LITERAL_HDR_SIZE <= size) {
+            size_t len = get_u16(data + pos + 1);
+            pos += DELTA_LITERAL_HDR_SIZE;
+
+            if(pos + len > size || offset + len > file->length) {
+                break;
+            }
+            memcpy(file->data + offset, data + pos, len);
+            pos     += len;
+            offset  += len;
+        }
+        else {
+            break;
+        }
+    }
+    debug_assert_continue(pos == size, "Malformed delta frame at offset %ld", offset);
+}
+
+
+//
+// See delta.h for description of non-static functions
+//
+
+void init_delta_packetizer(delta_packetizer* delta, unsigned threshold, unsigned keyframe) {
+    debug_assert(delta);
+
+    memset(delta, 0x00, sizeof(delta_packetizer));
+
+    delta->threshold    = (threshold < 100) ? threshold : 100;
+    delta->keyframe     = keyframe;
+
+    grow_file(&delta->file, DELTA_BUFFER_SIZE_DFLT);
+    grow_file(&delta->reference, DELTA_BUFFER_SIZE_DFLT);
+
+    reset_delta_packetizer(delta);
+}
+
+
+void teardown_delta_packetizer(delta_packetizer* delta) {
+    debug_assert(delta);
+
+    free(delta->file.data);
+    free(delta->reference.data);
+    free(delta->index_heads);
+    free(delta->index_next);
+    free(delta->index_weak);
+    free(delta->ops);
+    memset(delta, 0x00, sizeof(delta_packetizer));
+}
+
+
+ssize_t delta_packetize(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    delta_packetizer* delta = (delta_packetizer*) user;
+    debug_assert(delta && payload && blocksize > sizeof(dxwifi_unit_hdr) + sizeof(delta_frame_hdr) + DELTA_COPY_SIZE);
+
+    if(!delta->loaded) {
+        delta_file* file = &delta->file;
+        if(file->length == file->capacity) {
+            if(file->capacity >= DELTA_FILE_SIZE_MAX) {
+                log_error("File exceeds %d bytes, the remainder will not be sent", DELTA_FILE_SIZE_MAX);
+            }
+            else {
+                grow_file(file, file->capacity * 2);
+            }
+        }
+        ssize_t nbytes = 0;
+        if(file->length < file->capacity) {
+            nbytes = read(fd, file->data + file->length, file->capacity - file->length);
+        }
+        if(nbytes < 0) {
+            return -1;
+        }
+        if(nbytes > 0) {
+            file->length += nbytes;
+            errno = EAGAIN; // Keep reading until the whole file is buffered
+            return -1;
+        }
+        if(file->length == 0) {
+            reset_delta_packetizer(delta);
+            return 0;
+        }
+        delta->loaded = true;
+        start_file(delta);
+    }
+
+    if(delta->out_offset >= delta->file.length) {
+        finish_file(delta);
+        return 0;
+    }
+
+    size_t capacity = blocksize - sizeof(dxwifi_unit_hdr);
+    capacity = (capacity < sizeof(delta->unit_buffer)) ? capacity : sizeof(delta->unit_buffer);
+
+    size_t unit_len = build_frame(delta, capacity);
+    bool unit_done  = false;
+
+    size_t size = unit_fragmenter_next(
+        &delta->fragmenter,
+        delta->unit_buffer,
+        unit_len,
+        delta->frame,
+        delta->send_delta ? DELTA_UNIT_DELTA : DELTA_UNIT_FULL,
+        delta->send_delta ? 0 : DXWIFI_UNIT_F_KEY,
+        0,
+        payload,
+        blocksize,
+        &unit_done
+        );
+    debug_assert(unit_done);
+
+    ++delta->frame;
+    delta->stats.bytes_out += unit_len;
+    return size;
+}
+
+
+bool delta_packetizer_pending(void* user) {
+    delta_packetizer* delta = (delta_packetizer*) user;
+    debug_assert(delta);
+
+    return delta->loaded;
+}
+
+
+void init_delta_depacketizer(delta_depacketizer* delta, uint8_t fill_value) {
+    debug_assert(delta);
+
+    memset(delta, 0x00, sizeof(delta_depacketizer));
+
+    delta->fill_value = fill_value;
+
+    init_unit_reassembler(&delta->reassembler, DXWIFI_BLOCK_SIZE_MAX, DXWIFI_BLOCK_SIZE_MAX);
+}
+
+
+void teardown_delta_depacketizer(delta_depacketizer* delta) {
+    debug_assert(delta);
+
+    teardown_unit_reassembler(&delta->reassembler);
+
+    free(delta->file.data);
+    free(delta->reference.data);
+    memset(&delta->file, 0x00, sizeof(delta_file));
+    memset(&delta->reference, 0x00, sizeof(delta_file));
+    delta->active   = false;
+    delta->have_ref = false;
+}
+
+
+ssize_t delta_depacketize(int fd, const uint8_t* payload, size_t size, void* user) {
+    delta_depacketizer* delta = (delta_depacketizer*) user;
+    debug_assert(delta && payload);
+
+    unit_reassembler* r = &delta->reassembler;
+
+    if(!unit_reassembler_push(r, payload, size) || r->length < sizeof(delta_frame_hdr)) {
+        return 0;
+    }
+
+    const delta_frame_hdr* hdr = (const delta_frame_hdr*) r->buffer;
+    uint32_t file_id    = ntohl(hdr->file_id);
+    uint32_t ref_id     = ntohl(hdr->ref_id);
+    size_t offset       = ntohl(hdr->offset);
+    size_t file_size    = ntohl(hdr->file_size);
+    const uint8_t* data = r->buffer + sizeof(delta_frame_hdr);
+    size_t data_len     = r->length - sizeof(delta_frame_hdr);
+
+    if(file_size > DELTA_FILE_SIZE_MAX || offset > file_size || (r->type != DELTA_UNIT_FULL && r->type != DELTA_UNIT_DELTA)) {
+        log_warning("Dropping malformed delta frame %u", r->unit);
+        return 0;
+    }
+
+    ssize_t nbytes = 0;
+    bool is_delta  = (r->type == DELTA_UNIT_DELTA);
+    if(!delta->active || delta->file.id != file_id || delta->file.length != file_size || delta->is_delta != is_delta) {
+        if(delta->active) {
+            nbytes = write_file(delta, fd);
+        }
+        begin_file(delta, file_id, ref_id, file_size, r->type);
+    }
+
+    if(is_delta) {
+        apply_delta(delta, ref_id, offset, data, data_len);
+    }
+    else {
+        data_len = (data_len < file_size - offset) ? data_len : file_size - offset;
+        memcpy(delta->file.data + offset, data, data_len);
+    }
+    return nbytes;
+}
+
+
+ssize_t delta_depacketizer_flush(int fd, void* user) {
+    delta_depacketizer* delta = (delta_depacketizer*) user;
+    debug_assert(delta);
+
+    ssize_t nbytes = 0;
+    if(delta->active) {
+        nbytes = write_file(delta, fd);
+    }
+    reset_unit_reassembler(&delta->reassembler);
+    return nbytes;
+}
@@ -0,0 +1,232 @@
+/**
+ *  delta.h
+ * 
+ *  DESCRIPTION: Inter-file delta packetizer and depacketizer. The packetizer
+ *  keeps the last file it sent as a reference and indexes the reference's
+ *  blocks by a rolling checksum. Each new file is scanned for blocks that
+ *  already exist in the reference, wherever they moved to, and if enough of
+ *  the file is found the packetizer sends the changed bytes plus copy
+ *  instructions instead of the whole file. The depacketizer keeps its own
+ *  copy of the reference to rebuild each file from.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Every frame is self contained, it carries the output offset its
+ *  instructions start at. When a delta frame is lost the receiver keeps the
+ *  reference's bytes for that range, so the damage is usually limited to
+ *  whatever changed there. Files are identified by a checksum of their
+ *  contents which the receiver also uses to verify each rebuilt file.
+ * 
+ */
+
+#ifndef LIBDXWIFI_DELTA_H
+#define LIBDXWIFI_DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/units.h>
+
+
+/************************
+ *  Constants
+ ***********************/
+
+#define DELTA_BLOCK_SIZE            256
+#define DELTA_FILE_SIZE_MAX         (1024 * 1024 * 32)
+#define DELTA_BUFFER_SIZE_DFLT      (1024 * 64)
+#define DELTA_THRESHOLD_DFLT        25      /* Minimum savings in percent   */
+#define DELTA_KEYFRAME_DFLT         10      /* Full file every N files      */
+
+#define DELTA_UNIT_FULL             0       /* Raw bytes of the file        */
+#define DELTA_UNIT_DELTA            1       /* Copy and literal operations  */
+
+#define DELTA_OP_LITERAL            0       /* uint16 len, then len bytes   */
+#define DELTA_OP_COPY               1       /* uint32 ref offset, uint16 len*/
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct __attribute__((packed)) {
+    uint32_t    file_id;        /* Checksum of the file being sent          */
+    uint32_t    ref_id;         /* Checksum of the reference, 0 if none     */
+    uint32_t    offset;         /* Output offset of this frame's data       */
+    uint32_t    file_size;      /* Size of the file being sent              */
+} delta_frame_hdr;              /* Fields are in network byte order         */
+
+
+typedef struct {
+    uint8_t     type;           /* DELTA_OP_LITERAL or DELTA_OP_COPY        */
+    uint32_t    src;            /* Input offset of a literal, or reference  */
+                                /* offset of a copy                         */
+    uint32_t    len;            /* Number of output bytes                   */
+} delta_op;
+
+
+typedef struct {
+    uint8_t*    data;           /* File contents                            */
+    size_t      capacity;       /* Size of the data buffer                  */
+    size_t      length;         /* Size of the file                         */
+    uint32_t    id;             /* Checksum of the file                     */
+} delta_file;
+
+
+typedef struct {
+    uint32_t    full_files;     /* Files sent in full                       */
+    uint32_t    delta_files;    /* Files sent as a delta                    */
+    uint64_t    bytes_in;       /* Total size of the files                  */
+    uint64_t    bytes_out;      /* Total size of the frame payloads         */
+    uint64_t    bytes_matched;  /* Bytes found in the reference             */
+} delta_packetizer_stats;
+
+
+typedef struct {
+    delta_file  file;           /* File being sent                          */
+    delta_file  reference;      /* Last file sent                           */
+    bool        loaded;         /* Entire file read and diffed?             */
+
+    uint32_t*   index_heads;    /* First reference block in each bucket     */
+    uint32_t*   index_next;     /* Next reference block in the same bucket  */
+    uint32_t*   index_weak;     /* Rolling checksum of each reference block */
+    size_t      index_buckets;  /* Number of buckets, a power of two        */
+    size_t      index_blocks;   /* Number of reference blocks indexed       */
+
+    delta_op*   ops;            /* Delta of the file against the reference  */
+    size_t      num_ops;        /* Number of operations                     */
+    size_t      ops_capacity;   /* Size of the operation list               */
+
+    bool        send_delta;     /* Sending a delta rather than the file?    */
+    size_t      op;             /* Next operation to send                   */
+    size_t      op_offset;      /* Bytes of the next operation already sent */
+    size_t      out_offset;     /* Output offset of the next frame          */
+    uint32_t    frame;          /* Index of the next frame of the file      */
+    uint8_t     unit_buffer[DXWIFI_BLOCK_SIZE_MAX]; /* Frame being built    */
+
+    unsigned    threshold;      /* Minimum savings to send a delta          */
+    unsigned    keyframe;       /* Send a full file every N files           */
+    unsigned    since_keyframe; /* Files sent since the last full file      */
+
+    unit_fragmenter fragmenter; /* Frames units                             */
+    delta_packetizer_stats stats;
+} delta_packetizer;
+
+
+typedef struct {
+    uint32_t    files;          /* Files written                            */
+    uint32_t    delta_files;    /* Files rebuilt from a delta               */
+    uint32_t    verified;       /* Files whose checksum matched             */
+    uint32_t    missing_refs;   /* Deltas against a reference we don't have */
+} delta_depacketizer_stats;
+
+
+typedef struct {
+    unit_reassembler reassembler;   /* Collects the fragments of each unit  */
+
+    delta_file  file;               /* File being rebuilt                   */
+    delta_file  reference;          /* Last file written                    */
+    bool        active;             /* Rebuilding a file?                   */
+    bool        is_delta;           /* File is being rebuilt from a delta?  */
+    bool        have_ref;           /* Reference is valid?                  */
+    uint8_t     fill_value;         /* Byte for data that was never received*/
+
+    delta_depacketizer_stats stats;
+} delta_depacketizer;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Initializes the delta packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Pointer to an allocated packetizer
+ * 
+ *      threshold:  Only send a delta if it saves at least this percent
+ * 
+ *      keyframe:   Send every Nth file in full regardless, 0 to disable
+ * 
+ */
+void init_delta_packetizer(delta_packetizer* delta, unsigned threshold, unsigned keyframe);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Initialized packetizer
+ * 
+ */
+void teardown_delta_packetizer(delta_packetizer* delta);
+
+
+/**
+ *  DESCRIPTION:    Packetizer read_block callback, see transmitter.h. Reads
+ *                  the entire file, diffs it against the reference, then fills
+ *                  each payload with a unit header, a frame header and as
+ *                  much of the file or delta as fits
+ * 
+ *  NOTES: Once the end of the file is reached it becomes the new reference
+ *  and the packetizer is ready for the next transmission.
+ * 
+ */
+ssize_t delta_packetize(int fd, uint8_t* payload, size_t blocksize, void* delta);
+
+
+/**
+ *  DESCRIPTION:    Packetizer has_pending callback, see transmitter.h.
+ * 
+ */
+bool delta_packetizer_pending(void* delta);
+
+
+/**
+ *  DESCRIPTION:    Initializes the delta depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Pointer to an allocated depacketizer
+ * 
+ *      fill_value: Byte written for data that was lost with no reference
+ * 
+ */
+void init_delta_depacketizer(delta_depacketizer* delta, uint8_t fill_value);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      delta:      Initialized depacketizer
+ * 
+ */
+void teardown_delta_depacketizer(delta_depacketizer* delta);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer write_block callback, see receiver.h. Applies
+ *                  each frame to the file being rebuilt, writing out the
+ *                  previous file when the next one starts
+ * 
+ */
+ssize_t delta_depacketize(int fd, const uint8_t* payload, size_t size, void* delta);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer flush callback, see receiver.h. Writes out
+ *                  the file being rebuilt, it becomes the new reference
+ * 
+ */
+ssize_t delta_depacketizer_flush(int fd, void* delta);
+
+
+#endif // LIBDXWIFI_DELTA_H
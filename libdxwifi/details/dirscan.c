@@ -0,0 +1,218 @@
+/**
+ *  dirscan.c
+ * 
+ *  DESCRIPTION: See dirscan.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#define _GNU_SOURCE // statx, qsort_r
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <libdxwifi/details/dirscan.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+// Layout of the records returned by getdents64, see getdents(2)
+typedef struct {
+    uint64_t        d_ino;
+    int64_t         d_off;
+    unsigned short  d_reclen;
+    unsigned char   d_type;
+    char            d_name[];
+} linux_dirent64;
+
+
+// Parts of the glob that can be compared before calling fnmatch()
+typedef struct {
+    const char* pattern;        /* Full glob                                */
+    size_t      prefix_len;     /* Literal characters at the start          */
+    size_t      suffix_len;     /* Literal characters at the end            */
+    size_t      pattern_len;    /* Length of the glob                       */
+    bool        literal;        /* Glob has no wildcards at all             */
+    bool        match_all;      /* Glob is "*"                              */
+} glob_filter;
+
+
+// ']' only means something after '[' but treating it as special keeps a
+// bracket expression out of the suffix
+static bool is_glob_special(char c) {
+    return c == '*' || c == '?' || c == '[' || c == ']' || c == '\\';
+}
+
+
+static glob_filter compile_glob(const char* pattern) {
+    glob_filter glob = {
+        .pattern        = pattern,
+        .pattern_len    = strlen(pattern),
+        .prefix_len     = 0,
+        .suffix_len     = 0,
+    };
+
+    while(glob.prefix_len < glob.pattern_len && !is_glob_special(pattern[glob.prefix_len])) {
+        ++glob.prefix_len;
+    }
+    glob.literal = (glob.prefix_len == glob.pattern_len);
+
+    while(!glob.literal && glob.suffix_len < glob.pattern_len && !is_glob_special(pattern[glob.pattern_len - glob.suffix_len - 1])) {
+        ++glob.suffix_len;
+    }
+    // An escaped character right before the suffix belongs to it, don't try to be clever
+    if(glob.suffix_len < glob.pattern_len && pattern[glob.pattern_len - glob.suffix_len - 1] == '\\') {
+        glob.suffix_len = 0;
+    }
+
+    glob.match_all = (strcmp(pattern, "*") == 0);
+    return glob;
+}
+
+
+static bool glob_matches(const glob_filter* glob, const char* name) {
+    if(glob->match_all) {
+        return true;
+    }
+    if(glob->literal) {
+        return strcmp(glob->pattern, name) == 0;
+    }
+
+    size_t len = strlen(name);
+    if(len < glob->prefix_len + glob->suffix_len) {
+        return false;
+    }
+    if(memcmp(name, glob->pattern, glob->prefix_len) != 0) {
+        return false;
+    }
+    if(memcmp(name + len - glob->suffix_len, glob->pattern + glob->pattern_len - glob->suffix_len, glob->suffix_len) != 0) {
+        return false;
+    }
+    return fnmatch(glob->pattern, name, 0) == 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Checks if a directory entry is a regular file, only stats
+ *                  the entry if the filesystem didn't fill in d_type
+ * 
+ */
+static bool is_regular_entry(dirscan_list* list, int dirfd, const linux_dirent64* entry) {
+    if(entry->d_type != DT_UNKNOWN) {
+        return entry->d_type == DT_REG;
+    }
+    ++list->stats.stat_calls;
+
+    struct statx stx;
+    if(statx(dirfd, entry->d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE, &stx) < 0) {
+        return false;
+    }
+    return S_ISREG(stx.stx_mode);
+}
+
+
+static void append_name(dirscan_list* list, const char* name) {
+    size_t len = strlen(name) + 1;
+
+    if(list->names_len + len > list->names_cap) {
+        size_t cap = list->names_cap ? list->names_cap * 2 : 4096;
+        while(cap < list->names_len + len) {
+            cap *= 2;
+        }
+        list->names = realloc(list->names, cap);
+        assert_M(list->names, "Failed to grow file name buffer to %ld bytes", cap);
+        list->names_cap = cap;
+    }
+    if(list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        list->offsets = realloc(list->offsets, list->capacity * sizeof(size_t));
+        assert_M(list->offsets, "Failed to grow file list to %ld entries", list->capacity);
+    }
+
+    memcpy(list->names + list->names_len, name, len);
+    list->offsets[list->count++] = list->names_len;
+    list->names_len += len;
+}
+
+
+static int compare_names(const void* lhs, const void* rhs, void* names) {
+    return strcmp((const char*) names + *(const size_t*) lhs, (const char*) names + *(const size_t*) rhs);
+}
+
+
+void init_dirscan_list(dirscan_list* list) {
+    debug_assert(list);
+
+    memset(list, 0x00, sizeof(dirscan_list));
+}
+
+
+void teardown_dirscan_list(dirscan_list* list) {
+    debug_assert(list);
+
+    free(list->names);
+    free(list->offsets);
+    memset(list, 0x00, sizeof(dirscan_list));
+}
+
+
+bool dirscan(dirscan_list* list, const char* dirname, const char* filter) {
+    debug_assert(list && dirname && filter);
+
+    list->names_len = 0;
+    list->count     = 0;
+    memset(&list->stats, 0x00, sizeof(dirscan_stats));
+
+    int dirfd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirfd < 0) {
+        log_error("Failed to open directory: %s - %s", dirname, strerror(errno));
+        return false;
+    }
+
+    uint8_t* buffer = malloc(DIRSCAN_BUFFER_SIZE);
+    assert_M(buffer, "Failed to allocate directory scan buffer");
+
+    glob_filter glob = compile_glob(filter);
+
+    bool success = true;
+    long nbytes = 0;
+    while((nbytes = syscall(SYS_getdents64, dirfd, buffer, DIRSCAN_BUFFER_SIZE)) > 0) {
+        ++list->stats.batches;
+
+        for(long offset = 0; offset < nbytes;) {
+            const linux_dirent64* entry = (const linux_dirent64*) (buffer + offset);
+            offset += entry->d_reclen;
+            ++list->stats.entries;
+
+            if(entry->d_type == DT_DIR || entry->d_type == DT_LNK) {
+                continue;
+            }
+            if(!glob_matches(&glob, entry->d_name)) {
+                ++list->stats.filtered;
+                continue;
+            }
+            if(is_regular_entry(list, dirfd, entry)) {
+                append_name(list, entry->d_name);
+            }
+        }
+    }
+    if(nbytes < 0) {
+        log_error("Failed to read directory: %s - %s", dirname, strerror(errno));
+        success = false;
+    }
+
+    free(buffer);
+    close(dirfd);
+
+    qsort_r(list->offsets, list->count, sizeof(size_t), compare_names, list->names);
+
+    return success;
+}
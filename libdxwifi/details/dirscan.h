@@ -0,0 +1,101 @@
+/**
+ *  dirscan.h
+ * 
+ *  DESCRIPTION: Fast listing of the regular files in a directory that match a
+ *  glob, sorted by name. Used to find the files already waiting in a
+ *  directory before transmission starts.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Entries are read straight from the kernel in large getdents64
+ *  batches. The file type comes from d_type where the filesystem provides it
+ *  so most entries are never stat'd, and names are checked against the
+ *  literal parts of the glob before fnmatch() is called. Matching names are
+ *  copied back to back into one buffer, nothing is allocated per entry.
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_DIRSCAN_H
+#define LIBDXWIFI_DIRSCAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+
+// Size of the buffer directory entries are read into
+#define DIRSCAN_BUFFER_SIZE (256 * 1024)
+
+
+typedef struct {
+    uint32_t    entries;        /* Directory entries read                   */
+    uint32_t    batches;        /* Number of getdents64 calls               */
+    uint32_t    filtered;       /* Entries rejected by the glob             */
+    uint32_t    stat_calls;     /* Entries that needed a statx for the type */
+} dirscan_stats;
+
+
+typedef struct {
+    char*           names;      /* Null terminated file names, back to back */
+    size_t          names_len;  /* Bytes used in names                      */
+    size_t          names_cap;  /* Bytes allocated for names                */
+    size_t*         offsets;    /* Offset of each name, in sorted order     */
+    size_t          count;      /* Number of files found                    */
+    size_t          capacity;   /* Number of offsets allocated              */
+    dirscan_stats   stats;      /* Counters for the last scan               */
+} dirscan_list;
+
+
+/**
+ *  DESCRIPTION:    Initializes an empty file list
+ * 
+ *  ARGUMENTS:
+ * 
+ *      list:       pointer to the list to be initialized
+ * 
+ */
+void init_dirscan_list(dirscan_list* list);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the list
+ * 
+ *  ARGUMENTS:
+ * 
+ *      list:       pointer to the list to be torndown
+ * 
+ */
+void teardown_dirscan_list(dirscan_list* list);
+
+
+/**
+ *  DESCRIPTION:    Lists the regular files in a directory whose names match a
+ *                  glob. Symbolic links and subdirectories are skipped.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      list:       Initialized list, replaced with the files found
+ * 
+ *      dirname:    Path of the directory to scan
+ * 
+ *      filter:     Glob pattern the file names must match
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the directory couldn't be read
+ * 
+ */
+bool dirscan(dirscan_list* list, const char* dirname, const char* filter);
+
+
+/**
+ *  DESCRIPTION:    Name of the Nth file in the list, in sorted order
+ * 
+ */
+static inline const char* dirscan_name(const dirscan_list* list, size_t index) {
+    return list->names + list->offsets[index];
+}
+
+
+#endif // LIBDXWIFI_DIRSCAN_H
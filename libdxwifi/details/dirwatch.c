@@ -1,34 +1,36 @@
 /**
  *  dirwatch.c
- *  
+ * 
  *  DESCRIPTION: See dirwatch.h for description
  * 
  *  https://github.com/oresat/oresat-dxwifi-software
  * 
  */
 
+#define DXWIFI_LOG_MODULE DXWIFI_DIRWATCH
 
 #include <poll.h>
+#include <time.h>
 #include <errno.h>
+#include <dirent.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fnmatch.h>
 
+#include <sys/stat.h>
 #include <linux/limits.h>
 
+#include <libdxwifi/details/utils.h>
 #include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/hashmap.h>
 #include <libdxwifi/details/logging.h>
 #include <libdxwifi/details/dirwatch.h>
 
 
-// TODO all the find operations just do a linear search, which is obviously suboptimal
-
-// Buffer can hold at a minimum, 32 events
-#define EVENT_BUFFSIZE ((sizeof(struct inotify_event) + NAME_MAX + 1) * 32)
-
-static const int EMPTY_NODE = 0;
-
+// Value of recent entries reported by a rescan rather than an event
+static char rescanned_mark;
+#define RESCANNED ((void*) &rescanned_mark)
 
 typedef struct {
     int wd;                     /* Watch Descriptor handle                  */
@@ -37,143 +39,447 @@ typedef struct {
 
     char* file_filter;          /* Glob pattern to filter file events       */
 
-    char* watchfiles[DIRWATCH_MAX];
-                                /* Name of each file to watch within the dir*/
+    dirwatch_events_t events;   /* Events subscribed to                     */
+
+    hashmap pending;            /* Files created but not yet closed         */
 } watchdir;
 
 
 struct __dirwatch {
     struct pollfd handle;       /* Pollable inotify handle                  */
 
-    watchdir watchdirs[DIRWATCH_MAX];
-                                /* Directory watchlist                      */
+    hashmap by_wd;              /* Watchdirs keyed by watch descriptor      */
+
+    hashmap by_dirname;         /* Watchdirs keyed by directory name        */
+
+    hashmap recent;             /* Paths reported since the event queue was */
+                                /* last drained, see RESCANNED              */
+
+    struct timespec drained;    /* When the event queue was last drained    */
+
+    uint8_t* event_buffer;      /* Inotify events are read into here        */
+
+    char* path_buffer;          /* Scratch space for building paths         */
+
+    dirwatch_stats stats;       /* Event counters                           */
 
     volatile bool listen;       /* Loop variable flag                       */
 };
 
 
-// Filtering expression for searching watch lists
-typedef bool (*filter)(const watchdir* node, const void* val);
+/**
+ *  DESCRIPTION:    Converts a dirwatch event bitmask to the correct inotify bitmask
+ * 
+ *  ARGUMENTS:
+ * 
+ *      events:     Dirwatch event bitmask
+ * 
+ *  RETURNS:
+ * 
+ *      int:        Inotify event bitmask
+ * 
+ */
+static int get_inotify_mask(dirwatch_events_t events) {
+    int mask = 0x00;
+    if(events & DW_CREATE_AND_CLOSE) {
+        // Deleted or renamed files will never be closed, stop tracking them
+        mask |= IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM;
+    }
+    if(events & DW_MOVED_TO) {
+        mask |= IN_MOVED_TO;
+    }
+    if(events & DW_CREATED) {
+        mask |= IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+    }
+    if(events & DW_MODIFIED) {
+        mask |= IN_MODIFY;
+    }
+    if(events & DW_RECURSIVE) {
+        mask |= IN_CREATE | IN_MOVED_TO;
+    }
+    return mask;
+}
+
+
+static watchdir* find_by_wd(const dirwatch* dw, int wd) {
+    return hashmap_get(&dw->by_wd, &wd, sizeof(wd));
+}
+
+
+static void free_watchdir(watchdir* dir) {
+    teardown_hashmap(&dir->pending);
+    free(dir->dirname);
+    free(dir->file_filter);
+    free(dir);
+}
 
 
 /**
- *  DESCRIPTION:    Finds the first watchdir that matches the filter
+ *  DESCRIPTION:    Removes a watchdir from the lookup tables and frees it
  * 
  *  ARGUMENTS:
- *      dw:             Allocated dirwatch object
  * 
- *      target:         Value to compare against
+ *      dw:         Allocated dirwatch handle
+ * 
+ *      dir:        Watchdir to remove
  * 
- *      match:          Filter expression
+ *      rm_watch:   Remove the inotify watch as well? Not needed when the
+ *                  kernel already removed it
+ * 
+ */
+static void remove_watchdir(dirwatch* dw, watchdir* dir, bool rm_watch) {
+    if(rm_watch) {
+        inotify_rm_watch(dw->handle.fd, dir->wd);
+    }
+    hashmap_remove(&dw->by_wd, &dir->wd, sizeof(dir->wd), NULL);
+    hashmap_remove_str(&dw->by_dirname, dir->dirname, NULL);
+    --dw->stats.directories;
+
+    log_debug("Stopped watching %s", dir->dirname);
+    free_watchdir(dir);
+}
+
+
+/**
+ *  DESCRIPTION:    Starts watching a single directory, or updates the watch if
+ *                  the directory is already being watched
  * 
  *  RETURNS:
  * 
- *      watch_node*:    Pointer to the matched watch node or NULL
+ *      watchdir*:  The watchdir or NULL if the watch couldn't be added
  * 
  */
-static watchdir* find_watchdir(dirwatch* dw, const void* target, filter match) {
-    debug_assert(dw && target);
+static watchdir* add_watchdir(dirwatch* dw, const char* dirname, const char* file_filter, dirwatch_events_t events, bool clobber) {
+    int mask = get_inotify_mask(events) | (clobber ? 0 : IN_MASK_ADD);
 
-    for(size_t i = 0; i < DIRWATCH_MAX; ++i) {
-        if(match(&dw->watchdirs[i], target)) {
-            return &dw->watchdirs[i];
+    int wd = inotify_add_watch(dw->handle.fd, dirname, mask);
+    if(wd < 0) {
+        log_error("Failed to watch %s: %s", dirname, strerror(errno));
+        return NULL;
+    }
+
+    watchdir* dir = hashmap_get_str(&dw->by_dirname, dirname);
+    if(dir) {
+        if(clobber) {
+            free(dir->file_filter);
+            dir->file_filter    = strdup(file_filter);
+            dir->events         = events;
         }
+        else {
+            dir->events        |= events;
+        }
+        return dir;
     }
-    return NULL;
+
+    dir = calloc(1, sizeof(watchdir));
+    assert_M(dir, "Calloc failed: %s", strerror(errno));
+
+    dir->wd             = wd;
+    dir->dirname        = strdup(dirname);
+    dir->file_filter    = strdup(file_filter);
+    dir->events         = events;
+    init_hashmap(&dir->pending, 0);
+
+    hashmap_put(&dw->by_wd, &dir->wd, sizeof(dir->wd), dir);
+    hashmap_put_str(&dw->by_dirname, dir->dirname, dir);
+    ++dw->stats.directories;
+
+    log_debug("Watching %s", dirname);
+    return dir;
 }
 
 
 /**
- *  DESCRIPTION:    Finds the integer index to the first watchdir that matches the filter
+ *  DESCRIPTION:    Reports an event to the handler
  * 
  *  ARGUMENTS:
- *      dw:             Allocated dirwatch handle
  * 
- *      target:         Value to compare against
+ *      dw:         Allocated dirwatch handle
  * 
- *      match:          Filter expression
+ *      dir:        Watchdir where the event occured
  * 
- *  RETURNS:
+ *      event:      Dirwatch event
  * 
- *      int:            Index to the matched watch node or -1
+ *      filename:   Name of the file
+ * 
+ *      handler:    Callback to process the event
+ * 
+ *      user:       User arguments to forward to the handler
  * 
  */
-static int get_watchdir_idx(dirwatch* dw, const void* target, filter match) {
-    debug_assert(dw && target);
-
-    for(size_t i = 0; i < DIRWATCH_MAX; ++i) {
-        if(match(&dw->watchdirs[i], target)) {
-            return i;
-        }
+static void report(dirwatch* dw, watchdir* dir, dirwatch_events_t event, const char* filename, dirwatch_event_handler handler, void* user) {
+    combine_path(dw->path_buffer, PATH_MAX, dir->dirname, filename);
+    if(!hashmap_contains_str(&dw->recent, dw->path_buffer)) {
+        hashmap_put_str(&dw->recent, dw->path_buffer, NULL);
     }
-    return -1;
+
+    dirwatch_event dw_event = {
+        .event      = event,
+        .dirname    = dir->dirname,
+        .filename   = filename
+    };
+    ++dw->stats.reported;
+    handler(&dw_event, user);
 }
 
+
 /**
- *  DESCRIPTION:        Filters by watch descriptor
+ *  DESCRIPTION:    Checks if a file was reported by a rescan since the event
+ *                  queue was last drained. Its mark is cleared, so the check
+ *                  only suppresses the first create event for the path.
  * 
  *  ARGUMENTS:
  * 
- *      watch:          Watchdir to be tested
+ *      dw:         Allocated dirwatch handle
  * 
- *      val:            Target watch descriptor value
+ *      dir:        Watchdir containing the file
+ * 
+ *      filename:   Name of the file
  * 
  *  RETURNS:
  * 
- *      bool:           True if the watch descriptors match
+ *      bool:       true if the file was reported by a rescan
  * 
  */
-static bool find_by_wd(const watchdir* watch, const void* val) {
-    debug_assert(watch && val);
+static bool was_rescanned(dirwatch* dw, const watchdir* dir, const char* filename) {
+    combine_path(dw->path_buffer, PATH_MAX, dir->dirname, filename);
+    if(hashmap_get_str(&dw->recent, dw->path_buffer) != RESCANNED) {
+        return false;
+    }
+    hashmap_put_str(&dw->recent, dw->path_buffer, NULL);
+    return true;
+}
 
-    int wd = *(const int*)val;
-    return watch->wd == wd;
+
+static bool is_newer(const struct timespec* mtime, const struct timespec* since) {
+    return mtime->tv_sec > since->tv_sec || (mtime->tv_sec == since->tv_sec && mtime->tv_nsec >= since->tv_nsec);
 }
 
 
 /**
- *  DESCRIPTION:        Filters by directory name
+ *  DESCRIPTION:    Scans a watched directory for files whose events may have
+ *                  been missed and reports them. Recursive watches also pick
+ *                  up any subdirectories that aren't watched yet.
  * 
  *  ARGUMENTS:
  * 
- *      watch:          Watchdir to be tested
+ *      dw:         Allocated dirwatch handle
  * 
- *      val:            Target directory name
+ *      dir:        Watchdir to scan
  * 
- *  RETURNS:
- *      bool:           True if the directory names match
+ *      since:      Only report files modified at or after this time, NULL to
+ *                  report every file
+ * 
+ *      handler:    Callback to process each event
+ * 
+ *      user:       User arguments to forward to the handler
  * 
  */
-static bool find_by_dirname(const watchdir* watch, const void* val) {
-    debug_assert(watch && val);
+static void rescan_dir(dirwatch* dw, watchdir* dir, const struct timespec* since, dirwatch_event_handler handler, void* user) {
+    DIR* dirp = opendir(dir->dirname);
+    if(!dirp) {
+        log_error("Failed to rescan %s: %s", dir->dirname, strerror(errno));
+        return;
+    }
+
+    // The handler may add or remove watches, copy what's needed up front
+    char* dirname               = strdup(dir->dirname);
+    char* file_filter           = strdup(dir->file_filter);
+    dirwatch_events_t events    = dir->events;
+    int wd                      = dir->wd;
+
+    dirwatch_events_t report_as = (events & DW_CREATE_AND_CLOSE) ? DW_CREATE_AND_CLOSE : DW_MOVED_TO;
+
+    struct dirent* entry;
+    struct stat st;
+    while((entry = readdir(dirp)) && dw->listen) {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        combine_path(dw->path_buffer, PATH_MAX, dirname, entry->d_name);
+        if(stat(dw->path_buffer, &st) < 0) {
+            continue;
+        }
+
+        if(S_ISDIR(st.st_mode)) {
+            if((events & DW_RECURSIVE) && !hashmap_contains_str(&dw->by_dirname, dw->path_buffer)) {
+                char* subdir = strdup(dw->path_buffer);
+                watchdir* sub = add_watchdir(dw, subdir, file_filter, events, true);
+                if(sub) {
+                    rescan_dir(dw, sub, NULL, handler, user);
+                }
+                free(subdir);
+            }
+            continue;
+        }
+
+        if(!S_ISREG(st.st_mode) || fnmatch(file_filter, entry->d_name, 0) != 0) {
+            continue;
+        }
+        if(since && !is_newer(&st.st_mtim, since)) {
+            continue;
+        }
 
-    if(watch->dirname) {
-        return strcmp(watch->dirname, (const char*)val) == 0;
+        // Watch may have been removed by the handler during this scan
+        dir = find_by_wd(dw, wd);
+        if(!dir) {
+            break;
+        }
+        // Its close event may have been one of the ones dropped. Followed
+        // files were already reported when created, they still need closing
+        bool pending = hashmap_remove_str(&dir->pending, entry->d_name, NULL);
+        if(!pending && hashmap_contains_str(&dw->recent, dw->path_buffer)) {
+            continue;
+        }
+
+        // Its create event may still be queued, see process_event()
+        hashmap_put_str(&dw->recent, dw->path_buffer, RESCANNED);
+
+        ++dw->stats.rescanned;
+        report(dw, dir, report_as, entry->d_name, handler, user);
     }
-    return false;
+    closedir(dirp);
+    free(dirname);
+    free(file_filter);
+}
+
+
+// Collects watch descriptors so watchdirs can be visited while being modified
+typedef struct {
+    int*    wds;
+    size_t  count;
+} wd_list;
+
+
+static void collect_wd(const void* key, size_t key_len, void* value, void* user) {
+    __DXWIFI_UTILS_UNUSED(key, key_len);
+
+    wd_list* list = user;
+    list->wds[list->count++] = ((watchdir*) value)->wd;
+}
+
+
+static wd_list get_wds(const dirwatch* dw) {
+    wd_list list = { .wds = malloc((dw->by_wd.count + 1) * sizeof(int)), .count = 0 };
+    assert_M(list.wds, "Malloc failed: %s", strerror(errno));
+
+    hashmap_foreach(&dw->by_wd, collect_wd, &list);
+    return list;
 }
 
 
 /**
- *  DESCRIPTION:    Converts a dirwatch event bitmask to the correct inotify bitmask
+ *  DESCRIPTION:    Recovers from an event queue overflow by rescanning every
+ *                  watched directory for files modified since the queue was
+ *                  last drained
+ * 
+ */
+static void recover_overflow(dirwatch* dw, dirwatch_event_handler handler, void* user) {
+    ++dw->stats.overflows;
+    log_warning("Dirwatch event queue overflowed, rescanning %u directories", dw->stats.directories);
+
+    struct timespec since = dw->drained;
+
+    wd_list list = get_wds(dw);
+    for(size_t i = 0; i < list.count && dw->listen; ++i) {
+        watchdir* dir = find_by_wd(dw, list.wds[i]);
+        if(dir) {
+            rescan_dir(dw, dir, &since, handler, user);
+        }
+    }
+    free(list.wds);
+}
+
+
+/**
+ *  DESCRIPTION:    Processes a single inotify event
  * 
  *  ARGUMENTS:
  * 
- *      events:     Dirwatch event bitmask
+ *      dw:         Allocated dirwatch handle
  * 
- *  RETURNS:
+ *      event:      Inotify event
  * 
- *      int:        Inotify event bitmask
+ *      handler:    Callback to process each dirwatch event
+ * 
+ *      user:       User arguments to forward to the handler
  * 
  */
-static int get_inotify_mask(dirwatch_events_t events) {
-    int mask = 0x00;
-    if(events & DW_CREATE_AND_CLOSE) {
-        mask |= IN_CREATE | IN_CLOSE_WRITE;
+static void process_event(dirwatch* dw, const struct inotify_event* event, dirwatch_event_handler handler, void* user) {
+    watchdir* dir = find_by_wd(dw, event->wd);
+    if(!dir) {
+        return;
+    }
+
+    // Watched directory was deleted or unmounted
+    if(event->mask & IN_IGNORED) {
+        remove_watchdir(dw, dir, false);
+        return;
+    }
+    if(event->len == 0) {
+        return;
+    }
+
+    if(event->mask & IN_ISDIR) {
+        // New subdirectory, files may have landed in it before the watch was added
+        if((event->mask & (IN_CREATE | IN_MOVED_TO)) && (dir->events & DW_RECURSIVE)) {
+            combine_path(dw->path_buffer, PATH_MAX, dir->dirname, event->name);
+            char* subdir = strdup(dw->path_buffer);
+            watchdir* sub = add_watchdir(dw, subdir, dir->file_filter, dir->events, true);
+            if(sub) {
+                rescan_dir(dw, sub, NULL, handler, user);
+            }
+            free(subdir);
+        }
+        return;
+    }
+
+    bool matches = fnmatch(dir->file_filter, event->name, 0) == 0;
+
+    // New file was created, watch for file close
+    if(event->mask & IN_CREATE) {
+        // Created after the watch was added but found by the rescan that
+        // followed, it was reported already and its close must be ignored
+        if(matches && was_rescanned(dw, dir, event->name)) {
+            return;
+        }
+        if((dir->events & (DW_CREATE_AND_CLOSE | DW_CREATED)) && matches) {
+            hashmap_put_str(&dir->pending, event->name, NULL);
+            if(dir->pending.count > dw->stats.pending_max) {
+                dw->stats.pending_max = dir->pending.count;
+            }
+            if(dir->events & DW_CREATED) {
+                report(dw, dir, DW_CREATED, event->name, handler, user);
+            }
+        }
+    }
+    // File that's still open was written to
+    else if(event->mask & IN_MODIFY) {
+        if(hashmap_contains_str(&dir->pending, event->name)) {
+            report(dw, dir, DW_MODIFIED, event->name, handler, user);
+        }
+    }
+    // File was closed, check if we were watching it
+    else if(event->mask & IN_CLOSE_WRITE) {
+        if(hashmap_remove_str(&dir->pending, event->name, NULL)) {
+            report(dw, dir, DW_CREATE_AND_CLOSE, event->name, handler, user);
+        }
+    }
+    // File is gone before it was closed, anyone following it is done
+    else if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if(hashmap_remove_str(&dir->pending, event->name, NULL) && (dir->events & DW_CREATED)) {
+            report(dw, dir, DW_CREATE_AND_CLOSE, event->name, handler, user);
+        }
+    }
+    // Moved files are complete, report them straight away
+    else if(event->mask & IN_MOVED_TO) {
+        if((dir->events & DW_MOVED_TO) && matches) {
+            report(dw, dir, DW_MOVED_TO, event->name, handler, user);
+        }
     }
-    return mask;
 }
 
+
 //
 // See dirwatch.h for non-static function descriptions
 //
@@ -187,72 +493,89 @@ dirwatch* dirwatch_init() {
 
     dw->handle.events = POLLIN;
 
+    //https://man7.org/linux/man-pages/man7/inotify.7.html - See example section
+    dw->event_buffer = aligned_alloc(__alignof__(struct inotify_event), DIRWATCH_BUFFER_SIZE);
+    dw->path_buffer  = calloc(PATH_MAX, sizeof(char));
+    assert_M(dw->event_buffer && dw->path_buffer, "Failed to allocate dirwatch buffers: %s", strerror(errno));
+
+    init_hashmap(&dw->by_wd, 0);
+    init_hashmap(&dw->by_dirname, 0);
+    init_hashmap(&dw->recent, 0);
+
     return dw;
 }
 
 
+static void free_watchdir_visitor(const void* key, size_t key_len, void* value, void* user) {
+    __DXWIFI_UTILS_UNUSED(key, key_len);
+
+    dirwatch* dw    = user;
+    watchdir* dir   = value;
+    inotify_rm_watch(dw->handle.fd, dir->wd);
+    free_watchdir(dir);
+}
+
+
 void dirwatch_close(dirwatch* dw) {
     debug_assert(dw);
     if(dw) {
-        for(int i = 0; i < DIRWATCH_MAX; ++i) {
-            dirwatch_remove(dw, i);
-        }
+        hashmap_foreach(&dw->by_wd, free_watchdir_visitor, dw);
+
+        teardown_hashmap(&dw->by_wd);
+        teardown_hashmap(&dw->by_dirname);
+        teardown_hashmap(&dw->recent);
 
         close(dw->handle.fd);
 
+        free(dw->event_buffer);
+        free(dw->path_buffer);
         free(dw);
     }
 }
 
 
 int dirwatch_add(dirwatch* dw, const char* dirname, const char* file_filter, dirwatch_events_t events, bool clobber) {
-    debug_assert(dw && dw->handle.fd);
-
-    int mask = get_inotify_mask(events) | (clobber ? 0 : IN_MASK_ADD);
+    debug_assert(dw && dw->handle.fd && dirname && file_filter);
 
-    // Check if node already exists, update it if it does
-    int idx = get_watchdir_idx(dw, dirname, find_by_dirname);
-    if(idx >= 0) { 
-        dw->watchdirs[idx].wd = inotify_add_watch(dw->handle.fd, dirname, mask);
+    watchdir* dir = add_watchdir(dw, dirname, file_filter, events, clobber);
+    if(!dir) {
+        return -1;
+    }
+    int wd = dir->wd;
 
-        if(clobber) {
-            free(dw->watchdirs[idx].file_filter); // Free old filter
-            dw->watchdirs[idx].file_filter = strdup(file_filter);
+    if(events & DW_RECURSIVE) {
+        DIR* dirp = opendir(dirname);
+        if(!dirp) {
+            log_error("Failed to open directory: %s - %s", dirname, strerror(errno));
+            return wd;
         }
-    }
-    else 
-    {
-        // Add watch to empty node
-        idx = get_watchdir_idx(dw, &EMPTY_NODE, find_by_wd);
-        if(idx >= 0) {
-            dw->watchdirs[idx].wd = inotify_add_watch(dw->handle.fd, dirname, mask);
-            dw->watchdirs[idx].dirname = strdup(dirname);
-            dw->watchdirs[idx].file_filter = strdup(file_filter);
+        char* path = calloc(PATH_MAX, sizeof(char));
+        assert_M(path, "Calloc failed: %s", strerror(errno));
+
+        struct dirent* entry;
+        while((entry = readdir(dirp))) {
+            if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            combine_path(path, PATH_MAX, dirname, entry->d_name);
+            if(is_directory(path)) {
+                dirwatch_add(dw, path, file_filter, events, clobber);
+            }
         }
+        free(path);
+        closedir(dirp);
     }
-
-    return idx;
+    return wd;
 }
 
 
-
-bool dirwatch_remove(dirwatch* dw, unsigned index) {
+bool dirwatch_remove(dirwatch* dw, int wd) {
     debug_assert(dw);
 
-    if(dw && index < DIRWATCH_MAX) {
-        if(dw->watchdirs[index].wd > 0) {
-            inotify_rm_watch(dw->handle.fd, dw->watchdirs[index].wd);
-            free(dw->watchdirs[index].dirname);
-            free(dw->watchdirs[index].file_filter);
-
-            // Free any associated watch files
-            for(size_t i = 0; i < DIRWATCH_MAX; ++i) {
-                if(dw->watchdirs[index].watchfiles[i]) {
-                    free(dw->watchdirs[index].watchfiles[i]);
-                }
-            }
-
-            dw->watchdirs[index].wd = 0;
+    if(dw) {
+        watchdir* dir = find_by_wd(dw, wd);
+        if(dir) {
+            remove_watchdir(dw, dir, true);
             return true;
         }
     }
@@ -263,18 +586,12 @@ bool dirwatch_remove(dirwatch* dw, unsigned index) {
 void dirwatch_listen(dirwatch* dw, int timeout_ms, dirwatch_event_handler handler, void* user) {
     debug_assert(dw && handler);
 
-    dirwatch_event dw_event;
-    char* path_buffer = calloc(PATH_MAX, sizeof(char));
-
-    ssize_t next = 0;
-    ssize_t nbytes = 0;
-
-    //https://man7.org/linux/man-pages/man7/inotify.7.html - See example section
-    uint8_t event_buffer[EVENT_BUFFSIZE] 
-        __attribute__((aligned(__alignof__(struct inotify_event))));
-
     log_info("Dirwatch activated");
     dw->listen = true;
+    // File mtimes are stamped from the coarse clock, which lags the precise
+    // one by up to a tick. A precise cutoff could be later than the mtime of
+    // a file written just after it and the rescan would skip that file
+    clock_gettime(CLOCK_REALTIME_COARSE, &dw->drained);
     while(dw->listen) {
         int status = poll(&dw->handle, 1, timeout_ms);
         if(status == 0) {
@@ -286,57 +603,47 @@ void dirwatch_listen(dirwatch* dw, int timeout_ms, dirwatch_event_handler handle
                 log_error("Error occured: %s", strerror(errno));
             }
         }
-        else {// Events have occured, read them into the buffer
-            nbytes = read(dw->handle.fd, event_buffer, EVENT_BUFFSIZE);
-
-            next = 0;
-            while(next < nbytes) { // Process all events
-                struct inotify_event* event = (struct inotify_event*) &event_buffer[next];
-
-                // New file was created, watch for file close
-                if((event->mask & IN_CREATE) && !(event->mask & IN_ISDIR)) {
+        else {
+            // Read until the queue is empty, the handler may take a while and
+            // events keep piling up in the meantime
+            bool overflow = false;
+            struct timespec before_read;
+            while(dw->listen) {
+                clock_gettime(CLOCK_REALTIME_COARSE, &before_read);
+                ssize_t nbytes = read(dw->handle.fd, dw->event_buffer, DIRWATCH_BUFFER_SIZE);
+                if(nbytes <= 0) {
+                    if(nbytes < 0 && errno != EAGAIN) {
+                        log_error("Failed to read events: %s", strerror(errno));
+                    }
+                    break;
+                }
 
-                    watchdir* dir = find_watchdir(dw, &event->wd, find_by_wd);
+                ssize_t next = 0;
+                while(next < nbytes) { // Process all events
+                    const struct inotify_event* event = (const struct inotify_event*) &dw->event_buffer[next];
+                    ++dw->stats.events;
 
-                    // Cache the filename if it matches the filter
-                    if(dir && fnmatch(dir->file_filter, event->name, 0) == 0) {
-                        for(int i = 0; i < DIRWATCH_MAX; ++i) { // Find an empty watchfile
-                            if(dir->watchfiles[i] == NULL){
-                                dir->watchfiles[i] = strdup(event->name);
-                            }
-                        }
+                    if(event->mask & IN_Q_OVERFLOW) {
+                        overflow = true;
                     }
-                }
-                // File was closed, check if we were watching it
-                if (event->mask & IN_CLOSE_WRITE) {
-
-                    watchdir* dir = find_watchdir(dw, &event->wd, find_by_wd);
-
-                    if(dir) {
-                        bool found = false;
-                        for(int i = 0; i < DIRWATCH_MAX && !found; ++i) {
-                            // TODO: strcmp in linear search is sub-optimal at best
-                            if(strcmp(event->name, dir->watchfiles[i]) == 0) {
-                                dw_event.event    = DW_CREATE_AND_CLOSE;
-                                dw_event.dirname  = dir->dirname;
-                                dw_event.filename = dir->watchfiles[i];
-
-                                handler(&dw_event, user);
-
-                                free(dir->watchfiles[i]);
-                                dir->watchfiles[i] = NULL;
-                                found = true;
-                            }
-                        }
+                    else {
+                        process_event(dw, event, handler, user);
                     }
+                    next += sizeof(struct inotify_event) + event->len;
                 }
-                next += sizeof(struct inotify_event) + event->len;
+            }
+            // Anything modified before the last, empty, read has been seen.
+            // After an overflow that only holds once the next read is empty
+            if(overflow) {
+                recover_overflow(dw, handler, user);
+            }
+            else {
+                dw->drained = before_read;
+                hashmap_clear(&dw->recent);
             }
         }
     }
 
-    free(path_buffer);
-
     log_info("DirWatch deactivated");
 }
 
@@ -347,3 +654,9 @@ void dirwatch_stop(dirwatch* dw) {
     }
 }
 
+
+dirwatch_stats dirwatch_get_stats(const dirwatch* dw) {
+    debug_assert(dw);
+
+    return dw->stats;
+}
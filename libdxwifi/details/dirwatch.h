@@ -5,8 +5,18 @@
  * 
  *  https://github.com/oresat/oresat-dxwifi-software
  * 
- *  NOTES: Currently only supports tracking a directory for new files but can
- *  easily be modified to listen for a number of other events
+ *  NOTES: Watches are looked up by watch descriptor, and files waiting to be
+ *  closed by name, through hash tables so the cost of an event doesn't depend
+ *  on how many directories or files are being tracked. If the kernel's event
+ *  queue overflows the watched directories are rescanned for files modified
+ *  since the queue was last drained, so a burst of files is delayed rather
+ *  than lost. A file that is still being written when the rescan runs is
+ *  reported early, there's no telling whether its close event was dropped.
+ * 
+ *  DW_CREATED and DW_MODIFIED report files that are still being written so 
+ *  they can be followed, subscribe to DW_CREATE_AND_CLOSE alongside them to 
+ *  learn when the file is done. A followed file that's deleted or moved away
+ *  before it's closed is reported as closed. 
  * 
  */
 
@@ -14,15 +24,23 @@
 #ifndef LIBDXWIFI_DIRWATCH_H
 #define LIBDXWIFI_DIRWATCH_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <sys/inotify.h>
 
 
-// Maximum number of directories to watch concurrently
-#define DIRWATCH_MAX 256 
+// Size of the buffer events are read into, inotify events are at most
+// sizeof(struct inotify_event) + NAME_MAX + 1 bytes so this holds thousands
+#define DIRWATCH_BUFFER_SIZE (256 * 1024)
 
 
 typedef enum {
-    DW_CREATE_AND_CLOSE = 0x00000001,
+    DW_CREATE_AND_CLOSE = 0x00000001,   /* File created then closed         */
+    DW_MOVED_TO         = 0x00000002,   /* File moved into the directory    */
+    DW_CREATED          = 0x00000004,   /* File created, not yet closed     */
+    DW_MODIFIED         = 0x00000008,   /* Created file was written to      */
+    DW_RECURSIVE        = 0x00000100,   /* Also watch subdirectories, even  */
+                                        /* ones created later               */
 } dirwatch_events_t;
 
 
@@ -46,6 +64,16 @@ typedef struct {
 typedef void (*dirwatch_event_handler)(const dirwatch_event* event, void* user);
 
 
+typedef struct {
+    uint64_t    events;         /* Inotify events read                      */
+    uint64_t    reported;       /* Events passed to the handler             */
+    uint32_t    overflows;      /* Times the kernel event queue overflowed  */
+    uint32_t    rescanned;      /* Files reported by a rescan               */
+    uint32_t    directories;    /* Directories currently watched            */
+    uint32_t    pending_max;    /* Most files waiting to be closed at once  */
+} dirwatch_stats;
+
+
 // Implementation in dirwatch.c
 typedef struct __dirwatch dirwatch;
 
@@ -93,7 +121,10 @@ void dirwatch_close(dirwatch* dw);
  * 
  *  RETURNS:
  *      
- *      int:            Index reference to watched directory
+ *      int:            Watch descriptor of the directory, -1 on failure
+ * 
+ *  NOTES: With DW_RECURSIVE every existing subdirectory is watched as well, 
+ *  each with its own watch descriptor.
  * 
  */
 int dirwatch_add(dirwatch* dw, const char* dirname, const char* file_filter, dirwatch_events_t events, bool clobber);
@@ -106,14 +137,14 @@ int dirwatch_add(dirwatch* dw, const char* dirname, const char* file_filter, dir
  * 
  *      dw:         Allocated dirwatch handle, see dirwatch_init()
  * 
- *      index:      Index reference to watch directory, see dirwatch_add()
+ *      wd:         Watch descriptor of the directory, see dirwatch_add()
  * 
  *  RETURNS:
  *      
  *      bool:       True if directory was successfully removed from the watchlist
  * 
  */
-bool dirwatch_remove(dirwatch* dw, unsigned index);
+bool dirwatch_remove(dirwatch* dw, int wd);
 
 
 /**
@@ -150,4 +181,14 @@ void dirwatch_listen(dirwatch* dw, int timeout_ms, dirwatch_event_handler handle
  */
 void dirwatch_stop(dirwatch* dw);
 
+
+/**
+ *  DESCRIPTION:    Get a copy of the dirwatch statistics
+ * 
+ *  ARGUMENTS:
+ *      dw:         Allocated dirwatch handle, see dirwatch_init()
+ * 
+ */
+dirwatch_stats dirwatch_get_stats(const dirwatch* dw);
+
 #endif // LIBDXWIFI_DIRWATCH_H
@@ -0,0 +1,167 @@
+/**
+ *  follow.c
+ * 
+ *  DESCRIPTION: See follow.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libdxwifi/details/follow.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+// Must be called with the lock held
+static void notify_changed(file_follower* follower) {
+    ++follower->generation;
+    pthread_cond_broadcast(&follower->changed);
+}
+
+
+void init_file_follower(file_follower* follower) {
+    debug_assert(follower);
+
+    init_hashmap(&follower->growing, 0);
+    follower->generation    = 0;
+    follower->stopped       = false;
+    memset(&follower->stats, 0x00, sizeof(file_follower_stats));
+
+    pthread_mutex_init(&follower->lock, NULL);
+
+    // Waits are timed against the monotonic clock so they aren't thrown off by
+    // changes to the system time
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&follower->changed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+
+void teardown_file_follower(file_follower* follower) {
+    debug_assert(follower);
+
+    teardown_hashmap(&follower->growing);
+    pthread_cond_destroy(&follower->changed);
+    pthread_mutex_destroy(&follower->lock);
+}
+
+
+void follow_created(file_follower* follower, const char* path) {
+    debug_assert(follower && path);
+
+    pthread_mutex_lock(&follower->lock);
+    hashmap_put_str(&follower->growing, path, NULL);
+    ++follower->stats.followed;
+    notify_changed(follower);
+    pthread_mutex_unlock(&follower->lock);
+}
+
+
+void follow_modified(file_follower* follower, const char* path) {
+    debug_assert(follower && path);
+
+    pthread_mutex_lock(&follower->lock);
+    if(hashmap_contains_str(&follower->growing, path)) {
+        ++follower->stats.modified;
+        notify_changed(follower);
+    }
+    pthread_mutex_unlock(&follower->lock);
+}
+
+
+bool follow_closed(file_follower* follower, const char* path) {
+    debug_assert(follower && path);
+
+    pthread_mutex_lock(&follower->lock);
+    bool followed = hashmap_remove_str(&follower->growing, path, NULL);
+    if(followed) {
+        notify_changed(follower);
+    }
+    pthread_mutex_unlock(&follower->lock);
+
+    return followed;
+}
+
+
+void follow_stop(file_follower* follower) {
+    debug_assert(follower);
+
+    pthread_mutex_lock(&follower->lock);
+    follower->stopped = true;
+    hashmap_clear(&follower->growing);
+    notify_changed(follower);
+    pthread_mutex_unlock(&follower->lock);
+}
+
+
+bool follow_is_growing(file_follower* follower, const char* path) {
+    debug_assert(follower && path);
+
+    pthread_mutex_lock(&follower->lock);
+    bool growing = !follower->stopped && hashmap_contains_str(&follower->growing, path);
+    pthread_mutex_unlock(&follower->lock);
+
+    return growing;
+}
+
+
+ssize_t follow_read(file_follower* follower, const char* path, int fd, uint8_t* buffer, size_t nbytes, off_t* offset) {
+    debug_assert(follower && path && buffer && offset);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += FOLLOW_WAIT_MS * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec  += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&follower->lock);
+    while(true) {
+        // Whether the file was closed has to be known before reading, a close
+        // after the read means there may be more to come
+        bool growing        = !follower->stopped && hashmap_contains_str(&follower->growing, path);
+        uint64_t generation = follower->generation;
+        pthread_mutex_unlock(&follower->lock);
+
+        ssize_t nread = pread(fd, buffer, nbytes, *offset);
+        if(nread < 0) {
+            return -1;
+        }
+        if(nread == (ssize_t) nbytes || !growing) {
+            *offset += nread;
+            return nread;
+        }
+
+        // Caught up with the writer, wait for it to write or close the file
+        pthread_mutex_lock(&follower->lock);
+        ++follower->stats.catch_ups;
+        int status = 0;
+        while(follower->generation == generation && status == 0) {
+            status = pthread_cond_timedwait(&follower->changed, &follower->lock, &deadline);
+        }
+        if(status == ETIMEDOUT) {
+            pthread_mutex_unlock(&follower->lock);
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+}
+
+
+file_follower_stats follow_get_stats(file_follower* follower) {
+    debug_assert(follower);
+
+    pthread_mutex_lock(&follower->lock);
+    file_follower_stats stats = follower->stats;
+    pthread_mutex_unlock(&follower->lock);
+
+    return stats;
+}
@@ -0,0 +1,182 @@
+/**
+ *  follow.h
+ * 
+ *  DESCRIPTION: Tracks files that are still being written so they can be read
+ *  while they grow, like tail -f. One thread reports when files are created,
+ *  modified, and closed (e.g. from dirwatch), others read them with
+ *  follow_read() which waits for the writer instead of returning end of file.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: follow_read() only returns full reads until the file is closed, so
+ *  a follower cuts a file into exactly the same blocks as reading the
+ *  finished file would.
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_FOLLOW_H
+#define LIBDXWIFI_FOLLOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <libdxwifi/details/hashmap.h>
+
+
+// How long follow_read() waits on the writer before giving up with EAGAIN
+#define FOLLOW_WAIT_MS 100
+
+
+typedef struct {
+    uint32_t    followed;       /* Files reported as created                */
+    uint64_t    modified;       /* Modification events reported             */
+    uint64_t    catch_ups;      /* Times a reader waited on a writer        */
+} file_follower_stats;
+
+
+typedef struct {
+    hashmap             growing;    /* Files created but not yet closed     */
+    uint64_t            generation; /* Bumped whenever any file changes     */
+    bool                stopped;    /* Treat every file as closed           */
+    file_follower_stats stats;      /* Accumulated statistics               */
+    pthread_mutex_t     lock;       /* Guards all of the above              */
+    pthread_cond_t      changed;    /* Broadcast when generation is bumped  */
+} file_follower;
+
+
+/**
+ *  DESCRIPTION:    Initializes the follower
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   pointer to the follower to be initialized
+ * 
+ */
+void init_file_follower(file_follower* follower);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the follower
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   pointer to the follower to be torndown
+ * 
+ */
+void teardown_file_follower(file_follower* follower);
+
+
+/**
+ *  DESCRIPTION:    Reports that a file was created and is being written
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ *      path:       Path of the new file
+ * 
+ */
+void follow_created(file_follower* follower, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Reports that a file was written to, wakes up readers
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ *      path:       Path of the modified file
+ * 
+ */
+void follow_modified(file_follower* follower, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Reports that a file was closed, readers will read it to
+ *                  the end
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ *      path:       Path of the closed file
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the file was being followed
+ * 
+ */
+bool follow_closed(file_follower* follower, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Stops following, every file is treated as closed from here
+ *                  on. Used when nothing will report closes anymore.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ */
+void follow_stop(file_follower* follower);
+
+
+/**
+ *  DESCRIPTION:    Checks if a file is still being written
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ *      path:       Path of the file
+ * 
+ */
+bool follow_is_growing(file_follower* follower, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Reads from a followed file. While the file is still being
+ *                  written only full reads are returned, waiting up to
+ *                  FOLLOW_WAIT_MS for the writer to catch up.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ *      path:       Path of the file being read
+ * 
+ *      fd:         Opened file descriptor of the file
+ * 
+ *      buffer:     Buffer to read into
+ * 
+ *      nbytes:     Number of bytes to read
+ * 
+ *      offset:     Offset to read from, advanced by the bytes read
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    nbytes while the file grows, fewer only once the file was
+ *                  closed and 0 at its end. -1 with errno set to EAGAIN if
+ *                  the writer didn't catch up in time, or to the read error.
+ * 
+ */
+ssize_t follow_read(file_follower* follower, const char* path, int fd, uint8_t* buffer, size_t nbytes, off_t* offset);
+
+
+/**
+ *  DESCRIPTION:    Snapshot of the follower statistics
+ * 
+ *  ARGUMENTS:
+ * 
+ *      follower:   Initialized follower
+ * 
+ */
+file_follower_stats follow_get_stats(file_follower* follower);
+
+
+#endif // LIBDXWIFI_FOLLOW_H
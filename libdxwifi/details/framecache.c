@@ -0,0 +1,317 @@
+/**
+ *  framecache.c
+ * 
+ *  DESCRIPTION: See framecache.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#define _GNU_SOURCE // mremap
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#include <libdxwifi/details/framecache.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+// Prefix of every cached entry. Built frames are followed by their MAC header
+// and payload, unit payloads by the payload alone
+typedef struct {
+    uint32_t    payload_size;   /* Bytes of payload in the entry            */
+    uint32_t    bytes_read;     /* Bytes the payload was read from          */
+} entry_hdr;
+
+
+static ssize_t read_inner(frame_cache* cache, int fd, uint8_t* payload, size_t blocksize) {
+    if(cache->inner.read_block) {
+        return cache->inner.read_block(fd, payload, blocksize, cache->inner.user_args);
+    }
+    return read(fd, payload, blocksize);
+}
+
+
+/**
+ *  DESCRIPTION:    Makes room for another @nbytes, mapping or growing the
+ *                  cache as needed
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the cache would grow past its limit
+ * 
+ */
+static bool reserve(frame_cache* cache, size_t nbytes) {
+    size_t needed = cache->used + nbytes;
+    if(needed <= cache->capacity) {
+        return true;
+    }
+    if(needed > cache->limit) {
+        return false;
+    }
+
+    size_t capacity = cache->capacity ? cache->capacity : FRAME_CACHE_MAP_MIN;
+    while(capacity < needed) {
+        capacity *= 2;
+    }
+    if(capacity > cache->limit) {
+        capacity = cache->limit;
+    }
+
+    void* data = cache->data
+        ? mremap(cache->data, cache->capacity, capacity, MREMAP_MAYMOVE)
+        : mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(data == MAP_FAILED) {
+        log_warning("Failed to grow frame cache to %ld bytes: %s", capacity, strerror(errno));
+        return false;
+    }
+    cache->data     = data;
+    cache->capacity = capacity;
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Appends an entry to the cache
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Cache recording a pass
+ * 
+ *      mac_hdr:    MAC header of the built frame, NULL for a unit payload
+ * 
+ *      payload:    Payload to record
+ * 
+ *      nbytes:     Size of the payload
+ * 
+ *      bytes_read: Bytes the payload was read from
+ * 
+ */
+static void record(frame_cache* cache, const ieee80211_hdr* mac_hdr, const uint8_t* payload, size_t nbytes, size_t bytes_read) {
+    if(cache->overflowed) {
+        return;
+    }
+
+    entry_hdr entry = { .payload_size = nbytes, .bytes_read = bytes_read };
+    size_t head = sizeof(entry) + (mac_hdr ? sizeof(ieee80211_hdr) : 0);
+
+    if(!reserve(cache, head + nbytes)) {
+        log_info("File has more than %ld bytes of frames, not caching it", cache->limit);
+        cache->overflowed = true;
+        ++cache->stats.overflows;
+        return;
+    }
+    uint8_t* next = cache->data + cache->used;
+
+    memcpy(next, &entry, sizeof(entry));
+    if(mac_hdr) {
+        memcpy(next + sizeof(entry), mac_hdr, sizeof(ieee80211_hdr));
+    }
+    memcpy(next + head, payload, nbytes);
+    cache->used += head + nbytes;
+
+    ++cache->stats.frames_cached;
+    cache->stats.bytes_cached += nbytes;
+}
+
+
+static void drop_frames(frame_cache* cache) {
+    cache->used         = 0;
+    cache->cursor       = 0;
+    cache->complete     = false;
+    cache->overflowed   = false;
+}
+
+
+void init_frame_cache(frame_cache* cache, size_t limit, uint32_t* unit_seq) {
+    debug_assert(cache);
+
+    memset(cache, 0x00, sizeof(frame_cache));
+    cache->limit    = limit;
+    cache->unit_seq = unit_seq;
+    cache->frames   = unit_seq == NULL;
+    cache->mode     = FRAME_CACHE_BYPASS;
+}
+
+
+void teardown_frame_cache(frame_cache* cache) {
+    debug_assert(cache);
+
+    if(cache->data) {
+        munmap(cache->data, cache->capacity);
+    }
+    cache->data     = NULL;
+    cache->capacity = 0;
+    drop_frames(cache);
+}
+
+
+void frame_cache_attach(frame_cache* cache, dxwifi_transmitter* tx) {
+    debug_assert(cache && tx);
+
+    drop_frames(cache);
+    cache->mode     = FRAME_CACHE_BYPASS;
+    cache->inner    = tx->packetizer;
+
+    tx->packetizer = (dxwifi_tx_packetizer) {
+        .read_block     = frame_cache_read,
+        .has_pending    = frame_cache_pending,
+        .record_frame   = cache->frames ? frame_cache_record : NULL,
+        .replay_frame   = cache->frames ? frame_cache_replay : NULL,
+        .user_args      = cache
+    };
+}
+
+
+void frame_cache_detach(frame_cache* cache, dxwifi_transmitter* tx) {
+    debug_assert(cache && tx);
+
+    tx->packetizer = cache->inner;
+    memset(&cache->inner, 0x00, sizeof(dxwifi_tx_packetizer));
+
+    // Keep the mapping for the next file but let the kernel have the pages
+    if(cache->data && cache->used > 0) {
+        madvise(cache->data, cache->used, MADV_DONTNEED);
+    }
+    drop_frames(cache);
+    cache->mode = FRAME_CACHE_BYPASS;
+}
+
+
+void frame_cache_begin_pass(frame_cache* cache, bool from_start) {
+    debug_assert(cache);
+
+    cache->cursor = 0;
+
+    if(cache->complete) {
+        cache->mode = FRAME_CACHE_REPLAY;
+        if(cache->unit_seq) {
+            cache->seq_base = *cache->unit_seq;
+        }
+    }
+    else if(from_start) {
+        drop_frames(cache);
+        cache->mode = FRAME_CACHE_RECORD;
+        if(cache->unit_seq) {
+            cache->seq_first = *cache->unit_seq;
+        }
+    }
+    else {
+        cache->mode = FRAME_CACHE_BYPASS;
+    }
+}
+
+
+void frame_cache_end_pass(frame_cache* cache, bool finished) {
+    debug_assert(cache);
+
+    switch (cache->mode)
+    {
+    case FRAME_CACHE_RECORD:
+        cache->complete = finished && !cache->overflowed;
+        if(!cache->complete) {
+            drop_frames(cache);
+        }
+        else if(cache->unit_seq) {
+            cache->seq_span = *cache->unit_seq - cache->seq_first;
+        }
+        break;
+
+    case FRAME_CACHE_REPLAY:
+        // Even a replay that was cut short used up the whole range
+        if(cache->unit_seq) {
+            *cache->unit_seq = cache->seq_base + cache->seq_span;
+        }
+        ++cache->stats.replays;
+        break;
+
+    default:
+        break;
+    }
+    cache->mode = FRAME_CACHE_BYPASS;
+}
+
+
+ssize_t frame_cache_read(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    frame_cache* cache = (frame_cache*) user;
+
+    entry_hdr entry;
+    ssize_t nread = 0;
+
+    switch (cache->mode)
+    {
+    case FRAME_CACHE_REPLAY:
+        // Built frames are all handed back by frame_cache_replay
+        if(cache->frames || cache->cursor >= cache->used) {
+            return 0;
+        }
+        memcpy(&entry, cache->data + cache->cursor, sizeof(entry));
+        debug_assert(entry.payload_size <= blocksize);
+
+        memcpy(payload, cache->data + cache->cursor + sizeof(entry), entry.payload_size);
+        cache->cursor += sizeof(entry) + entry.payload_size;
+
+        dxwifi_unit_hdr* hdr = (dxwifi_unit_hdr*) payload;
+        hdr->seq = htonl(ntohl(hdr->seq) - cache->seq_first + cache->seq_base);
+
+        ++cache->stats.frames_replayed;
+        return entry.payload_size;
+
+    case FRAME_CACHE_RECORD:
+        nread = read_inner(cache, fd, payload, blocksize);
+        if(nread > 0 && !cache->frames) {
+            record(cache, NULL, payload, nread, nread);
+        }
+        return nread;
+
+    default:
+        return read_inner(cache, fd, payload, blocksize);
+    }
+}
+
+
+bool frame_cache_pending(void* user) {
+    frame_cache* cache = (frame_cache*) user;
+
+    if(cache->mode == FRAME_CACHE_REPLAY) {
+        return true;
+    }
+    return cache->inner.has_pending && cache->inner.has_pending(cache->inner.user_args);
+}
+
+
+void frame_cache_record(const dxwifi_tx_frame* frame, size_t payload_size, size_t bytes_read, void* user) {
+    frame_cache* cache = (frame_cache*) user;
+
+    if(cache->mode == FRAME_CACHE_RECORD) {
+        record(cache, frame->mac_hdr, frame->payload, payload_size, bytes_read);
+    }
+}
+
+
+size_t frame_cache_replay(dxwifi_tx_frame* frame, size_t* bytes_read, void* user) {
+    frame_cache* cache = (frame_cache*) user;
+
+    if(cache->mode != FRAME_CACHE_REPLAY || cache->cursor >= cache->used) {
+        return 0;
+    }
+    const uint8_t* next = cache->data + cache->cursor;
+
+    entry_hdr entry;
+    memcpy(&entry, next, sizeof(entry));
+    debug_assert(entry.payload_size <= DXWIFI_TX_PAYLOAD_SIZE_MAX);
+
+    memcpy(frame->mac_hdr, next + sizeof(entry), sizeof(ieee80211_hdr));
+    memcpy(frame->payload, next + sizeof(entry) + sizeof(ieee80211_hdr), entry.payload_size);
+    cache->cursor += sizeof(entry) + sizeof(ieee80211_hdr) + entry.payload_size;
+
+    ++cache->stats.frames_replayed;
+    *bytes_read = entry.bytes_read;
+    return entry.payload_size;
+}
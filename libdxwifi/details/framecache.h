@@ -0,0 +1,189 @@
+/**
+ *  framecache.h
+ * 
+ *  DESCRIPTION: Cache of the frames a file was sent as, so a file that's 
+ *  retransmitted is only read, packetized and run through the pure preinject
+ *  handlers once. Stands in for the transmitter's packetizer: the first pass 
+ *  over a file reads through the real packetizer and records every frame as
+ *  the pure handlers left it, later passes hand the recorded frames straight
+ *  back without touching the file.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Frames are stored back to back in an anonymous memory mapping, each
+ *  one prefixed by its size. The mapping grows as needed up to a limit, a 
+ *  file with more than that is simply not cached. Only full passes are 
+ *  replayed, so a frame number the pure handlers put in the MAC header is the
+ *  same on every pass. The regular preinject handlers still run for every
+ *  replayed frame, so the send time and any inter-frame delay are applied as
+ *  usual. 
+ * 
+ *  Payloads of a unit aware packetizer get new sequence numbers on every 
+ *  pass, the same ones packetizing the file again would have given them. 
+ *  Those are cached before the pure handlers instead, which run again on the 
+ *  restamped payloads.
+ * 
+ */
+
+#ifndef LIBDXWIFI_FRAMECACHE_H
+#define LIBDXWIFI_FRAMECACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libdxwifi/transmitter.h>
+
+
+#define FRAME_CACHE_LIMIT_DFLT  (1024 * 1024 * 64)
+#define FRAME_CACHE_MAP_MIN     (1024 * 1024)
+
+
+typedef enum {
+    FRAME_CACHE_BYPASS,         /* Read through without recording           */
+    FRAME_CACHE_RECORD,         /* Read through and record each frame       */
+    FRAME_CACHE_REPLAY,         /* Hand back the recorded frames            */
+} frame_cache_mode_t;
+
+
+typedef struct {
+    uint32_t    frames_cached;  /* Frames recorded                          */
+    uint64_t    bytes_cached;   /* Bytes of payload recorded                */
+    uint32_t    replays;        /* Passes served from the cache             */
+    uint64_t    frames_replayed;/* Frames handed back from the cache        */
+    uint32_t    overflows;      /* Files too large to cache                 */
+} frame_cache_stats;
+
+
+typedef struct {
+    uint8_t*                data;       /* Size prefixed frames             */
+    size_t                  capacity;   /* Bytes mapped                     */
+    size_t                  limit;      /* Most bytes that may be mapped    */
+    size_t                  used;       /* Bytes recorded                   */
+    size_t                  cursor;     /* Offset of the next replay        */
+    frame_cache_mode_t      mode;       /* What the current pass does       */
+    uint32_t*               unit_seq;   /* Packetizer's fragment sequence   */
+    uint32_t                seq_first;  /* Sequence of the first payload    */
+    uint32_t                seq_span;   /* Sequence numbers the file uses   */
+    uint32_t                seq_base;   /* Sequence the replay starts at    */
+    bool                    frames;     /* Holds built frames, not payloads */
+    bool                    complete;   /* Holds every frame of the file    */
+    bool                    overflowed; /* Current file outgrew the limit   */
+    dxwifi_tx_packetizer    inner;      /* Packetizer being cached          */
+    frame_cache_stats       stats;      /* Counters for every file          */
+} frame_cache;
+
+
+/**
+ *  DESCRIPTION:    Initializes an empty cache, nothing is mapped until the
+ *                  first payload is recorded
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Cache to initialize
+ * 
+ *      limit:      Most bytes of payload a single file may take up
+ * 
+ *      unit_seq:   Next sequence number of the packetizer's unit 
+ *                  fragmenter, NULL if the payloads aren't units. Only 
+ *                  payloads that aren't units are cached as built frames.
+ * 
+ */
+void init_frame_cache(frame_cache* cache, size_t limit, uint32_t* unit_seq);
+
+
+/**
+ *  DESCRIPTION:    Unmaps the cache
+ * 
+ */
+void teardown_frame_cache(frame_cache* cache);
+
+
+/**
+ *  DESCRIPTION:    Starts caching the frames of a new file. The transmitter's
+ *                  packetizer is saved and replaced by the cache.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Initialized cache
+ * 
+ *      tx:         Transmitter whose packetizer to wrap
+ * 
+ */
+void frame_cache_attach(frame_cache* cache, dxwifi_transmitter* tx);
+
+
+/**
+ *  DESCRIPTION:    Restores the transmitter's packetizer and drops the cached
+ *                  frames, giving the memory back
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Attached cache
+ * 
+ *      tx:         Transmitter the cache was attached to
+ * 
+ */
+void frame_cache_detach(frame_cache* cache, dxwifi_transmitter* tx);
+
+
+/**
+ *  DESCRIPTION:    Called before each pass over the file. Replays the cache
+ *                  once it holds the whole file, otherwise records the pass
+ *                  if it starts from the beginning of the file.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Attached cache
+ * 
+ *      from_start: The pass reads the file from its first byte
+ * 
+ */
+void frame_cache_begin_pass(frame_cache* cache, bool from_start);
+
+
+/**
+ *  DESCRIPTION:    Called after each pass over the file
+ * 
+ *  ARGUMENTS:
+ * 
+ *      cache:      Attached cache
+ * 
+ *      finished:   The pass reached the end of the file
+ * 
+ */
+void frame_cache_end_pass(frame_cache* cache, bool finished);
+
+
+/**
+ *  DESCRIPTION:    Packetizer read_block, see dxwifi_tx_packetizer in
+ *                  transmitter.h. @user is the cache.
+ * 
+ */
+ssize_t frame_cache_read(int fd, uint8_t* payload, size_t blocksize, void* user);
+
+
+/**
+ *  DESCRIPTION:    Packetizer has_pending, a replay never waits on the file
+ * 
+ */
+bool frame_cache_pending(void* user);
+
+
+/**
+ *  DESCRIPTION:    Packetizer record_frame, records the frame the pure 
+ *                  handlers left while recording a pass of built frames
+ * 
+ */
+void frame_cache_record(const dxwifi_tx_frame* frame, size_t payload_size, size_t bytes_read, void* user);
+
+
+/**
+ *  DESCRIPTION:    Packetizer replay_frame, hands back the next built frame 
+ *                  while replaying
+ * 
+ */
+size_t frame_cache_replay(dxwifi_tx_frame* frame, size_t* bytes_read, void* user);
+
+
+#endif // LIBDXWIFI_FRAMECACHE_H
@@ -0,0 +1,186 @@
+/**
+ *  hashmap.c
+ * 
+ *  DESCRIPTION: See hashmap.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <libdxwifi/details/hashmap.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define HASHMAP_BUCKETS_MIN 16
+
+
+// FNV-1a
+static uint32_t hash_key(const void* key, size_t key_len) {
+    const uint8_t* bytes = key;
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < key_len; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+static inline size_t bucket_of(const hashmap* map, uint32_t hash) {
+    return hash & (map->num_buckets - 1);
+}
+
+
+static void alloc_buckets(hashmap* map, size_t num_buckets) {
+    map->buckets = calloc(num_buckets, sizeof(hashmap_entry*));
+    assert_M(map->buckets, "Failed to allocate hashmap with %ld buckets", num_buckets);
+    map->num_buckets = num_buckets;
+}
+
+
+/**
+ *  DESCRIPTION:    Doubles the number of buckets and rehashes every entry
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ */
+static void grow(hashmap* map) {
+    hashmap_entry** old_buckets = map->buckets;
+    size_t old_count            = map->num_buckets;
+
+    alloc_buckets(map, old_count * 2);
+
+    for(size_t i = 0; i < old_count; ++i) {
+        hashmap_entry* entry = old_buckets[i];
+        while(entry) {
+            hashmap_entry* next = entry->next;
+            size_t b            = bucket_of(map, entry->hash);
+            entry->next         = map->buckets[b];
+            map->buckets[b]     = entry;
+            entry               = next;
+        }
+    }
+    free(old_buckets);
+}
+
+
+void init_hashmap(hashmap* map, size_t capacity) {
+    debug_assert(map);
+
+    size_t num_buckets = HASHMAP_BUCKETS_MIN;
+    while(num_buckets * 3 < capacity * 4) {
+        num_buckets *= 2;
+    }
+    map->count = 0;
+    alloc_buckets(map, num_buckets);
+}
+
+
+void teardown_hashmap(hashmap* map) {
+    debug_assert(map);
+
+    if(map->buckets) {
+        hashmap_clear(map);
+        free(map->buckets);
+    }
+    map->buckets        = NULL;
+    map->num_buckets    = 0;
+}
+
+
+void hashmap_clear(hashmap* map) {
+    debug_assert(map);
+
+    for(size_t i = 0; i < map->num_buckets && map->count > 0; ++i) {
+        hashmap_entry* entry = map->buckets[i];
+        while(entry) {
+            hashmap_entry* next = entry->next;
+            free(entry);
+            entry = next;
+            --map->count;
+        }
+        map->buckets[i] = NULL;
+    }
+}
+
+
+bool hashmap_put(hashmap* map, const void* key, size_t key_len, void* value) {
+    debug_assert(map && map->buckets && (key || key_len == 0));
+
+    uint32_t hash   = hash_key(key, key_len);
+    size_t b        = bucket_of(map, hash);
+
+    for(hashmap_entry* entry = map->buckets[b]; entry; entry = entry->next) {
+        if(entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            entry->value = value;
+            return false;
+        }
+    }
+
+    hashmap_entry* entry = malloc(sizeof(hashmap_entry) + key_len);
+    assert_M(entry, "Failed to allocate hashmap entry");
+
+    entry->hash     = hash;
+    entry->key_len  = key_len;
+    entry->value    = value;
+    memcpy(entry->key, key, key_len);
+
+    entry->next     = map->buckets[b];
+    map->buckets[b] = entry;
+
+    if(++map->count * 4 > map->num_buckets * 3) {
+        grow(map);
+    }
+    return true;
+}
+
+
+hashmap_entry* hashmap_find(const hashmap* map, const void* key, size_t key_len) {
+    debug_assert(map && map->buckets);
+
+    uint32_t hash = hash_key(key, key_len);
+
+    for(hashmap_entry* entry = map->buckets[bucket_of(map, hash)]; entry; entry = entry->next) {
+        if(entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+bool hashmap_remove(hashmap* map, const void* key, size_t key_len, void** value) {
+    debug_assert(map && map->buckets);
+
+    uint32_t hash = hash_key(key, key_len);
+
+    hashmap_entry** link = &map->buckets[bucket_of(map, hash)];
+    while(*link) {
+        hashmap_entry* entry = *link;
+        if(entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            if(value) {
+                *value = entry->value;
+            }
+            *link = entry->next;
+            free(entry);
+            --map->count;
+            return true;
+        }
+        link = &entry->next;
+    }
+    return false;
+}
+
+
+void hashmap_foreach(const hashmap* map, hashmap_visitor visit, void* user) {
+    debug_assert(map && visit);
+
+    for(size_t i = 0; i < map->num_buckets; ++i) {
+        for(hashmap_entry* entry = map->buckets[i]; entry; entry = entry->next) {
+            visit(entry->key, entry->key_len, entry->value, user);
+        }
+    }
+}
@@ -0,0 +1,190 @@
+/**
+ *  hashmap.h
+ * 
+ *  DESCRIPTION: Generic hash map with separate chaining. Keys are arbitrary
+ *  byte strings which the map copies, values are opaque pointers owned by the
+ *  user.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: The bucket array doubles whenever the map is more than 3/4 full so
+ *  lookups stay constant time no matter how many entries are added.
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_HASHMAP_H
+#define LIBDXWIFI_HASHMAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+
+typedef struct hashmap_entry {
+    struct hashmap_entry* next; /* Next entry in the same bucket            */
+    uint32_t    hash;           /* Hash of the key                          */
+    size_t      key_len;        /* Size of the key                          */
+    void*       value;          /* User value                               */
+    uint8_t     key[];          /* Copy of the key                          */
+} hashmap_entry;
+
+
+typedef struct {
+    hashmap_entry** buckets;    /* Chains of entries                        */
+    size_t      num_buckets;    /* Number of buckets, a power of two        */
+    size_t      count;          /* Number of entries in the map             */
+} hashmap;
+
+
+/**
+ *  Visitor is called once for every entry in the map, see hashmap_foreach()
+ */
+typedef void (*hashmap_visitor)(const void* key, size_t key_len, void* value, void* user);
+
+
+/**
+ *  DESCRIPTION:    Initializes the hash map
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        pointer to the map to be initialized
+ * 
+ *      capacity:   Expected number of entries, the map grows past this
+ * 
+ */
+void init_hashmap(hashmap* map, size_t capacity);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the map. Values
+ *                  are not freed, see hashmap_foreach()
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        pointer to the map to be torndown
+ * 
+ */
+void teardown_hashmap(hashmap* map);
+
+
+/**
+ *  DESCRIPTION:    Removes every entry from the map
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ */
+void hashmap_clear(hashmap* map);
+
+
+/**
+ *  DESCRIPTION:    Inserts or replaces the value for a key
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ *      key:        Key data, copied into the map
+ * 
+ *      key_len:    Size of the key
+ * 
+ *      value:      Value to store
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the key was newly inserted, false if an existing
+ *                  value was replaced
+ * 
+ */
+bool hashmap_put(hashmap* map, const void* key, size_t key_len, void* value);
+
+
+/**
+ *  DESCRIPTION:    Finds the entry for a key
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ *      key:        Key data
+ * 
+ *      key_len:    Size of the key
+ * 
+ *  RETURNS:
+ * 
+ *      hashmap_entry*: The entry or NULL if the key isn't in the map
+ * 
+ */
+hashmap_entry* hashmap_find(const hashmap* map, const void* key, size_t key_len);
+
+
+/**
+ *  DESCRIPTION:    Removes a key from the map
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ *      key:        Key data
+ * 
+ *      key_len:    Size of the key
+ * 
+ *      value:      Set to the removed value if not NULL
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the key was in the map
+ * 
+ */
+bool hashmap_remove(hashmap* map, const void* key, size_t key_len, void** value);
+
+
+/**
+ *  DESCRIPTION:    Calls the visitor for every entry in the map. The visitor
+ *                  must not add or remove entries.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      map:        Initialized map
+ * 
+ *      visit:      Visitor function
+ * 
+ *      user:       User arguments to forward to the visitor
+ * 
+ */
+void hashmap_foreach(const hashmap* map, hashmap_visitor visit, void* user);
+
+
+static inline void* hashmap_get(const hashmap* map, const void* key, size_t key_len) {
+    hashmap_entry* entry = hashmap_find(map, key, key_len);
+    return entry ? entry->value : NULL;
+}
+
+
+static inline bool hashmap_contains(const hashmap* map, const void* key, size_t key_len) {
+    return hashmap_find(map, key, key_len) != NULL;
+}
+
+
+// String key conveniences, the terminating null is not part of the key
+static inline bool hashmap_put_str(hashmap* map, const char* key, void* value) {
+    return hashmap_put(map, key, strlen(key), value);
+}
+
+static inline void* hashmap_get_str(const hashmap* map, const char* key) {
+    return hashmap_get(map, key, strlen(key));
+}
+
+static inline bool hashmap_contains_str(const hashmap* map, const char* key) {
+    return hashmap_contains(map, key, strlen(key));
+}
+
+static inline bool hashmap_remove_str(hashmap* map, const char* key, void** value) {
+    return hashmap_remove(map, key, strlen(key), value);
+}
+
+
+#endif // LIBDXWIFI_HASHMAP_H
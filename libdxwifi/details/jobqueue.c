@@ -0,0 +1,173 @@
+/**
+ *  jobqueue.c
+ * 
+ *  DESCRIPTION: See jobqueue.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <string.h>
+
+#include <libdxwifi/details/jobqueue.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+void init_job_queue(job_queue* queue, size_t capacity) {
+    debug_assert(queue && capacity > 0);
+
+    queue->jobs = calloc(capacity, sizeof(char*));
+    assert_M(queue->jobs, "Failed to allocate job queue with %ld slots", capacity);
+
+    queue->capacity = capacity;
+    queue->head     = 0;
+    queue->depth    = 0;
+    queue->closed   = false;
+    memset(&queue->stats, 0x00, sizeof(job_queue_stats));
+
+    init_hashmap(&queue->queued, capacity);
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+}
+
+
+void teardown_job_queue(job_queue* queue) {
+    debug_assert(queue);
+
+    job_queue_discard(queue);
+
+    teardown_hashmap(&queue->queued);
+    free(queue->jobs);
+    queue->jobs = NULL;
+
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+
+job_queue_status_t job_queue_push(job_queue* queue, const char* path) {
+    debug_assert(queue && path);
+
+    job_queue_status_t status = JOB_QUEUED;
+
+    pthread_mutex_lock(&queue->lock);
+
+    if(hashmap_contains_str(&queue->queued, path)) {
+        ++queue->stats.duplicates;
+        status = queue->closed ? JOB_REJECTED : JOB_DUPLICATE;
+    }
+    else {
+        if(queue->depth == queue->capacity && !queue->closed) {
+            ++queue->stats.producer_waits;
+            while(queue->depth == queue->capacity && !queue->closed) {
+                pthread_cond_wait(&queue->not_full, &queue->lock);
+            }
+        }
+        if(queue->closed) {
+            status = JOB_REJECTED;
+        }
+        else {
+            char* job = strdup(path);
+            assert_M(job, "Failed to allocate job for %s", path);
+
+            queue->jobs[(queue->head + queue->depth) % queue->capacity] = job;
+            hashmap_put_str(&queue->queued, job, job);
+
+            ++queue->depth;
+            ++queue->stats.enqueued;
+            if(queue->depth > queue->stats.depth_max) {
+                queue->stats.depth_max = queue->depth;
+            }
+            pthread_cond_signal(&queue->not_empty);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return status;
+}
+
+
+char* job_queue_pop(job_queue* queue) {
+    debug_assert(queue);
+
+    char* job = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+
+    while(queue->depth == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if(queue->depth > 0) {
+        job = queue->jobs[queue->head];
+        queue->jobs[queue->head] = NULL;
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->depth;
+        ++queue->stats.dequeued;
+
+        hashmap_remove_str(&queue->queued, job, NULL);
+
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return job;
+}
+
+
+void job_queue_close(job_queue* queue) {
+    debug_assert(queue);
+
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+
+size_t job_queue_discard(job_queue* queue) {
+    debug_assert(queue);
+
+    pthread_mutex_lock(&queue->lock);
+
+    size_t discarded = queue->depth;
+    while(queue->depth > 0) {
+        free(queue->jobs[queue->head]);
+        queue->jobs[queue->head] = NULL;
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->depth;
+    }
+    hashmap_clear(&queue->queued);
+    queue->stats.discarded += discarded;
+
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    return discarded;
+}
+
+
+size_t job_queue_depth(job_queue* queue) {
+    debug_assert(queue);
+
+    pthread_mutex_lock(&queue->lock);
+    size_t depth = queue->depth;
+    pthread_mutex_unlock(&queue->lock);
+
+    return depth;
+}
+
+
+job_queue_stats job_queue_get_stats(job_queue* queue) {
+    debug_assert(queue);
+
+    pthread_mutex_lock(&queue->lock);
+    job_queue_stats stats = queue->stats;
+    pthread_mutex_unlock(&queue->lock);
+
+    return stats;
+}
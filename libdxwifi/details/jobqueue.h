@@ -0,0 +1,174 @@
+/**
+ *  jobqueue.h
+ * 
+ *  DESCRIPTION: Bounded, thread safe FIFO of file paths. Decouples whatever
+ *  discovers files (e.g. dirwatch) from whatever transmits them so a long
+ *  transmission doesn't stall the producer.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: A path that's already waiting in the queue isn't queued a second
+ *  time, the existing job will pick up whatever is on disk when it's popped.
+ *  Once a path is popped it can be queued again.
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_JOBQUEUE_H
+#define LIBDXWIFI_JOBQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <pthread.h>
+
+#include <libdxwifi/details/hashmap.h>
+
+
+#define JOB_QUEUE_CAPACITY_DFLT 1024
+
+
+typedef enum {
+    JOB_QUEUED,                 /* Path was added to the queue              */
+    JOB_DUPLICATE,              /* Path was already waiting in the queue    */
+    JOB_REJECTED,               /* Queue was closed, path was not added     */
+} job_queue_status_t;
+
+
+typedef struct {
+    uint64_t    enqueued;       /* Number of jobs added to the queue        */
+    uint64_t    duplicates;     /* Number of jobs dropped as duplicates     */
+    uint64_t    dequeued;       /* Number of jobs handed to the consumer    */
+    uint64_t    discarded;      /* Number of jobs dropped untransmitted     */
+    uint32_t    producer_waits; /* Number of pushes that blocked            */
+    uint32_t    depth_max;      /* Deepest the backlog got                  */
+} job_queue_stats;
+
+
+typedef struct {
+    char**          jobs;       /* Ring of queued paths                     */
+    size_t          capacity;   /* Size of the ring                         */
+    size_t          head;       /* Index of the oldest job                  */
+    size_t          depth;      /* Number of queued jobs                    */
+    bool            closed;     /* No more jobs will be accepted            */
+    hashmap         queued;     /* Paths currently waiting in the queue     */
+    job_queue_stats stats;      /* Accumulated statistics                   */
+    pthread_mutex_t lock;       /* Guards all of the above                  */
+    pthread_cond_t  not_empty;  /* Signalled when a job is pushed or closed */
+    pthread_cond_t  not_full;   /* Signalled when a job is popped or closed */
+} job_queue;
+
+
+/**
+ *  DESCRIPTION:    Initializes the job queue
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      pointer to the queue to be initialized
+ * 
+ *      capacity:   Maximum number of jobs waiting at once, pushes block
+ *                  while the queue is full
+ * 
+ */
+void init_job_queue(job_queue* queue, size_t capacity);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the queue. Jobs
+ *                  still waiting are freed.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      pointer to the queue to be torndown
+ * 
+ */
+void teardown_job_queue(job_queue* queue);
+
+
+/**
+ *  DESCRIPTION:    Adds a path to the back of the queue. Blocks while the
+ *                  queue is full.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ *      path:       Null terminated path, copied into the queue
+ * 
+ *  RETURNS:
+ * 
+ *      job_queue_status_t: JOB_QUEUED on success, JOB_DUPLICATE if the path
+ *                          is already waiting, JOB_REJECTED if the queue was
+ *                          closed.
+ * 
+ */
+job_queue_status_t job_queue_push(job_queue* queue, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Removes the path at the front of the queue. Blocks until
+ *                  a job is available or the queue is closed.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ *  RETURNS:
+ * 
+ *      char*:      Path to process, the caller must free it. NULL once the
+ *                  queue has been closed and every job has been popped.
+ * 
+ */
+char* job_queue_pop(job_queue* queue);
+
+
+/**
+ *  DESCRIPTION:    Closes the queue. Further pushes are rejected, jobs still
+ *                  waiting can be popped, and blocked threads are woken.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ */
+void job_queue_close(job_queue* queue);
+
+
+/**
+ *  DESCRIPTION:    Drops every job still waiting in the queue
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Number of jobs dropped
+ * 
+ */
+size_t job_queue_discard(job_queue* queue);
+
+
+/**
+ *  DESCRIPTION:    Number of jobs currently waiting
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ */
+size_t job_queue_depth(job_queue* queue);
+
+
+/**
+ *  DESCRIPTION:    Snapshot of the queue statistics
+ * 
+ *  ARGUMENTS:
+ * 
+ *      queue:      Initialized queue
+ * 
+ */
+job_queue_stats job_queue_get_stats(job_queue* queue);
+
+
+#endif // LIBDXWIFI_JOBQUEUE_H
@@ -0,0 +1,1008 @@
+/**
+ *  jpeg.c
+ * 
+ *  DESCRIPTION: See jpeg.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libdxwifi/details/jpeg.h>
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define JPEG_MARKER_SOI     0xd8
+#define JPEG_MARKER_EOI     0xd9
+#define JPEG_MARKER_RST0    0xd0
+#define JPEG_MARKER_RST7    0xd7
+#define JPEG_MARKER_SOF0    0xc0
+#define JPEG_MARKER_SOF1    0xc1
+#define JPEG_MARKER_DHT     0xc4
+#define JPEG_MARKER_JPG     0xc8
+#define JPEG_MARKER_SOF15   0xcf
+#define JPEG_MARKER_SOS     0xda
+#define JPEG_MARKER_DRI     0xdd
+
+#define JPEG_WRITER_BUFFER_SIZE 4096
+
+
+/**
+ *  Buffers output to a file descriptor and packs entropy coded bits
+ */
+typedef struct {
+    int         fd;
+    uint8_t     buffer[JPEG_WRITER_BUFFER_SIZE];
+    size_t      length;
+    uint32_t    bits;           /* Bits waiting to be packed into a byte    */
+    unsigned    nbits;          /* Number of waiting bits                   */
+    ssize_t     written;        /* Total bytes written to the fd            */
+} jpeg_writer;
+
+
+/**
+ *  Huffman codes of a neutral block for one scan component
+ */
+typedef struct {
+    uint16_t    dc_code;        /* Code for a DC difference of zero         */
+    uint8_t     dc_length;
+    uint16_t    eob_code;       /* Code for the AC end of block symbol      */
+    uint8_t     eob_length;
+    unsigned    blocks;         /* Blocks of the component in each MCU      */
+} neutral_block;
+
+
+static bool is_rst_marker(uint8_t marker) {
+    return marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7;
+}
+
+
+static uint16_t read_be16(const uint8_t* data) {
+    return (data[0] << 8) | data[1];
+}
+
+
+static uint32_t ceil_div(uint32_t n, uint32_t d) {
+    return (n + d - 1) / d;
+}
+
+
+/**
+ *  DESCRIPTION:    Grows a dynamically allocated array to fit a minimum size
+ * 
+ *  ARGUMENTS:
+ * 
+ *      array:      Pointer to the array pointer
+ * 
+ *      capacity:   Number of elements allocated, updated on growth
+ * 
+ *      needed:     Minimum number of elements
+ * 
+ *      elem_size:  Size of each element
+ * 
+ */
+static void grow_array(void** array, size_t* capacity, size_t needed, size_t elem_size) {
+    if(needed <= *capacity) {
+        return;
+    }
+    size_t new_capacity = (*capacity > 0 ? *capacity : 16);
+    while(new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void* new_array = realloc(*array, new_capacity * elem_size);
+    assert_M(new_array, "Failed to grow JPEG buffer to %ld elements", new_capacity);
+
+    *array      = new_array;
+    *capacity   = new_capacity;
+}
+
+
+/**
+ *  DESCRIPTION:    Parses a start of frame segment
+ * 
+ *  ARGUMENTS:
+ * 
+ *      seg:        Segment data following the length field
+ * 
+ *      len:        Size of the segment data
+ * 
+ *      info:       Header info to fill
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the frame is unsupported or malformed
+ * 
+ */
+static bool parse_frame(const uint8_t* seg, size_t len, jpeg_info* info) {
+    if(len < 6 || seg[0] != 8) {
+        return false;
+    }
+    info->height            = read_be16(seg + 1);
+    info->width             = read_be16(seg + 3);
+    info->num_components    = seg[5];
+
+    // A height of zero is deferred to a DNL marker after the scan
+    if(info->height == 0 || info->width == 0) {
+        return false;
+    }
+    if(info->num_components == 0 || info->num_components > JPEG_MAX_COMPONENTS || len < 6 + 3 * (size_t)info->num_components) {
+        return false;
+    }
+    for(unsigned i = 0; i < info->num_components; ++i) {
+        jpeg_component* c = &info->components[i];
+        c->id   = seg[6 + 3 * i];
+        c->h    = seg[7 + 3 * i] >> 4;
+        c->v    = seg[7 + 3 * i] & 0x0f;
+        if(c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Parses a define Huffman table segment
+ * 
+ *  ARGUMENTS:
+ * 
+ *      seg:        Segment data following the length field
+ * 
+ *      len:        Size of the segment data
+ * 
+ *      info:       Header info to fill
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the segment is malformed
+ * 
+ */
+static bool parse_huffman_tables(const uint8_t* seg, size_t len, jpeg_info* info) {
+    size_t pos = 0;
+    while(pos < len) {
+        uint8_t tc = seg[pos] >> 4;
+        uint8_t th = seg[pos] & 0x0f;
+        if(tc > 1 || th >= JPEG_MAX_HUFFMAN_TABLES || pos + 17 > len) {
+            return false;
+        }
+        jpeg_huffman_table* table = (tc == 0) ? &info->dc_tables[th] : &info->ac_tables[th];
+
+        size_t total = 0;
+        table->counts[0] = 0;
+        for(unsigned i = 1; i <= 16; ++i) {
+            table->counts[i] = seg[pos + i];
+            total += seg[pos + i];
+        }
+        if(total > sizeof(table->symbols) || pos + 17 + total > len) {
+            return false;
+        }
+        memcpy(table->symbols, seg + pos + 17, total);
+        table->present = true;
+
+        pos += 17 + total;
+    }
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Parses a start of scan segment
+ * 
+ *  ARGUMENTS:
+ * 
+ *      seg:        Segment data following the length field
+ * 
+ *      len:        Size of the segment data
+ * 
+ *      info:       Header info with the frame already parsed
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the scan is unsupported or malformed
+ * 
+ */
+static bool parse_scan(const uint8_t* seg, size_t len, jpeg_info* info) {
+    if(len < 1) {
+        return false;
+    }
+    uint8_t ns = seg[0];
+    if(ns == 0 || ns > info->num_components || len < 1 + 2 * (size_t)ns + 3) {
+        return false;
+    }
+    for(unsigned i = 0; i < ns; ++i) {
+        uint8_t id = seg[1 + 2 * i];
+        uint8_t td = seg[2 + 2 * i] >> 4;
+        uint8_t ta = seg[2 + 2 * i] & 0x0f;
+
+        unsigned c = 0;
+        while(c < info->num_components && info->components[c].id != id) {
+            ++c;
+        }
+        if(c == info->num_components || td >= JPEG_MAX_HUFFMAN_TABLES || ta >= JPEG_MAX_HUFFMAN_TABLES) {
+            return false;
+        }
+        info->components[c].dc_table    = td;
+        info->components[c].ac_table    = ta;
+        info->scan_index[i]             = c;
+    }
+    info->scan_components = ns;
+
+    // Spectral selection and successive approximation must cover everything
+    const uint8_t* tail = seg + 1 + 2 * ns;
+    return tail[0] == 0 && tail[1] == 63 && tail[2] == 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Counts the MCUs in the scan and the restart intervals
+ *                  they're divided into
+ * 
+ *  ARGUMENTS:
+ * 
+ *      info:       Header info with the frame and scan parsed
+ * 
+ */
+static void count_mcus(jpeg_info* info) {
+    unsigned hmax = 1, vmax = 1;
+    for(unsigned i = 0; i < info->num_components; ++i) {
+        hmax = (info->components[i].h > hmax) ? info->components[i].h : hmax;
+        vmax = (info->components[i].v > vmax) ? info->components[i].v : vmax;
+    }
+
+    if(info->scan_components == 1) {
+        // Non-interleaved scans have one block per MCU
+        const jpeg_component* c = &info->components[info->scan_index[0]];
+        uint32_t width  = ceil_div(info->width * c->h, hmax);
+        uint32_t height = ceil_div(info->height * c->v, vmax);
+        info->total_mcus = ceil_div(width, 8) * ceil_div(height, 8);
+    }
+    else {
+        info->total_mcus = ceil_div(info->width, 8 * hmax) * ceil_div(info->height, 8 * vmax);
+    }
+    info->num_intervals = ceil_div(info->total_mcus, info->restart_interval);
+}
+
+
+/**
+ *  DESCRIPTION:    Finds the canonical Huffman code for a symbol
+ * 
+ *  ARGUMENTS:
+ * 
+ *      table:      Huffman table
+ * 
+ *      symbol:     Symbol to look up
+ * 
+ *      code:       Code of the symbol
+ * 
+ *      length:     Length of the code in bits
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the symbol isn't in the table
+ * 
+ */
+static bool huffman_code(const jpeg_huffman_table* table, uint8_t symbol, uint16_t* code, uint8_t* length) {
+    uint16_t next   = 0;
+    unsigned k      = 0;
+    for(unsigned len = 1; len <= 16; ++len) {
+        for(unsigned i = 0; i < table->counts[len]; ++i, ++k, ++next) {
+            if(table->symbols[k] == symbol) {
+                *code   = next;
+                *length = len;
+                return true;
+            }
+        }
+        next <<= 1;
+    }
+    return false;
+}
+
+
+static void writer_flush(jpeg_writer* w) {
+    if(w->length > 0) {
+        ssize_t nbytes = write(w->fd, w->buffer, w->length);
+        debug_assert_continue(nbytes == (ssize_t)w->length, "Partial write: %ld - %s", nbytes, strerror(errno));
+
+        w->written += (nbytes > 0) ? nbytes : 0;
+        w->length   = 0;
+    }
+}
+
+
+static void writer_put(jpeg_writer* w, const uint8_t* data, size_t size) {
+    if(w->length + size > JPEG_WRITER_BUFFER_SIZE) {
+        writer_flush(w);
+    }
+    if(size > JPEG_WRITER_BUFFER_SIZE) {
+        ssize_t nbytes = write(w->fd, data, size);
+        debug_assert_continue(nbytes == (ssize_t)size, "Partial write: %ld - %s", nbytes, strerror(errno));
+
+        w->written += (nbytes > 0) ? nbytes : 0;
+        return;
+    }
+    memcpy(w->buffer + w->length, data, size);
+    w->length += size;
+}
+
+
+static void writer_marker(jpeg_writer* w, uint8_t marker) {
+    uint8_t bytes[] = { 0xff, marker };
+    writer_put(w, bytes, sizeof(bytes));
+}
+
+
+/**
+ *  DESCRIPTION:    Packs entropy coded bits, byte stuffing any 0xFF bytes
+ * 
+ *  ARGUMENTS:
+ * 
+ *      w:          Initialized writer
+ * 
+ *      code:       Bits to write, right aligned
+ * 
+ *      length:     Number of bits to write, at most 16
+ * 
+ */
+static void writer_bits(jpeg_writer* w, uint16_t code, unsigned length) {
+    w->bits     = (w->bits << length) | code;
+    w->nbits   += length;
+
+    while(w->nbits >= 8) {
+        uint8_t bytes[] = { (w->bits >> (w->nbits - 8)) & 0xff, 0x00 };
+        writer_put(w, bytes, bytes[0] == 0xff ? 2 : 1);
+
+        w->nbits -= 8;
+        w->bits  &= (1u << w->nbits) - 1;
+    }
+}
+
+
+static void writer_align(jpeg_writer* w) {
+    if(w->nbits > 0) {
+        unsigned pad = 8 - w->nbits;
+        writer_bits(w, (1u << pad) - 1, pad); // Pad with 1 bits
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Looks up the codes of a neutral block for each component
+ * 
+ *  ARGUMENTS:
+ * 
+ *      info:       Parsed header info
+ * 
+ *      blocks:     Neutral block codes of each scan component
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the Huffman tables can't encode a neutral block
+ * 
+ */
+static bool neutral_blocks(const jpeg_info* info, neutral_block* blocks) {
+    for(unsigned i = 0; i < info->scan_components; ++i) {
+        const jpeg_component* c = &info->components[info->scan_index[i]];
+
+        blocks[i].blocks = (info->scan_components == 1) ? 1 : c->h * c->v;
+
+        if(!huffman_code(&info->dc_tables[c->dc_table], 0x00, &blocks[i].dc_code, &blocks[i].dc_length)
+        || !huffman_code(&info->ac_tables[c->ac_table], 0x00, &blocks[i].eob_code, &blocks[i].eob_length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a restart interval where every block is flat. The
+ *                  DC predictor is reset at each restart marker so a zero DC
+ *                  difference yields mid gray luma and neutral chroma.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      w:          Initialized writer
+ * 
+ *      info:       Parsed header info
+ * 
+ *      blocks:     Neutral block codes of each scan component
+ * 
+ *      interval:   Index of the interval to write
+ * 
+ */
+static void write_neutral_interval(jpeg_writer* w, const jpeg_info* info, const neutral_block* blocks, uint32_t interval) {
+    uint32_t first  = interval * info->restart_interval;
+    uint32_t mcus   = info->total_mcus - first;
+    if(mcus > info->restart_interval) {
+        mcus = info->restart_interval;
+    }
+    for(uint32_t m = 0; m < mcus; ++m) {
+        for(unsigned i = 0; i < info->scan_components; ++i) {
+            for(unsigned b = 0; b < blocks[i].blocks; ++b) {
+                writer_bits(w, blocks[i].dc_code, blocks[i].dc_length);
+                writer_bits(w, blocks[i].eob_code, blocks[i].eob_length);
+            }
+        }
+    }
+    writer_align(w);
+}
+
+
+/**
+ *  DESCRIPTION:    Locates each restart interval in a buffered JPEG
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Packetizer with the entire file buffered
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the file can be sent interval by interval
+ * 
+ */
+static bool split_intervals(jpeg_packetizer* jpeg) {
+    const uint8_t* data = jpeg->buffer;
+    jpeg_info* info     = &jpeg->info;
+
+    if(!jpeg_parse_header(data, jpeg->length, info)) {
+        return false;
+    }
+
+    size_t count = 0;
+    size_t start = info->header_size;
+    size_t pos   = info->header_size;
+    while(pos + 1 < jpeg->length) {
+        if(data[pos] != 0xff || data[pos + 1] == 0x00) {
+            pos += (data[pos] == 0xff) ? 2 : 1;
+            continue;
+        }
+        if(data[pos + 1] == 0xff) {
+            ++pos; // Fill byte
+            continue;
+        }
+        if(!is_rst_marker(data[pos + 1])) {
+            break; // End of the scan
+        }
+        if((size_t)(data[pos + 1] - JPEG_MARKER_RST0) != count % 8) {
+            log_debug("Restart marker %ld out of order", count);
+            return false;
+        }
+        grow_array((void**)&jpeg->intervals, &jpeg->intervals_capacity, count + 1, sizeof(jpeg_interval));
+        jpeg->intervals[count].start    = start;
+        jpeg->intervals[count].end      = pos;
+        ++count;
+
+        pos  += 2;
+        start = pos;
+    }
+
+    // Anything other than a single scan followed by the EOI isn't supported
+    if(pos + 2 != jpeg->length || data[pos + 1] != JPEG_MARKER_EOI) {
+        log_debug("JPEG has multiple scans or trailing data");
+        return false;
+    }
+    grow_array((void**)&jpeg->intervals, &jpeg->intervals_capacity, count + 1, sizeof(jpeg_interval));
+    jpeg->intervals[count].start    = start;
+    jpeg->intervals[count].end      = pos;
+    ++count;
+
+    if(count != info->num_intervals) {
+        log_debug("Expected %d restart intervals, found %ld", info->num_intervals, count);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Reads more of the input file into the buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized packetizer
+ * 
+ *      fd:         Input source
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Return value of read(), 0 if the file exceeds the maximum
+ *                  size
+ * 
+ */
+static ssize_t fill_buffer(jpeg_packetizer* jpeg, int fd) {
+    if(jpeg->length == jpeg->capacity) {
+        if(jpeg->capacity >= JPEG_FILE_SIZE_MAX) {
+            log_error("File exceeds %d bytes, the remainder will not be sent", JPEG_FILE_SIZE_MAX);
+            return 0;
+        }
+        grow_array((void**)&jpeg->buffer, &jpeg->capacity, jpeg->capacity * 2, sizeof(uint8_t));
+    }
+    return read(fd, jpeg->buffer + jpeg->length, jpeg->capacity - jpeg->length);
+}
+
+
+/**
+ *  DESCRIPTION:    Selects the next unit to send. Whole intervals are packed
+ *                  into a unit until the next one would overflow the payload,
+ *                  an interval larger than the payload is sent on its own.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Loaded packetizer
+ * 
+ *      capacity:   Payload size available for unit data
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the entire file has been sent
+ * 
+ */
+static bool select_unit(jpeg_packetizer* jpeg, size_t capacity) {
+    if(jpeg->aligned) {
+        uint32_t first  = jpeg->next_interval;
+        uint32_t last   = first + 1;
+        if(first >= jpeg->info.num_intervals) {
+            return false;
+        }
+        while(last < jpeg->info.num_intervals && jpeg->intervals[last].end - jpeg->intervals[first].start <= capacity) {
+            ++last;
+        }
+        jpeg->unit_start    = jpeg->intervals[first].start;
+        jpeg->unit_end      = jpeg->intervals[last - 1].end;
+        jpeg->unit          = first + 1; // Unit 0 is the header
+        jpeg->unit_type     = JPEG_UNIT_INTERVALS;
+        jpeg->next_interval = last;
+
+        jpeg->stats.intervals += last - first;
+    }
+    else {
+        if(jpeg->next_offset >= jpeg->length) {
+            return false;
+        }
+        jpeg->unit_start    = jpeg->next_offset;
+        jpeg->unit_end      = jpeg->next_offset + capacity;
+        if(jpeg->unit_end > jpeg->length) {
+            jpeg->unit_end  = jpeg->length;
+        }
+        jpeg->unit          = (jpeg->unit_start == 0) ? 0 : jpeg->unit + 1;
+        jpeg->unit_type     = JPEG_UNIT_RAW;
+        jpeg->next_offset   = jpeg->unit_end;
+    }
+    jpeg->in_unit = true;
+    ++jpeg->stats.units;
+    return true;
+}
+
+
+static void reset_jpeg_packetizer(jpeg_packetizer* jpeg) {
+    jpeg->length        = 0;
+    jpeg->loaded        = false;
+    jpeg->aligned       = false;
+    jpeg->in_unit       = false;
+    jpeg->next_interval = 0;
+    jpeg->next_offset   = 0;
+    reset_unit_fragmenter(&jpeg->fragmenter);
+}
+
+
+/**
+ *  DESCRIPTION:    Discards the buffered image
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized depacketizer
+ * 
+ */
+static void reset_image(jpeg_depacketizer* jpeg) {
+    jpeg->header_len    = 0;
+    jpeg->data_len      = 0;
+    jpeg->num_segments  = 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Writes out the buffered image, substituting a neutral strip
+ *                  for each missing interval, and discards it
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized depacketizer
+ * 
+ *      fd:         Output file
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Number of bytes written
+ * 
+ */
+static ssize_t write_image(jpeg_depacketizer* jpeg, int fd) {
+    jpeg_info info;
+    neutral_block blocks[JPEG_MAX_COMPONENTS];
+
+    if(jpeg->header_len == 0) {
+        if(jpeg->num_segments > 0) {
+            log_error("JPEG header lost, dropping %ld received units", jpeg->num_segments);
+            ++jpeg->stats.headers_lost;
+        }
+        reset_image(jpeg);
+        return 0;
+    }
+    if(!jpeg_parse_header(jpeg->header, jpeg->header_len, &info)) {
+        log_error("Received an unsupported JPEG header");
+        reset_image(jpeg);
+        return 0;
+    }
+    bool neutral = neutral_blocks(&info, blocks);
+    if(!neutral) {
+        log_warning("Huffman tables can't encode a neutral strip, lost intervals will be left empty");
+    }
+
+    jpeg_writer* w = calloc(1, sizeof(jpeg_writer));
+    assert_M(w, "Failed to allocate JPEG writer");
+    w->fd = fd;
+
+    writer_put(w, jpeg->header, jpeg->header_len);
+
+    size_t seg = 0;
+    uint32_t interval = 0;
+    while(interval < info.num_intervals) {
+        if(interval > 0) {
+            writer_marker(w, JPEG_MARKER_RST0 + ((interval - 1) % 8));
+        }
+        while(seg < jpeg->num_segments && jpeg->segments[seg].first < interval) {
+            ++seg; // Overlaps an interval that was already written
+        }
+        const jpeg_segment* s = (seg < jpeg->num_segments) ? &jpeg->segments[seg] : NULL;
+
+        if(s && s->first == interval && s->first + s->count <= info.num_intervals) {
+            writer_put(w, jpeg->data + s->offset, s->length);
+            jpeg->stats.intervals_received += s->count;
+            interval += s->count;
+        }
+        else {
+            if(neutral) {
+                write_neutral_interval(w, &info, blocks, interval);
+            }
+            ++jpeg->stats.intervals_substituted;
+            ++interval;
+        }
+    }
+    writer_marker(w, JPEG_MARKER_EOI);
+    writer_flush(w);
+
+    ssize_t written = w->written;
+    free(w);
+
+    ++jpeg->stats.images;
+    reset_image(jpeg);
+    return written;
+}
+
+
+/**
+ *  DESCRIPTION:    Stores a complete interval unit
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized depacketizer
+ * 
+ *      unit:       Index of the unit
+ * 
+ *      data:       Unit data
+ * 
+ *      size:       Size of the unit data
+ * 
+ *      fd:         Output file
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Number of bytes written if the unit belongs to a new image
+ *                  whose header was lost and the previous image was written
+ * 
+ */
+static ssize_t store_intervals(jpeg_depacketizer* jpeg, uint32_t unit, const uint8_t* data, size_t size, int fd) {
+    ssize_t nbytes = 0;
+
+    if(unit == 0) {
+        return 0;
+    }
+
+    uint32_t count = 1;
+    for(size_t i = 0; i + 1 < size; ++i) {
+        if(data[i] == 0xff && is_rst_marker(data[i + 1])) {
+            ++count;
+        }
+    }
+
+    // Intervals going backwards means the next image started without a header
+    if(jpeg->num_segments > 0) {
+        const jpeg_segment* last = &jpeg->segments[jpeg->num_segments - 1];
+        if(unit - 1 < last->first + last->count) {
+            nbytes = write_image(jpeg, fd);
+        }
+    }
+    if(jpeg->data_len + size > JPEG_FILE_SIZE_MAX) {
+        log_warning("Received image exceeds %d bytes, dropping intervals", JPEG_FILE_SIZE_MAX);
+        return nbytes;
+    }
+
+    grow_array((void**)&jpeg->data, &jpeg->data_capacity, jpeg->data_len + size, sizeof(uint8_t));
+    grow_array((void**)&jpeg->segments, &jpeg->segments_capacity, jpeg->num_segments + 1, sizeof(jpeg_segment));
+
+    jpeg_segment* s = &jpeg->segments[jpeg->num_segments++];
+    s->first    = unit - 1;
+    s->count    = count;
+    s->offset   = jpeg->data_len;
+    s->length   = size;
+
+    memcpy(jpeg->data + jpeg->data_len, data, size);
+    jpeg->data_len += size;
+
+    return nbytes;
+}
+
+
+//
+// See jpeg.h for description of non-static functions
+//
+
+bool jpeg_parse_header(const uint8_t* data, size_t size, jpeg_info* info) {
+    debug_assert(data && info);
+
+    memset(info, 0x00, sizeof(jpeg_info));
+
+    if(size < 4 || data[0] != 0xff || data[1] != JPEG_MARKER_SOI) {
+        return false;
+    }
+
+    bool have_frame = false;
+    size_t pos = 2;
+    while(pos < size) {
+        if(data[pos] != 0xff) {
+            return false;
+        }
+        while(pos < size && data[pos] == 0xff) {
+            ++pos;
+        }
+        if(pos + 3 > size) {
+            return false;
+        }
+        uint8_t marker = data[pos++];
+
+        // Standalone markers have no business before the scan
+        if(marker == JPEG_MARKER_SOI || marker == JPEG_MARKER_EOI || marker == 0x01 || is_rst_marker(marker)) {
+            return false;
+        }
+
+        size_t len = read_be16(data + pos);
+        if(len < 2 || pos + len > size) {
+            return false;
+        }
+        const uint8_t* seg = data + pos + 2;
+
+        switch (marker)
+        {
+        case JPEG_MARKER_SOF0:
+        case JPEG_MARKER_SOF1:
+            if(have_frame || !parse_frame(seg, len - 2, info)) {
+                return false;
+            }
+            have_frame = true;
+            break;
+
+        case JPEG_MARKER_DHT:
+            if(!parse_huffman_tables(seg, len - 2, info)) {
+                return false;
+            }
+            break;
+
+        case JPEG_MARKER_DRI:
+            if(len < 4) {
+                return false;
+            }
+            info->restart_interval = read_be16(seg);
+            break;
+
+        case JPEG_MARKER_SOS:
+            if(!have_frame || info->restart_interval == 0 || !parse_scan(seg, len - 2, info)) {
+                return false;
+            }
+            for(unsigned i = 0; i < info->scan_components; ++i) {
+                const jpeg_component* c = &info->components[info->scan_index[i]];
+                if(!info->dc_tables[c->dc_table].present || !info->ac_tables[c->ac_table].present) {
+                    return false;
+                }
+            }
+            info->header_size = pos + len;
+            count_mcus(info);
+            return true;
+
+        default:
+            // Progressive, lossless, hierarchical and arithmetic coded frames
+            if(marker > JPEG_MARKER_SOF1 && marker <= JPEG_MARKER_SOF15 && marker != JPEG_MARKER_JPG) {
+                return false;
+            }
+            break;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+
+void init_jpeg_packetizer(jpeg_packetizer* jpeg, unsigned key_repeats) {
+    debug_assert(jpeg);
+
+    memset(jpeg, 0x00, sizeof(jpeg_packetizer));
+
+    jpeg->key_repeats   = key_repeats;
+    jpeg->capacity      = JPEG_BUFFER_SIZE_DFLT;
+    jpeg->buffer        = malloc(jpeg->capacity);
+    assert_M(jpeg->buffer, "Failed to allocate JPEG buffer of size: %ld", jpeg->capacity);
+
+    reset_jpeg_packetizer(jpeg);
+}
+
+
+void teardown_jpeg_packetizer(jpeg_packetizer* jpeg) {
+    debug_assert(jpeg);
+
+    free(jpeg->buffer);
+    free(jpeg->intervals);
+    jpeg->buffer                = NULL;
+    jpeg->capacity              = 0;
+    jpeg->intervals             = NULL;
+    jpeg->intervals_capacity    = 0;
+    reset_jpeg_packetizer(jpeg);
+}
+
+
+ssize_t jpeg_packetize(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    jpeg_packetizer* jpeg = (jpeg_packetizer*) user;
+    debug_assert(jpeg && payload && blocksize > sizeof(dxwifi_unit_hdr));
+
+    if(!jpeg->loaded) {
+        ssize_t nbytes = fill_buffer(jpeg, fd);
+        if(nbytes < 0) {
+            return -1;
+        }
+        if(nbytes > 0) {
+            jpeg->length += nbytes;
+            errno = EAGAIN; // Keep reading until the whole file is buffered
+            return -1;
+        }
+        if(jpeg->length == 0) {
+            reset_jpeg_packetizer(jpeg);
+            return 0;
+        }
+        jpeg->loaded    = true;
+        jpeg->aligned   = split_intervals(jpeg);
+
+        if(jpeg->aligned) {
+            log_info("Sending JPEG as %d restart intervals of %d MCUs", jpeg->info.num_intervals, jpeg->info.restart_interval);
+            ++jpeg->stats.images;
+
+            jpeg->in_unit       = true;
+            jpeg->unit_start    = 0;
+            jpeg->unit_end      = jpeg->info.header_size;
+            jpeg->unit          = 0;
+            jpeg->unit_type     = JPEG_UNIT_HEADER;
+            ++jpeg->stats.units;
+        }
+        else {
+            log_warning("File is not a baseline JPEG with restart markers, sending it as is");
+            ++jpeg->stats.raw_images;
+        }
+    }
+
+    if(!jpeg->in_unit && !select_unit(jpeg, blocksize - sizeof(dxwifi_unit_hdr))) {
+        reset_jpeg_packetizer(jpeg);
+        return 0;
+    }
+
+    bool unit_done  = false;
+    bool key        = (jpeg->unit_type == JPEG_UNIT_HEADER);
+
+    size_t size = unit_fragmenter_next(
+        &jpeg->fragmenter,
+        jpeg->buffer + jpeg->unit_start,
+        jpeg->unit_end - jpeg->unit_start,
+        jpeg->unit,
+        jpeg->unit_type,
+        key ? DXWIFI_UNIT_F_KEY : 0,
+        key ? jpeg->key_repeats : 0,
+        payload,
+        blocksize,
+        &unit_done
+        );
+
+    jpeg->in_unit = !unit_done;
+    return size;
+}
+
+
+bool jpeg_packetizer_pending(void* user) {
+    jpeg_packetizer* jpeg = (jpeg_packetizer*) user;
+    debug_assert(jpeg);
+
+    return jpeg->loaded;
+}
+
+
+void init_jpeg_depacketizer(jpeg_depacketizer* jpeg) {
+    debug_assert(jpeg);
+
+    memset(jpeg, 0x00, sizeof(jpeg_depacketizer));
+
+    init_unit_reassembler(&jpeg->reassembler, JPEG_BUFFER_SIZE_DFLT, JPEG_FILE_SIZE_MAX);
+}
+
+
+void teardown_jpeg_depacketizer(jpeg_depacketizer* jpeg) {
+    debug_assert(jpeg);
+
+    teardown_unit_reassembler(&jpeg->reassembler);
+
+    free(jpeg->header);
+    free(jpeg->data);
+    free(jpeg->segments);
+    memset(jpeg, 0x00, sizeof(jpeg_depacketizer));
+}
+
+
+ssize_t jpeg_depacketize(int fd, const uint8_t* payload, size_t size, void* user) {
+    jpeg_depacketizer* jpeg = (jpeg_depacketizer*) user;
+    debug_assert(jpeg && payload);
+
+    ssize_t nbytes = 0;
+    unit_reassembler* r = &jpeg->reassembler;
+
+    if(!unit_reassembler_push(r, payload, size)) {
+        return 0;
+    }
+
+    switch (r->type)
+    {
+    case JPEG_UNIT_HEADER:
+        // Headers of the next image, the previous one is as complete as it gets
+        if(jpeg->header_len > 0 || jpeg->num_segments > 0) {
+            nbytes = write_image(jpeg, fd);
+        }
+        grow_array((void**)&jpeg->header, &jpeg->header_capacity, r->length, sizeof(uint8_t));
+        memcpy(jpeg->header, r->buffer, r->length);
+        jpeg->header_len = r->length;
+        break;
+
+    case JPEG_UNIT_INTERVALS:
+        nbytes = store_intervals(jpeg, r->unit, r->buffer, r->length, fd);
+        break;
+
+    case JPEG_UNIT_RAW:
+        nbytes = write(fd, r->buffer, r->length);
+        debug_assert_continue(nbytes == (ssize_t)r->length, "Partial write: %ld - %s", nbytes, strerror(errno));
+        break;
+
+    default:
+        log_warning("Unknown JPEG unit type: %d", r->type);
+        break;
+    }
+    return nbytes;
+}
+
+
+ssize_t jpeg_depacketizer_flush(int fd, void* user) {
+    jpeg_depacketizer* jpeg = (jpeg_depacketizer*) user;
+    debug_assert(jpeg);
+
+    ssize_t nbytes = 0;
+    if(jpeg->header_len > 0 || jpeg->num_segments > 0) {
+        nbytes = write_image(jpeg, fd);
+    }
+    reset_unit_reassembler(&jpeg->reassembler);
+    return nbytes;
+}
@@ -0,0 +1,263 @@
+/**
+ *  jpeg.h
+ * 
+ *  DESCRIPTION: Restart interval aware JPEG packetizer and depacketizer. The
+ *  packetizer sends the headers of a baseline JPEG as one unit and packs whole
+ *  restart intervals into each frame, so a lost frame only damages the MCU
+ *  strips it carried. The depacketizer rebuilds the image and substitutes a
+ *  neutral (flat gray) strip for every interval that was lost.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Only sequential Huffman coded JPEGs (SOF0/SOF1) with a DRI marker
+ *  and a single scan are split on restart intervals. Anything else is sent as
+ *  plain fragments and written out as received. JPEGs are not re-encoded, use
+ *  an encoder option such as `cjpeg -restart 1` to add restart markers.
+ * 
+ */
+
+#ifndef LIBDXWIFI_JPEG_H
+#define LIBDXWIFI_JPEG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/units.h>
+
+
+/************************
+ *  Constants
+ ***********************/
+
+#define JPEG_BUFFER_SIZE_DFLT   (1024 * 64)
+#define JPEG_FILE_SIZE_MAX      (1024 * 1024 * 32)
+
+#define JPEG_MAX_COMPONENTS     4
+#define JPEG_MAX_HUFFMAN_TABLES 4
+
+#define JPEG_UNIT_HEADER        0   /* SOI through the SOS segment          */
+#define JPEG_UNIT_INTERVALS     1   /* One or more restart intervals        */
+#define JPEG_UNIT_RAW           2   /* Fragment of an unsupported file      */
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct {
+    bool        present;        /* Table was defined?                       */
+    uint8_t     counts[17];     /* Number of codes of each length, 1..16    */
+    uint8_t     symbols[256];   /* Symbols in order of increasing length    */
+} jpeg_huffman_table;
+
+
+typedef struct {
+    uint8_t     id;             /* Component identifier                     */
+    uint8_t     h;              /* Horizontal sampling factor               */
+    uint8_t     v;              /* Vertical sampling factor                 */
+    uint8_t     dc_table;       /* DC Huffman table selector (from SOS)     */
+    uint8_t     ac_table;       /* AC Huffman table selector (from SOS)     */
+} jpeg_component;
+
+
+typedef struct {
+    uint16_t    width;                  /* Image width in pixels            */
+    uint16_t    height;                 /* Image height in pixels           */
+    uint16_t    restart_interval;       /* MCUs per restart interval        */
+    uint8_t     num_components;         /* Components in the frame          */
+    uint8_t     scan_components;        /* Components in the scan           */
+    uint8_t     scan_index[JPEG_MAX_COMPONENTS];    /* Scan to frame index  */
+    jpeg_component components[JPEG_MAX_COMPONENTS];
+    jpeg_huffman_table dc_tables[JPEG_MAX_HUFFMAN_TABLES];
+    jpeg_huffman_table ac_tables[JPEG_MAX_HUFFMAN_TABLES];
+    uint32_t    total_mcus;             /* MCUs in the scan                 */
+    uint32_t    num_intervals;          /* Restart intervals in the scan    */
+    size_t      header_size;            /* Offset of the entropy coded data */
+} jpeg_info;
+
+
+typedef struct {
+    size_t      start;          /* Offset of the interval's first byte      */
+    size_t      end;            /* Offset just past the interval's data     */
+} jpeg_interval;
+
+
+typedef struct {
+    uint32_t    images;         /* Images split on restart intervals        */
+    uint32_t    raw_images;     /* Files sent as plain fragments            */
+    uint32_t    intervals;      /* Restart intervals packetized             */
+    uint32_t    units;          /* Units packetized                         */
+} jpeg_packetizer_stats;
+
+
+typedef struct {
+    uint8_t*    buffer;         /* The entire input file                    */
+    size_t      capacity;       /* Size of the buffer                       */
+    size_t      length;         /* Number of bytes buffered                 */
+    bool        loaded;         /* Entire file read and split?              */
+    bool        aligned;        /* File split on restart intervals?         */
+
+    jpeg_info   info;           /* Parsed headers of an aligned file        */
+    jpeg_interval* intervals;   /* Location of each restart interval        */
+    size_t      intervals_capacity; /* Size of the interval list            */
+
+    bool        in_unit;        /* Current unit selected but not yet sent?  */
+    size_t      unit_start;     /* Offset of the current unit               */
+    size_t      unit_end;       /* Offset just past the current unit        */
+    uint32_t    unit;           /* Index of the current unit                */
+    uint8_t     unit_type;      /* Type of the current unit                 */
+    uint32_t    next_interval;  /* First interval of the next unit          */
+    size_t      next_offset;    /* Offset of the next raw unit              */
+    unsigned    key_repeats;    /* Extra copies of each header fragment     */
+
+    unit_fragmenter fragmenter; /* Splits units into payloads               */
+    jpeg_packetizer_stats stats;
+} jpeg_packetizer;
+
+
+typedef struct {
+    uint32_t    first;          /* Index of the first interval in the unit  */
+    uint32_t    count;          /* Number of intervals in the unit          */
+    size_t      offset;         /* Offset of the unit in the data buffer    */
+    size_t      length;         /* Size of the unit                         */
+} jpeg_segment;
+
+
+typedef struct {
+    uint32_t    images;                 /* Images written                   */
+    uint32_t    intervals_received;     /* Intervals received in full       */
+    uint32_t    intervals_substituted;  /* Intervals replaced by a strip    */
+    uint32_t    headers_lost;           /* Images dropped with no header    */
+} jpeg_depacketizer_stats;
+
+
+typedef struct {
+    unit_reassembler reassembler;   /* Collects the fragments of each unit  */
+
+    uint8_t*    header;             /* Header unit of the current image     */
+    size_t      header_len;         /* Size of the header, 0 if none yet    */
+    size_t      header_capacity;    /* Size of the header buffer            */
+
+    uint8_t*    data;               /* Received interval units              */
+    size_t      data_len;           /* Bytes of interval units received     */
+    size_t      data_capacity;      /* Size of the data buffer              */
+
+    jpeg_segment* segments;         /* Location of each interval unit       */
+    size_t      num_segments;       /* Number of interval units received    */
+    size_t      segments_capacity;  /* Size of the segment list             */
+
+    jpeg_depacketizer_stats stats;
+} jpeg_depacketizer;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Parses the headers of a JPEG up to the start of the scan
+ * 
+ *  ARGUMENTS:
+ * 
+ *      data:       JPEG file data, at least the SOI through SOS segments
+ * 
+ *      size:       Size of the data
+ * 
+ *      info:       Parsed header info
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the JPEG is sequential Huffman coded with restart
+ *                  intervals enabled and can be split on them
+ * 
+ */
+bool jpeg_parse_header(const uint8_t* data, size_t size, jpeg_info* info);
+
+
+/**
+ *  DESCRIPTION:    Initializes the JPEG packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:           Pointer to an allocated packetizer
+ * 
+ *      key_repeats:    Number of extra times to send each fragment of the
+ *                      JPEG headers
+ * 
+ */
+void init_jpeg_packetizer(jpeg_packetizer* jpeg, unsigned key_repeats);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized packetizer
+ * 
+ */
+void teardown_jpeg_packetizer(jpeg_packetizer* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Packetizer read_block callback, see transmitter.h. Reads
+ *                  the entire file then fills each payload with a unit header
+ *                  and the next fragment
+ * 
+ *  NOTES: The packetizer resets itself once the end of input is reached so it
+ *  can be reused for the next transmission.
+ * 
+ */
+ssize_t jpeg_packetize(int fd, uint8_t* payload, size_t blocksize, void* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Packetizer has_pending callback, see transmitter.h.
+ * 
+ */
+bool jpeg_packetizer_pending(void* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Initializes the JPEG depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Pointer to an allocated depacketizer
+ * 
+ */
+void init_jpeg_depacketizer(jpeg_depacketizer* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      jpeg:       Initialized depacketizer
+ * 
+ */
+void teardown_jpeg_depacketizer(jpeg_depacketizer* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer write_block callback, see receiver.h. Buffers
+ *                  the units of an image, writing out the previous image when
+ *                  the headers of the next one arrive
+ * 
+ */
+ssize_t jpeg_depacketize(int fd, const uint8_t* payload, size_t size, void* jpeg);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer flush callback, see receiver.h. Writes out
+ *                  the buffered image and resets for the next capture
+ * 
+ */
+ssize_t jpeg_depacketizer_flush(int fd, void* jpeg);
+
+
+#endif // LIBDXWIFI_JPEG_H
@@ -0,0 +1,205 @@
+/**
+ *  latency.c
+ * 
+ *  DESCRIPTION: See latency.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include <libdxwifi/details/latency.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/metrics.h>
+
+
+/* Samples slot of each stage, the time spent in it is the slot after */
+static const dxwifi_metric_t stage_metrics[DXWIFI_LATENCY_STAGE_COUNT] = {
+    [DXWIFI_LATENCY_TX_WAIT]        = DXWIFI_METRIC_TX_WAIT_SAMPLES,
+    [DXWIFI_LATENCY_TX_READ]        = DXWIFI_METRIC_TX_READ_SAMPLES,
+    [DXWIFI_LATENCY_TX_PREPARE]     = DXWIFI_METRIC_TX_PREPARE_SAMPLES,
+    [DXWIFI_LATENCY_TX_PREINJECT]   = DXWIFI_METRIC_TX_PREINJECT_SAMPLES,
+    [DXWIFI_LATENCY_TX_INJECT]      = DXWIFI_METRIC_TX_INJECT_SAMPLES,
+    [DXWIFI_LATENCY_TX_POSTINJECT]  = DXWIFI_METRIC_TX_POSTINJECT_SAMPLES,
+    [DXWIFI_LATENCY_RX_WAIT]        = DXWIFI_METRIC_RX_WAIT_SAMPLES,
+    [DXWIFI_LATENCY_RX_DISPATCH]    = DXWIFI_METRIC_RX_DISPATCH_SAMPLES,
+    [DXWIFI_LATENCY_RX_COPY]        = DXWIFI_METRIC_RX_COPY_SAMPLES,
+    [DXWIFI_LATENCY_RX_HEAP]        = DXWIFI_METRIC_RX_HEAP_SAMPLES,
+    [DXWIFI_LATENCY_RX_WRITE]       = DXWIFI_METRIC_RX_WRITE_SAMPLES,
+    [DXWIFI_LATENCY_RX_TRANSIT]     = DXWIFI_METRIC_RX_TRANSIT_SAMPLES,
+    [DXWIFI_LATENCY_RX_HOLD]        = DXWIFI_METRIC_RX_HOLD_SAMPLES,
+    [DXWIFI_LATENCY_RX_DELIVERY]    = DXWIFI_METRIC_RX_DELIVERY_SAMPLES,
+};
+
+
+void init_latency(dxwifi_latency* latency, dxwifi_metrics* metrics) {
+    debug_assert(latency);
+
+    memset(latency->stages, 0x00, sizeof(latency->stages));
+    latency->metrics = metrics;
+}
+
+
+/**
+ *  NOTES: Values under DXWIFI_LATENCY_SUB_BUCKETS get a bucket each, above
+ *  that every power of two is split into DXWIFI_LATENCY_SUB_BUCKETS buckets
+ *  by the bits right after the leading one.
+ * 
+ */
+unsigned latency_bucket(uint64_t nanoseconds) {
+    if(nanoseconds < DXWIFI_LATENCY_SUB_BUCKETS) {
+        return nanoseconds;
+    }
+    unsigned msb    = 63 - __builtin_clzll(nanoseconds);
+    unsigned shift  = msb - DXWIFI_LATENCY_SUB_BITS;
+    return (shift + 1) * DXWIFI_LATENCY_SUB_BUCKETS + ((nanoseconds >> shift) & (DXWIFI_LATENCY_SUB_BUCKETS - 1));
+}
+
+
+uint64_t latency_bucket_limit(unsigned bucket) {
+    debug_assert(bucket < DXWIFI_LATENCY_BUCKETS);
+
+    if(bucket < DXWIFI_LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned shift  = bucket / DXWIFI_LATENCY_SUB_BUCKETS - 1;
+    uint64_t lower  = (uint64_t) (DXWIFI_LATENCY_SUB_BUCKETS + bucket % DXWIFI_LATENCY_SUB_BUCKETS) << shift;
+
+    // Wraps around to UINT64_MAX for the last bucket
+    return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+
+void record_latency(dxwifi_latency* latency, dxwifi_latency_stage_t stage, uint64_t start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t end = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+    record_latency_value(latency, stage, end > start ? end - start : 0);
+}
+
+
+void record_latency_value(dxwifi_latency* latency, dxwifi_latency_stage_t stage, uint64_t elapsed) {
+    debug_assert(latency && stage < DXWIFI_LATENCY_STAGE_COUNT);
+
+    dxwifi_latency_histogram* hist = &latency->stages[stage];
+    __atomic_fetch_add(&hist->samples, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->total, elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->buckets[latency_bucket(elapsed)], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while(elapsed > max && !__atomic_compare_exchange_n(&hist->max, &max, elapsed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max was reloaded, try again while this one's still bigger
+    }
+
+    metrics_add(latency->metrics, stage_metrics[stage], 1);
+    metrics_add(latency->metrics, stage_metrics[stage] + 1, elapsed);
+}
+
+
+void latency_histogram(const dxwifi_latency* latency, dxwifi_latency_stage_t stage, dxwifi_latency_histogram* out) {
+    debug_assert(latency && stage < DXWIFI_LATENCY_STAGE_COUNT && out);
+
+    const dxwifi_latency_histogram* hist = &latency->stages[stage];
+    out->samples    = __atomic_load_n(&hist->samples, __ATOMIC_RELAXED);
+    out->total      = __atomic_load_n(&hist->total, __ATOMIC_RELAXED);
+    out->max        = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    for(size_t i = 0; i < DXWIFI_LATENCY_BUCKETS; ++i) {
+        out->buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Largest latency of the bucket holding the sample at
+ *                  @percentile, never more than the longest recorded
+ * 
+ */
+static uint64_t value_at_percentile(const dxwifi_latency_histogram* hist, uint64_t counted, double percentile) {
+    uint64_t rank = (uint64_t) (counted * percentile / 100.0 + 0.5);
+    rank = rank > 0 ? rank : 1;
+
+    uint64_t seen = 0;
+    for(unsigned i = 0; i < DXWIFI_LATENCY_BUCKETS; ++i) {
+        seen += hist->buckets[i];
+        if(seen >= rank) {
+            uint64_t limit = latency_bucket_limit(i);
+            return limit < hist->max ? limit : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+
+bool latency_summary(const dxwifi_latency* latency, dxwifi_latency_stage_t stage, dxwifi_latency_summary* out) {
+    debug_assert(latency && out);
+
+    dxwifi_latency_histogram hist;
+    latency_histogram(latency, stage, &hist);
+
+    // Buckets are read one at a time while frames may still be recorded
+    uint64_t counted = 0;
+    for(size_t i = 0; i < DXWIFI_LATENCY_BUCKETS; ++i) {
+        counted += hist.buckets[i];
+    }
+    if(counted == 0) {
+        return false;
+    }
+
+    out->samples    = hist.samples;
+    out->mean       = hist.total / hist.samples;
+    out->p50        = value_at_percentile(&hist, counted, 50.0);
+    out->p90        = value_at_percentile(&hist, counted, 90.0);
+    out->p99        = value_at_percentile(&hist, counted, 99.0);
+    out->p999       = value_at_percentile(&hist, counted, 99.9);
+    out->max        = hist.max;
+    return true;
+}
+
+
+void log_latency_summary(const dxwifi_latency* latency) {
+    debug_assert(latency);
+
+    dxwifi_latency_summary summary;
+
+    for(size_t i = 0; i < DXWIFI_LATENCY_STAGE_COUNT; ++i) {
+        if(latency_summary(latency, i, &summary)) {
+            log_info("Latency %-14s samples=%-8" PRIu64 " mean=%.3fus p50=%.3fus p90=%.3fus p99=%.3fus p99.9=%.3fus max=%.3fus",
+                latency_stage_to_str(i),
+                summary.samples,
+                summary.mean / 1e3,
+                summary.p50 / 1e3,
+                summary.p90 / 1e3,
+                summary.p99 / 1e3,
+                summary.p999 / 1e3,
+                summary.max / 1e3
+            );
+        }
+    }
+}
+
+
+const char* latency_stage_to_str(dxwifi_latency_stage_t stage) {
+    switch (stage)
+    {
+    case DXWIFI_LATENCY_TX_WAIT:        return "tx.wait";
+    case DXWIFI_LATENCY_TX_READ:        return "tx.read";
+    case DXWIFI_LATENCY_TX_PREPARE:     return "tx.prepare";
+    case DXWIFI_LATENCY_TX_PREINJECT:   return "tx.preinject";
+    case DXWIFI_LATENCY_TX_INJECT:      return "tx.inject";
+    case DXWIFI_LATENCY_TX_POSTINJECT:  return "tx.postinject";
+    case DXWIFI_LATENCY_RX_WAIT:        return "rx.wait";
+    case DXWIFI_LATENCY_RX_DISPATCH:    return "rx.dispatch";
+    case DXWIFI_LATENCY_RX_COPY:        return "rx.copy";
+    case DXWIFI_LATENCY_RX_HEAP:        return "rx.heap";
+    case DXWIFI_LATENCY_RX_WRITE:       return "rx.write";
+    case DXWIFI_LATENCY_RX_TRANSIT:     return "rx.transit";
+    case DXWIFI_LATENCY_RX_HOLD:        return "rx.hold";
+    case DXWIFI_LATENCY_RX_DELIVERY:    return "rx.delivery";
+    default:
+        return "Unknown";
+    }
+}
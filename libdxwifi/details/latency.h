@@ -0,0 +1,197 @@
+/**
+ *  latency.h
+ * 
+ *  DESCRIPTION: Per-stage latency histograms for the tx and rx hot paths.
+ *  Each stage, waiting on input, reading a block, the handlers, injecting,
+ *  dispatching, copying a frame, the packet heap and writing it out, is
+ *  timed with the monotonic clock and recorded into a log bucketed
+ *  histogram, like HdrHistogram, so the percentiles stay within 1/8th of
+ *  the true value from nanoseconds up to minutes in a fixed amount of
+ *  memory. The receiver also records how long frames with a send time took
+ *  to arrive and how long each frame is held in the packet buffer before
+ *  it's written out.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Only transmitters and receivers with histograms attached are
+ *  timed, without them timing a stage is a load and a branch, no clock
+ *  reads. Several can share histograms, recording is an atomic add so block
+ *  workers can time their stages too. When the histograms are set up with
+ *  metrics each stage also adds its samples and the time spent in it to the
+ *  metrics segment, see metrics.h.
+ * 
+ */
+
+#ifndef LIBDXWIFI_LATENCY_H
+#define LIBDXWIFI_LATENCY_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libdxwifi/details/metrics.h>
+
+
+#define DXWIFI_LATENCY_SUB_BITS     3   /* Buckets per power of two, log2   */
+#define DXWIFI_LATENCY_SUB_BUCKETS  (1 << DXWIFI_LATENCY_SUB_BITS)
+#define DXWIFI_LATENCY_BUCKETS      ((64 - DXWIFI_LATENCY_SUB_BITS + 1) * DXWIFI_LATENCY_SUB_BUCKETS)
+
+
+typedef enum {
+    DXWIFI_LATENCY_TX_WAIT,         /* Polling the input                    */
+    DXWIFI_LATENCY_TX_READ,         /* Reading a block from the input       */
+    DXWIFI_LATENCY_TX_PREPARE,      /* Pure preinject handlers, per batch   */
+    DXWIFI_LATENCY_TX_PREINJECT,    /* Preinject handlers, per frame        */
+    DXWIFI_LATENCY_TX_INJECT,       /* pcap_inject()                        */
+    DXWIFI_LATENCY_TX_POSTINJECT,   /* Postinject handlers, per batch       */
+    DXWIFI_LATENCY_RX_WAIT,         /* Polling the capture                  */
+    DXWIFI_LATENCY_RX_DISPATCH,     /* pcap_dispatch(), with every frame    */
+    DXWIFI_LATENCY_RX_COPY,         /* Copying a frame into the buffer      */
+    DXWIFI_LATENCY_RX_HEAP,         /* Pushing or popping the packet heap   */
+    DXWIFI_LATENCY_RX_WRITE,        /* Sink writing out a block or a gap    */
+    DXWIFI_LATENCY_RX_TRANSIT,      /* Sending a frame to capturing it      */
+    DXWIFI_LATENCY_RX_HOLD,         /* Frame waiting in the packet buffer   */
+    DXWIFI_LATENCY_RX_DELIVERY,     /* Sending a frame to writing it out    */
+    DXWIFI_LATENCY_STAGE_COUNT
+} dxwifi_latency_stage_t;
+
+
+typedef struct {
+    uint64_t    samples;        /* Times the stage was timed                */
+    uint64_t    total;          /* Nanoseconds spent in it                  */
+    uint64_t    max;            /* Longest it took, nanoseconds             */
+    uint64_t    buckets[DXWIFI_LATENCY_BUCKETS];
+} dxwifi_latency_histogram;
+
+
+typedef struct {
+    uint64_t    samples;
+    uint64_t    mean;           /* All in nanoseconds                       */
+    uint64_t    p50;
+    uint64_t    p90;
+    uint64_t    p99;
+    uint64_t    p999;
+    uint64_t    max;
+} dxwifi_latency_summary;
+
+
+typedef struct {
+    dxwifi_latency_histogram stages[DXWIFI_LATENCY_STAGE_COUNT];
+    dxwifi_metrics*         metrics;    /* Optional, publishes the stages   */
+} dxwifi_latency;
+
+
+/**
+ *  DESCRIPTION:    Clears the histograms, attach them to a transmitter or
+ *                  receiver to time its stages
+ * 
+ *  ARGUMENTS:
+ * 
+ *      latency:    Histograms to set up
+ * 
+ *      metrics:    Where each stage's samples and time are published, NULL
+ *                  to only record them
+ * 
+ */
+void init_latency(dxwifi_latency* latency, dxwifi_metrics* metrics);
+
+
+/**
+ *  DESCRIPTION:    Time at the start of a stage
+ * 
+ *  ARGUMENTS:
+ * 
+ *      latency:    Histograms or NULL when stages aren't timed
+ * 
+ *  RETURNS:
+ * 
+ *      uint64_t:   Monotonic time in nanoseconds, 0 when timing is off
+ * 
+ */
+static inline uint64_t latency_start(const dxwifi_latency* latency) {
+    if(!latency) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/**
+ *  DESCRIPTION:    Records the time since @start into a stage's histogram
+ * 
+ */
+void record_latency(dxwifi_latency* latency, dxwifi_latency_stage_t stage, uint64_t start);
+
+
+/**
+ *  DESCRIPTION:    Records a latency that wasn't timed with latency_start(),
+ *                  like one measured from timestamps in the frames
+ * 
+ */
+void record_latency_value(dxwifi_latency* latency, dxwifi_latency_stage_t stage, uint64_t nanoseconds);
+
+
+/**
+ *  DESCRIPTION:    Ends the timing of a stage started with latency_start()
+ * 
+ *  ARGUMENTS:
+ * 
+ *      latency:    Histograms latency_start() was called with
+ * 
+ *      stage:      Stage that was timed
+ * 
+ *      start:      What latency_start() returned, nothing is recorded for 0
+ * 
+ */
+static inline void latency_end(dxwifi_latency* latency, dxwifi_latency_stage_t stage, uint64_t start) {
+    if(start) {
+        record_latency(latency, stage, start);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Index of the bucket a latency is counted in
+ * 
+ */
+unsigned latency_bucket(uint64_t nanoseconds);
+
+
+/**
+ *  DESCRIPTION:    Largest latency counted in a bucket
+ * 
+ */
+uint64_t latency_bucket_limit(unsigned bucket);
+
+
+/**
+ *  DESCRIPTION:    Copies a stage's histogram out
+ * 
+ */
+void latency_histogram(const dxwifi_latency* latency, dxwifi_latency_stage_t stage, dxwifi_latency_histogram* out);
+
+
+/**
+ *  DESCRIPTION:    Summarizes what was recorded for a stage
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if nothing was recorded for it
+ * 
+ */
+bool latency_summary(const dxwifi_latency* latency, dxwifi_latency_stage_t stage, dxwifi_latency_summary* out);
+
+
+/**
+ *  DESCRIPTION:    Logs the summary of every stage that was timed
+ * 
+ */
+void log_latency_summary(const dxwifi_latency* latency);
+
+
+const char* latency_stage_to_str(dxwifi_latency_stage_t stage);
+
+
+#endif // LIBDXWIFI_LATENCY_H
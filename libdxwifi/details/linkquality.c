@@ -0,0 +1,275 @@
+/**
+ *  linkquality.c
+ * 
+ *  DESCRIPTION: See linkquality.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <libdxwifi/details/linkquality.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define SMOOTHING 16    /* Weight of the past in the smoothed times, like RFC 3550's jitter */
+
+
+static bool window_test(const dxwifi_link_quality* link, int64_t frame_number) {
+    size_t slot = frame_number % DXWIFI_LINK_WINDOW;
+    return (link->__window[slot / 64] >> (slot % 64)) & 1;
+}
+
+
+static void window_set(dxwifi_link_quality* link, int64_t frame_number) {
+    size_t slot = frame_number % DXWIFI_LINK_WINDOW;
+    link->__window[slot / 64] |= (uint64_t) 1 << (slot % 64);
+    ++link->__in_window;
+}
+
+
+static void window_clear(dxwifi_link_quality* link, int64_t frame_number) {
+    size_t slot = frame_number % DXWIFI_LINK_WINDOW;
+    link->__window[slot / 64] &= ~((uint64_t) 1 << (slot % 64));
+    --link->__in_window;
+}
+
+
+/**
+ *  DESCRIPTION:    Ends the current run of lost frames, if any
+ * 
+ */
+static void end_run(dxwifi_link_quality* link) {
+    if(link->__run == 0) {
+        return;
+    }
+    unsigned bucket = 63 - __builtin_clzll(link->__run);
+    bucket = bucket < DXWIFI_LINK_BURST_BUCKETS ? bucket : DXWIFI_LINK_BURST_BUCKETS - 1;
+
+    link->stats.burst_lengths[bucket] += 1;
+    link->stats.bursts += 1;
+    link->stats.burst_max = link->__run > link->stats.burst_max ? link->__run : link->stats.burst_max;
+    link->__run = 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Settles a frame number as the window moves past it, it was
+ *                  either captured or lost for good
+ * 
+ */
+static void retire(dxwifi_link_quality* link, int64_t frame_number) {
+    if(frame_number < link->__lowest) {
+        return; // Went by before anything was captured
+    }
+    if(window_test(link, frame_number)) {
+        window_clear(link, frame_number);
+        end_run(link);
+    }
+    else {
+        link->stats.lost    += 1;
+        link->__run         += 1;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Moves the window up until @frame_number is the highest
+ * 
+ *  NOTES: Every frame number is retired once, so the cost is O(1) per frame
+ *  number amortized. A jump past the whole window retires it and counts the
+ *  frames in between as lost in one go.
+ * 
+ */
+static void advance(dxwifi_link_quality* link, int64_t frame_number) {
+    int64_t next = link->__highest + 1;
+
+    if(frame_number - next >= DXWIFI_LINK_WINDOW) {
+        for(int64_t n = link->__highest - DXWIFI_LINK_WINDOW + 1; n <= link->__highest; ++n) {
+            retire(link, n);
+        }
+        uint64_t skipped = frame_number - next + 1 - DXWIFI_LINK_WINDOW;
+        link->stats.lost    += skipped;
+        link->__run         += skipped;
+    }
+    else {
+        for(int64_t n = next; n <= frame_number; ++n) {
+            retire(link, n - DXWIFI_LINK_WINDOW);
+        }
+    }
+    link->__highest = frame_number;
+}
+
+
+static void track_first(dxwifi_link_quality* link, int64_t frame_number) {
+    link->__highest = frame_number;
+    link->__lowest  = frame_number;
+    window_set(link, frame_number);
+}
+
+
+void init_link_quality(dxwifi_link_quality* link) {
+    debug_assert(link);
+
+    memset(link, 0x00, sizeof(dxwifi_link_quality));
+    link->__highest = -1;
+}
+
+
+void link_quality_update(dxwifi_link_quality* link, int64_t frame_number, uint64_t arrival, size_t payload_size) {
+    debug_assert(link);
+
+    dxwifi_link_stats* stats = &link->stats;
+
+    stats->frames += 1;
+    if(stats->frames == 1) {
+        link->__first_arrival = arrival;
+    }
+    else {
+        double gap = arrival > link->__last_arrival ? arrival - link->__last_arrival : 0;
+        if(stats->frames == 2) {
+            stats->interarrival = gap;
+        }
+        double deviation = gap > stats->interarrival ? gap - stats->interarrival : stats->interarrival - gap;
+        stats->interarrival += (gap - stats->interarrival) / SMOOTHING;
+        stats->jitter       += (deviation - stats->jitter) / SMOOTHING;
+    }
+    link->__last_arrival    = arrival > link->__last_arrival ? arrival : link->__last_arrival;
+    stats->duration         = link->__last_arrival - link->__first_arrival;
+
+    bool unique = true;
+    if(frame_number < 0) {
+        // Nothing to tell lost frames or copies by
+    }
+    else if(link->__highest < 0) {
+        track_first(link, frame_number);
+    }
+    else if(frame_number > link->__highest) {
+        advance(link, frame_number);
+        window_set(link, frame_number);
+    }
+    else if(frame_number + DXWIFI_LINK_WINDOW <= link->__highest) {
+        // Too far back to be out of order, the frame numbers started over
+        link_quality_flush(link);
+        track_first(link, frame_number);
+    }
+    else if(window_test(link, frame_number)) {
+        stats->duplicates += 1;
+        unique = false;
+    }
+    else {
+        window_set(link, frame_number);
+        link->__lowest = frame_number < link->__lowest ? frame_number : link->__lowest;
+    }
+
+    if(unique) {
+        stats->unique           += 1;
+        stats->goodput_bytes    += payload_size;
+    }
+    if(link->__highest >= 0) {
+        int64_t span = link->__highest - link->__lowest + 1;
+        span = span < DXWIFI_LINK_WINDOW ? span : DXWIFI_LINK_WINDOW;
+        stats->window_loss = 1.0 - (double) link->__in_window / span;
+    }
+}
+
+
+void link_quality_flush(dxwifi_link_quality* link) {
+    debug_assert(link);
+
+    if(link->__highest < 0) {
+        return;
+    }
+    int64_t first = link->__highest - DXWIFI_LINK_WINDOW + 1;
+    for(int64_t n = (first > link->__lowest ? first : link->__lowest); n <= link->__highest; ++n) {
+        retire(link, n);
+    }
+    end_run(link);
+
+    link->__highest = -1;
+    link->__lowest  = 0;
+}
+
+
+void merge_link_stats(dxwifi_link_stats* dst, const dxwifi_link_stats* src) {
+    debug_assert(dst && src);
+
+    uint64_t frames = dst->frames + src->frames;
+    if(frames > 0) {
+        dst->interarrival   = (dst->interarrival * dst->frames + src->interarrival * src->frames) / frames;
+        dst->jitter         = (dst->jitter * dst->frames + src->jitter * src->frames) / frames;
+    }
+    if(src->frames > 0) {
+        dst->window_loss = src->window_loss;
+    }
+    for(size_t i = 0; i < DXWIFI_LINK_BURST_BUCKETS; ++i) {
+        dst->burst_lengths[i] += src->burst_lengths[i];
+    }
+    dst->frames         = frames;
+    dst->unique         += src->unique;
+    dst->duplicates     += src->duplicates;
+    dst->lost           += src->lost;
+    dst->bursts         += src->bursts;
+    dst->burst_max      = src->burst_max > dst->burst_max ? src->burst_max : dst->burst_max;
+    dst->goodput_bytes  += src->goodput_bytes;
+    dst->duration       += src->duration;
+}
+
+
+double link_loss_rate(const dxwifi_link_stats* stats) {
+    uint64_t sent = stats->unique + stats->lost;
+    return sent > 0 ? (double) stats->lost / sent : 0.0;
+}
+
+
+double link_duplicate_rate(const dxwifi_link_stats* stats) {
+    return stats->frames > 0 ? (double) stats->duplicates / stats->frames : 0.0;
+}
+
+
+double link_goodput(const dxwifi_link_stats* stats) {
+    return stats->duration > 0 ? stats->goodput_bytes * 1e6 / stats->duration : 0.0;
+}
+
+
+bool write_link_summary(const dxwifi_link_stats* stats, const char* path) {
+    debug_assert(stats && path);
+
+    FILE* out = fopen(path, "w");
+    if(!out) {
+        log_error("Failed to open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(out, "frames %" PRIu64 "\n",            stats->frames);
+    fprintf(out, "unique %" PRIu64 "\n",            stats->unique);
+    fprintf(out, "duplicates %" PRIu64 "\n",        stats->duplicates);
+    fprintf(out, "lost %" PRIu64 "\n",              stats->lost);
+    fprintf(out, "loss_rate %.6f\n",                link_loss_rate(stats));
+    fprintf(out, "window_loss_rate %.6f\n",         stats->window_loss);
+    fprintf(out, "duplicate_rate %.6f\n",           link_duplicate_rate(stats));
+    fprintf(out, "bursts %" PRIu64 "\n",            stats->bursts);
+    fprintf(out, "burst_max %" PRIu64 "\n",         stats->burst_max);
+    fprintf(out, "burst_mean %.3f\n",               stats->bursts > 0 ? (double) stats->lost / stats->bursts : 0.0);
+    for(size_t i = 0; i < DXWIFI_LINK_BURST_BUCKETS - 1; ++i) {
+        fprintf(out, "bursts_%" PRIu64 "-%" PRIu64 " %" PRIu64 "\n", (uint64_t) 1 << i, ((uint64_t) 2 << i) - 1, stats->burst_lengths[i]);
+    }
+    fprintf(out, "bursts_%" PRIu64 "+ %" PRIu64 "\n", (uint64_t) 1 << (DXWIFI_LINK_BURST_BUCKETS - 1), stats->burst_lengths[DXWIFI_LINK_BURST_BUCKETS - 1]);
+    fprintf(out, "goodput_bytes %" PRIu64 "\n",     stats->goodput_bytes);
+    fprintf(out, "goodput_bytes_per_sec %.0f\n",     link_goodput(stats));
+    fprintf(out, "duration_us %" PRIu64 "\n",       stats->duration);
+    fprintf(out, "interarrival_us %.3f\n",          stats->interarrival);
+    fprintf(out, "jitter_us %.3f\n",                stats->jitter);
+
+    bool written = !ferror(out);
+    if(fclose(out) != 0 || !written) {
+        log_error("Failed to write %s", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,135 @@
+/**
+ *  linkquality.h
+ * 
+ *  DESCRIPTION: Streaming estimate of the quality of the link a receiver is
+ *  capturing from. Keeps the loss rate over a sliding window of frame
+ *  numbers, the lengths of runs of lost frames, the jitter in the time
+ *  between frames, the duplicate rate and the goodput. Memory is constant
+ *  and each frame is O(1) to account for, amortized, so it's updated for
+ *  every frame captured.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: A frame is only counted lost once the window moves past it, so
+ *  frames that arrive out of order within the window aren't. Loss, bursts
+ *  and duplicates need frame numbers, the transmission has to be ordered.
+ *  Times are pcap's capture timestamps, which test builds reading a
+ *  savefile take from when tx dumped the frames.
+ * 
+ */
+
+#ifndef LIBDXWIFI_LINKQUALITY_H
+#define LIBDXWIFI_LINKQUALITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define DXWIFI_LINK_WINDOW          1024    /* Frames the loss rate is over, a multiple of 64   */
+#define DXWIFI_LINK_BURST_BUCKETS   16      /* Burst lengths of 2^i up to 2^(i+1) - 1 frames    */
+
+
+typedef struct {
+    uint64_t    frames;             /* Data frames captured, copies included    */
+    uint64_t    unique;             /* Frames captured at least once            */
+    uint64_t    duplicates;         /* Copies of frames already captured        */
+    uint64_t    lost;               /* Frames the window moved past uncaptured  */
+    uint64_t    bursts;             /* Runs of consecutive lost frames          */
+    uint64_t    burst_max;          /* Longest run                              */
+    uint64_t    burst_lengths[DXWIFI_LINK_BURST_BUCKETS];
+    uint64_t    goodput_bytes;      /* Payload bytes of the unique frames       */
+    uint64_t    duration;           /* First to last frame, microseconds        */
+    double      interarrival;       /* Smoothed time between frames, us         */
+    double      jitter;             /* Smoothed deviation from it, us           */
+    double      window_loss;        /* Loss rate over the latest window         */
+} dxwifi_link_stats;
+
+
+typedef struct {
+    dxwifi_link_stats   stats;
+
+    uint64_t    __window[DXWIFI_LINK_WINDOW / 64];  /* Frames captured, by number   */
+    int64_t     __highest;          /* Highest frame number, -1 before the first    */
+    int64_t     __lowest;           /* Lowest frame number since the last flush     */
+    uint32_t    __in_window;        /* Bits set in the window                       */
+    uint64_t    __run;              /* Frames lost in the current run               */
+    uint64_t    __first_arrival;    /* Capture times, microseconds                  */
+    uint64_t    __last_arrival;
+} dxwifi_link_quality;
+
+
+/**
+ *  DESCRIPTION:    Starts an estimate with nothing captured
+ * 
+ */
+void init_link_quality(dxwifi_link_quality* link);
+
+
+/**
+ *  DESCRIPTION:    Accounts for a captured data frame
+ * 
+ *  ARGUMENTS:
+ * 
+ *      link:           Estimate to update
+ * 
+ *      frame_number:   Number the frame was sent with, negative if unknown
+ * 
+ *      arrival:        Capture time in microseconds
+ * 
+ *      payload_size:   Bytes of payload in the frame
+ * 
+ */
+void link_quality_update(dxwifi_link_quality* link, int64_t frame_number, uint64_t arrival, size_t payload_size);
+
+
+/**
+ *  DESCRIPTION:    Settles every frame still in the window, for when the
+ *                  frame numbers start over with a new transmission or the
+ *                  capture ends. The totals are kept.
+ * 
+ */
+void link_quality_flush(dxwifi_link_quality* link);
+
+
+/**
+ *  DESCRIPTION:    Adds the counts of @src into @dst, the smoothed times are
+ *                  weighted by the frames behind them
+ * 
+ */
+void merge_link_stats(dxwifi_link_stats* dst, const dxwifi_link_stats* src);
+
+
+/**
+ *  DESCRIPTION:    Frames lost out of every frame sent
+ * 
+ */
+double link_loss_rate(const dxwifi_link_stats* stats);
+
+
+/**
+ *  DESCRIPTION:    Copies out of every frame captured
+ * 
+ */
+double link_duplicate_rate(const dxwifi_link_stats* stats);
+
+
+/**
+ *  DESCRIPTION:    Payload bytes of the unique frames per second
+ * 
+ */
+double link_goodput(const dxwifi_link_stats* stats);
+
+
+/**
+ *  DESCRIPTION:    Writes the stats out as `name value` lines
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the file couldn't be written
+ * 
+ */
+bool write_link_summary(const dxwifi_link_stats* stats, const char* path);
+
+
+#endif // LIBDXWIFI_LINKQUALITY_H
@@ -11,29 +11,34 @@
 #include <stdarg.h>
 #include <string.h>
 
+#include <time.h>
+
 #include <libdxwifi/details/utils.h>
 #include <libdxwifi/details/assert.h>
 #include <libdxwifi/details/logging.h>
 
 
-typedef struct {
-    dxwifi_logger       logger;
-    dxwifi_log_level_t  log_level;
-} dxwifi_log_handler;
+dxwifi_log_context __default_log_context = {
+    .handlers = {
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
+        { default_logger, DXWIFI_LOG_FATAL, 1, 0 },
 
+        // New modules should follow the same format
 
-static dxwifi_log_handler handlers[] = {
-    { default_logger, DXWIFI_LOG_FATAL },
-    { default_logger, DXWIFI_LOG_FATAL },
-    { default_logger, DXWIFI_LOG_FATAL },
-    { default_logger, DXWIFI_LOG_FATAL },
-    { default_logger, DXWIFI_LOG_FATAL },
-    { default_logger, DXWIFI_LOG_FATAL },
+    },
+    .suppressed = { 0 },
+    .name = NULL,
+    .user = NULL
+};
+compiler_assert(NELEMS(__default_log_context.handlers) == DXWIFI_LOG_MODULE_COUNT, "Handler count must match module count");
 
-    // New modules should follow the same format
 
-};
-compiler_assert(NELEMS(handlers) == DXWIFI_LOG_MODULE_COUNT, "Handler count must match module count");
+// Context bound to each thread, NULL falls back to the default context
+__thread dxwifi_log_context* __bound_log_context = NULL;
 
 
 // table entry must match the name of the file and index of the enumeration
@@ -52,9 +57,15 @@ static const char* file_lookup_tbl[DXWIFI_LOG_MODULE_COUNT] = {
 
 void default_logger(dxwifi_log_module_t module, dxwifi_log_level_t log_level, const char* fmt, va_list args) {
     // For now just dump everything to stdout
-    fprintf(stderr, "[ %s ][ %s ] : ", log_level_to_str(log_level), log_module_to_str(module));
+    const char* name = current_log_context()->name;
+    if(name) {
+        fprintf(stderr, "[ %s ][ %s ][ %s ] : ", log_level_to_str(log_level), log_module_to_str(module), name);
+    }
+    else {
+        fprintf(stderr, "[ %s ][ %s ] : ", log_level_to_str(log_level), log_module_to_str(module));
+    }
     vfprintf(stderr, fmt, args);
-    printf("\n");
+    fputc('\n', stderr);
     fflush(stderr);
 }
 
@@ -90,6 +101,8 @@ const char* log_module_to_str(dxwifi_log_module_t module) {
 
 dxwifi_log_module_t file_to_log_module(const char* file_name) {
 
+    dxwifi_log_module_t found = DXWIFI_LOG_GENERIC;
+
     char* path  = strdup(file_name);
     char* bname = basename(path);
 
@@ -97,51 +110,149 @@ dxwifi_log_module_t file_to_log_module(const char* file_name) {
         char* extension = index(bname, '.'); // Drop the file extension
         for(dxwifi_log_module_t module = DXWIFI_LOG_GENERIC; module < DXWIFI_LOG_MODULE_COUNT; ++module) {
             if(strncmp(bname, file_lookup_tbl[module], extension - bname) == 0) {
-                return module;
+                found = module;
+                break;
             }
         }
     }
     free(path);
-    return DXWIFI_LOG_GENERIC;
+    return found;
 }
 
 
-bool set_logger(dxwifi_log_module_t module, dxwifi_logger logger) {
+void init_log_context(dxwifi_log_context* ctx, const char* name, void* user) {
+    debug_assert(ctx);
+
+    memcpy(ctx->handlers, __default_log_context.handlers, sizeof(ctx->handlers));
+    memset(ctx->suppressed, 0x00, sizeof(ctx->suppressed));
+    ctx->name = name;
+    ctx->user = user;
+}
+
+
+bool set_context_logger(dxwifi_log_context* ctx, dxwifi_log_module_t module, dxwifi_logger logger) {
+    debug_assert(ctx);
+
     bool success = false;
     if(module == DXWIFI_LOG_ALL_MODULES) {
         for(size_t i = 0; i < DXWIFI_LOG_MODULE_COUNT; ++i) {
-            handlers[i].logger = logger;
+            ctx->handlers[i].logger = logger;
         }
         success = true;
     }
     else if(module < DXWIFI_LOG_MODULE_COUNT) {
-        handlers[module].logger = logger;
+        ctx->handlers[module].logger = logger;
         success = true;
     }
     return success;
 }
 
 
-bool set_log_level(dxwifi_log_module_t module, dxwifi_log_level_t level) {
+bool set_context_log_level(dxwifi_log_context* ctx, dxwifi_log_module_t module, dxwifi_log_level_t level) {
+    debug_assert(ctx);
+
+    bool success = false;
+    if(module == DXWIFI_LOG_ALL_MODULES) {
+        for(size_t i = 0; i < DXWIFI_LOG_MODULE_COUNT; ++i) {
+            ctx->handlers[i].log_level = level;
+        }
+        success = true;
+    }
+    else if(module < DXWIFI_LOG_MODULE_COUNT) {
+        ctx->handlers[module].log_level = level;
+        success = true;
+    }
+    return success;
+}
+
+
+bool set_context_log_sampling(dxwifi_log_context* ctx, dxwifi_log_module_t module, unsigned every) {
+    debug_assert(ctx);
+
+    bool success = false;
+    if(module == DXWIFI_LOG_ALL_MODULES) {
+        for(size_t i = 0; i < DXWIFI_LOG_MODULE_COUNT; ++i) {
+            ctx->handlers[i].sample_every = every;
+        }
+        success = true;
+    }
+    else if(module < DXWIFI_LOG_MODULE_COUNT) {
+        ctx->handlers[module].sample_every = every;
+        success = true;
+    }
+    return success;
+}
+
+
+bool set_context_log_rate_limit(dxwifi_log_context* ctx, dxwifi_log_module_t module, unsigned per_second) {
+    debug_assert(ctx);
+
     bool success = false;
     if(module == DXWIFI_LOG_ALL_MODULES) {
         for(size_t i = 0; i < DXWIFI_LOG_MODULE_COUNT; ++i) {
-            handlers[i].log_level = level;
+            ctx->handlers[i].rate_limit = per_second;
         }
         success = true;
     }
     else if(module < DXWIFI_LOG_MODULE_COUNT) {
-        handlers[module].log_level = level;
+        ctx->handlers[module].rate_limit = per_second;
         success = true;
     }
     return success;
 }
 
 
-void __log(dxwifi_log_level_t log_level, const char* file, const char* fmt, ...) {
+bool set_logger(dxwifi_log_module_t module, dxwifi_logger logger) {
+    return set_context_logger(&__default_log_context, module, logger);
+}
+
+
+bool set_log_level(dxwifi_log_module_t module, dxwifi_log_level_t level) {
+    return set_context_log_level(&__default_log_context, module, level);
+}
+
+
+bool set_log_sampling(dxwifi_log_module_t module, unsigned every) {
+    return set_context_log_sampling(&__default_log_context, module, every);
+}
+
+
+bool set_log_rate_limit(dxwifi_log_module_t module, unsigned per_second) {
+    return set_context_log_rate_limit(&__default_log_context, module, per_second);
+}
+
+
+uint64_t get_log_suppressed(dxwifi_log_module_t module) {
+    const dxwifi_log_context* ctx = current_log_context();
+
+    uint64_t suppressed = 0;
+    if(module == DXWIFI_LOG_ALL_MODULES) {
+        for(size_t i = 0; i < DXWIFI_LOG_MODULE_COUNT; ++i) {
+            suppressed += __atomic_load_n(&ctx->suppressed[i], __ATOMIC_RELAXED);
+        }
+    }
+    else if(module < DXWIFI_LOG_MODULE_COUNT) {
+        suppressed = __atomic_load_n(&ctx->suppressed[module], __ATOMIC_RELAXED);
+    }
+    return suppressed;
+}
+
+
+dxwifi_log_context* bind_log_context(dxwifi_log_context* ctx) {
+    dxwifi_log_context* prev = __bound_log_context;
+    __bound_log_context = ctx;
+    return prev;
+}
+
+
+dxwifi_log_context* current_log_context(void) {
+    return __bound_log_context ? __bound_log_context : &__default_log_context;
+}
+
+
+void __log(dxwifi_log_level_t log_level, dxwifi_log_module_t module, const char* fmt, ...) {
 
-    dxwifi_log_module_t module  = file_to_log_module(file);
-    dxwifi_log_handler  handler = handlers[module];
+    dxwifi_log_handler  handler = current_log_context()->handlers[module];
 
     if( handler.logger && log_level <= handler.log_level) {
         va_list args;
@@ -152,7 +263,7 @@ void __log(dxwifi_log_level_t log_level, const char* file, const char* fmt, ...)
 }
 
 
-void __log_hexdump(const char* file, const uint8_t* data, int size) {
+void __log_hexdump(dxwifi_log_module_t module, const uint8_t* data, int size) {
 
     int i           = 0;
     int nbytes      = 0;
@@ -183,5 +294,34 @@ void __log_hexdump(const char* file, const uint8_t* data, int size) {
     }
     formatted_str[location] = '\0';
 
-    __log(DXWIFI_LOG_TRACE, file, "%s", formatted_str);
+    __log(DXWIFI_LOG_TRACE, module, "%s", formatted_str);
+}
+
+
+// Statements can be reached from several threads at once, the counts are 
+// updated atomically but the limits are best effort
+bool __log_site_allowed(dxwifi_log_site* site, dxwifi_log_module_t module) {
+    dxwifi_log_context* ctx = current_log_context();
+    const dxwifi_log_handler* handler = &ctx->handlers[module];
+
+    bool allowed = true;
+    if(handler->sample_every > 1) {
+        uint64_t seen = __atomic_fetch_add(&site->seen, 1, __ATOMIC_RELAXED);
+        allowed = (seen % handler->sample_every) == 0;
+    }
+    if(allowed && handler->rate_limit > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+        uint64_t second = (uint64_t) now.tv_sec + 1; // Never matches a fresh site
+        if(__atomic_load_n(&site->window, __ATOMIC_RELAXED) != second) {
+            __atomic_store_n(&site->window, second, __ATOMIC_RELAXED);
+            __atomic_store_n(&site->let_through, 0, __ATOMIC_RELAXED);
+        }
+        allowed = __atomic_fetch_add(&site->let_through, 1, __ATOMIC_RELAXED) < handler->rate_limit;
+    }
+    if(!allowed) {
+        __atomic_fetch_add(&ctx->suppressed[module], 1, __ATOMIC_RELAXED);
+    }
+    return allowed;
 }
@@ -4,12 +4,20 @@
  *  DESCRIPTION: DxWiFi Logging API Facade
  * 
  *  This logging facade supports formatted strings as well as user, module, and 
- *  compiler log levels. Logging under the compiler log level gets culled out 
- *  and won't be present in release builds. By default, logging is set to fatal 
+ *  compiler log levels. Logging under the compiler log level gets culled out,
+ *  release builds keep debug logging but not trace logging. Disabled debug
+ *  statements cost an inline level check. By default, logging is set to fatal 
  *  messages and the default logger just pipes everything to stderr. To use a 
  *  different logging library simply create a function that fulfills the 
  *  dxwifi_logger interface and call the set_logger method
  * 
+ *  Loggers and levels live in a log context. set_logger and set_log_level 
+ *  configure the process wide default context. Programs running more than one
+ *  transmitter or receiver can give each instance its own context, the 
+ *  library binds it to the calling thread for the duration of each call so 
+ *  every log statement made on behalf of that instance goes through it. 
+ *  Contexts are read without locks, configure them before they're in use.
+ * 
  *  https://github.com/oresat/oresat-dxwifi-software
  * 
  */
@@ -33,7 +41,8 @@ typedef enum {
     DXWIFI_LOG_TRACE    = 6
 } dxwifi_log_level_t;
 
-// If you want module specific logging add it here and update the file_lookup_tbl
+// If you want module specific logging add it here, update the file_lookup_tbl
+// and define DXWIFI_LOG_MODULE at the top of the module's source files.
 // Otherwise log statements  will get grouped into the generic sink. 
 typedef enum {
     DXWIFI_LOG_GENERIC      = 0,
@@ -53,6 +62,33 @@ typedef enum {
 typedef void(*dxwifi_logger)(dxwifi_log_module_t, dxwifi_log_level_t, const char* fmt, va_list args);
 
 
+typedef struct {
+    dxwifi_logger       logger;
+    dxwifi_log_level_t  log_level;
+    unsigned            sample_every;   /* Diagnostics let through 1 in N   */
+    unsigned            rate_limit;     /* Diagnostics per second per site  */
+} dxwifi_log_handler;
+
+
+typedef struct {
+    dxwifi_log_handler  handlers[DXWIFI_LOG_MODULE_COUNT];
+                                    /* Logger and level for each module     */
+    uint64_t            suppressed[DXWIFI_LOG_MODULE_COUNT];
+                                    /* Diagnostics held back by the limits  */
+    const char*         name;       /* Optional, tags messages of instance  */
+    void*               user;       /* Optional, for custom loggers         */
+} dxwifi_log_context;
+
+
+// State of a single debug or trace log statement, see set_log_sampling. There
+// is one per statement, shared by every log context that reaches it
+typedef struct {
+    uint64_t            seen;       /* Messages that reached the statement  */
+    uint64_t            window;     /* Second the rate window started       */
+    uint32_t            let_through;/* Messages logged in the window        */
+} dxwifi_log_site;
+
+
 /**
  *  DESCRIPTION:    Default logger simply dumps everything to stdout. By default all logging modules are
  *                  configured to use the default_logger
@@ -150,43 +186,233 @@ bool set_logger(dxwifi_log_module_t module, dxwifi_logger logger);
 bool set_log_level(dxwifi_log_module_t module, dxwifi_log_level_t level);
 
 
+/**
+ *  DESCRIPTION:  Logs only 1 in N of the debug and trace messages of a 
+ *                module at each log statement. Meant for per-frame 
+ *                diagnostics that would otherwise flood the log, messages
+ *                at info and above always go out.
+ * 
+ *  ARGUMENTS:
+ *  
+ *      module:   Logging module 
+ * 
+ *      every:    Let 1 in this many messages through, 0 or 1 for all
+ * 
+ *  RETURNS:       
+ *      
+ *      bool:     true if sampling was set successfully
+ * 
+ *  NOTES:        The count of messages seen is kept per statement for the
+ *                whole process. Contexts only set N, instances logging 
+ *                from the same statement share one count.
+ * 
+ */
+bool set_log_sampling(dxwifi_log_module_t module, unsigned every);
+
+
+/**
+ *  DESCRIPTION:  Caps how many debug and trace messages per second each log
+ *                statement of a module writes. Applies after sampling.
+ * 
+ *  ARGUMENTS:
+ *  
+ *      module:   Logging module 
+ * 
+ *      per_second: Most messages per second per statement, 0 for no limit
+ * 
+ *  RETURNS:       
+ *      
+ *      bool:     true if the limit was set successfully
+ * 
+ *  NOTES:        Like sampling the budget is kept per statement for the 
+ *                whole process, instances logging from the same statement
+ *                share it.
+ * 
+ */
+bool set_log_rate_limit(dxwifi_log_module_t module, unsigned per_second);
+
+
+/**
+ *  DESCRIPTION:  Number of debug and trace messages held back by sampling or
+ *                rate limits in the context bound to the calling thread
+ * 
+ *  ARGUMENTS:
+ *  
+ *      module:   Logging module or DXWIFI_LOG_ALL_MODULES for the total
+ * 
+ */
+uint64_t get_log_suppressed(dxwifi_log_module_t module);
+
+
+/**
+ *  DESCRIPTION:    Initializes a log context with a copy of the default 
+ *                  context's loggers and levels
+ * 
+ *  ARGUMENTS:
+ *  
+ *      ctx:        Context to initialize
+ * 
+ *      name:       Optional, name of the instance the context belongs to
+ * 
+ *      user:       Optional, user data for custom loggers
+ * 
+ */
+void init_log_context(dxwifi_log_context* ctx, const char* name, void* user);
+
+
+/**
+ *  DESCRIPTION:  Sets the logger for the specified module of a log context,
+ *                see set_logger
+ * 
+ */
+bool set_context_logger(dxwifi_log_context* ctx, dxwifi_log_module_t module, dxwifi_logger logger);
+
+
+/**
+ *  DESCRIPTION:  Sets the logging level for the specified module of a log 
+ *                context, see set_log_level
+ * 
+ */
+bool set_context_log_level(dxwifi_log_context* ctx, dxwifi_log_module_t module, dxwifi_log_level_t level);
+
+
+/**
+ *  DESCRIPTION:  Sets sampling for the specified module of a log context, 
+ *                see set_log_sampling. The count it applies to is still 
+ *                shared with other contexts.
+ * 
+ */
+bool set_context_log_sampling(dxwifi_log_context* ctx, dxwifi_log_module_t module, unsigned every);
+
+
+/**
+ *  DESCRIPTION:  Sets the rate limit for the specified module of a log 
+ *                context, see set_log_rate_limit. The budget it applies to
+ *                is still shared with other contexts.
+ * 
+ */
+bool set_context_log_rate_limit(dxwifi_log_context* ctx, dxwifi_log_module_t module, unsigned per_second);
+
+
+/**
+ *  DESCRIPTION:    Binds a log context to the calling thread, all logging 
+ *                  on the thread goes through it until another one is bound
+ * 
+ *  ARGUMENTS:
+ *  
+ *      ctx:        Context to bind, NULL for the default context
+ * 
+ *  RETURNS:       
+ *      
+ *      dxwifi_log_context*: The previously bound context, pass it back in to
+ *                           restore it
+ * 
+ */
+dxwifi_log_context* bind_log_context(dxwifi_log_context* ctx);
+
+
+/**
+ *  DESCRIPTION:    Context logging on the calling thread goes through. Lets 
+ *                  custom loggers get at the name and user data of the 
+ *                  instance they're logging for.
+ * 
+ *  RETURNS:       
+ *      
+ *      dxwifi_log_context*: Bound context or the default context, never NULL
+ * 
+ */
+dxwifi_log_context* current_log_context(void);
+
+
 #if defined(LIBDXWIFI_DISABLE_LOGGING)
     #define DXWIFI_LOG_LEVEL 0
 #elif defined(NDEBUG)
-    #define DXWIFI_LOG_LEVEL 4
+    #define DXWIFI_LOG_LEVEL 5
 #else 
     #define DXWIFI_LOG_LEVEL 6
 #endif
 
 
+// Module every log statement in a source file belongs to. Define it at the top
+// of the file, before any includes, to log under a specific module.
+#ifndef DXWIFI_LOG_MODULE
+  #define DXWIFI_LOG_MODULE DXWIFI_LOG_GENERIC
+#endif
+
+
+// Storage behind current_log_context(), exposed for the inline level check
+extern dxwifi_log_context __default_log_context;
+extern __thread dxwifi_log_context* __bound_log_context;
+
+
+/**
+ *  DESCRIPTION:    Checks the level of a module in the context bound to the 
+ *                  calling thread, see log_level_enabled
+ * 
+ */
+static inline bool __log_enabled(dxwifi_log_module_t module, dxwifi_log_level_t log_level) {
+    const dxwifi_log_context* ctx = __bound_log_context ? __bound_log_context : &__default_log_context;
+    return log_level <= ctx->handlers[module].log_level;
+}
+
+
+/**
+ *  DESCRIPTION:    Whether a message at the given level would be logged by 
+ *                  the calling file's module. Constant false for levels that
+ *                  are compiled out, so work only needed for a log message 
+ *                  can be skipped with it.
+ * 
+ */
+#define log_level_enabled(level) (DXWIFI_LOG_LEVEL >= (level) && __log_enabled(DXWIFI_LOG_MODULE, level))
+
+
+// Arguments are only evaluated once the level is known to be enabled
+#define __log_if_enabled(level, fmt, ...)                                       \
+    do {                                                                        \
+        if(__log_enabled(DXWIFI_LOG_MODULE, level))                             \
+            __log(level, DXWIFI_LOG_MODULE, fmt, ##__VA_ARGS__);                \
+    } while(0)
+
+
+// Debug and trace statements also answer to the module's sampling and limits
+#define __log_sampled(level, call)                                              \
+    do {                                                                        \
+        if(__log_enabled(DXWIFI_LOG_MODULE, level)) {                           \
+            static dxwifi_log_site __site;                                      \
+            if(__log_site_allowed(&__site, DXWIFI_LOG_MODULE))                  \
+                call;                                                           \
+        }                                                                       \
+    } while(0)
+
+
 #if DXWIFI_LOG_LEVEL < 1
   #define log_fatal(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
 #else
-  #define log_fatal(fmt, ...) __log(DXWIFI_LOG_FATAL, __FILE__, fmt, ##__VA_ARGS__)
+  #define log_fatal(fmt, ...) __log_if_enabled(DXWIFI_LOG_FATAL, fmt, ##__VA_ARGS__)
 #endif
 
 #if DXWIFI_LOG_LEVEL < 2
   #define log_error(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
 #else
-  #define log_error(fmt, ...) __log(DXWIFI_LOG_ERROR, __FILE__, fmt, ##__VA_ARGS__)
+  #define log_error(fmt, ...) __log_if_enabled(DXWIFI_LOG_ERROR, fmt, ##__VA_ARGS__)
 #endif
 
 #if DXWIFI_LOG_LEVEL < 3
   #define log_warning(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
 #else
-  #define log_warning(fmt, ...) __log(DXWIFI_LOG_WARN, __FILE__, fmt, ##__VA_ARGS__)
+  #define log_warning(fmt, ...) __log_if_enabled(DXWIFI_LOG_WARN, fmt, ##__VA_ARGS__)
 #endif
 
 #if DXWIFI_LOG_LEVEL < 4
   #define log_info(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
 #else
-  #define log_info(fmt, ...) __log(DXWIFI_LOG_INFO, __FILE__, fmt, ##__VA_ARGS__)
+  #define log_info(fmt, ...) __log_if_enabled(DXWIFI_LOG_INFO, fmt, ##__VA_ARGS__)
 #endif
 
 #if DXWIFI_LOG_LEVEL < 5
   #define log_debug(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
 #else
-  #define log_debug(fmt, ...) __log(DXWIFI_LOG_DEBUG, __FILE__, fmt, ##__VA_ARGS__)
+  #define log_debug(fmt, ...) __log_sampled(DXWIFI_LOG_DEBUG, __log(DXWIFI_LOG_DEBUG, DXWIFI_LOG_MODULE, fmt, ##__VA_ARGS__))
 #endif
 
 // Hexdump is expensive, so it's only enabled for trace logging
@@ -194,13 +420,14 @@ bool set_log_level(dxwifi_log_module_t module, dxwifi_log_level_t level);
   #define log_trace(fmt, ...) __DXWIFI_UTILS_UNUSED(fmt, ##__VA_ARGS__)
   #define log_hexdump(data, size) __DXWIFI_UTILS_UNUSED(data, size)
 #else
-  #define log_trace(fmt, ...) __log(DXWIFI_LOG_TRACE, __FILE__, fmt, ##__VA_ARGS__)
-  #define log_hexdump(data, size) __log_hexdump(__FILE__, data, size);
+  #define log_trace(fmt, ...) __log_sampled(DXWIFI_LOG_TRACE, __log(DXWIFI_LOG_TRACE, DXWIFI_LOG_MODULE, fmt, ##__VA_ARGS__))
+  #define log_hexdump(data, size) __log_sampled(DXWIFI_LOG_TRACE, __log_hexdump(DXWIFI_LOG_MODULE, data, size))
 #endif
 
 
-void __log(dxwifi_log_level_t log_level, const char* file, const char* fmt, ...);
-void __log_hexdump(const char* file, const uint8_t* data, int size);
+void __log(dxwifi_log_level_t log_level, dxwifi_log_module_t module, const char* fmt, ...);
+void __log_hexdump(dxwifi_log_module_t module, const uint8_t* data, int size);
+bool __log_site_allowed(dxwifi_log_site* site, dxwifi_log_module_t module);
 
 
 #endif // LIBDXWIFI_LOGGING_H
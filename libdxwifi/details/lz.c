@@ -0,0 +1,282 @@
+/**
+ *  lz.c
+ * 
+ *  DESCRIPTION: See lz.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <string.h>
+#include <stdbool.h>
+
+#include <libdxwifi/details/lz.h>
+#include <libdxwifi/details/assert.h>
+
+
+#define LZ_WINDOW_MASK  (LZ_WINDOW_SIZE - 1)
+#define LZ_MAX_OFFSET   (LZ_WINDOW_SIZE - 1)
+#define LZ_RUN_MASK     0x0f
+
+
+typedef struct {
+    uint8_t*    op;             /* Next output byte                         */
+    uint8_t*    end;            /* End of the output buffer                 */
+    bool        overflow;       /* Ran out of room?                         */
+} lz_output;
+
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+static uint32_t hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+
+static void insert(lz_context* ctx, const uint8_t* src, size_t pos) {
+    uint32_t h = hash32(read32(src + pos));
+    ctx->chain[pos & LZ_WINDOW_MASK] = ctx->head[h];
+    ctx->head[h] = (int32_t) pos;
+}
+
+
+/**
+ *  DESCRIPTION:    Walks the hash chain for the longest match at a position
+ * 
+ *  ARGUMENTS:
+ * 
+ *      ctx:        Match finder with every earlier position inserted
+ * 
+ *      src:        Data being compressed
+ * 
+ *      size:       Size of the data
+ * 
+ *      pos:        Position to match, must not be inserted yet
+ * 
+ *      depth:      Maximum number of candidates to compare
+ * 
+ *      offset:     Distance back to the best match
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Length of the best match, 0 if none is LZ_MIN_MATCH long
+ * 
+ */
+static size_t find_match(const lz_context* ctx, const uint8_t* src, size_t size, size_t pos, unsigned depth, size_t* offset) {
+    size_t best     = 0;
+    uint32_t word   = read32(src + pos);
+    int32_t cand    = ctx->head[hash32(word)];
+
+    while(cand >= 0 && pos - (size_t)cand <= LZ_MAX_OFFSET && depth-- > 0) {
+        if(read32(src + cand) == word) {
+            size_t len = LZ_MIN_MATCH;
+            while(pos + len < size && src[cand + len] == src[pos + len]) {
+                ++len;
+            }
+            if(len > best) {
+                best    = len;
+                *offset = pos - cand;
+            }
+        }
+        cand = ctx->chain[cand & LZ_WINDOW_MASK];
+    }
+    return best;
+}
+
+
+static void put_byte(lz_output* out, uint8_t byte) {
+    if(out->op < out->end) {
+        *out->op++ = byte;
+    }
+    else {
+        out->overflow = true;
+    }
+}
+
+
+static void put_length(lz_output* out, size_t len) {
+    while(len >= 255) {
+        put_byte(out, 255);
+        len -= 255;
+    }
+    put_byte(out, len);
+}
+
+
+/**
+ *  DESCRIPTION:    Writes a literal run followed by an optional match
+ * 
+ *  ARGUMENTS:
+ * 
+ *      out:        Output buffer
+ * 
+ *      literals:   Literal bytes
+ * 
+ *      nliterals:  Number of literal bytes
+ * 
+ *      offset:     Match offset
+ * 
+ *      match_len:  Match length, 0 for the final literal only sequence
+ * 
+ */
+static void put_sequence(lz_output* out, const uint8_t* literals, size_t nliterals, size_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    put_byte(out, ((nliterals < LZ_RUN_MASK ? nliterals : LZ_RUN_MASK) << 4) | (ml < LZ_RUN_MASK ? ml : LZ_RUN_MASK));
+    if(nliterals >= LZ_RUN_MASK) {
+        put_length(out, nliterals - LZ_RUN_MASK);
+    }
+    if((size_t)(out->end - out->op) < nliterals) {
+        out->overflow = true;
+        return;
+    }
+    memcpy(out->op, literals, nliterals);
+    out->op += nliterals;
+
+    if(match_len) {
+        put_byte(out, offset & 0xff);
+        put_byte(out, offset >> 8);
+        if(ml >= LZ_RUN_MASK) {
+            put_length(out, ml - LZ_RUN_MASK);
+        }
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Reads a run length extension
+ * 
+ *  ARGUMENTS:
+ * 
+ *      ip:         Next input byte, advanced past the extension
+ * 
+ *      end:        End of the input
+ * 
+ *      len:        Length to extend
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the input ended in the middle of the extension
+ * 
+ */
+static bool get_length(const uint8_t** ip, const uint8_t* end, size_t* len) {
+    uint8_t byte = 255;
+    while(byte == 255) {
+        if(*ip >= end) {
+            return false;
+        }
+        byte  = *(*ip)++;
+        *len += byte;
+    }
+    return true;
+}
+
+
+//
+// See lz.h for description of non-static functions
+//
+
+size_t lz_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+
+size_t lz_compress(lz_context* ctx, const uint8_t* src, size_t size, uint8_t* dst, size_t capacity, int level) {
+    debug_assert(ctx && src && dst);
+
+    lz_output out   = { .op = dst, .end = dst + capacity, .overflow = false };
+    level           = (level < LZ_LEVEL_MIN) ? LZ_LEVEL_MIN : (level > LZ_LEVEL_MAX) ? LZ_LEVEL_MAX : level;
+    unsigned depth  = 1u << (level - 1);
+    bool lazy       = level >= 5;
+
+    memset(ctx->head, 0xff, sizeof(ctx->head));
+
+    size_t anchor   = 0;
+    size_t pos      = 0;
+    size_t limit    = (size > LZ_MIN_MATCH) ? size - LZ_MIN_MATCH : 0;
+
+    while(pos < limit && !out.overflow) {
+        size_t offset   = 0;
+        size_t len      = find_match(ctx, src, size, pos, depth, &offset);
+        insert(ctx, src, pos);
+
+        if(len < LZ_MIN_MATCH) {
+            ++pos;
+            continue;
+        }
+        if(lazy && pos + 1 < limit) {
+            size_t next_offset  = 0;
+            size_t next_len     = find_match(ctx, src, size, pos + 1, depth, &next_offset);
+            if(next_len > len + 1) {
+                ++pos;
+                insert(ctx, src, pos);
+                len     = next_len;
+                offset  = next_offset;
+            }
+        }
+        put_sequence(&out, src + anchor, pos - anchor, offset, len);
+
+        for(size_t i = pos + 1; i < pos + len && i < limit; ++i) {
+            insert(ctx, src, i);
+        }
+        pos    += len;
+        anchor  = pos;
+    }
+    put_sequence(&out, src + anchor, size - anchor, 0, 0);
+
+    return out.overflow ? 0 : out.op - dst;
+}
+
+
+ssize_t lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    debug_assert(src && dst);
+
+    const uint8_t* ip   = src;
+    const uint8_t* end  = src + size;
+    uint8_t* op         = dst;
+    uint8_t* op_end     = dst + capacity;
+
+    while(ip < end) {
+        uint8_t token       = *ip++;
+        size_t nliterals    = token >> 4;
+        size_t len          = (token & LZ_RUN_MASK) + LZ_MIN_MATCH;
+
+        if(nliterals == LZ_RUN_MASK && !get_length(&ip, end, &nliterals)) {
+            return -1;
+        }
+        if((size_t)(end - ip) < nliterals || (size_t)(op_end - op) < nliterals) {
+            return -1;
+        }
+        memcpy(op, ip, nliterals);
+        ip += nliterals;
+        op += nliterals;
+
+        if(ip == end) {
+            break; // Final sequence has no match
+        }
+        if(end - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if((token & LZ_RUN_MASK) == LZ_RUN_MASK && !get_length(&ip, end, &len)) {
+            return -1;
+        }
+        if(offset == 0 || offset > (size_t)(op - dst) || (size_t)(op_end - op) < len) {
+            return -1;
+        }
+        // Matches may overlap the bytes they produce
+        const uint8_t* match = op - offset;
+        for(size_t i = 0; i < len; ++i) {
+            op[i] = match[i];
+        }
+        op += len;
+    }
+    return op - dst;
+}
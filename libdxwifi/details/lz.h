@@ -0,0 +1,112 @@
+/**
+ *  lz.h
+ * 
+ *  DESCRIPTION: Small LZ77 codec with a selectable compression level. The
+ *  encoder finds matches through a hash chain whose search depth grows with
+ *  the level, levels 5 and up also try a one byte lazy match. Output is a
+ *  sequence of LZ4 style tokens, literal run and match length nibbles,
+ *  followed by the literals and a 16-bit little endian match offset.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Every call to lz_compress() is independent, there is no dictionary
+ *  shared between buffers. The decoder validates every length and offset so
+ *  it's safe to feed it corrupted input.
+ * 
+ */
+
+#ifndef LIBDXWIFI_LZ_H
+#define LIBDXWIFI_LZ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+
+/************************
+ *  Constants
+ ***********************/
+
+#define LZ_LEVEL_MIN        1
+#define LZ_LEVEL_MAX        9
+#define LZ_LEVEL_DFLT       3
+
+#define LZ_MIN_MATCH        4
+#define LZ_WINDOW_SIZE      (1 << 16)
+#define LZ_HASH_BITS        14
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct {
+    int32_t     head[1 << LZ_HASH_BITS];    /* Last position of each hash   */
+    int32_t     chain[LZ_WINDOW_SIZE];      /* Previous position, same hash */
+} lz_context;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Worst case compressed size of a buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      size:       Size of the uncompressed data
+ * 
+ */
+size_t lz_compress_bound(size_t size);
+
+
+/**
+ *  DESCRIPTION:    Compresses a buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      ctx:        Scratch space for the match finder
+ * 
+ *      src:        Data to compress
+ * 
+ *      size:       Size of the data
+ * 
+ *      dst:        Output buffer
+ * 
+ *      capacity:   Size of the output buffer
+ * 
+ *      level:      Compression level, LZ_LEVEL_MIN to LZ_LEVEL_MAX
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     Compressed size, 0 if the output didn't fit in capacity
+ * 
+ */
+size_t lz_compress(lz_context* ctx, const uint8_t* src, size_t size, uint8_t* dst, size_t capacity, int level);
+
+
+/**
+ *  DESCRIPTION:    Decompresses a buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      src:        Compressed data
+ * 
+ *      size:       Size of the compressed data
+ * 
+ *      dst:        Output buffer
+ * 
+ *      capacity:   Size of the output buffer
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Decompressed size, -1 if the input is malformed or doesn't
+ *                  fit in capacity
+ * 
+ */
+ssize_t lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+
+#endif // LIBDXWIFI_LZ_H
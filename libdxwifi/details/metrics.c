@@ -0,0 +1,261 @@
+/**
+ *  metrics.c
+ * 
+ *  DESCRIPTION: See metrics.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+static const dxwifi_metric_info metric_table[DXWIFI_METRIC_COUNT] = {
+    [DXWIFI_METRIC_TX_FRAMES]           = { "tx.frames",            "frames",   DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_CONTROL_FRAMES]   = { "tx.control_frames",    "ctrl",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_BYTES_READ]       = { "tx.bytes_read",        "read",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_BYTES_SENT]       = { "tx.bytes_sent",        "sent",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_INJECT_ERRORS]    = { "tx.inject_errors",     "errors",   DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_ACTIVE]           = { "tx.active",            "active",   DXWIFI_METRIC_GAUGE,    DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_RX_FRAMES]           = { "rx.frames",            "frames",   DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_CONTROL_FRAMES]   = { "rx.control_frames",    "ctrl",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_BYTES_CAPTURED]   = { "rx.bytes_captured",    "capture",  DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_PAYLOAD_BYTES]    = { "rx.payload_bytes",     "payload",  DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_BYTES_WRITTEN]    = { "rx.bytes_written",     "written",  DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_BLOCKS_LOST]      = { "rx.blocks_lost",       "lost",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_NOISE_BYTES]      = { "rx.noise_bytes",       "noise",    DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_BUFFERED_BYTES]   = { "rx.buffered_bytes",    "buffer",   DXWIFI_METRIC_GAUGE,    DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_PCAP_RECEIVED]    = { "rx.pcap_received",     "recv",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_PCAP_DROPPED]     = { "rx.pcap_dropped",      "drop",     DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_PCAP_IFDROPPED]   = { "rx.pcap_ifdropped",    "ifdrop",   DXWIFI_METRIC_COUNTER,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_TX_WAIT_SAMPLES]        = { "tx.latency.wait.samples",       "wait.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_WAIT_TIME]           = { "tx.latency.wait.ns",            "wait",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_READ_SAMPLES]        = { "tx.latency.read.samples",       "read.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_READ_TIME]           = { "tx.latency.read.ns",            "read",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_PREPARE_SAMPLES]     = { "tx.latency.prepare.samples",    "prep.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_PREPARE_TIME]        = { "tx.latency.prepare.ns",         "prep",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_PREINJECT_SAMPLES]   = { "tx.latency.preinject.samples",  "prein.n",  DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_PREINJECT_TIME]      = { "tx.latency.preinject.ns",       "prein",    DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_INJECT_SAMPLES]      = { "tx.latency.inject.samples",     "inject.n", DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_INJECT_TIME]         = { "tx.latency.inject.ns",          "inject",   DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_POSTINJECT_SAMPLES]  = { "tx.latency.postinject.samples", "postin.n", DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_TX_POSTINJECT_TIME]     = { "tx.latency.postinject.ns",      "postin",   DXWIFI_METRIC_TIME,     DXWIFI_METRICS_TX },
+    [DXWIFI_METRIC_RX_WAIT_SAMPLES]        = { "rx.latency.wait.samples",       "wait.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_WAIT_TIME]           = { "rx.latency.wait.ns",            "wait",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_DISPATCH_SAMPLES]    = { "rx.latency.dispatch.samples",   "dispatch.n", DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_DISPATCH_TIME]       = { "rx.latency.dispatch.ns",        "dispatch", DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_COPY_SAMPLES]        = { "rx.latency.copy.samples",       "copy.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_COPY_TIME]           = { "rx.latency.copy.ns",            "copy",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_HEAP_SAMPLES]        = { "rx.latency.heap.samples",       "heap.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_HEAP_TIME]           = { "rx.latency.heap.ns",            "heap",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_WRITE_SAMPLES]       = { "rx.latency.write.samples",      "write.n",  DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_WRITE_TIME]          = { "rx.latency.write.ns",           "write",    DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_TRANSIT_SAMPLES]     = { "rx.latency.transit.samples",    "transit.n", DXWIFI_METRIC_SAMPLES, DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_TRANSIT_TIME]        = { "rx.latency.transit.ns",         "transit",  DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_HOLD_SAMPLES]        = { "rx.latency.hold.samples",       "hold.n",   DXWIFI_METRIC_SAMPLES,  DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_HOLD_TIME]           = { "rx.latency.hold.ns",            "hold",     DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_DELIVERY_SAMPLES]    = { "rx.latency.delivery.samples",   "deliver.n", DXWIFI_METRIC_SAMPLES, DXWIFI_METRICS_RX },
+    [DXWIFI_METRIC_RX_DELIVERY_TIME]       = { "rx.latency.delivery.ns",        "deliver",  DXWIFI_METRIC_TIME,     DXWIFI_METRICS_RX },
+};
+
+
+static bool format_segment_name(char* buffer, size_t size, const char* name) {
+    if(strchr(name, '/') || strlen(name) == 0 || strlen(name) > DXWIFI_METRICS_NAME_MAX) {
+        log_error("Invalid metrics name `%s`, up to %d characters without slashes", name, DXWIFI_METRICS_NAME_MAX);
+        return false;
+    }
+    snprintf(buffer, size, "/dxwifi.%s", name);
+    return true;
+}
+
+
+/**
+ *  DESCRIPTION:    Checks whether an existing segment was left behind by a 
+ *                  process that's no longer running
+ * 
+ *  ARGUMENTS:
+ * 
+ *      path:       Full segment name, /dxwifi.<name>
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if the publishing process is dead. Segments without
+ *                  a complete header have no pid to check and are kept.
+ * 
+ */
+static bool segment_abandoned(const char* path) {
+    int fd = shm_open(path, O_RDONLY, 0);
+    if(fd < 0) {
+        // Removed since, nothing to take over
+        return errno == ENOENT;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size != sizeof(dxwifi_metrics_segment)) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, sizeof(dxwifi_metrics_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return false;
+    }
+
+    const dxwifi_metrics_segment* segment = map;
+    bool abandoned = false;
+    if(memcmp(segment->magic, DXWIFI_METRICS_MAGIC, sizeof(DXWIFI_METRICS_MAGIC)) == 0) {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        abandoned = segment->pid > 0 && kill(segment->pid, 0) < 0 && errno == ESRCH;
+        if(!abandoned) {
+            log_error("Metrics segment %s is in use by process %d", path, segment->pid);
+        }
+    }
+    else {
+        log_error("Metrics segment %s has no header, remove /dev/shm%s if it's stale", path, path);
+    }
+    munmap(map, sizeof(dxwifi_metrics_segment));
+    return abandoned;
+}
+
+
+bool open_metrics(dxwifi_metrics* metrics, const char* name, dxwifi_metrics_role_t role) {
+    debug_assert(metrics && name);
+
+    metrics->segment = NULL;
+    if(!format_segment_name(metrics->path, sizeof(metrics->path), name)) {
+        return false;
+    }
+
+    int fd = shm_open(metrics->path, O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    // A segment left behind by a process that crashed is taken over
+    if(fd < 0 && errno == EEXIST && segment_abandoned(metrics->path)) {
+        log_info("Taking over metrics segment %s", metrics->path);
+        shm_unlink(metrics->path);
+        fd = shm_open(metrics->path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if(fd < 0) {
+        log_error("Failed to create metrics segment %s: %s", metrics->path, strerror(errno));
+        return false;
+    }
+    if(ftruncate(fd, sizeof(dxwifi_metrics_segment)) < 0) {
+        log_error("Failed to size metrics segment %s: %s", metrics->path, strerror(errno));
+        close(fd);
+        shm_unlink(metrics->path);
+        return false;
+    }
+
+    void* map = mmap(NULL, sizeof(dxwifi_metrics_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        log_error("Failed to map metrics segment %s: %s", metrics->path, strerror(errno));
+        shm_unlink(metrics->path);
+        return false;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    dxwifi_metrics_segment* segment = map;
+    segment->metric_count   = DXWIFI_METRIC_COUNT;
+    segment->role           = role;
+    segment->pid            = getpid();
+    segment->start_time     = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+    segment->version        = DXWIFI_METRICS_VERSION;
+
+    // Readers check the magic last, so they never see a half made header
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(segment->magic, DXWIFI_METRICS_MAGIC, sizeof(DXWIFI_METRICS_MAGIC));
+
+    metrics->segment = segment;
+
+    log_info("Publishing metrics in %s", metrics->path);
+    return true;
+}
+
+
+void close_metrics(dxwifi_metrics* metrics) {
+    debug_assert(metrics);
+
+    if(!metrics->segment) {
+        return;
+    }
+    shm_unlink(metrics->path);
+    munmap(metrics->segment, sizeof(dxwifi_metrics_segment));
+    metrics->segment = NULL;
+}
+
+
+const dxwifi_metrics_segment* attach_metrics(const char* name) {
+    debug_assert(name);
+
+    char path[sizeof("/dxwifi.") + DXWIFI_METRICS_NAME_MAX];
+    if(!format_segment_name(path, sizeof(path), name)) {
+        return NULL;
+    }
+
+    int fd = shm_open(path, O_RDONLY, 0);
+    if(fd < 0) {
+        log_error("No metrics published as %s: %s", name, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        log_error("Failed to stat metrics segment %s: %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    if(st.st_size != sizeof(dxwifi_metrics_segment)) {
+        log_error("Metrics segment %s is %ld bytes, expected %ld", path, st.st_size, sizeof(dxwifi_metrics_segment));
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, sizeof(dxwifi_metrics_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    assert_M(map != MAP_FAILED, "Failed to map metrics segment: %s", strerror(errno));
+
+    const dxwifi_metrics_segment* segment = map;
+    if(memcmp(segment->magic, DXWIFI_METRICS_MAGIC, sizeof(DXWIFI_METRICS_MAGIC)) != 0) {
+        log_error("%s isn't a metrics segment", path);
+        detach_metrics(segment);
+        return NULL;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if(segment->version != DXWIFI_METRICS_VERSION) {
+        log_error("Metrics segment %s is version %d, this build reads version %d", path, segment->version, DXWIFI_METRICS_VERSION);
+        detach_metrics(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+
+void detach_metrics(const dxwifi_metrics_segment* segment) {
+    if(segment) {
+        munmap((void*) segment, sizeof(dxwifi_metrics_segment));
+    }
+}
+
+
+const dxwifi_metric_info* metric_info(dxwifi_metric_t metric) {
+    debug_assert(metric < DXWIFI_METRIC_COUNT);
+
+    return &metric_table[metric];
+}
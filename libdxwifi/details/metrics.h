@@ -0,0 +1,239 @@
+/**
+ *  metrics.h
+ * 
+ *  DESCRIPTION: Live metrics for tx and rx. Counters and gauges are 64-bit
+ *  slots in a versioned shared memory segment that other processes, like
+ *  dxwifi-stat or a monitoring agent, can map and read while a pass is
+ *  running. Updating a metric is an atomic add or store to that memory, no
+ *  system calls, so the hot paths update them for every frame.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: A segment publishes the metrics of the transmitters and receivers
+ *  it's attached to, several can share one and their counts add up. Segments
+ *  live in /dev/shm as dxwifi.<name> and are removed when they're closed.
+ *  Transmitters and receivers must be closed before their metrics are.
+ *  Slots keep their meaning, new metrics take new slots and raise the metric
+ *  count, so a reader only shows the slots below both its own count and the
+ *  segment's. The version only changes with the layout of the segment. Rates
+ *  aren't published, readers derive them from counter deltas.
+ * 
+ */
+
+#ifndef LIBDXWIFI_METRICS_H
+#define LIBDXWIFI_METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <libdxwifi/details/assert.h>
+
+
+#define DXWIFI_METRICS_MAGIC        "DXMETRC"
+#define DXWIFI_METRICS_VERSION      1
+#define DXWIFI_METRICS_SLOTS        64      /* Room for metrics in a segment    */
+#define DXWIFI_METRICS_NAME_MAX     64      /* Longest segment name             */
+
+
+typedef enum {
+    DXWIFI_METRICS_TX,
+    DXWIFI_METRICS_RX
+} dxwifi_metrics_role_t;
+
+
+typedef enum {
+    DXWIFI_METRIC_COUNTER,  /* Only goes up, readers show its rate          */
+    DXWIFI_METRIC_GAUGE,    /* Current value of something                   */
+    DXWIFI_METRIC_SAMPLES,  /* Times a timed stage ran, see latency.h       */
+    DXWIFI_METRIC_TIME      /* Nanoseconds spent in the stage counted by the
+                               slot before it                               */
+} dxwifi_metric_kind_t;
+
+
+typedef enum {
+    DXWIFI_METRIC_TX_FRAMES,            /* Data frames injected             */
+    DXWIFI_METRIC_TX_CONTROL_FRAMES,    /* Control frames injected          */
+    DXWIFI_METRIC_TX_BYTES_READ,        /* Payload bytes read from sources  */
+    DXWIFI_METRIC_TX_BYTES_SENT,        /* Bytes handed to pcap             */
+    DXWIFI_METRIC_TX_INJECT_ERRORS,     /* Frames pcap failed to inject     */
+    DXWIFI_METRIC_TX_ACTIVE,            /* Transmissions in progress        */
+    DXWIFI_METRIC_RX_FRAMES,            /* Data frames captured             */
+    DXWIFI_METRIC_RX_CONTROL_FRAMES,    /* Control frames captured          */
+    DXWIFI_METRIC_RX_BYTES_CAPTURED,    /* Bytes of the data frames captured*/
+    DXWIFI_METRIC_RX_PAYLOAD_BYTES,     /* Payload bytes captured           */
+    DXWIFI_METRIC_RX_BYTES_WRITTEN,     /* Bytes the sinks wrote out        */
+    DXWIFI_METRIC_RX_BLOCKS_LOST,       /* Data blocks found missing        */
+    DXWIFI_METRIC_RX_NOISE_BYTES,       /* Noise written for lost blocks    */
+    DXWIFI_METRIC_RX_BUFFERED_BYTES,    /* Bytes held in packet buffers     */
+    DXWIFI_METRIC_RX_PCAP_RECEIVED,     /* Packets pcap saw, sampled        */
+    DXWIFI_METRIC_RX_PCAP_DROPPED,      /* Packets the kernel dropped       */
+    DXWIFI_METRIC_RX_PCAP_IFDROPPED,    /* Packets the interface dropped    */
+    // Stage latencies, published while timing is enabled
+    DXWIFI_METRIC_TX_WAIT_SAMPLES,
+    DXWIFI_METRIC_TX_WAIT_TIME,
+    DXWIFI_METRIC_TX_READ_SAMPLES,
+    DXWIFI_METRIC_TX_READ_TIME,
+    DXWIFI_METRIC_TX_PREPARE_SAMPLES,
+    DXWIFI_METRIC_TX_PREPARE_TIME,
+    DXWIFI_METRIC_TX_PREINJECT_SAMPLES,
+    DXWIFI_METRIC_TX_PREINJECT_TIME,
+    DXWIFI_METRIC_TX_INJECT_SAMPLES,
+    DXWIFI_METRIC_TX_INJECT_TIME,
+    DXWIFI_METRIC_TX_POSTINJECT_SAMPLES,
+    DXWIFI_METRIC_TX_POSTINJECT_TIME,
+    DXWIFI_METRIC_RX_WAIT_SAMPLES,
+    DXWIFI_METRIC_RX_WAIT_TIME,
+    DXWIFI_METRIC_RX_DISPATCH_SAMPLES,
+    DXWIFI_METRIC_RX_DISPATCH_TIME,
+    DXWIFI_METRIC_RX_COPY_SAMPLES,
+    DXWIFI_METRIC_RX_COPY_TIME,
+    DXWIFI_METRIC_RX_HEAP_SAMPLES,
+    DXWIFI_METRIC_RX_HEAP_TIME,
+    DXWIFI_METRIC_RX_WRITE_SAMPLES,
+    DXWIFI_METRIC_RX_WRITE_TIME,
+    DXWIFI_METRIC_RX_TRANSIT_SAMPLES,
+    DXWIFI_METRIC_RX_TRANSIT_TIME,
+    DXWIFI_METRIC_RX_HOLD_SAMPLES,
+    DXWIFI_METRIC_RX_HOLD_TIME,
+    DXWIFI_METRIC_RX_DELIVERY_SAMPLES,
+    DXWIFI_METRIC_RX_DELIVERY_TIME,
+    DXWIFI_METRIC_COUNT
+} dxwifi_metric_t;
+
+compiler_assert(DXWIFI_METRIC_COUNT <= DXWIFI_METRICS_SLOTS, "Metrics must fit in the segment's slots");
+
+
+typedef struct {
+    const char*             name;       /* Full name, for scripts           */
+    const char*             column;     /* Short name, for dxwifi-stat      */
+    dxwifi_metric_kind_t    kind;
+    dxwifi_metrics_role_t   role;       /* Program that publishes it        */
+} dxwifi_metric_info;
+
+
+typedef struct {
+    char        magic[8];       /* DXWIFI_METRICS_MAGIC, null terminated    */
+    uint32_t    version;        /* DXWIFI_METRICS_VERSION                   */
+    uint32_t    metric_count;   /* Slots in use, DXWIFI_METRIC_COUNT        */
+    uint32_t    role;           /* dxwifi_metrics_role_t                    */
+    int32_t     pid;            /* Process publishing the metrics           */
+    uint64_t    start_time;     /* Monotonic time it started, nanoseconds   */
+    uint8_t     padding[32];
+    uint64_t    values[DXWIFI_METRICS_SLOTS];
+} dxwifi_metrics_segment;
+
+
+typedef struct {
+    dxwifi_metrics_segment* segment;    /* Mapped segment, NULL once closed */
+    char    path[sizeof("/dxwifi.") + DXWIFI_METRICS_NAME_MAX];
+                                        /* Name it's published under        */
+} dxwifi_metrics;
+
+
+/**
+ *  DESCRIPTION:    Creates a metrics segment to publish into
+ * 
+ *  ARGUMENTS:
+ * 
+ *      metrics:    Metrics to open, attach them to a transmitter or receiver
+ *                  to publish its counters
+ * 
+ *      name:       Segment name, without slashes
+ * 
+ *      role:       Program publishing the metrics
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the name is in use or the segment couldn't be 
+ *                  created
+ * 
+ */
+bool open_metrics(dxwifi_metrics* metrics, const char* name, dxwifi_metrics_role_t role);
+
+
+/**
+ *  DESCRIPTION:    Stops publishing and removes the segment. Safe to call
+ *                  more than once.
+ * 
+ */
+void close_metrics(dxwifi_metrics* metrics);
+
+
+/**
+ *  DESCRIPTION:    Adds to a metric, if metrics are published
+ * 
+ *  ARGUMENTS:
+ * 
+ *      metrics:    Open metrics or NULL when they aren't published
+ * 
+ *      metric:     Metric to update
+ * 
+ *      delta:      Amount to add, gauges can go down
+ * 
+ */
+static inline void metrics_add(dxwifi_metrics* metrics, dxwifi_metric_t metric, int64_t delta) {
+    if(metrics) {
+        __atomic_fetch_add(&metrics->segment->values[metric], (uint64_t) delta, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Sets a metric, if metrics are published
+ * 
+ *  ARGUMENTS:
+ * 
+ *      metrics:    Open metrics or NULL when they aren't published
+ * 
+ *      metric:     Metric to update
+ * 
+ *      value:      Value to publish
+ * 
+ */
+static inline void metrics_set(dxwifi_metrics* metrics, dxwifi_metric_t metric, uint64_t value) {
+    if(metrics) {
+        __atomic_store_n(&metrics->segment->values[metric], value, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Maps another process's segment for reading
+ * 
+ *  ARGUMENTS:
+ * 
+ *      name:       Name the segment was opened with
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_metrics_segment*: The mapped segment, or NULL if it doesn't
+ *                  exist or isn't a version this build understands
+ * 
+ */
+const dxwifi_metrics_segment* attach_metrics(const char* name);
+
+
+/**
+ *  DESCRIPTION:    Unmaps a segment mapped with attach_metrics
+ * 
+ */
+void detach_metrics(const dxwifi_metrics_segment* segment);
+
+
+/**
+ *  DESCRIPTION:    Reads a metric from a segment
+ * 
+ */
+static inline uint64_t metrics_read(const dxwifi_metrics_segment* segment, dxwifi_metric_t metric) {
+    return __atomic_load_n(&segment->values[metric], __ATOMIC_RELAXED);
+}
+
+
+/**
+ *  DESCRIPTION:    Describes a metric
+ * 
+ */
+const dxwifi_metric_info* metric_info(dxwifi_metric_t metric);
+
+
+#endif // LIBDXWIFI_METRICS_H
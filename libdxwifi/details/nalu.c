@@ -0,0 +1,313 @@
+/**
+ *  nalu.c
+ * 
+ *  DESCRIPTION: See nalu.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include <libdxwifi/details/nalu.h>
+#include <libdxwifi/details/utils.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+/**
+ *  DESCRIPTION:    Determines the length of the start code at an offset
+ * 
+ *  ARGUMENTS:
+ * 
+ *      buffer:     Buffered stream data
+ * 
+ *      length:     Number of valid bytes in the buffer
+ * 
+ *      pos:        Offset to check
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:     4 or 3 for a long or short start code, 0 if there is none
+ * 
+ */
+static size_t start_code_length(const uint8_t* buffer, size_t length, size_t pos) {
+    if(pos + 4 <= length && buffer[pos] == 0 && buffer[pos + 1] == 0 && buffer[pos + 2] == 0 && buffer[pos + 3] == 1) {
+        return 4;
+    }
+    if(pos + 3 <= length && buffer[pos] == 0 && buffer[pos + 1] == 0 && buffer[pos + 2] == 1) {
+        return 3;
+    }
+    return 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Gets the nal_unit_type of the current unit
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Packetizer with a complete unit buffered
+ * 
+ */
+static uint8_t current_unit_type(const nalu_packetizer* nalu) {
+    size_t sc_len = start_code_length(nalu->buffer, nalu->unit_end, nalu->unit_start);
+
+    if(sc_len == 0 || nalu->unit_start + sc_len >= nalu->unit_end) {
+        return NALU_TYPE_NONE;
+    }
+    return nalu->buffer[nalu->unit_start + sc_len] & 0x1f;
+}
+
+
+static bool is_key_unit(uint8_t type) {
+    return type == NALU_TYPE_IDR || type == NALU_TYPE_SPS || type == NALU_TYPE_PPS;
+}
+
+
+/**
+ *  DESCRIPTION:    Determines if the current unit has been completely buffered
+ *                  by scanning for the start code of the next unit
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Initialized packetizer
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       true if unit_end marks the end of a complete unit
+ * 
+ */
+static bool unit_ready(nalu_packetizer* nalu) {
+    if(nalu->unit_end > nalu->unit_start) {
+        return true;
+    }
+
+    size_t body  = nalu->unit_start + start_code_length(nalu->buffer, nalu->length, nalu->unit_start);
+    size_t start = (nalu->scan_pos > body ? nalu->scan_pos : body);
+
+    for(size_t i = start; i + 3 <= nalu->length; ++i) {
+        if(nalu->buffer[i + 2] > 1) {
+            i += 2; // Can't be part of a start code, skip ahead
+            continue;
+        }
+        if(nalu->buffer[i] == 0 && nalu->buffer[i + 1] == 0 && nalu->buffer[i + 2] == 1) {
+            // A long start code owns the preceding zero byte
+            nalu->unit_end = (i > body && nalu->buffer[i - 1] == 0) ? i - 1 : i;
+            return true;
+        }
+    }
+    nalu->scan_pos = (nalu->length > start + 2) ? nalu->length - 2 : start;
+
+    bool buffer_exhausted = nalu->unit_start == 0 && nalu->length == NALU_BUFFER_SIZE_MAX;
+
+    if(nalu->length > nalu->unit_start && (nalu->eof || buffer_exhausted)) {
+        if(!nalu->eof) {
+            log_warning("NAL unit exceeds %d bytes, forcing a split", NALU_BUFFER_SIZE_MAX);
+            ++nalu->stats.forced_splits;
+        }
+        nalu->unit_end = nalu->length;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ *  DESCRIPTION:    Reads more of the input stream into the buffer, compacting
+ *                  or growing the buffer as needed
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Initialized packetizer
+ * 
+ *      fd:         Input source
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Return value of read()
+ * 
+ */
+static ssize_t fill_buffer(nalu_packetizer* nalu, int fd) {
+    if(nalu->unit_start > 0) {
+        memmove(nalu->buffer, nalu->buffer + nalu->unit_start, nalu->length - nalu->unit_start);
+        nalu->length    -= nalu->unit_start;
+        nalu->scan_pos  -= nalu->unit_start;
+        nalu->unit_start = 0;
+    }
+    if(nalu->length == nalu->capacity && nalu->capacity < NALU_BUFFER_SIZE_MAX) {
+        size_t capacity = nalu->capacity * 2;
+        uint8_t* buffer = realloc(nalu->buffer, capacity);
+        assert_M(buffer, "Failed to grow NAL unit buffer to %ld bytes", capacity);
+
+        nalu->buffer    = buffer;
+        nalu->capacity  = capacity;
+    }
+    return read(fd, nalu->buffer + nalu->length, nalu->capacity - nalu->length);
+}
+
+
+/**
+ *  DESCRIPTION:    Fills the payload with the next fragment of the current 
+ *                  unit and moves on to the next unit once it's been sent
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Packetizer with a complete unit buffered
+ * 
+ *      payload:    Frame payload to fill
+ * 
+ *      blocksize:  Maximum payload size
+ * 
+ *  RETURNS:
+ * 
+ *      ssize_t:    Size of the payload
+ * 
+ */
+static ssize_t next_fragment(nalu_packetizer* nalu, uint8_t* payload, size_t blocksize) {
+    bool unit_done  = false;
+    uint8_t type    = current_unit_type(nalu);
+    bool key        = is_key_unit(type);
+
+    if(nalu->fragmenter.frag_offset == 0 && nalu->fragmenter.repeats_left == 0) {
+        ++nalu->stats.units;
+        nalu->stats.key_units += key;
+    }
+
+    size_t size = unit_fragmenter_next(
+        &nalu->fragmenter,
+        nalu->buffer + nalu->unit_start,
+        nalu->unit_end - nalu->unit_start,
+        nalu->unit,
+        type,
+        key ? DXWIFI_UNIT_F_KEY : 0,
+        key ? nalu->key_repeats : 0,
+        payload,
+        blocksize,
+        &unit_done
+        );
+
+    if(unit_done) {
+        ++nalu->unit;
+        nalu->unit_start    = nalu->unit_end;
+        nalu->scan_pos      = nalu->unit_end;
+        nalu->unit_end      = 0;
+    }
+    return size;
+}
+
+
+static void reset_nalu_packetizer(nalu_packetizer* nalu) {
+    nalu->length        = 0;
+    nalu->unit_start    = 0;
+    nalu->unit_end      = 0;
+    nalu->scan_pos      = 0;
+    nalu->eof           = false;
+    nalu->unit          = 0;
+    reset_unit_fragmenter(&nalu->fragmenter);
+}
+
+
+//
+// See nalu.h for description of non-static functions
+//
+
+void init_nalu_packetizer(nalu_packetizer* nalu, unsigned key_repeats) {
+    debug_assert(nalu);
+
+    memset(nalu, 0x00, sizeof(nalu_packetizer));
+
+    nalu->key_repeats   = key_repeats;
+    nalu->capacity      = NALU_BUFFER_SIZE_DFLT;
+    nalu->buffer        = malloc(nalu->capacity);
+    assert_M(nalu->buffer, "Failed to allocate NAL unit buffer of size: %ld", nalu->capacity);
+
+    reset_nalu_packetizer(nalu);
+}
+
+
+void teardown_nalu_packetizer(nalu_packetizer* nalu) {
+    debug_assert(nalu);
+
+    free(nalu->buffer);
+    nalu->buffer    = NULL;
+    nalu->capacity  = 0;
+    reset_nalu_packetizer(nalu);
+}
+
+
+ssize_t nalu_packetize(int fd, uint8_t* payload, size_t blocksize, void* user) {
+    nalu_packetizer* nalu = (nalu_packetizer*) user;
+    debug_assert(nalu && payload && blocksize > sizeof(dxwifi_unit_hdr));
+
+    if(!unit_ready(nalu)) {
+        ssize_t nbytes = fill_buffer(nalu, fd);
+        if(nbytes < 0) {
+            return -1;
+        }
+        nalu->length += nbytes;
+        nalu->eof     = (nbytes == 0);
+
+        if(!unit_ready(nalu)) {
+            if(nalu->eof) {
+                reset_nalu_packetizer(nalu);
+                return 0;
+            }
+            errno = EAGAIN; // Still in the middle of a unit, wait for more
+            return -1;
+        }
+    }
+    return next_fragment(nalu, payload, blocksize);
+}
+
+
+bool nalu_packetizer_pending(void* user) {
+    nalu_packetizer* nalu = (nalu_packetizer*) user;
+    debug_assert(nalu);
+
+    return unit_ready(nalu);
+}
+
+
+void init_nalu_depacketizer(nalu_depacketizer* nalu) {
+    debug_assert(nalu);
+
+    init_unit_reassembler(&nalu->reassembler, NALU_BUFFER_SIZE_DFLT, NALU_BUFFER_SIZE_MAX);
+}
+
+
+void teardown_nalu_depacketizer(nalu_depacketizer* nalu) {
+    debug_assert(nalu);
+
+    teardown_unit_reassembler(&nalu->reassembler);
+}
+
+
+ssize_t nalu_depacketize(int fd, const uint8_t* payload, size_t size, void* user) {
+    nalu_depacketizer* nalu = (nalu_depacketizer*) user;
+    debug_assert(nalu && payload);
+
+    ssize_t nbytes = 0;
+    unit_reassembler* r = &nalu->reassembler;
+
+    if(unit_reassembler_push(r, payload, size)) {
+        nbytes = write(fd, r->buffer, r->length);
+        debug_assert_continue(nbytes == (ssize_t)r->length, "Partial write: %ld - %s", nbytes, strerror(errno));
+    }
+    return nbytes;
+}
+
+
+ssize_t nalu_depacketizer_flush(int fd, void* user) {
+    nalu_depacketizer* nalu = (nalu_depacketizer*) user;
+    debug_assert(nalu);
+
+    __DXWIFI_UTILS_UNUSED(fd);
+
+    reset_unit_reassembler(&nalu->reassembler);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/**
+ *  nalu.h
+ * 
+ *  DESCRIPTION: Annex-B H.264 NAL unit packetizer and depacketizer. The
+ *  packetizer splits a byte stream on start codes so that no frame ever spans
+ *  two NAL units. Large NAL units are fragmented over several frames. The
+ *  depacketizer reassembles the fragments and only writes out NAL units that
+ *  were received in full.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: Both halves conform to the packetizer/depacketizer interfaces in
+ *  transmitter.h and receiver.h. The start code of each NAL unit is carried
+ *  with the unit so the receiver output is byte-identical to the input when
+ *  nothing is lost.
+ * 
+ */
+
+#ifndef LIBDXWIFI_NALU_H
+#define LIBDXWIFI_NALU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <libdxwifi/dxwifi.h>
+#include <libdxwifi/details/units.h>
+
+
+/************************
+ *  Constants
+ ***********************/
+
+#define NALU_BUFFER_SIZE_DFLT   (1024 * 64)
+#define NALU_BUFFER_SIZE_MAX    (1024 * 1024 * 4)
+
+#define NALU_TYPE_NONE          0xff    /* Data preceding the first start code */
+#define NALU_TYPE_IDR           5       /* Coded slice of an IDR picture       */
+#define NALU_TYPE_SPS           7       /* Sequence parameter set              */
+#define NALU_TYPE_PPS           8       /* Picture parameter set               */
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct {
+    uint32_t    units;          /* Number of NAL units packetized           */
+    uint32_t    key_units;      /* Number of parameter sets and IDR slices  */
+    uint32_t    forced_splits;  /* NAL units larger than the buffer         */
+} nalu_packetizer_stats;
+
+
+typedef struct {
+    uint8_t*    buffer;         /* Buffered input stream                    */
+    size_t      capacity;       /* Size of the buffer                       */
+    size_t      length;         /* Number of bytes buffered                 */
+    size_t      unit_start;     /* Offset of the current NAL unit           */
+    size_t      unit_end;       /* End of the current unit, 0 if unknown    */
+    size_t      scan_pos;       /* Resume position for the start code scan  */
+    bool        eof;            /* Input source is exhausted?               */
+    unsigned    key_repeats;    /* Extra copies of each key fragment        */
+    uint32_t    unit;           /* Index of the current unit                */
+
+    unit_fragmenter fragmenter; /* Splits units into payloads               */
+    nalu_packetizer_stats stats;
+} nalu_packetizer;
+
+
+typedef struct {
+    unit_reassembler reassembler;   /* Collects the fragments of each unit  */
+} nalu_depacketizer;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Initializes the NAL unit packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:           Pointer to an allocated packetizer
+ * 
+ *      key_repeats:    Number of extra times to send each fragment of a
+ *                      parameter set or IDR slice
+ * 
+ */
+void init_nalu_packetizer(nalu_packetizer* nalu, unsigned key_repeats);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the packetizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Initialized packetizer
+ * 
+ */
+void teardown_nalu_packetizer(nalu_packetizer* nalu);
+
+
+/**
+ *  DESCRIPTION:    Packetizer read_block callback, see transmitter.h. Fills
+ *                  the payload with a unit header and the next fragment
+ * 
+ *  NOTES: The packetizer resets itself once the end of input is reached so it
+ *  can be reused for the next transmission.
+ * 
+ */
+ssize_t nalu_packetize(int fd, uint8_t* payload, size_t blocksize, void* nalu);
+
+
+/**
+ *  DESCRIPTION:    Packetizer has_pending callback, see transmitter.h.
+ * 
+ */
+bool nalu_packetizer_pending(void* nalu);
+
+
+/**
+ *  DESCRIPTION:    Initializes the NAL unit depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Pointer to an allocated depacketizer
+ * 
+ */
+void init_nalu_depacketizer(nalu_depacketizer* nalu);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      nalu:       Initialized depacketizer
+ * 
+ */
+void teardown_nalu_depacketizer(nalu_depacketizer* nalu);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer write_block callback, see receiver.h. Writes
+ *                  out a NAL unit once its last fragment has been received
+ * 
+ */
+ssize_t nalu_depacketize(int fd, const uint8_t* payload, size_t size, void* nalu);
+
+
+/**
+ *  DESCRIPTION:    Depacketizer flush callback, see receiver.h. Drops any
+ *                  partially received unit and resets for the next capture
+ * 
+ */
+ssize_t nalu_depacketizer_flush(int fd, void* nalu);
+
+
+#endif // LIBDXWIFI_NALU_H
@@ -0,0 +1,347 @@
+/**
+ *  sentindex.c
+ * 
+ *  DESCRIPTION: See sentindex.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include <libdxwifi/details/sentindex.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+#define FNV64_OFFSET    0xcbf29ce484222325ULL
+#define FNV64_PRIME     0x100000001b3ULL
+
+// Size of the reads used to hash a whole file
+#define HASH_READ_SIZE  (64 * 1024)
+
+
+static inline uint64_t fnv1a(uint64_t hash, const uint8_t* data, size_t nbytes) {
+    for(size_t i = 0; i < nbytes; ++i) {
+        hash ^= data[i];
+        hash *= FNV64_PRIME;
+    }
+    return hash;
+}
+
+
+static inline int64_t mtime_ns(const struct stat* st) {
+    return (int64_t) st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+static inline size_t map_size_for(uint32_t capacity) {
+    return sizeof(sent_index_header) + (size_t) capacity * sizeof(sent_record);
+}
+
+
+static inline uint32_t slot_of(const sent_index* index, uint64_t size, uint64_t head) {
+    uint64_t key = (head ^ (size * 0x9e3779b97f4a7c15ULL));
+    key ^= key >> 32;
+    return (uint32_t) key & (index->header->capacity - 1);
+}
+
+
+static inline uint32_t next_slot(const sent_index* index, uint32_t slot) {
+    return (slot + 1) & (index->header->capacity - 1);
+}
+
+
+static void map_index(sent_index* index, size_t size) {
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, index->fd, 0);
+    assert_M(map != MAP_FAILED, "Failed to map sent index: %s", strerror(errno));
+
+    index->map_size = size;
+    index->header   = map;
+    index->records  = (sent_record*) ((uint8_t*) map + sizeof(sent_index_header));
+}
+
+
+static void insert_record(sent_index* index, const sent_record* record) {
+    uint32_t slot = slot_of(index, record->size, record->head);
+    while(index->records[slot].used) {
+        slot = next_slot(index, slot);
+    }
+    index->records[slot]        = *record;
+    index->records[slot].used   = 1;
+    ++index->header->count;
+}
+
+
+/**
+ *  DESCRIPTION:    Doubles the number of record slots and rehashes every record
+ * 
+ */
+static void grow(sent_index* index) {
+    uint32_t old_capacity   = index->header->capacity;
+    uint32_t new_capacity   = old_capacity * 2;
+
+    sent_record* old_records = malloc(old_capacity * sizeof(sent_record));
+    assert_M(old_records, "Failed to allocate %d sent records", old_capacity);
+    memcpy(old_records, index->records, old_capacity * sizeof(sent_record));
+
+    munmap(index->header, index->map_size);
+    int status = ftruncate(index->fd, map_size_for(new_capacity));
+    assert_M(status == 0, "Failed to grow sent index: %s", strerror(errno));
+    map_index(index, map_size_for(new_capacity));
+
+    memset(index->records, 0x00, new_capacity * sizeof(sent_record));
+    index->header->capacity = new_capacity;
+    index->header->count    = 0;
+
+    for(uint32_t i = 0; i < old_capacity; ++i) {
+        if(old_records[i].used) {
+            insert_record(index, &old_records[i]);
+        }
+    }
+    free(old_records);
+}
+
+
+// Total times the contents were sent, under any modification time
+static uint32_t sent_count(const sent_index* index, const sent_record* content) {
+    uint32_t count = 0;
+    for(uint32_t slot = slot_of(index, content->size, content->head); index->records[slot].used; slot = next_slot(index, slot)) {
+        const sent_record* record = &index->records[slot];
+        if(record->size == content->size && record->head == content->head && record->hash == content->hash) {
+            count += record->count;
+        }
+    }
+    return count;
+}
+
+
+void init_content_hash(content_hash* hash) {
+    debug_assert(hash);
+
+    hash->hash      = FNV64_OFFSET;
+    hash->head      = FNV64_OFFSET;
+    hash->nbytes    = 0;
+}
+
+
+void content_hash_update(content_hash* hash, const uint8_t* data, size_t nbytes) {
+    debug_assert(hash && (data || nbytes == 0));
+
+    if(hash->nbytes < SENT_INDEX_HEAD_SIZE) {
+        size_t head_bytes = SENT_INDEX_HEAD_SIZE - hash->nbytes;
+        if(head_bytes > nbytes) {
+            head_bytes = nbytes;
+        }
+        hash->head = fnv1a(hash->head, data, head_bytes);
+    }
+    hash->hash      = fnv1a(hash->hash, data, nbytes);
+    hash->nbytes   += nbytes;
+}
+
+
+bool content_hash_file(int fd, content_hash* hash) {
+    debug_assert(hash);
+
+    uint8_t* buffer = malloc(HASH_READ_SIZE);
+    assert_M(buffer, "Failed to allocate hash buffer");
+
+    init_content_hash(hash);
+
+    ssize_t nbytes = 0;
+    while((nbytes = pread(fd, buffer, HASH_READ_SIZE, hash->nbytes)) > 0) {
+        content_hash_update(hash, buffer, nbytes);
+    }
+    free(buffer);
+
+    return nbytes == 0;
+}
+
+
+bool open_sent_index(sent_index* index, const char* path) {
+    debug_assert(index && path);
+
+    memset(index, 0x00, sizeof(sent_index));
+
+    index->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(index->fd < 0) {
+        log_error("Failed to open sent index %s: %s", path, strerror(errno));
+        return false;
+    }
+    // Two transmitters updating the same index would corrupt it
+    if(flock(index->fd, LOCK_EX | LOCK_NB) < 0) {
+        log_error("Sent index %s is in use: %s", path, strerror(errno));
+        close(index->fd);
+        return false;
+    }
+
+    struct stat st;
+    fstat(index->fd, &st);
+
+    if(st.st_size == 0) {
+        int status = ftruncate(index->fd, map_size_for(SENT_INDEX_CAPACITY_MIN));
+        if(status < 0) {
+            log_error("Failed to create sent index %s: %s", path, strerror(errno));
+            close(index->fd);
+            return false;
+        }
+        map_index(index, map_size_for(SENT_INDEX_CAPACITY_MIN));
+
+        memcpy(index->header->magic, SENT_INDEX_MAGIC, sizeof(index->header->magic));
+        index->header->version  = SENT_INDEX_VERSION;
+        index->header->capacity = SENT_INDEX_CAPACITY_MIN;
+        index->header->count    = 0;
+        return true;
+    }
+
+    const sent_index_header* header = NULL;
+    if((size_t) st.st_size >= sizeof(sent_index_header)) {
+        map_index(index, st.st_size);
+        header = index->header;
+    }
+    if(!header
+        || memcmp(header->magic, SENT_INDEX_MAGIC, sizeof(header->magic)) != 0
+        || header->version != SENT_INDEX_VERSION
+        || header->capacity < SENT_INDEX_CAPACITY_MIN
+        || (header->capacity & (header->capacity - 1)) != 0
+        || map_size_for(header->capacity) != (size_t) st.st_size
+        || header->count >= header->capacity)
+    {
+        log_error("%s is not a sent index", path);
+        close_sent_index(index);
+        return false;
+    }
+    log_info("Sent index %s holds %d records", path, header->count);
+    return true;
+}
+
+
+void close_sent_index(sent_index* index) {
+    debug_assert(index);
+
+    if(index->header) {
+        msync(index->header, index->map_size, MS_SYNC);
+        munmap(index->header, index->map_size);
+    }
+    if(index->fd >= 0) {
+        close(index->fd);
+    }
+    index->header   = NULL;
+    index->records  = NULL;
+    index->fd       = -1;
+}
+
+
+sent_status_t sent_index_lookup(sent_index* index, int fd, const struct stat* st, uint32_t* count) {
+    debug_assert(index && index->header && st);
+
+    ++index->stats.lookups;
+
+    uint8_t head_buffer[SENT_INDEX_HEAD_SIZE];
+    size_t head_size = (st->st_size < SENT_INDEX_HEAD_SIZE) ? st->st_size : SENT_INDEX_HEAD_SIZE;
+
+    if(pread(fd, head_buffer, head_size, 0) != (ssize_t) head_size) {
+        return SENT_NEVER;
+    }
+    content_hash head;
+    init_content_hash(&head);
+    content_hash_update(&head, head_buffer, head_size);
+
+    uint64_t size   = st->st_size;
+    int64_t mtime   = mtime_ns(st);
+    bool candidates = false;
+
+    for(uint32_t slot = slot_of(index, size, head.head); index->records[slot].used; slot = next_slot(index, slot)) {
+        const sent_record* record = &index->records[slot];
+        if(record->size == size && record->head == head.head) {
+            candidates = true;
+            if(record->mtime_ns == mtime) {
+                ++index->stats.unchanged;
+                if(count) {
+                    *count = sent_count(index, record);
+                }
+                return SENT_UNCHANGED;
+            }
+        }
+    }
+    if(!candidates) {
+        return SENT_NEVER;
+    }
+
+    // Something with the same size and head was sent, compare everything
+    content_hash full;
+    ++index->stats.full_hashes;
+    if(!content_hash_file(fd, &full) || full.nbytes != size) {
+        return SENT_NEVER;
+    }
+
+    sent_record alias = {
+        .hash       = full.hash,
+        .head       = full.head,
+        .size       = size,
+        .mtime_ns   = mtime,
+        .count      = 0,
+        .used       = 1
+    };
+    uint32_t sent = sent_count(index, &alias);
+    if(sent == 0) {
+        return SENT_NEVER;
+    }
+
+    if((index->header->count + 1) * 4 > index->header->capacity * 3) {
+        grow(index);
+    }
+    insert_record(index, &alias);
+    msync(index->header, index->map_size, MS_ASYNC);
+
+    ++index->stats.duplicates;
+    if(count) {
+        *count = sent;
+    }
+    return SENT_DUPLICATE;
+}
+
+
+void sent_index_record(sent_index* index, const content_hash* hash, const struct stat* st) {
+    debug_assert(index && index->header && hash && st);
+
+    if(hash->nbytes != (uint64_t) st->st_size) {
+        log_warning("File changed while it was sent, not adding it to the sent index");
+        return;
+    }
+
+    sent_record record = {
+        .hash       = hash->hash,
+        .head       = hash->head,
+        .size       = st->st_size,
+        .mtime_ns   = mtime_ns(st),
+        .count      = 1,
+        .used       = 1
+    };
+
+    for(uint32_t slot = slot_of(index, record.size, record.head); index->records[slot].used; slot = next_slot(index, slot)) {
+        sent_record* existing = &index->records[slot];
+        if(existing->size == record.size && existing->head == record.head
+            && existing->hash == record.hash && existing->mtime_ns == record.mtime_ns)
+        {
+            ++existing->count;
+            ++index->stats.recorded;
+            msync(index->header, index->map_size, MS_ASYNC);
+            return;
+        }
+    }
+
+    if((index->header->count + 1) * 4 > index->header->capacity * 3) {
+        grow(index);
+    }
+    insert_record(index, &record);
+    ++index->stats.recorded;
+    msync(index->header, index->map_size, MS_ASYNC);
+}
@@ -0,0 +1,196 @@
+/**
+ *  sentindex.h
+ * 
+ *  DESCRIPTION: Persistent index of the files that have been transmitted,
+ *  keyed by their content. Lets tx skip files it already sent before a
+ *  restart, or that were written again under a different name.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: The index is a hash table in a memory mapped file. Records are
+ *  bucketed by file size and a hash of the first SENT_INDEX_HEAD_SIZE bytes,
+ *  each holds the hash of the full contents, the modification time, and how
+ *  many times it was sent. A lookup only reads the head of the file. The
+ *  full contents are only hashed when a record with the same size and head
+ *  but a different modification time exists, otherwise the hash is built up
+ *  from the bytes as they're transmitted, see content_hash_update().
+ * 
+ */
+
+
+#ifndef LIBDXWIFI_SENTINDEX_H
+#define LIBDXWIFI_SENTINDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+#define SENT_INDEX_MAGIC        "DXSENTIX"
+#define SENT_INDEX_VERSION      1
+#define SENT_INDEX_CAPACITY_MIN 1024
+#define SENT_INDEX_HEAD_SIZE    4096
+
+
+typedef enum {
+    SENT_NEVER,                 /* Contents were never sent                 */
+    SENT_UNCHANGED,             /* This exact file was already sent         */
+    SENT_DUPLICATE,             /* Same contents were sent as another file  */
+} sent_status_t;
+
+
+// Hash of a file's contents built up a piece at a time
+typedef struct {
+    uint64_t    hash;           /* Hash of every byte so far                */
+    uint64_t    head;           /* Hash of the first SENT_INDEX_HEAD_SIZE   */
+    uint64_t    nbytes;         /* Number of bytes hashed                   */
+} content_hash;
+
+
+typedef struct {
+    uint64_t    hash;           /* Hash of the full contents                */
+    uint64_t    head;           /* Hash of the first SENT_INDEX_HEAD_SIZE   */
+    uint64_t    size;           /* Size of the file                         */
+    int64_t     mtime_ns;       /* Modification time of the file            */
+    uint32_t    count;          /* Number of times it was transmitted       */
+    uint32_t    used;           /* Slot holds a record                      */
+} sent_record;
+
+
+typedef struct {
+    char        magic[8];       /* SENT_INDEX_MAGIC, not null terminated    */
+    uint32_t    version;        /* SENT_INDEX_VERSION                       */
+    uint32_t    capacity;       /* Number of record slots, a power of two   */
+    uint32_t    count;          /* Number of slots in use                   */
+    uint32_t    reserved;
+} sent_index_header;
+
+
+typedef struct {
+    uint32_t    lookups;        /* Files looked up                          */
+    uint32_t    unchanged;      /* Files found unchanged                    */
+    uint32_t    duplicates;     /* Files found with contents already sent   */
+    uint32_t    full_hashes;    /* Files whose contents had to be read      */
+    uint32_t    recorded;       /* Transmissions recorded                   */
+} sent_index_stats;
+
+
+typedef struct {
+    int                 fd;         /* Index file                           */
+    size_t              map_size;   /* Bytes mapped                         */
+    sent_index_header*  header;     /* Start of the mapping                 */
+    sent_record*        records;    /* Record slots, follow the header      */
+    sent_index_stats    stats;      /* Counters since the index was opened  */
+} sent_index;
+
+
+/**
+ *  DESCRIPTION:    Starts a new content hash
+ * 
+ */
+void init_content_hash(content_hash* hash);
+
+
+/**
+ *  DESCRIPTION:    Adds the next bytes of the file to the hash
+ * 
+ *  ARGUMENTS:
+ * 
+ *      hash:       Initialized hash
+ * 
+ *      data:       Next bytes of the file
+ * 
+ *      nbytes:     Number of bytes
+ * 
+ */
+void content_hash_update(content_hash* hash, const uint8_t* data, size_t nbytes);
+
+
+/**
+ *  DESCRIPTION:    Opens an index, creating it if the file doesn't exist
+ * 
+ *  ARGUMENTS:
+ * 
+ *      index:      Index to open
+ * 
+ *      path:       Path of the index file
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the file couldn't be opened or isn't an index
+ * 
+ */
+bool open_sent_index(sent_index* index, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Flushes and closes the index
+ * 
+ *  ARGUMENTS:
+ * 
+ *      index:      Opened index
+ * 
+ */
+void close_sent_index(sent_index* index);
+
+
+/**
+ *  DESCRIPTION:    Checks if a file, or a file with the same contents, was
+ *                  already sent
+ * 
+ *  ARGUMENTS:
+ * 
+ *      index:      Opened index
+ * 
+ *      fd:         File descriptor of the file, only read with pread()
+ * 
+ *      st:         Status of the file
+ * 
+ *      count:      Set to how many times the contents were sent, if not NULL
+ * 
+ *  RETURNS:
+ * 
+ *      sent_status_t: Whether the file was sent before
+ * 
+ *  NOTES: A duplicate is recorded under its own modification time so it's
+ *  found without reading it again next time.
+ * 
+ */
+sent_status_t sent_index_lookup(sent_index* index, int fd, const struct stat* st, uint32_t* count);
+
+
+/**
+ *  DESCRIPTION:    Records that a file was transmitted
+ * 
+ *  ARGUMENTS:
+ * 
+ *      index:      Opened index
+ * 
+ *      hash:       Hash of every byte of the file
+ * 
+ *      st:         Status of the file once it was transmitted
+ * 
+ */
+void sent_index_record(sent_index* index, const content_hash* hash, const struct stat* st);
+
+
+/**
+ *  DESCRIPTION:    Hashes the full contents of a file
+ * 
+ *  ARGUMENTS:
+ * 
+ *      fd:         File descriptor of the file, only read with pread()
+ * 
+ *      hash:       Set to the hash of the file
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the file couldn't be read
+ * 
+ */
+bool content_hash_file(int fd, content_hash* hash);
+
+
+#endif // LIBDXWIFI_SENTINDEX_H
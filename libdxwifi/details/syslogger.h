@@ -11,6 +11,7 @@
 #define LIBDXWIFI_SYSLOGGER_H
 
 #include <syslog.h>
+#include <pthread.h>
 
 #include <libdxwifi/details/logging.h>
 
@@ -45,21 +46,32 @@ static inline int dxwifi_log_level_to_syslog(dxwifi_log_level_t log_level) {
 }
 
 
+/**
+ *  DESCRIPTION:    Opens the connection to syslog, only done once per process
+ * 
+ */
+static inline void open_syslog(void) {
+    openlog("dxwifi", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_USER);
+}
+
+
 /**
  *  DESCRIPTION:    Syslog adapter for the DxWiFI logging facade. See logging.h
  *                  for description of arguments
  * 
+ *  NOTES:          The connection is opened on the first message and left 
+ *                  open, vsyslog is safe to call from any thread after that
+ * 
  */
-void syslogger(dxwifi_log_module_t module, dxwifi_log_level_t log_level, const char* fmt, va_list args) {
+static inline void syslogger(dxwifi_log_module_t module, dxwifi_log_level_t log_level, const char* fmt, va_list args) {
     __DXWIFI_UTILS_UNUSED(module);
 
-    openlog("dxwifi", LOG_CONS | LOG_PID, LOG_USER);
+    static pthread_once_t syslog_opened = PTHREAD_ONCE_INIT;
+    pthread_once(&syslog_opened, open_syslog);
 
     int priority = LOG_MAKEPRI(LOG_USER, dxwifi_log_level_to_syslog(log_level));
 
     vsyslog(priority, fmt, args);
-
-    closelog();
 }
 
 
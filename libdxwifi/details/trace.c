@@ -0,0 +1,261 @@
+/**
+ *  trace.c
+ * 
+ *  DESCRIPTION: See trace.h for details
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+
+
+static size_t record_size_for(size_t snaplen) {
+    return sizeof(dxwifi_trace_record) + ((snaplen + 7) & ~((size_t) 7));
+}
+
+
+/**
+ *  DESCRIPTION:    Smallest power of two no less than @n, 0 if there's none
+ * 
+ */
+static size_t round_up_pow2(size_t n) {
+    size_t pow2 = 1;
+    while(pow2 < n) {
+        if(pow2 > SIZE_MAX / 2) {
+            return 0;
+        }
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+
+static inline dxwifi_trace_record* record_at(const dxwifi_trace* trace, uint64_t event) {
+    uint64_t slot = event & (trace->header->capacity - 1);
+    return (dxwifi_trace_record*) (trace->records + slot * trace->header->record_size);
+}
+
+
+bool open_frame_trace(dxwifi_trace* trace, const char* path, size_t capacity, size_t snaplen) {
+    debug_assert(trace && path && capacity > 0);
+
+    memset(trace, 0x00, sizeof(dxwifi_trace));
+    trace->fd = -1;
+
+    if(snaplen > DXWIFI_TRACE_SNAPLEN_MAX) {
+        log_warning("Trace snaplen of %ld is too large, using %d", snaplen, DXWIFI_TRACE_SNAPLEN_MAX);
+        snaplen = DXWIFI_TRACE_SNAPLEN_MAX;
+    }
+    if(capacity > DXWIFI_TRACE_CAPACITY_MAX || (capacity = round_up_pow2(capacity)) == 0) {
+        log_error("Trace capacity of %ld records is too large, at most %d", capacity, DXWIFI_TRACE_CAPACITY_MAX);
+        return false;
+    }
+
+    size_t record_size  = record_size_for(snaplen);
+    size_t size         = 0;
+    if(__builtin_mul_overflow(capacity, record_size, &size) || __builtin_add_overflow(size, sizeof(dxwifi_trace_header), &size)) {
+        log_error("Trace of %ld records of %ld bytes is too large", capacity, record_size);
+        return false;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        log_error("Failed to open frame trace %s: %s", path, strerror(errno));
+        return false;
+    }
+    if(ftruncate(fd, size) < 0) {
+        log_error("Failed to create frame trace %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED) {
+        log_error("Failed to map frame trace %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    // The file starts out zeroed, so no record is complete until written
+    dxwifi_trace_header* header = map;
+    memcpy(header->magic, DXWIFI_TRACE_MAGIC, sizeof(DXWIFI_TRACE_MAGIC));
+    header->version     = DXWIFI_TRACE_VERSION;
+    header->record_size = record_size;
+    header->capacity    = capacity;
+    header->snaplen     = snaplen;
+    header->head        = 0;
+
+    trace->fd       = fd;
+    trace->size     = size;
+    trace->header   = header;
+    trace->records  = (uint8_t*) map + sizeof(dxwifi_trace_header);
+
+    log_info("Tracing frames into %s (%ld records of %ld bytes)", path, capacity, record_size);
+    return true;
+}
+
+
+void close_frame_trace(dxwifi_trace* trace) {
+    debug_assert(trace);
+
+    if(!trace->header) {
+        return;
+    }
+    log_info("Recorded %lu frame events", trace->header->head);
+
+    unload_frame_trace(trace);
+}
+
+
+void __trace_frame(const dxwifi_trace* trace, dxwifi_trace_stage_t stage, int32_t frame_no, int32_t status, const uint8_t* frame, size_t length) {
+    debug_assert(trace && trace->header);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint64_t event = __atomic_fetch_add(&trace->header->head, 1, __ATOMIC_RELAXED);
+    dxwifi_trace_record* record = record_at(trace, event);
+
+    // Marked incomplete while it's filled in, in case a reader looks at it
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    size_t captured = (length < trace->header->snaplen ? length : trace->header->snaplen);
+
+    record->timestamp   = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    record->frame_no    = frame_no;
+    record->status      = status;
+    record->length      = length;
+    record->stage       = stage;
+    record->captured    = captured;
+    memcpy(record->data, frame, captured);
+
+    __atomic_store_n(&record->sequence, event + 1, __ATOMIC_RELEASE);
+}
+
+
+bool load_frame_trace(dxwifi_trace* trace, const char* path) {
+    debug_assert(trace && path);
+
+    memset(trace, 0x00, sizeof(dxwifi_trace));
+    trace->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(trace->fd < 0) {
+        log_error("Failed to open frame trace %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(trace->fd, &st) < 0) {
+        log_error("Failed to stat frame trace %s: %s", path, strerror(errno));
+        unload_frame_trace(trace);
+        return false;
+    }
+
+    const char* problem = NULL;
+    if((size_t) st.st_size < sizeof(dxwifi_trace_header)) {
+        problem = "too short";
+    }
+    else {
+        trace->size = st.st_size;
+        void* map = mmap(NULL, trace->size, PROT_READ, MAP_SHARED, trace->fd, 0);
+        if(map == MAP_FAILED) {
+            log_error("Failed to map frame trace %s: %s", path, strerror(errno));
+            unload_frame_trace(trace);
+            return false;
+        }
+        trace->header   = map;
+        trace->records  = (uint8_t*) map + sizeof(dxwifi_trace_header);
+
+        const dxwifi_trace_header* header = trace->header;
+        if(memcmp(header->magic, DXWIFI_TRACE_MAGIC, sizeof(DXWIFI_TRACE_MAGIC)) != 0) {
+            problem = "not a frame trace";
+        }
+        else if(header->version != DXWIFI_TRACE_VERSION) {
+            problem = "from an unsupported version";
+        }
+        else if(header->capacity == 0
+            || header->capacity > DXWIFI_TRACE_CAPACITY_MAX
+            || (header->capacity & (header->capacity - 1)) != 0
+            || header->snaplen > DXWIFI_TRACE_SNAPLEN_MAX
+            || header->record_size != record_size_for(header->snaplen)
+            || trace->size != sizeof(dxwifi_trace_header) + header->capacity * header->record_size)
+        {
+            problem = "damaged";
+        }
+    }
+    if(problem) {
+        log_error("Frame trace %s is %s", path, problem);
+        unload_frame_trace(trace);
+        return false;
+    }
+    return true;
+}
+
+
+void unload_frame_trace(dxwifi_trace* trace) {
+    debug_assert(trace);
+
+    if(trace->header) {
+        munmap(trace->header, trace->size);
+    }
+    if(trace->fd >= 0) {
+        close(trace->fd);
+    }
+    trace->header   = NULL;
+    trace->records  = NULL;
+    trace->fd       = -1;
+}
+
+
+uint64_t frame_trace_first(const dxwifi_trace* trace) {
+    debug_assert(trace && trace->header);
+
+    uint64_t head = __atomic_load_n(&trace->header->head, __ATOMIC_ACQUIRE);
+    return (head > trace->header->capacity ? head - trace->header->capacity : 0);
+}
+
+
+const dxwifi_trace_record* frame_trace_record(const dxwifi_trace* trace, uint64_t event) {
+    debug_assert(trace && trace->header);
+
+    const dxwifi_trace_record* record = record_at(trace, event);
+
+    bool complete = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) == event + 1
+        && record->stage < DXWIFI_TRACE_STAGE_COUNT
+        && record->captured <= trace->header->snaplen;
+
+    return (complete ? record : NULL);
+}
+
+
+const char* trace_stage_to_str(dxwifi_trace_stage_t stage) {
+    switch (stage)
+    {
+    case DXWIFI_TRACE_TX_DATA:
+        return "tx data";
+
+    case DXWIFI_TRACE_TX_CONTROL:
+        return "tx control";
+
+    case DXWIFI_TRACE_RX_DATA:
+        return "rx data";
+
+    case DXWIFI_TRACE_RX_CONTROL:
+        return "rx control";
+
+    default:
+        return "unknown";
+    }
+}
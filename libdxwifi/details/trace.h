@@ -0,0 +1,204 @@
+/**
+ *  trace.h
+ * 
+ *  DESCRIPTION: Binary per-frame trace. Every frame the transmitter injects
+ *  or the receiver captures can be recorded as a fixed size event, with a
+ *  timestamp, the frame's size and number and optionally its first few
+ *  bytes, into a ring in a memory mapped file. Recording an event is a few
+ *  stores to memory, no formatting and no system calls, so it can stay on
+ *  for a whole pass. dxwifi-trace turns a trace into text or pcapng after the
+ *  fact.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ *  NOTES: A trace records the frames of the transmitters and receivers it's
+ *  attached to, several can share one since recording is lock free. The ring
+ *  keeps the latest `capacity` events, older ones
+ *  are overwritten. Since the file is shared with the kernel's page cache
+ *  the events written before a crash are still there, a record that was cut
+ *  off part way through is skipped when the trace is read. Transmitters and
+ *  receivers must be closed before their trace is.
+ * 
+ */
+
+#ifndef LIBDXWIFI_TRACE_H
+#define LIBDXWIFI_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define DXWIFI_TRACE_MAGIC          "DXTRACE"
+#define DXWIFI_TRACE_VERSION        1
+#define DXWIFI_TRACE_CAPACITY_DFLT  65536   /* Events the ring holds            */
+#define DXWIFI_TRACE_CAPACITY_MAX   16777216 /* Most events a ring can hold     */
+#define DXWIFI_TRACE_SNAPLEN_DFLT   64      /* Bytes of each frame recorded     */
+#define DXWIFI_TRACE_SNAPLEN_MAX    4096    /* Most bytes of a frame recorded   */
+
+
+typedef enum {
+    DXWIFI_TRACE_TX_DATA,       /* Data frame injected                      */
+    DXWIFI_TRACE_TX_CONTROL,    /* Control frame injected                   */
+    DXWIFI_TRACE_RX_DATA,       /* Data frame captured                      */
+    DXWIFI_TRACE_RX_CONTROL,    /* Control frame captured                   */
+    DXWIFI_TRACE_STAGE_COUNT
+} dxwifi_trace_stage_t;
+
+
+typedef struct {
+    char        magic[8];       /* DXWIFI_TRACE_MAGIC, null terminated      */
+    uint32_t    version;        /* DXWIFI_TRACE_VERSION                     */
+    uint32_t    record_size;    /* Bytes per record, including the data     */
+    uint64_t    capacity;       /* Records in the ring, a power of two      */
+    uint32_t    snaplen;        /* Most bytes of a frame in a record        */
+    uint32_t    reserved;
+    uint64_t    head;           /* Events recorded since the trace opened   */
+    uint8_t     padding[24];
+} dxwifi_trace_header;
+
+
+typedef struct {
+    uint64_t    sequence;       /* Event number plus one once complete      */
+    uint64_t    timestamp;      /* Wall clock time in nanoseconds           */
+    int32_t     frame_no;       /* Frame number or the control frame type   */
+    int32_t     status;         /* Result of the injection, 0 on capture    */
+    uint32_t    length;         /* Size of the whole frame                  */
+    uint16_t    stage;          /* dxwifi_trace_stage_t                     */
+    uint16_t    captured;       /* Bytes of the frame that follow           */
+    uint8_t     data[];
+} dxwifi_trace_record;
+
+
+typedef struct {
+    int                     fd;         /* Trace file                       */
+    size_t                  size;       /* Bytes mapped                     */
+    dxwifi_trace_header*    header;     /* Start of the mapping             */
+    uint8_t*                records;    /* First record in the ring         */
+} dxwifi_trace;
+
+
+/**
+ *  DESCRIPTION:    Creates a trace file to record frames into
+ * 
+ *  ARGUMENTS:
+ * 
+ *      trace:      Trace to open, attach it to a transmitter or receiver to
+ *                  record its frames
+ * 
+ *      path:       File to record into, truncated if it exists
+ * 
+ *      capacity:   Records the ring holds, rounded up to a power of two, up
+ *                  to DXWIFI_TRACE_CAPACITY_MAX
+ * 
+ *      snaplen:    Most bytes of each frame to record, up to
+ *                  DXWIFI_TRACE_SNAPLEN_MAX
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the capacity is too large or the file couldn't be
+ *                  created
+ * 
+ */
+bool open_frame_trace(dxwifi_trace* trace, const char* path, size_t capacity, size_t snaplen);
+
+
+/**
+ *  DESCRIPTION:    Stops recording and closes the trace file. Safe to call
+ *                  more than once.
+ * 
+ */
+void close_frame_trace(dxwifi_trace* trace);
+
+
+/**
+ *  DESCRIPTION:    Records a frame event, see trace_frame()
+ * 
+ */
+void __trace_frame(const dxwifi_trace* trace, dxwifi_trace_stage_t stage, int32_t frame_no, int32_t status, const uint8_t* frame, size_t length);
+
+
+/**
+ *  DESCRIPTION:    Records a frame event into a trace, if there's one
+ * 
+ *  ARGUMENTS:
+ * 
+ *      trace:      Open trace or NULL when frames aren't traced
+ * 
+ *      stage:      Where the frame was seen
+ * 
+ *      frame_no:   Number of the frame, or its dxwifi_control_frame_t for
+ *                  control stages
+ * 
+ *      status:     Result of injecting the frame, 0 for captured frames
+ * 
+ *      frame:      The whole frame, radiotap header first
+ * 
+ *      length:     Size of the frame
+ * 
+ */
+static inline void trace_frame(const dxwifi_trace* trace, dxwifi_trace_stage_t stage, int32_t frame_no, int32_t status, const uint8_t* frame, size_t length) {
+    if(trace) {
+        __trace_frame(trace, stage, frame_no, status, frame, length);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Maps a trace file for reading
+ * 
+ *  ARGUMENTS:
+ * 
+ *      trace:      Trace to load into
+ * 
+ *      path:       Trace file
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the file couldn't be read or isn't a trace
+ * 
+ */
+bool load_frame_trace(dxwifi_trace* trace, const char* path);
+
+
+/**
+ *  DESCRIPTION:    Unmaps a trace loaded with load_frame_trace
+ * 
+ */
+void unload_frame_trace(dxwifi_trace* trace);
+
+
+/**
+ *  DESCRIPTION:    Number of the oldest event still in the ring
+ * 
+ */
+uint64_t frame_trace_first(const dxwifi_trace* trace);
+
+
+/**
+ *  DESCRIPTION:    Looks up an event in a loaded trace
+ * 
+ *  ARGUMENTS:
+ * 
+ *      trace:      Loaded trace
+ * 
+ *      event:      Event number, from frame_trace_first() up to the header's
+ *                  head
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_trace_record*: The event, or NULL if it was overwritten or
+ *                  never finished
+ * 
+ */
+const dxwifi_trace_record* frame_trace_record(const dxwifi_trace* trace, uint64_t event);
+
+
+/**
+ *  DESCRIPTION:    Name of a trace stage, for the decoder
+ * 
+ */
+const char* trace_stage_to_str(dxwifi_trace_stage_t stage);
+
+
+#endif // LIBDXWIFI_TRACE_H
@@ -0,0 +1,216 @@
+/**
+ *  units.c
+ * 
+ *  DESCRIPTION: See units.h for description
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#include <string.h>
+
+#include <arpa/inet.h>
+
+#include <libdxwifi/details/assert.h>
+#include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/units.h>
+
+
+/**
+ *  DESCRIPTION:    Discards the unit currently being reassembled
+ * 
+ *  ARGUMENTS:
+ * 
+ *      r:          Initialized reassembler
+ * 
+ *      reason:     Why the unit is being dropped, for logging
+ * 
+ */
+static void drop_unit(unit_reassembler* r, const char* reason) {
+    if(r->in_unit) {
+        log_debug("Dropped unit %u (%ld bytes received): %s", r->unit, r->length, reason);
+        ++r->stats.units_dropped;
+    }
+    r->in_unit  = false;
+    r->length   = 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Appends fragment data to the reassembly buffer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      r:          Initialized reassembler
+ * 
+ *      data:       Fragment data
+ * 
+ *      size:       Size of the fragment data
+ * 
+ *  RETURNS:
+ * 
+ *      bool:       false if the unit would exceed the maximum unit size
+ * 
+ */
+static bool append_fragment(unit_reassembler* r, const uint8_t* data, size_t size) {
+    if(r->length + size > r->capacity) {
+        size_t capacity = r->capacity;
+        while(capacity < r->length + size && capacity < r->capacity_max) {
+            capacity *= 2;
+        }
+        if(capacity < r->length + size) {
+            return false;
+        }
+        uint8_t* buffer = realloc(r->buffer, capacity);
+        assert_M(buffer, "Failed to grow reassembly buffer to %ld bytes", capacity);
+
+        r->buffer   = buffer;
+        r->capacity = capacity;
+    }
+    memcpy(r->buffer + r->length, data, size);
+    r->length += size;
+    return true;
+}
+
+
+//
+// See units.h for description of non-static functions
+//
+
+void reset_unit_fragmenter(unit_fragmenter* f) {
+    debug_assert(f);
+
+    f->frag_offset  = 0;
+    f->repeats_left = 0;
+}
+
+
+size_t unit_fragmenter_next(unit_fragmenter* f, const uint8_t* unit, size_t unit_len, uint32_t index, 
+                            uint8_t type, uint8_t flags, unsigned repeats, uint8_t* payload, size_t blocksize, bool* unit_done) {
+    debug_assert(f && unit && payload && unit_done && blocksize > sizeof(dxwifi_unit_hdr));
+
+    dxwifi_unit_hdr* hdr = (dxwifi_unit_hdr*) payload;
+
+    size_t remaining    = unit_len - f->frag_offset;
+    size_t frag_len     = blocksize - sizeof(dxwifi_unit_hdr);
+
+    if(frag_len > remaining) {
+        frag_len = remaining;
+    }
+
+    hdr->seq    = htonl(f->seq);
+    hdr->unit   = htonl(index);
+    hdr->type   = type;
+    hdr->flags  = flags
+                | (f->frag_offset == 0  ? DXWIFI_UNIT_F_START : 0)
+                | (frag_len == remaining ? DXWIFI_UNIT_F_END   : 0);
+
+    memcpy(payload + sizeof(dxwifi_unit_hdr), unit + f->frag_offset, frag_len);
+
+    if(f->repeats_left > 0) {
+        --f->repeats_left;
+        ++f->stats.repeats;
+    }
+    else {
+        f->repeats_left = repeats;
+        ++f->stats.fragments;
+    }
+
+    // Last copy of this fragment, move on to the next one
+    *unit_done = false;
+    if(f->repeats_left == 0) {
+        ++f->seq;
+        f->frag_offset += frag_len;
+        if(f->frag_offset == unit_len) {
+            f->frag_offset  = 0;
+            *unit_done      = true;
+        }
+    }
+    return sizeof(dxwifi_unit_hdr) + frag_len;
+}
+
+
+void init_unit_reassembler(unit_reassembler* r, size_t capacity, size_t capacity_max) {
+    debug_assert(r && capacity > 0 && capacity <= capacity_max);
+
+    memset(r, 0x00, sizeof(unit_reassembler));
+
+    r->capacity     = capacity;
+    r->capacity_max = capacity_max;
+    r->buffer       = malloc(capacity);
+    assert_M(r->buffer, "Failed to allocate reassembly buffer of size: %ld", capacity);
+}
+
+
+void teardown_unit_reassembler(unit_reassembler* r) {
+    debug_assert(r);
+
+    free(r->buffer);
+    r->buffer   = NULL;
+    r->capacity = 0;
+    r->length   = 0;
+    r->in_unit  = false;
+}
+
+
+void reset_unit_reassembler(unit_reassembler* r) {
+    debug_assert(r);
+
+    drop_unit(r, "transmission ended");
+    r->have_seq = false;
+    r->last_seq = 0;
+}
+
+
+bool unit_reassembler_push(unit_reassembler* r, const uint8_t* payload, size_t size) {
+    debug_assert(r && payload);
+
+    // Previous push completed a unit, start fresh
+    if(!r->in_unit) {
+        r->length = 0;
+    }
+
+    if(size < sizeof(dxwifi_unit_hdr)) {
+        ++r->stats.orphans;
+        return false;
+    }
+
+    const dxwifi_unit_hdr* hdr = (const dxwifi_unit_hdr*) payload;
+    uint32_t seq    = ntohl(hdr->seq);
+    uint32_t unit   = ntohl(hdr->unit);
+
+    if(r->have_seq && (int32_t)(seq - r->last_seq) <= 0) {
+        ++r->stats.duplicates;
+        return false;
+    }
+    if(r->have_seq && seq != r->last_seq + 1) {
+        drop_unit(r, "fragment lost");
+    }
+    r->have_seq = true;
+    r->last_seq = seq;
+
+    if(hdr->flags & DXWIFI_UNIT_F_START) {
+        drop_unit(r, "end of unit lost");
+        r->in_unit  = true;
+        r->unit     = unit;
+        r->type     = hdr->type;
+        r->flags    = hdr->flags;
+    }
+    else if(!r->in_unit || r->unit != unit) {
+        drop_unit(r, "start of unit lost");
+        ++r->stats.orphans;
+        return false;
+    }
+
+    if(!append_fragment(r, payload + sizeof(dxwifi_unit_hdr), size - sizeof(dxwifi_unit_hdr))) {
+        drop_unit(r, "unit too large");
+        return false;
+    }
+
+    if(hdr->flags & DXWIFI_UNIT_F_END) {
+        ++r->stats.units_complete;
+        r->in_unit = false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,182 @@
+/**
+ *  units.h
+ * 
+ *  DESCRIPTION: Fragmentation and reassembly for unit aware packetizers (see
+ *  dxwifi_unit_hdr in dxwifi.h). The fragmenter splits a unit over as many
+ *  payloads as needed, optionally repeating each fragment. The reassembler 
+ *  takes fragments in sequence order, discards redundant copies, and only 
+ *  reports a unit complete if every one of its fragments was received.
+ * 
+ *  https://github.com/oresat/oresat-dxwifi-software
+ * 
+ */
+
+#ifndef LIBDXWIFI_UNITS_H
+#define LIBDXWIFI_UNITS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include <libdxwifi/dxwifi.h>
+
+
+/************************
+ *  Data structures
+ ***********************/
+
+typedef struct {
+    uint32_t    fragments;      /* Number of unique fragments created       */
+    uint32_t    repeats;        /* Number of redundant fragments sent       */
+} unit_fragmenter_stats;
+
+
+typedef struct {
+    uint32_t    seq;            /* Next fragment sequence number            */
+    size_t      frag_offset;    /* Offset into the unit of next fragment    */
+    unsigned    repeats_left;   /* Copies left of the current fragment      */
+
+    unit_fragmenter_stats stats;
+} unit_fragmenter;
+
+
+typedef struct {
+    uint32_t    units_complete; /* Units received in full                   */
+    uint32_t    units_dropped;  /* Units missing one or more fragments      */
+    uint32_t    duplicates;     /* Redundant fragments discarded            */
+    uint32_t    orphans;        /* Fragments whose unit start was lost      */
+} unit_reassembler_stats;
+
+
+typedef struct {
+    uint8_t*    buffer;         /* Reassembly buffer                        */
+    size_t      capacity;       /* Size of the reassembly buffer            */
+    size_t      capacity_max;   /* Units larger than this are dropped       */
+    size_t      length;         /* Bytes of the current unit reassembled    */
+    bool        in_unit;        /* Currently reassembling a unit?           */
+    uint32_t    unit;           /* Index of the unit being reassembled      */
+    uint8_t     type;           /* Type of the unit being reassembled       */
+    uint8_t     flags;          /* Flags of the first fragment of the unit  */
+    bool        have_seq;       /* Received at least one fragment?          */
+    uint32_t    last_seq;       /* Sequence number of the last fragment     */
+
+    unit_reassembler_stats stats;
+} unit_reassembler;
+
+
+/************************
+ *  Functions
+ ***********************/
+
+
+/**
+ *  DESCRIPTION:    Resets the fragmenter for a new transmission
+ * 
+ *  ARGUMENTS:
+ * 
+ *      fragmenter:     Initialized fragmenter
+ * 
+ *  NOTES: Sequence numbers carry over between transmissions so the receiver
+ *  never mistakes the start of the next file for redundant copies.
+ * 
+ */
+void reset_unit_fragmenter(unit_fragmenter* fragmenter);
+
+
+/**
+ *  DESCRIPTION:    Fills the payload with a unit header and the next fragment
+ *                  of the unit. The fragmenter only advances past a fragment
+ *                  once all of its copies have been sent.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      fragmenter:     Initialized fragmenter
+ * 
+ *      unit:           Unit data
+ * 
+ *      unit_len:       Size of the unit
+ * 
+ *      index:          Index of the unit
+ * 
+ *      type:           Packetizer specific unit type
+ * 
+ *      flags:          Extra DXWIFI_UNIT_F_* flags, i.e. DXWIFI_UNIT_F_KEY
+ * 
+ *      repeats:        Number of extra copies to send of each fragment
+ * 
+ *      payload:        Frame payload to fill
+ * 
+ *      blocksize:      Maximum payload size
+ * 
+ *      unit_done:      Set to true once the last copy of the last fragment
+ *                      of the unit has been written
+ * 
+ *  RETURNS:
+ * 
+ *      size_t:         Size of the payload
+ * 
+ */
+size_t unit_fragmenter_next(unit_fragmenter* fragmenter, const uint8_t* unit, size_t unit_len, uint32_t index, 
+                            uint8_t type, uint8_t flags, unsigned repeats, uint8_t* payload, size_t blocksize, bool* unit_done);
+
+
+/**
+ *  DESCRIPTION:    Initializes the reassembler
+ * 
+ *  ARGUMENTS:
+ * 
+ *      reassembler:    Pointer to an allocated reassembler
+ * 
+ *      capacity:       Initial size of the reassembly buffer
+ * 
+ *      capacity_max:   Maximum size of a unit
+ * 
+ */
+void init_unit_reassembler(unit_reassembler* reassembler, size_t capacity, size_t capacity_max);
+
+
+/**
+ *  DESCRIPTION:    Tearsdown any resources associated with the reassembler
+ * 
+ *  ARGUMENTS:
+ * 
+ *      reassembler:    Initialized reassembler
+ * 
+ */
+void teardown_unit_reassembler(unit_reassembler* reassembler);
+
+
+/**
+ *  DESCRIPTION:    Drops any partial unit and resets the sequence tracking so
+ *                  the reassembler can be used for a new transmission
+ * 
+ *  ARGUMENTS:
+ * 
+ *      reassembler:    Initialized reassembler
+ * 
+ */
+void reset_unit_reassembler(unit_reassembler* reassembler);
+
+
+/**
+ *  DESCRIPTION:    Pushes the next received payload into the reassembler
+ * 
+ *  ARGUMENTS:
+ * 
+ *      reassembler:    Initialized reassembler
+ * 
+ *      payload:        Payload prefixed with a dxwifi_unit_hdr
+ * 
+ *      size:           Size of the payload
+ * 
+ *  RETURNS:
+ * 
+ *      bool:           true if the payload completed a unit. The unit data is
+ *                      then available in buffer/length, along with its unit
+ *                      index and type, until the next push.
+ * 
+ */
+bool unit_reassembler_push(unit_reassembler* reassembler, const uint8_t* payload, size_t size);
+
+
+#endif // LIBDXWIFI_UNITS_H
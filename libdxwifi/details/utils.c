@@ -63,6 +63,9 @@ const char* control_frame_type_to_str(dxwifi_control_frame_t type) {
     case DXWIFI_CONTROL_FRAME_EOT:
         return "EOT";
 
+    case DXWIFI_CONTROL_FRAME_RESUME:
+        return "Resume";
+
     case DXWIFI_CONTROL_FRAME_NONE:
         return "None";
 
@@ -88,7 +91,8 @@ int msleep(unsigned msec, bool require_elapsed) {
 
 
 void combine_path(char* buffer, size_t n, const char* path, const char* filename) {
-    if(rindex(path, '/')) {
+    size_t len = strlen(path);
+    if(len > 0 && path[len - 1] == '/') {
         snprintf(buffer, n, "%s%s", path, filename);
     }
     else {
@@ -10,6 +10,8 @@
 #ifndef LIBDXWIFI_H
 #define LIBDXWIFI_H
 
+#include <stdint.h>
+
 
 /************************
  *  Constants
@@ -26,6 +28,16 @@
 #define DXWIFI_BLOCK_SIZE_MIN (DXWIFI_FRAME_CONTROL_DATA_SIZE + 1)
 #define DXWIFI_BLOCK_SIZE_MAX 2048
 
+#define DXWIFI_UNIT_F_START 0x01    /* First fragment of a unit             */
+#define DXWIFI_UNIT_F_END   0x02    /* Last fragment of a unit              */
+#define DXWIFI_UNIT_F_KEY   0x04    /* Unit is required to decode the rest  */
+
+// Data frames can carry the wall clock time they were sent in microseconds, so
+// the receiver can tell how long they took to arrive. The low 48 bits of it 
+// are packed into the MAC header's addr3 field in network byte order, frames 
+// sent without one keep the broadcast address there.
+#define DXWIFI_SEND_TIME_BITS 48
+
 
 /************************
  *  Types
@@ -38,8 +50,39 @@
 typedef enum {
     DXWIFI_CONTROL_FRAME_NONE       = 0x00,
     DXWIFI_CONTROL_FRAME_PREAMBLE   = 0xff,
-    DXWIFI_CONTROL_FRAME_EOT        = 0xaa
+    DXWIFI_CONTROL_FRAME_EOT        = 0xaa,
+    DXWIFI_CONTROL_FRAME_RESUME     = 0x55
 } dxwifi_control_frame_t;
 
 
+/**
+ *  Sent in place of the preamble when a transmission picks up where an 
+ *  interrupted one left off, so the receiver continues the same file instead 
+ *  of starting a new one. The manifest fills the start of the control frame, 
+ *  the rest of the frame is DXWIFI_CONTROL_FRAME_RESUME. All fields are in 
+ *  network byte order.
+ */
+typedef struct __attribute__((packed)) {
+    uint64_t    file_id;    /* Identifies the file being transmitted    */
+    uint64_t    offset;     /* Byte offset of the first resumed block   */
+    uint32_t    block;      /* Index of the first resumed block         */
+} dxwifi_resume_manifest;
+
+
+/**
+ *  Unit aware packetizers split their input along natural boundaries (NAL 
+ *  units, restart intervals, etc.) instead of every blocksize bytes. Each 
+ *  payload is prefixed with a unit header so the receiver can reassemble the
+ *  fragments of a unit and discard units that weren't received in full. 
+ *  Redundant copies of a fragment share the same sequence number. All fields 
+ *  are in network byte order.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t    seq;        /* Fragment sequence number                 */
+    uint32_t    unit;       /* Index of the unit the fragment belongs to*/
+    uint8_t     flags;      /* DXWIFI_UNIT_F_* bitmask                  */
+    uint8_t     type;       /* Packetizer specific unit type            */
+} dxwifi_unit_hdr;
+
+
 #endif // LIBDXWIFI_H
\ No newline at end of file
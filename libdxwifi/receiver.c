@@ -7,12 +7,17 @@
  * 
  */
 
+#define DXWIFI_LOG_MODULE DXWIFI_LOG_RECEIVER
+
 #include <string.h>
+#include <inttypes.h>
 
 #include <time.h>
 #include <poll.h>
 #include <errno.h>
+#include <endian.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <arpa/inet.h>
 
@@ -21,6 +26,10 @@
 #include <libdxwifi/details/heap.h>
 #include <libdxwifi/details/assert.h>
 #include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+#include <libdxwifi/details/linkquality.h>
 
 
 #define DXWIFI_RX_PACKET_HEAP_CAPACITY ((DXWIFI_RX_PACKET_BUFFER_SIZE_MAX / DXWIFI_BLOCK_SIZE_MIN) + 1)
@@ -31,6 +40,8 @@ typedef struct {
     uint8_t*    data;           /* pointer to data inside the packet buffer   */
     ssize_t     size;           /* Size of the data frame                     */
     bool        crc_valid;      /* Was the attached crc correct?              */
+    uint64_t    buffered;       /* When it was buffered, 0 if not timed       */
+    int64_t     transit;        /* Send to capture, nanoseconds, -1 if unknown*/
 } packet_heap_node;
 
 
@@ -46,12 +57,38 @@ typedef struct {
     bool                    eot_reached;    /* EOT signalled?                 */
     bool                    preamble_recv;  /* Received preamble?             */
     bool                    end_capture;    /* eot && preamble?               */
+    bool                    resumed;        /* Received a resume manifest?    */
+    uint64_t                resume_offset;  /* Offset of the last resume      */
     const dxwifi_receiver*  rx;             /* Reference to owning receiver   */
     dxwifi_rx_stats         rx_stats;       /* Capture statistics             */
-    int                     fd;             /* Sink to write out data         */
+    dxwifi_link_quality     link;           /* Link quality estimate          */
+    const dxwifi_rx_sink*   sink;           /* Consumes the payload data      */
 } frame_controller;
 
 
+// State of the default sink, see dxwifi_rx_sink
+typedef struct {
+    const dxwifi_receiver*  rx;             /* Receiver settings              */
+    int                     fd;             /* File descriptor to write to    */
+} fd_sink;
+
+
+// State of a capture in progress, see receiver_begin_capture()
+struct dxwifi_rx_session {
+    frame_controller        fc;             /* Capture state                  */
+    dxwifi_rx_sink          sink;           /* Consumes the payload data      */
+    fd_sink                 fd_sink;        /* Default sink's state           */
+    struct pollfd           request;        /* Waits on the capture handle    */
+    time_t                  stats_sampled;  /* Last time pcap stats were read */
+    time_t                  link_reported;  /* Last link quality report time  */
+    dxwifi_link_stats       link_prev;      /* Link stats at the last report  */
+};
+
+
+// Shared by every receiver in the process, only held while compiling filters
+static pthread_mutex_t compile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
 /**
  *  DESCRIPTION:    Ordering function for the packet heap
  * 
@@ -87,6 +124,45 @@ static uint32_t extract_frame_number(ieee80211_hdr* mac_hdr) {
     return ntohl(*(uint32_t*)(mac_hdr->addr1 + 2));
 }
 
+
+/**
+ *  DESCRIPTION:    Time it took a frame to go from being sent to being 
+ *                  captured, from the send time packed into addr3
+ * 
+ *  ARGUMENTS:
+ * 
+ *      mac_hdr:    MAC header of the frame
+ * 
+ *      pkt_stats:  pcap's header for the frame
+ * 
+ *  RETURNS:
+ * 
+ *      int64_t:    Nanoseconds, -1 if the frame wasn't sent with a time
+ * 
+ *  NOTES: The capture time is pcap's timestamp. Live, that's when the kernel 
+ *  got the frame. Reading a savefile in a test build it's when the frame was 
+ *  dumped, which stands in for the air so latency can be measured offline. 
+ *  Only microseconds make it across, and the transmitter and receiver clocks 
+ *  have to be in sync, a frame that seems to come from the future took 0.
+ * 
+ */
+static int64_t extract_transit_time(const ieee80211_hdr* mac_hdr, const struct pcap_pkthdr* pkt_stats) {
+    const uint64_t mask = ((uint64_t) 1 << DXWIFI_SEND_TIME_BITS) - 1;
+
+    uint64_t sent = 0;
+    for(size_t i = 0; i < IEEE80211_MAC_ADDR_LEN; ++i) {
+        sent = (sent << 8) | mac_hdr->addr3[i];
+    }
+    if(sent == mask) {
+        return -1; // Still the broadcast address
+    }
+
+    // Both times wrap around at the same point, so only the difference matters
+    uint64_t captured = (uint64_t) pkt_stats->ts.tv_sec * 1000000 + pkt_stats->ts.tv_usec;
+    uint64_t transit = (captured - sent) & mask;
+    return transit <= (mask >> 1) ? (int64_t) transit * 1000 : 0;
+}
+
 /**
  *  DESCRIPTION:    Initializes and allocates any frame controller resources
  * 
@@ -96,22 +172,26 @@ static uint32_t extract_frame_number(ieee80211_hdr* mac_hdr) {
  * 
  *      rx:         Owning receiver object
  * 
- *      fd:         Sink to write out data to
+ *      sink:       Consumes the payload data
  * 
  */
-static void init_frame_controller(frame_controller* fc, const dxwifi_receiver* rx, int fd) {
-    debug_assert(fc);
+static void init_frame_controller(frame_controller* fc, const dxwifi_receiver* rx, const dxwifi_rx_sink* sink) {
+    debug_assert(fc && sink && sink->on_block);
 
     fc->index           = 0;
     fc->rx              = rx;
-    fc->fd              = fd;
+    fc->sink            = sink;
     fc->end_capture     = 0;
     fc->eot_reached     = false;
     fc->preamble_recv   = false;
+    fc->resumed         = false;
+    fc->resume_offset   = 0;
     fc->pb_size         = rx->packet_buffer_size;
 
     memset(&fc->rx_stats, 0x00, sizeof(dxwifi_rx_stats));
     fc->rx_stats.capture_state = DXWIFI_RX_NORMAL;
+
+    init_link_quality(&fc->link);
     
     fc->packet_buffer = calloc(fc->pb_size, sizeof(uint8_t));
     assert_M(fc->packet_buffer, "Failed to allocate Packet Buffer of size: %ld", fc->pb_size);
@@ -135,7 +215,7 @@ static void teardown_frame_controller(frame_controller* fc) {
     fc->packet_buffer   = NULL;
     fc->pb_size         = 0;
     fc->index           = 0;
-    fc->fd              = 0;
+    fc->sink            = NULL;
     memset(&fc->rx_stats, 0x00, sizeof(dxwifi_rx_stats));
 }
 
@@ -167,6 +247,18 @@ static dxwifi_rx_frame parse_rx_frame_fields(const struct pcap_pkthdr* pkt_stats
 }
 
 
+/**
+ *  DESCRIPTION:    Formats a capture timestamp into @buffer, returns @buffer
+ * 
+ */
+static const char* format_capture_time(time_t seconds, char* buffer, size_t size) {
+    struct tm time;
+    gmtime_r(&seconds, &time);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &time);
+    return buffer;
+}
+
+
 /**
  *  DESCRIPTION:    Verify if the captured data is a control frame and determine
  *                  what kind of control frame it is
@@ -183,16 +275,14 @@ static dxwifi_rx_frame parse_rx_frame_fields(const struct pcap_pkthdr* pkt_stats
 static void log_frame_stats(dxwifi_rx_frame* frame, int32_t frame_no, dxwifi_rx_stats* rx_stats) {
     debug_assert(frame && rx_stats);
 
+    // Called for every frame, the timestamp is only formatted when the 
+    // message isn't filtered, sampled or rate limited away
     char timestamp[256];
-    struct tm *time;
-
-    time = gmtime(&rx_stats->pkt_stats.ts.tv_sec);
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", time);
 
     log_debug(
         "%d - (%s) - (Capture Length=%d, Packet Length=%d)", 
         frame_no,
-        timestamp, 
+        format_capture_time(rx_stats->pkt_stats.ts.tv_sec, timestamp, sizeof(timestamp)), 
         rx_stats->pkt_stats.caplen, 
         rx_stats->pkt_stats.len
         );
@@ -200,6 +290,25 @@ static void log_frame_stats(dxwifi_rx_frame* frame, int32_t frame_no, dxwifi_rx_
 }
 
 
+/**
+ *  DESCRIPTION:    Checks if a control sized payload is a resume manifest, 
+ *                  everything after the manifest must be the resume marker
+ * 
+ *  ARGUMENTS:
+ * 
+ *      payload:    DXWIFI_FRAME_CONTROL_DATA_SIZE bytes of payload
+ * 
+ */
+static bool is_resume_frame(const uint8_t* payload) {
+    for(size_t i = sizeof(dxwifi_resume_manifest); i < DXWIFI_FRAME_CONTROL_DATA_SIZE; ++i) {
+        if(payload[i] != DXWIFI_CONTROL_FRAME_RESUME) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 /**
  *  DESCRIPTION:    Verify if the captured data is a control frame and determine
  *                  what kind of control frame it is
@@ -250,6 +359,9 @@ static dxwifi_control_frame_t check_frame_control(const uint8_t* frame, const st
         else if ((preamble / payload_size) > check_threshold) {
             type = DXWIFI_CONTROL_FRAME_PREAMBLE;
         }
+        else if (is_resume_frame(payload)) {
+            type = DXWIFI_CONTROL_FRAME_RESUME;
+        }
     }
     return type;
 }
@@ -279,6 +391,10 @@ static void handle_frame_control(frame_controller* fc, dxwifi_control_frame_t ty
         }
         else if(!fc->preamble_recv){
             log_info("Uplink established!");
+
+            if(fc->sink->on_file_start) {
+                fc->sink->on_file_start(NULL, fc->sink->user_args);
+            }
         }
         fc->preamble_recv = true;
         break;
@@ -289,6 +405,12 @@ static void handle_frame_control(frame_controller* fc, dxwifi_control_frame_t ty
         }
         fc->eot_reached = true;
         break;
+
+    case DXWIFI_CONTROL_FRAME_RESUME:
+        // Handled by resume_capture(), a resume never ends the capture
+        fc->preamble_recv   = true;
+        fc->eot_reached     = false;
+        break;
     
     default:
         debug_assert_always("Unkown control type");
@@ -298,7 +420,7 @@ static void handle_frame_control(frame_controller* fc, dxwifi_control_frame_t ty
 
 
 /**
- *  DESCRIPTION:    Write all the payload data recieved into a sink
+ *  DESCRIPTION:    Hands all the payload data recieved to the sink
  * 
  *  ARGUMENTS:
  * 
@@ -308,40 +430,181 @@ static void handle_frame_control(frame_controller* fc, dxwifi_control_frame_t ty
 static void dump_packet_buffer(frame_controller* fc) {
     debug_assert(fc);
 
-    int nbytes = 0;
     packet_heap_node node;
     int32_t expected_frame = ((packet_heap_node*)fc->packet_heap.tree)->frame_number;
+    const dxwifi_rx_sink* sink = fc->sink;
 
+    uint64_t start = latency_start(fc->rx->latency);
     while(heap_pop(&fc->packet_heap, &node)) {
+        latency_end(fc->rx->latency, DXWIFI_LATENCY_RX_HEAP, start);
+
+        uint64_t now = node.buffered ? latency_start(fc->rx->latency) : 0;
+        if(now) {
+            uint64_t held = now > node.buffered ? now - node.buffered : 0;
+            record_latency_value(fc->rx->latency, DXWIFI_LATENCY_RX_HOLD, held);
+            if(node.transit >= 0) {
+                record_latency_value(fc->rx->latency, DXWIFI_LATENCY_RX_DELIVERY, node.transit + held);
+            }
+        }
 
         // Data block is missing
         if(fc->rx->ordered && (expected_frame != node.frame_number)) { 
 
             int missing_blocks = (node.frame_number - expected_frame);
 
-            if(fc->rx->add_noise) {
-                uint8_t noise[node.size];
-
-                memset(noise, fc->rx->noise_value, sizeof(noise));
-
-                for(int i = 0; i < missing_blocks; ++i) {
-                    fc->rx_stats.total_noise_added += write(fc->fd, noise, sizeof(noise));
-                }
+            if(sink->on_gap) {
+                start = latency_start(fc->rx->latency);
+                ssize_t noise = sink->on_gap(missing_blocks, node.size, sink->user_args);
+                latency_end(fc->rx->latency, DXWIFI_LATENCY_RX_WRITE, start);
+                fc->rx_stats.total_noise_added += noise;
+                metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_NOISE_BYTES, noise);
             }
-
             fc->rx_stats.total_blocks_lost += missing_blocks;
+            metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_BLOCKS_LOST, missing_blocks);
         }
 
-        nbytes = write(fc->fd, node.data, node.size);
-        debug_assert_continue(nbytes == node.size, "Partial write: %d - %s", nbytes, strerror(errno));
+        start = latency_start(fc->rx->latency);
+        ssize_t written = sink->on_block(node.data, node.size, sink->user_args);
+        latency_end(fc->rx->latency, DXWIFI_LATENCY_RX_WRITE, start);
+        fc->rx_stats.total_writelen += written;
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_BYTES_WRITTEN, written);
 
-        fc->rx_stats.total_writelen += nbytes;
         expected_frame = node.frame_number + 1;
+        start = latency_start(fc->rx->latency);
     }
+    metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_BUFFERED_BYTES, -(int64_t) fc->index);
     fc->index = 0; // Reset the write position and reuse the buffer
 }
 
 
+/**
+ *  DESCRIPTION:    Continues the current output where an interrupted 
+ *                  transmission left off. Everything received so far is 
+ *                  handed to the sink first, then the sink is told where the
+ *                  transmission resumes.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      fc:         Frame controller with allocated packet buffer
+ * 
+ *      frame:      Captured resume control frame
+ * 
+ */
+static void resume_capture(frame_controller* fc, const uint8_t* frame) {
+    debug_assert(fc && frame);
+
+    const ieee80211_radiotap_hdr* rtap = (const ieee80211_radiotap_hdr*)frame;
+
+    dxwifi_resume_manifest manifest;
+    memcpy(&manifest, frame + rtap->it_len + sizeof(ieee80211_hdr), sizeof(manifest));
+
+    manifest.file_id    = be64toh(manifest.file_id);
+    manifest.offset     = be64toh(manifest.offset);
+    manifest.block      = ntohl(manifest.block);
+
+    // Redundant copies of the manifest land here as well
+    if(fc->resumed && fc->resume_offset == manifest.offset) {
+        return;
+    }
+    log_info("Transmission resumed at block %d (byte %lu)", manifest.block, manifest.offset);
+
+    fc->resumed         = true;
+    fc->resume_offset   = manifest.offset;
+
+    dump_packet_buffer(fc);
+
+    if(fc->sink->on_file_start) {
+        fc->sink->on_file_start(&manifest, fc->sink->user_args);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Default sink, writes a payload to the file descriptor 
+ *                  through the attached depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static ssize_t fd_sink_block(const uint8_t* payload, size_t size, void* user) {
+    fd_sink* sink = (fd_sink*) user;
+    const dxwifi_rx_depacketizer* depacketizer = &sink->rx->depacketizer;
+
+    if(depacketizer->write_block) {
+        return depacketizer->write_block(sink->fd, payload, size, depacketizer->user_args);
+    }
+
+    ssize_t nbytes = write(sink->fd, payload, size);
+    debug_assert_continue(nbytes == (ssize_t) size, "Partial write: %d - %s", nbytes, strerror(errno));
+
+    return nbytes;
+}
+
+
+/**
+ *  DESCRIPTION:    Default sink, fills missing blocks in with noise when 
+ *                  add_noise is set and no depacketizer is attached
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static ssize_t fd_sink_gap(uint32_t missing, size_t block_size, void* user) {
+    fd_sink* sink = (fd_sink*) user;
+
+    ssize_t nbytes = 0;
+    if(sink->rx->add_noise && !sink->rx->depacketizer.write_block) {
+        uint8_t noise[block_size];
+
+        memset(noise, sink->rx->noise_value, sizeof(noise));
+
+        for(uint32_t i = 0; i < missing; ++i) {
+            nbytes += write(sink->fd, noise, sizeof(noise));
+        }
+    }
+    return nbytes;
+}
+
+
+/**
+ *  DESCRIPTION:    Default sink, moves the output to the resume offset so 
+ *                  blocks sent again overwrite their first copy
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static void fd_sink_file_start(const dxwifi_resume_manifest* resume, void* user) {
+    fd_sink* sink = (fd_sink*) user;
+
+    if(resume && lseek(sink->fd, resume->offset, SEEK_SET) < 0) {
+        log_warning("Output can't seek, resumed data is appended: %s", strerror(errno));
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Default sink, flushes the depacketizer
+ * 
+ *  ARGUMENTS:
+ * 
+ *      See definition of dxwifi_rx_sink in receiver.h
+ * 
+ */
+static ssize_t fd_sink_file_end(void* user) {
+    fd_sink* sink = (fd_sink*) user;
+
+    if(sink->rx->depacketizer.flush) {
+        return sink->rx->depacketizer.flush(sink->fd, sink->rx->depacketizer.user_args);
+    }
+    return 0;
+}
+
+
 /**
  *  DESCRIPTION:    Callback for PCAP dispatch. Called each time a frame is
  *                  matching the BPF expression is captured
@@ -361,7 +624,12 @@ static void process_frame(uint8_t* args, const struct pcap_pkthdr* pkt_stats, co
 
     dxwifi_control_frame_t ctrl_frame = check_frame_control(frame, pkt_stats, DXWIFI_FRAME_CONTROL_CHECK_THRESHOLD);
 
+    if(ctrl_frame == DXWIFI_CONTROL_FRAME_RESUME) {
+        resume_capture(fc, frame);
+    }
     if(ctrl_frame != DXWIFI_CONTROL_FRAME_NONE) {
+        trace_frame(fc->rx->trace, DXWIFI_TRACE_RX_CONTROL, ctrl_frame, 0, frame, pkt_stats->caplen);
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_CONTROL_FRAMES, 1);
         handle_frame_control(fc, ctrl_frame);
     }
     else {
@@ -374,9 +642,12 @@ static void process_frame(uint8_t* args, const struct pcap_pkthdr* pkt_stats, co
         uint8_t* buffer_slot = fc->packet_buffer + fc->index;
 
         // Copy the entire frame into the packet buffer
+        uint64_t start = latency_start(fc->rx->latency);
+        uint64_t buffered = start;
         memcpy(buffer_slot, frame, pkt_stats->caplen);
 
         dxwifi_rx_frame rx_frame = parse_rx_frame_fields(pkt_stats, buffer_slot);
+        latency_end(fc->rx->latency, DXWIFI_LATENCY_RX_COPY, start);
 
         // TODO parse radiotap header data and store provided info
 
@@ -391,21 +662,275 @@ static void process_frame(uint8_t* args, const struct pcap_pkthdr* pkt_stats, co
             .frame_number   = frame_number,
             .data           = rx_frame.payload,
             .size           = payload_size,
-            .crc_valid      = false // TODO verify CRC
+            .crc_valid      = false, // TODO verify CRC
+            .buffered       = buffered,
+            .transit        = buffered ? extract_transit_time(rx_frame.mac_hdr, pkt_stats) : -1
         };
+        if(node.transit >= 0) {
+            record_latency_value(fc->rx->latency, DXWIFI_LATENCY_RX_TRANSIT, node.transit);
+        }
+        start = latency_start(fc->rx->latency);
         heap_push(&fc->packet_heap, &node);
+        latency_end(fc->rx->latency, DXWIFI_LATENCY_RX_HEAP, start);
+
+        trace_frame(fc->rx->trace, DXWIFI_TRACE_RX_DATA, frame_number, 0, buffer_slot, pkt_stats->caplen);
+
+        link_quality_update(
+            &fc->link,
+            fc->rx->ordered ? frame_number : -1,
+            (uint64_t) pkt_stats->ts.tv_sec * 1000000 + pkt_stats->ts.tv_usec,
+            payload_size
+        );
 
         // Update next write position and stats
         fc->index                           += pkt_stats->caplen; 
         fc->rx_stats.total_caplen           += pkt_stats->caplen;
         fc->rx_stats.total_payload_size     += payload_size;
         fc->rx_stats.num_packets_processed  += 1;
+
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_FRAMES, 1);
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_BYTES_CAPTURED, pkt_stats->caplen);
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_PAYLOAD_BYTES, payload_size);
+        metrics_add(fc->rx->metrics, DXWIFI_METRIC_RX_BUFFERED_BYTES, pkt_stats->caplen);
         memcpy(&fc->rx_stats.pkt_stats, pkt_stats, sizeof(struct pcap_pkthdr));
 
         log_frame_stats(&rx_frame, frame_number, &fc->rx_stats);
     }
 }
 
+/**
+ *  DESCRIPTION:    Sets up a capture into @sink
+ * 
+ *  ARGUMENTS:
+ * 
+ *      rx:         Initialized receiver, not capturing
+ * 
+ *      sink:       Consumes the payload data, copied into the capture state
+ * 
+ *      fd:         Output of the default sink, when @sink is NULL
+ * 
+ */
+static void begin_capture(dxwifi_receiver* rx, const dxwifi_rx_sink* sink, int fd) {
+    debug_assert(rx && rx->__handle && !rx->__session);
+
+    dxwifi_rx_session* s = calloc(1, sizeof(dxwifi_rx_session));
+    assert_M(s, "Failed to allocate capture state");
+
+    if(sink) {
+        s->sink = *sink;
+    }
+    else {
+        s->fd_sink.rx           = rx;
+        s->fd_sink.fd           = fd;
+        s->sink.on_block        = fd_sink_block;
+        s->sink.on_gap          = fd_sink_gap;
+        s->sink.on_file_start   = fd_sink_file_start;
+        s->sink.on_file_end     = fd_sink_file_end;
+        s->sink.user_args       = &s->fd_sink;
+    }
+
+    s->request.fd       = pcap_get_selectable_fd(rx->__handle);
+    s->request.events   = POLLIN;
+    s->request.revents  = 0;
+    assert_M(s->request.fd >= 0, "Receiver handle cannot be polled");
+
+    init_frame_controller(&s->fc, rx, &s->sink);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    s->link_reported = now.tv_sec;
+
+    rx->__session = s;
+
+    log_info("Starting packet capture...");
+    rx->__activated = true;
+}
+
+
+/**
+ *  DESCRIPTION:    Publishes the kernel's capture counters
+ * 
+ */
+static void publish_pcap_stats(const dxwifi_receiver* rx, const struct pcap_stat* stats) {
+    metrics_set(rx->metrics, DXWIFI_METRIC_RX_PCAP_RECEIVED,  stats->ps_recv);
+    metrics_set(rx->metrics, DXWIFI_METRIC_RX_PCAP_DROPPED,   stats->ps_drop);
+    metrics_set(rx->metrics, DXWIFI_METRIC_RX_PCAP_IFDROPPED, stats->ps_ifdrop);
+}
+
+
+/**
+ *  DESCRIPTION:    Reads the capture counters about once a second while
+ *                  metrics are published. Reading them is a system call, 
+ *                  the coarse clock that paces it isn't.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      rx:         Receiver with a capture in progress
+ * 
+ */
+static void sample_pcap_stats(dxwifi_receiver* rx) {
+    if(!rx->metrics) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    dxwifi_rx_session* s = rx->__session;
+    if(now.tv_sec != s->stats_sampled) {
+        s->stats_sampled = now.tv_sec;
+
+        struct pcap_stat stats;
+        if(pcap_stats(rx->__handle, &stats) != PCAP_ERROR) {
+            publish_pcap_stats(rx, &stats);
+        }
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Logs the link quality every link report interval. Loss,
+ *                  duplicates and goodput are over the time since the last 
+ *                  report, the window loss rate and jitter are as they are now.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      rx:         Receiver with a capture in progress
+ * 
+ */
+static void report_link_quality(dxwifi_receiver* rx) {
+    if(rx->link_report_interval == 0) {
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    dxwifi_rx_session* s = rx->__session;
+    if(now.tv_sec - s->link_reported < rx->link_report_interval) {
+        return;
+    }
+    s->link_reported = now.tv_sec;
+
+    const dxwifi_link_stats* stats = &s->fc.link.stats;
+    dxwifi_link_stats* prev = &s->link_prev;
+
+    dxwifi_link_stats interval = {
+        .frames         = stats->frames         - prev->frames,
+        .unique         = stats->unique         - prev->unique,
+        .duplicates     = stats->duplicates     - prev->duplicates,
+        .lost           = stats->lost           - prev->lost,
+        .bursts         = stats->bursts         - prev->bursts,
+        .goodput_bytes  = stats->goodput_bytes  - prev->goodput_bytes,
+        .duration       = stats->duration       - prev->duration
+    };
+    *prev = *stats;
+
+    if(interval.frames == 0) {
+        log_info("Link quality: no frames in the last %us", rx->link_report_interval);
+        return;
+    }
+    log_info(
+        "Link quality: frames=%" PRIu64 " loss=%.2f%% window_loss=%.2f%% bursts=%" PRIu64 " burst_max=%" PRIu64 " dup=%.2f%% goodput=%.0fB/s jitter=%.1fus",
+        interval.frames,
+        link_loss_rate(&interval) * 100,
+        stats->window_loss * 100,
+        interval.bursts,
+        stats->burst_max,
+        link_duplicate_rate(&interval) * 100,
+        link_goodput(&interval),
+        stats->jitter
+    );
+}
+
+
+/**
+ *  DESCRIPTION:    Processes the packets that are ready, at most the dispatch
+ *                  count
+ * 
+ *  ARGUMENTS:
+ * 
+ *      rx:         Receiver with a capture in progress
+ * 
+ *      wait_ms:    How long to wait for a packet, negative waits forever
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_rx_step_t:   DXWIFI_RX_STEP_WAIT if no packet came in after 
+ *                          waiting
+ * 
+ */
+static dxwifi_rx_step_t step_capture(dxwifi_receiver* rx, int wait_ms) {
+    dxwifi_rx_session* s = rx->__session;
+    debug_assert(s);
+
+    frame_controller* fc = &s->fc;
+
+    if(!rx->__activated || fc->end_capture) {
+        return DXWIFI_RX_STEP_DONE;
+    }
+
+    uint64_t start = latency_start(rx->latency);
+    int status = poll(&s->request, 1, wait_ms);
+    latency_end(rx->latency, DXWIFI_LATENCY_RX_WAIT, start);
+
+    if(status == 0) {
+        return DXWIFI_RX_STEP_WAIT;
+    }
+    else if(status < 0) {
+        if(rx->__activated) { 
+            log_error("Error occured: %s", strerror(errno));
+            fc->rx_stats.capture_state = DXWIFI_RX_ERROR;
+        }
+        else {
+            fc->rx_stats.capture_state = DXWIFI_RX_DEACTIVATED;
+        }
+    }
+    else {
+        start = latency_start(rx->latency);
+        status = pcap_dispatch(rx->__handle, rx->dispatch_count, process_frame, (uint8_t*)fc);
+        latency_end(rx->latency, DXWIFI_LATENCY_RX_DISPATCH, start);
+
+#if defined(DXWIFI_TESTS)
+        // When reading from a savefile, 0 denotes that there are no more packets
+        if(status == 0) {
+            rx->__activated = false;
+            fc->rx_stats.capture_state = DXWIFI_RX_DEACTIVATED;
+        }
+#endif // DXWIFI_TESTS
+
+        assert_continue(status != PCAP_ERROR, "Capture failure: %s", pcap_statustostr(status));
+
+        sample_pcap_stats(rx);
+        report_link_quality(rx);
+    }
+    return rx->__activated && !fc->end_capture ? DXWIFI_RX_STEP_READY : DXWIFI_RX_STEP_DONE;
+}
+
+
+/**
+ *  DESCRIPTION:    Runs a capture until it ends, waiting on packets for as 
+ *                  long as the capture timeout
+ * 
+ *  ARGUMENTS:
+ * 
+ *      rx:         Receiver started with begin_capture()
+ * 
+ *      out:        pointer to an allocated stats object or NULL
+ * 
+ */
+static void run_capture(dxwifi_receiver* rx, dxwifi_rx_stats* out) {
+    dxwifi_rx_step_t status = DXWIFI_RX_STEP_READY;
+    while(status != DXWIFI_RX_STEP_DONE) {
+        status = step_capture(rx, rx->capture_timeout * 1000);
+
+        if(status == DXWIFI_RX_STEP_WAIT) {
+            log_info("Reciever timeout occured");
+            rx->__session->fc.rx_stats.capture_state = DXWIFI_RX_TIMED_OUT;
+            rx->__activated = false;
+        }
+    }
+    receiver_end_capture(rx, out);
+}
+
 //
 // See receiver.h for description of non-static functions
 //
@@ -419,6 +944,7 @@ static void log_rx_configuration(const dxwifi_receiver* rx, const char* dev_name
             "\tPacket Buffer Size:       %ld\n"
             "\tOrdered:                  %d\n"
             "\tAdd-noise:                %d\n"
+            "\tLink Report Interval:     %us\n"
             "\tFilter:                   %s\n"
             "\tOptimize:                 %d\n"
             "\tSnapshot Length:          %d\n"
@@ -430,6 +956,7 @@ static void log_rx_configuration(const dxwifi_receiver* rx, const char* dev_name
             rx->packet_buffer_size,
             rx->ordered,
             rx->add_noise,
+            rx->link_report_interval,
             rx->filter,
             rx->optimize,
             rx->snaplen,
@@ -448,6 +975,7 @@ void init_receiver(dxwifi_receiver* rx, const char* device_name) {
     char err_buff[PCAP_ERRBUF_SIZE];
 
     rx->__activated = false;
+    rx->__session   = NULL;
 #if defined(DXWIFI_TESTS)
     if(rx->savefile) {
         rx->__handle = pcap_open_offline(rx->savefile, err_buff);
@@ -473,7 +1001,10 @@ void init_receiver(dxwifi_receiver* rx, const char* device_name) {
     status = pcap_set_datalink(rx->__handle, DLT_IEEE802_11_RADIO);
     assert_M(status != PCAP_ERROR, "Failed to set datalink: %s", pcap_statustostr(status));
 
+    // pcap_compile isn't thread safe before libpcap 1.8
+    pthread_mutex_lock(&compile_lock);
     status = pcap_compile(rx->__handle, &filter, rx->filter, rx->optimize, PCAP_NETMASK_UNKNOWN);
+    pthread_mutex_unlock(&compile_lock);
     assert_M(status != PCAP_ERROR, "Failed to compile filter %s: %s", rx->filter, pcap_statustostr(status));
 
     status = pcap_setfilter(rx->__handle, &filter);
@@ -481,7 +1012,9 @@ void init_receiver(dxwifi_receiver* rx, const char* device_name) {
 
     pcap_freecode(&filter);
 
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
     log_rx_configuration(rx, device_name);
+    bind_log_context(prev_context);
 }
 
 
@@ -490,73 +1023,107 @@ void close_receiver(dxwifi_receiver* receiver) {
 
     pcap_close(receiver->__handle);
 
+    dxwifi_log_context* prev_context = bind_log_context(receiver->log_context);
     log_info("DxWiFi receiver closed");
+    bind_log_context(prev_context);
 }
 
 
 void receiver_activate_capture(dxwifi_receiver* rx, int fd, dxwifi_rx_stats* out) {
-    debug_assert(rx && rx->__handle);
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
+    begin_capture(rx, NULL, fd);
+    run_capture(rx, out);
+    bind_log_context(prev_context);
+}
 
-    int status = 0;
-    frame_controller fc;
 
-    struct pollfd request = {
-        .fd         = pcap_get_selectable_fd(rx->__handle),
-        .events     = POLLIN,
-        .revents    = 0
-    };
-    assert_M(request.fd >= 0, "Receiver handle cannot be polled");
+void receiver_activate_capture_sink(dxwifi_receiver* rx, const dxwifi_rx_sink* sink, dxwifi_rx_stats* out) {
+    debug_assert(sink);
 
-    init_frame_controller(&fc, rx, fd);
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
+    begin_capture(rx, sink, -1);
+    run_capture(rx, out);
+    bind_log_context(prev_context);
+}
 
-    log_info("Starting packet capture...");
-    rx->__activated = true;
 
-    while(rx->__activated && !fc.end_capture) {
+void receiver_begin_capture(dxwifi_receiver* rx, int fd) {
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
+    begin_capture(rx, NULL, fd);
+    bind_log_context(prev_context);
+}
 
-        status = poll(&request, 1, rx->capture_timeout * 1000);
 
-        if(status == 0) {
-            log_info("Reciever timeout occured");
-            fc.rx_stats.capture_state = DXWIFI_RX_TIMED_OUT;
-            rx->__activated = false;
-        }
-        else if(status < 0) {
-            if(rx->__activated) { 
-                log_error("Error occured: %s", strerror(errno));
-                fc.rx_stats.capture_state = DXWIFI_RX_ERROR;
-            }
-            else {
-                fc.rx_stats.capture_state = DXWIFI_RX_DEACTIVATED;
-            }
-        }
-        else {
-            status = pcap_dispatch(rx->__handle, rx->dispatch_count, process_frame, (uint8_t*)&fc);
+void receiver_begin_capture_sink(dxwifi_receiver* rx, const dxwifi_rx_sink* sink) {
+    debug_assert(sink);
 
-#if defined(DXWIFI_TESTS)
-            // When reading from a savefile, 0 denotes that there are no more packets
-            if(status == 0) {
-                rx->__activated = false;
-                fc.rx_stats.capture_state = DXWIFI_RX_DEACTIVATED;
-            }
-#endif // DXWIFI_TESTS
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
+    begin_capture(rx, sink, -1);
+    bind_log_context(prev_context);
+}
+
+
+int receiver_capture_fd(const dxwifi_receiver* rx) {
+    debug_assert(rx && rx->__session);
+
+    return rx->__session->request.fd;
+}
+
+
+dxwifi_rx_step_t receiver_step_capture(dxwifi_receiver* rx) {
+    debug_assert(rx && rx->__session);
+
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
+    dxwifi_rx_step_t status = step_capture(rx, 0);
+    bind_log_context(prev_context);
+
+    return status;
+}
+
+
+void receiver_end_capture(dxwifi_receiver* rx, dxwifi_rx_stats* out) {
+    debug_assert(rx && rx->__session);
+
+    dxwifi_rx_session* s = rx->__session;
+    dxwifi_log_context* prev_context = bind_log_context(rx->log_context);
 
-            assert_continue(status != PCAP_ERROR, "Capture failure: %s", pcap_statustostr(status));
-        }
-    }
     log_info("DxWiFi Reciever capture ended");
 
-    dump_packet_buffer(&fc); // Flush out whatever's leftover in the buffer
+    dump_packet_buffer(&s->fc); // Flush out whatever's leftover in the buffer
+
+    if(s->sink.on_file_end) {
+        ssize_t written = s->sink.on_file_end(s->sink.user_args);
+        s->fc.rx_stats.total_writelen += written;
+        metrics_add(rx->metrics, DXWIFI_METRIC_RX_BYTES_WRITTEN, written);
+    }
 
-    if( pcap_stats(rx->__handle, &fc.rx_stats.pcap_stats) == PCAP_ERROR) {
+    // Stopped without a signal interrupting the wait
+    if(s->fc.rx_stats.capture_state == DXWIFI_RX_NORMAL && !rx->__activated) {
+        s->fc.rx_stats.capture_state = DXWIFI_RX_DEACTIVATED;
+    }
+
+    if( pcap_stats(rx->__handle, &s->fc.rx_stats.pcap_stats) == PCAP_ERROR) {
         log_warning("Failed to gather capture stats from PCAP");
     }
+    else {
+        publish_pcap_stats(rx, &s->fc.rx_stats.pcap_stats);
+    }
+
+    // Frames still in the window are settled now that nothing else is coming
+    link_quality_flush(&s->fc.link);
+    s->fc.rx_stats.link = s->fc.link.stats;
 
     if(out) {
-        *out = fc.rx_stats;
+        *out = s->fc.rx_stats;
     }
 
-    teardown_frame_controller(&fc);
+    teardown_frame_controller(&s->fc);
+
+    rx->__activated = false;
+    rx->__session   = NULL;
+    free(s);
+
+    bind_log_context(prev_context);
 }
 
 void receiver_stop_capture(dxwifi_receiver* rx) {
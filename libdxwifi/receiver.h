@@ -8,6 +8,9 @@
  * 
  *  NOTES: struct fields prefixed with a '__' denote private scope
  * 
+ *  Instances share no state, each receiver may run on its own thread. Calls on 
+ *  one instance must come from one thread at a time, except receiver_stop_capture.
+ * 
  */
 
 #ifndef LIBDXWIFI_RECEIVER_H
@@ -19,7 +22,13 @@
 
 #include <pcap.h>
 
+#include <libdxwifi/dxwifi.h>
 #include <libdxwifi/details/ieee80211.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+#include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/linkquality.h>
 
 /************************
  *  Constants
@@ -69,24 +78,94 @@ typedef struct {
  *  as well as overall capture statistics.
  */
 typedef struct {
-    uint32_t                total_payload_size;     /* Accumulated size of each payload */
-    uint32_t                total_writelen;         /* Total number of bytes written out*/
-    uint32_t                total_caplen;           /* Total number of bytes captured   */
-    uint32_t                total_blocks_lost;      /* Number of data blocks lost       */
-    uint32_t                total_noise_added;      /* Number of bytes of noise added   */
-    uint32_t                num_packets_processed;  /* Number of packets processed      */
+    uint64_t                total_payload_size;     /* Accumulated size of each payload */
+    uint64_t                total_writelen;         /* Total number of bytes written out*/
+    uint64_t                total_caplen;           /* Total number of bytes captured   */
+    uint64_t                total_blocks_lost;      /* Number of data blocks lost       */
+    uint64_t                total_noise_added;      /* Number of bytes of noise added   */
+    uint64_t                num_packets_processed;  /* Number of packets processed      */
     dxwifi_rx_state_t       capture_state;          /* State of last capture            */
     struct pcap_pkthdr      pkt_stats;              /* Stats for the current capture    */
     struct pcap_stat        pcap_stats;             /* Pcap statistics                  */
+    dxwifi_link_stats       link;                   /* Link quality, see linkquality.h  */
 } dxwifi_rx_stats;
 
 
+/**
+ *  Depacketizers are the receiving half of a transmitter packetizer. When 
+ *  attached, each payload is handed to write_block in frame order instead of 
+ *  being written out directly. The depacketizer is responsible for stripping
+ *  its headers, validating units, and writing the result to @fd. flush is 
+ *  called once the capture ends so any partial state can be resolved and 
+ *  reset for the next capture.
+ * 
+ *  write_block must return the number of bytes written to @fd
+ */
+typedef struct {
+    ssize_t (*write_block)(int fd, const uint8_t* payload, size_t size, void* user);
+    ssize_t (*flush)(int fd, void* user);
+    void*   user_args;
+} dxwifi_rx_depacketizer;
+
+
+/**
+ *  Sinks consume the payloads of a capture in place of a file descriptor, see
+ *  receiver_activate_capture_sink(). Payloads are handed over in frame order,
+ *  pointing straight into the receiver's capture buffer, and are only valid 
+ *  until the callback returns. Only on_block is required.
+ * 
+ *  on_block:       Next payload, returns the number of bytes written out
+ * 
+ *  on_gap:         Frames missing ahead of the next payload, only for ordered
+ *                  captures. Returns the number of bytes written in their 
+ *                  place, if any.
+ * 
+ *  on_file_start:  The transmission started, @resume is NULL for a preamble or
+ *                  the manifest in host byte order when an interrupted 
+ *                  transmission picks up again. Everything received before a
+ *                  resume was already handed to on_block.
+ * 
+ *  on_file_end:    The capture ended and every payload was handed over, 
+ *                  returns the number of bytes written out
+ * 
+ *  The default sink writes to a file descriptor through the attached 
+ *  depacketizer, fills gaps with noise when add_noise is set and seeks to the
+ *  resume offset. Depacketizers write to a file descriptor, a custom sink gets
+ *  the payloads as they were sent.
+ */
+typedef struct {
+    ssize_t (*on_block)(const uint8_t* payload, size_t size, void* user);
+    ssize_t (*on_gap)(uint32_t missing, size_t block_size, void* user);
+    void    (*on_file_start)(const dxwifi_resume_manifest* resume, void* user);
+    ssize_t (*on_file_end)(void* user);
+    void*   user_args;
+} dxwifi_rx_sink;
+
+
+/**
+ *  What receiver_step_capture() wants next. READY means there's more to do 
+ *  right away, WAIT means no packet is ready and receiver_capture_fd() should
+ *  be polled for POLLIN first, DONE means receiver_end_capture() should be 
+ *  called.
+ */
+typedef enum {
+    DXWIFI_RX_STEP_READY,
+    DXWIFI_RX_STEP_WAIT,
+    DXWIFI_RX_STEP_DONE
+} dxwifi_rx_step_t;
+
+
+// State of a capture in progress, private to receiver.c
+typedef struct dxwifi_rx_session dxwifi_rx_session;
+
+
 /**
  *  Receiver is responsible for handling packet capture. The reciever must be
  *  initialized before use and torn down after. It is the user's responsibility 
  *  to fill in the fields with the correct capture settings they want. 
  * 
- *  NOTES: add_noise is only used if the ordered flag is set. When receiving an
+ *  NOTES: add_noise is only used if the ordered flag is set and no 
+ *  depacketizer is attached. When receiving an
  *  "ordered" transmission it's important that the frame number is stuffed into 
  *  the last four bytes of the MAC header's addr1 field. If the frame number 
  *  is not present then the receiver will not be able to sort the packet data.
@@ -99,14 +178,23 @@ typedef struct {
     bool        ordered;            /* Packets have packed sequence data      */
     bool        add_noise;          /* Add noise for missing packets          */
     uint8_t     noise_value;        /* Value to use for noise                 */
+    dxwifi_rx_depacketizer depacketizer;
+                                    /* Optional, unpacks packetized payloads  */
+    unsigned    link_report_interval;
+                                    /* Seconds between link reports, 0 is off */
 
     // https://www.tcpdump.org/manpages/pcap.3pcap.html
     const char *filter;             /* BPF Program string                     */
     bool        optimize;           /* Optimize compiled filter?              */
     int         snaplen;            /* Snapshot length in bytes               */
     int         pb_timeout;         /* PCAP Packet buffer timeout             */
+    dxwifi_log_context* log_context;/* Optional, NULL logs to the default     */
+    dxwifi_trace*   trace;          /* Optional, NULL records no frames       */
+    dxwifi_metrics* metrics;        /* Optional, NULL publishes nothing       */
+    dxwifi_latency* latency;        /* Optional, NULL times nothing           */
 
     volatile bool   __activated;    /* Currently capturing packets?           */
+    dxwifi_rx_session* __session;   /* Capture in progress                    */
     pcap_t*         __handle;       /* Pcap session handle                    */
 
 #if defined(DXWIFI_TESTS)
@@ -170,6 +258,96 @@ void close_receiver(dxwifi_receiver* receiver);
 void receiver_activate_capture(dxwifi_receiver* receiver, int fd, dxwifi_rx_stats* out);
 
 
+/**
+ *  DESCRIPTION:    Captures packets like receiver_activate_capture() but 
+ *                  hands the payload data to a sink instead of writing it out
+ * 
+ *  ARGUMENTS:
+ * 
+ *      receiver:   pointer to an allocated receiver object
+ * 
+ *      sink:       Callbacks consuming the payload data, see dxwifi_rx_sink
+ * 
+ *      out:        pointer to an allocated stats object or NULL if stats aren't
+ *                  needed
+ * 
+ *  NOTES: The sink's callbacks are called on the capturing thread. Payloads
+ *  are still buffered and ordered first, so a block is handed over when the 
+ *  packet buffer fills up or the capture ends.
+ * 
+ */
+void receiver_activate_capture_sink(dxwifi_receiver* receiver, const dxwifi_rx_sink* sink, dxwifi_rx_stats* out);
+
+
+/**
+ *  DESCRIPTION:    Starts a capture that's driven by receiver_step_capture()
+ *                  instead of blocking
+ * 
+ *  ARGUMENTS:
+ * 
+ *      receiver:   pointer to an initialized receiver that isn't capturing
+ * 
+ *      fd:         File descriptor to write out payload data to
+ * 
+ *  NOTES: Meant for an event loop driving more than one transmitter, receiver
+ *  or anything else with a file descriptor. The capture timeout isn't used, 
+ *  time the capture out by calling receiver_stop_capture() from the loop.
+ * 
+ */
+void receiver_begin_capture(dxwifi_receiver* receiver, int fd);
+
+
+/**
+ *  DESCRIPTION:    receiver_begin_capture() into a sink, see 
+ *                  receiver_activate_capture_sink()
+ * 
+ */
+void receiver_begin_capture_sink(dxwifi_receiver* receiver, const dxwifi_rx_sink* sink);
+
+
+/**
+ *  DESCRIPTION:    File descriptor to poll for POLLIN when 
+ *                  receiver_step_capture() returns DXWIFI_RX_STEP_WAIT
+ * 
+ *  ARGUMENTS:
+ * 
+ *      receiver:   Receiver started with receiver_begin_capture()
+ * 
+ */
+int receiver_capture_fd(const dxwifi_receiver* receiver);
+
+
+/**
+ *  DESCRIPTION:    Processes the packets that are ready without waiting, at 
+ *                  most dispatch_count of them
+ * 
+ *  ARGUMENTS:
+ * 
+ *      receiver:   Receiver started with receiver_begin_capture()
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_rx_step_t:   What to do next, see dxwifi_rx_step_t
+ * 
+ */
+dxwifi_rx_step_t receiver_step_capture(dxwifi_receiver* receiver);
+
+
+/**
+ *  DESCRIPTION:    Hands whatever is left to the sink and releases the 
+ *                  capture's resources
+ * 
+ *  ARGUMENTS:
+ * 
+ *      receiver:   Receiver started with receiver_begin_capture()
+ * 
+ *      out:        pointer to an allocated stats object or NULL if stats aren't
+ *                  needed
+ * 
+ */
+void receiver_end_capture(dxwifi_receiver* receiver, dxwifi_rx_stats* out);
+
+
 /**
  *  DESCRIPTION:    Signals to the receiver to stop capturing packets
  * 
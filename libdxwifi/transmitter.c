@@ -7,8 +7,10 @@
  * 
  */
 
+#define DXWIFI_LOG_MODULE DXWIFI_LOG_TRANSMITTER
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdbool.h>
 
 #include <poll.h>
@@ -23,6 +25,47 @@
 #include <libdxwifi/details/utils.h>
 #include <libdxwifi/details/assert.h>
 #include <libdxwifi/details/logging.h>
+#include <libdxwifi/details/blockpool.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+
+
+// Frames read ahead of injection, handed to the handlers as a dxwifi_tx_batch
+typedef struct {
+    dxwifi_tx_frame     frames[DXWIFI_TX_BATCH_MAX];        /* Frames with their own headers    */
+    size_t              payload_sizes[DXWIFI_TX_BATCH_MAX]; /* Payload sizes after the handlers */
+    dxwifi_tx_stats     stats[DXWIFI_TX_BATCH_MAX];         /* Stats as of each frame           */
+    size_t              count;                              /* Frames read into the batch       */
+    bool                prepared;                           /* Frames came ready to go out      */
+} frame_batch;
+
+
+// Where a transmission reads its payloads from
+typedef struct {
+    int                 fd;         /* File descriptor, -1 for the others   */
+    const struct iovec* iov;        /* Caller memory left to send           */
+    size_t              iovcnt;     /* Number of buffers left               */
+    size_t              offset;     /* Bytes of the first buffer sent       */
+    dxwifi_tx_pull_cb   pull;       /* Caller fills in each payload         */
+    void*               pull_user;  /* Passed to pull                       */
+} tx_source;
+
+
+// State of a transmission in progress, see begin_transmission()
+struct dxwifi_tx_session {
+    tx_source           src;            /* Where payloads are read from     */
+    struct pollfd       request;        /* Waits on the source              */
+    dxwifi_tx_stats     stats;          /* Stats of the transmission        */
+    uint32_t            first_frame;    /* Number of the first frame        */
+    uint32_t            blocks_read;    /* Frames read so far               */
+    size_t              batches_read;   /* Batches handed to the workers    */
+    bool                end_of_input;   /* Nothing more will be read        */
+    bool                workers;        /* Block workers were started       */
+    block_pool          pool;           /* Block workers, if started        */
+    frame_batch*        batches;        /* Batches frames are read into     */
+    dxwifi_tx_frame     control_frame;  /* Preamble, resume and EOT frames  */
+};
 
 
 /**
@@ -125,14 +168,75 @@ static void construct_ieee80211_header( ieee80211_hdr* mac, ieee80211_frame_cont
 }
 
 
+/**
+ *  DESCRIPTION:    Adapter that runs a frame handler as a stage, calls it on
+ *                  each frame of the batch
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      batch:      Frames to handle
+ * 
+ *      user:       Frame handler
+ * 
+ */
+static void invoke_frame_handler(dxwifi_tx_batch* batch, void* user) {
+    dxwifi_tx_frame_handler* handler = (dxwifi_tx_frame_handler*) user;
+
+    for(size_t i = 0; i < batch->count; ++i) {
+        size_t sz = handler->callback(
+            &batch->frames[i], 
+            batch->payload_sizes[i], 
+            batch->stats[i], 
+            handler->user_args
+            );
+
+        assert_continue(
+            0 < sz && sz < DXWIFI_TX_PAYLOAD_SIZE_MAX, 
+            "Payload size: %d, exceeds defined bounds", 
+            sz
+            );
+
+        batch->payload_sizes[i] = sz;
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Rebuilds the pipeline's stages from its attached handlers
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      pipeline:   pre/post injection pipeline
+ * 
+ */
+static void compile_pipeline(dxwifi_tx_pipeline* pipeline) {
+    pipeline->stage_count = 0;
+    for(int i = 0; i < DXWIFI_TX_FRAME_HANDLER_MAX; ++i) {
+        dxwifi_tx_stage* stage = &pipeline->stages[pipeline->stage_count];
+
+        if(pipeline->handlers[i].callback != NULL) {
+            stage->callback     = invoke_frame_handler;
+            stage->user_args    = &pipeline->handlers[i];
+            ++pipeline->stage_count;
+        }
+        else if(pipeline->batch_handlers[i].callback != NULL) {
+            *stage = pipeline->batch_handlers[i];
+            ++pipeline->stage_count;
+        }
+    }
+}
+
+
 /**
  *  DESCRIPTION:    Looks for an empty callback slot and attaches the handler
  * 
  *  ARGUMENTS:
  * 
- *      pipeline:       pre/post injection handler array
+ *      pipeline:       pre/post injection pipeline
  *      
- *      callback:       Callback function called when pipeline is invoked
+ *      callback:       Frame callback, or NULL for a batch callback
+ * 
+ *      batch_callback: Batch callback, or NULL for a frame callback
  * 
  *      user:           Pointer to user allocated parameters for the callback
  * 
@@ -140,17 +244,17 @@ static void construct_ieee80211_header( ieee80211_hdr* mac, ieee80211_frame_cont
  *      int:            index to the attached handler.
  * 
  */
-static int attach_handler(dxwifi_tx_frame_handler* pipeline, dxwifi_tx_frame_cb callback, void* user) {
-    debug_assert(pipeline && callback);
-
-    dxwifi_tx_frame_handler handler = {
-        .callback   = callback,
-        .user_args  = user
-    };
+static int attach_handler(dxwifi_tx_pipeline* pipeline, dxwifi_tx_frame_cb callback, dxwifi_tx_batch_cb batch_callback, void* user) {
+    debug_assert(pipeline && (callback || batch_callback));
 
     for(int i = 0; i < DXWIFI_TX_FRAME_HANDLER_MAX; ++i) {
-        if(pipeline[i].callback == NULL) {
-            pipeline[i] = handler;
+        if(pipeline->handlers[i].callback == NULL && pipeline->batch_handlers[i].callback == NULL) {
+            pipeline->handlers[i].callback          = callback;
+            pipeline->handlers[i].user_args         = callback ? user : NULL;
+            pipeline->batch_handlers[i].callback    = callback ? NULL : batch_callback;
+            pipeline->batch_handlers[i].user_args   = callback ? NULL : user;
+
+            compile_pipeline(pipeline);
             return i;
         }
     }
@@ -163,68 +267,213 @@ static int attach_handler(dxwifi_tx_frame_handler* pipeline, dxwifi_tx_frame_cb
  * 
  *  ARGUMENTS: 
  * 
- *      pipeline:   pre/post injection handler array
+ *      pipeline:   pre/post injection pipeline
  * 
  *      index:      index of the handler to remove
  * 
  */
-static bool remove_handler(dxwifi_tx_frame_handler* pipeline, int index) {
+static bool remove_handler(dxwifi_tx_pipeline* pipeline, int index) {
     debug_assert(pipeline);
 
     bool success = false;
     if(index < 0) {
-        memset(pipeline, 0x00, sizeof(dxwifi_tx_frame_handler) * DXWIFI_TX_FRAME_HANDLER_MAX);
+        memset(pipeline, 0x00, sizeof(dxwifi_tx_pipeline));
         success = true;
     }
     else if (index < DXWIFI_TX_FRAME_HANDLER_MAX) {
-        dxwifi_tx_frame_handler* handler = &pipeline[index];
+        success = pipeline->handlers[index].callback != NULL 
+               || pipeline->batch_handlers[index].callback != NULL;
 
-        success = handler->callback != NULL;
+        memset(&pipeline->handlers[index], 0x00, sizeof(dxwifi_tx_frame_handler));
+        memset(&pipeline->batch_handlers[index], 0x00, sizeof(dxwifi_tx_stage));
 
-        handler->callback   = NULL;
-        handler->user_args  = NULL;
+        compile_pipeline(pipeline);
     }
     return success;
 }
 
 
 /**
- *  DESCRIPTION:    Invokes all handlers in the specified pipeline
+ *  DESCRIPTION:    Runs every stage of the pipeline over the batch
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      pipeline:   pre/post injection pipeline
+ * 
+ *      batch:      Frames to handle
+ * 
+ */
+static void invoke_stages(const dxwifi_tx_pipeline* pipeline, dxwifi_tx_batch* batch) {
+    debug_assert(pipeline && batch);
+
+    for(size_t i = 0; i < pipeline->stage_count; ++i) {
+        pipeline->stages[i].callback(batch, pipeline->stages[i].user_args);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Checks if any handler is attached to the pipeline
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      pipeline:   pre/post injection pipeline
+ * 
+ */
+static bool has_handlers(const dxwifi_tx_pipeline* pipeline) {
+    return pipeline->stage_count > 0;
+}
+
+
+/**
+ *  DESCRIPTION:    Batch over @count frames of @batch starting at @first
+ * 
+ */
+static dxwifi_tx_batch batch_view(frame_batch* batch, size_t first, size_t count) {
+    dxwifi_tx_batch view = {
+        .frames         = &batch->frames[first],
+        .payload_sizes  = &batch->payload_sizes[first],
+        .stats          = &batch->stats[first],
+        .count          = count
+    };
+    return view;
+}
+
+
+/**
+ *  DESCRIPTION:    Block pool work function, runs the pure preinject handlers
+ *                  on a batch of frames unless the packetizer handed them 
+ *                  back ready
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      item:       frame_batch to prepare
+ * 
+ *      user:       Transmitter
+ * 
+ */
+static void prepare_batch(void* item, void* user) {
+    frame_batch* batch = (frame_batch*) item;
+    dxwifi_transmitter* tx = (dxwifi_transmitter*) user;
+
+    if(batch->prepared) {
+        return;
+    }
+    dxwifi_tx_batch view = batch_view(batch, 0, batch->count);
+    uint64_t start = has_handlers(&tx->__pure_preinjection) ? latency_start(tx->latency) : 0;
+    invoke_stages(&tx->__pure_preinjection, &view);
+    latency_end(tx->latency, DXWIFI_LATENCY_TX_PREPARE, start);
+}
+
+
+/**
+ *  DESCRIPTION:    Copies the next block out of caller memory
  * 
  *  ARGUMENTS: 
  * 
- *      pipeline:   pre/post injection handler array
+ *      src:        Memory source
  * 
- *      frame:      Transmission data frame
+ *      payload:    Payload section of the data frame
  * 
- *      tx_stats:   State of the current transmission
+ *      blocksize:  Most bytes to copy
  * 
  *  RETURNS:
  *      
- *      size_t:     size of the new payload data in the tx frame
+ *      ssize_t:    Number of payload bytes, 0 once every buffer was sent
  * 
  */
-static size_t invoke_handlers(dxwifi_tx_frame_handler* pipeline, dxwifi_tx_frame* frame, dxwifi_tx_stats tx_stats) {
-    debug_assert(pipeline && frame);
-
-    size_t sz = tx_stats.prev_bytes_read;
-    for(int i = 0; i < DXWIFI_TX_FRAME_HANDLER_MAX; ++i) {
-        if(pipeline[i].callback != NULL) {
-            sz = pipeline[i].callback(
-                frame, 
-                sz, 
-                tx_stats, 
-                pipeline[i].user_args
-                );
-
-            assert_continue(
-                0 < sz && sz < DXWIFI_TX_PAYLOAD_SIZE_MAX, 
-                "Payload size: %d, exceeds defined bounds", 
-                sz
-                );
+static ssize_t copy_block(tx_source* src, uint8_t* payload, size_t blocksize) {
+    size_t nbytes = 0;
+    while(nbytes < blocksize && src->iovcnt > 0) {
+        size_t left = src->iov->iov_len - src->offset;
+        size_t count = left < blocksize - nbytes ? left : blocksize - nbytes;
+
+        memcpy(payload + nbytes, (const uint8_t*) src->iov->iov_base + src->offset, count);
+        nbytes      += count;
+        src->offset += count;
+
+        if(src->offset == src->iov->iov_len) {
+            ++src->iov;
+            --src->iovcnt;
+            src->offset = 0;
         }
     }
-    return sz;
+    return nbytes;
+}
+
+
+/**
+ *  DESCRIPTION:    Reads the next payload into the data frame, either through 
+ *                  the attached packetizer or with a fixed size read
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      src:        Input source
+ * 
+ *      payload:    Payload section of the data frame
+ * 
+ *  RETURNS:
+ *      
+ *      ssize_t:    Number of payload bytes, 0 on end of input, or -1 on error
+ * 
+ */
+static ssize_t read_block(dxwifi_transmitter* tx, tx_source* src, uint8_t* payload) {
+    if(src->pull) {
+        return src->pull(payload, tx->blocksize, src->pull_user);
+    }
+    if(src->fd < 0) {
+        return copy_block(src, payload, tx->blocksize);
+    }
+    if(tx->packetizer.read_block) {
+        return tx->packetizer.read_block(src->fd, payload, tx->blocksize, tx->packetizer.user_args);
+    }
+    return read(src->fd, payload, tx->blocksize);
+}
+
+
+/**
+ *  DESCRIPTION:    Asks the packetizer for a frame that's ready to go out, 
+ *                  see replay_frame in transmitter.h
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      src:        Input source
+ * 
+ *      frame:      Data frame to fill in
+ * 
+ *      bytes_read: Set to the bytes the payload was read from
+ * 
+ *  RETURNS:
+ *      
+ *      size_t:     Payload size, 0 if the frame must be read instead
+ * 
+ */
+static size_t replay_frame(dxwifi_transmitter* tx, const tx_source* src, dxwifi_tx_frame* frame, size_t* bytes_read) {
+    if(src->fd < 0 || !tx->packetizer.replay_frame) {
+        return 0;
+    }
+    return tx->packetizer.replay_frame(frame, bytes_read, tx->packetizer.user_args);
+}
+
+
+/**
+ *  DESCRIPTION:    Checks if a payload can be read without waiting on the 
+ *                  input's file descriptor. Memory and pull sources have no
+ *                  file descriptor, they're always ready.
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      src:        Input source
+ * 
+ */
+static bool source_ready(dxwifi_transmitter* tx, const tx_source* src) {
+    return src->fd < 0 || (tx->packetizer.has_pending && tx->packetizer.has_pending(tx->packetizer.user_args));
 }
 
 
@@ -246,6 +495,9 @@ static size_t invoke_handlers(dxwifi_tx_frame_handler* pipeline, dxwifi_tx_frame
  * 
  */
 static int inject_packet(dxwifi_transmitter* tx, dxwifi_tx_frame* frame, size_t payload_size) {
+    // Frames are reused, a longer payload sent before would be left in the FCS
+    memset(frame->payload + payload_size, 0x00, IEEE80211_FCS_SIZE);
+
 #if defined(DXWIFI_TESTS)
     struct pcap_pkthdr pcap_hdr;
     gettimeofday(&pcap_hdr.ts, NULL);
@@ -259,6 +511,30 @@ static int inject_packet(dxwifi_transmitter* tx, dxwifi_tx_frame* frame, size_t
 }
 
 
+/**
+ *  DESCRIPTION:    Injects the control data already in the frame's payload, 
+ *                  plus any redundant copies
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      frame:      Frame with DXWIFI_FRAME_CONTROL_DATA_SIZE bytes of payload
+ * 
+ *      type:       The kind of control frame we are sending
+ * 
+ */
+static void inject_control_frame(dxwifi_transmitter* tx, dxwifi_tx_frame* frame, dxwifi_control_frame_t type) {
+    for (int i = 0; i < tx->redundant_ctrl_frames + 1; ++i) {
+        int status = inject_packet(tx, frame, DXWIFI_FRAME_CONTROL_DATA_SIZE);
+        trace_frame(tx->trace, DXWIFI_TRACE_TX_CONTROL, type, status, frame->__frame, DXWIFI_TX_HEADER_SIZE + DXWIFI_FRAME_CONTROL_DATA_SIZE + IEEE80211_FCS_SIZE);
+        metrics_add(tx->metrics, status > 0 ? DXWIFI_METRIC_TX_CONTROL_FRAMES : DXWIFI_METRIC_TX_INJECT_ERRORS, 1);
+        log_debug("%s Frame Sent: %d", control_frame_type_to_str(type), status);
+        log_hexdump(frame->__frame, DXWIFI_TX_HEADER_SIZE + DXWIFI_FRAME_CONTROL_DATA_SIZE + IEEE80211_FCS_SIZE);
+    }
+}
+
+
 /**
  *  DESCRIPTION:    Sends a control frame to the receiver
  * 
@@ -287,11 +563,36 @@ static void send_control_frame(dxwifi_transmitter* tx, dxwifi_tx_frame* frame, d
 
     memcpy(frame->payload, control_data, DXWIFI_FRAME_CONTROL_DATA_SIZE);
 
-    for (int i = 0; i < tx->redundant_ctrl_frames + 1; ++i) {
-        int status = inject_packet(tx, frame, sizeof(control_data));
-        log_debug("%s Frame Sent: %d", control_frame_type_to_str(type), status);
-        log_hexdump(frame->__frame, DXWIFI_TX_HEADER_SIZE + sizeof(control_data) + IEEE80211_FCS_SIZE);
-    }
+    inject_control_frame(tx, frame, type);
+}
+
+
+/**
+ *  DESCRIPTION:    Sends a resume control frame carrying the manifest
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      frame:      Allocated transmission data frame
+ * 
+ *      manifest:   Where the transmission resumes, in host byte order
+ * 
+ */
+static void send_resume_frame(dxwifi_transmitter* tx, dxwifi_tx_frame* frame, const dxwifi_resume_manifest* manifest) {
+    debug_assert(tx && tx->__handle && frame && frame->__frame && manifest);
+
+    dxwifi_resume_manifest packed = {
+        .file_id    = htobe64(manifest->file_id),
+        .offset     = htobe64(manifest->offset),
+        .block      = htonl(manifest->block)
+    };
+
+    memset(frame->payload, DXWIFI_CONTROL_FRAME_RESUME, DXWIFI_FRAME_CONTROL_DATA_SIZE);
+
+    memcpy(frame->payload, &packed, sizeof(packed));
+
+    inject_control_frame(tx, frame, DXWIFI_CONTROL_FRAME_RESUME);
 }
 
 
@@ -336,9 +637,11 @@ void init_transmitter(dxwifi_transmitter* tx, const char* device_name) {
     char err_buff[PCAP_ERRBUF_SIZE];
 
     tx->__activated = false;
+    tx->__session   = NULL;
 
-    memset(tx->__preinjection,  0x00, sizeof(dxwifi_tx_frame_handler) * DXWIFI_TX_FRAME_HANDLER_MAX);
-    memset(tx->__postinjection, 0x00, sizeof(dxwifi_tx_frame_handler) * DXWIFI_TX_FRAME_HANDLER_MAX);
+    memset(&tx->__pure_preinjection, 0x00, sizeof(dxwifi_tx_pipeline));
+    memset(&tx->__preinjection,  0x00, sizeof(dxwifi_tx_pipeline));
+    memset(&tx->__postinjection, 0x00, sizeof(dxwifi_tx_pipeline));
 
 #if defined(DXWIFI_TESTS)
     tx->__handle = pcap_open_dead(DLT_IEEE802_11_RADIO, DXWIFI_SNAPLEN_MAX);
@@ -362,7 +665,9 @@ void init_transmitter(dxwifi_transmitter* tx, const char* device_name) {
     // Hard assert here because if pcap fails it's all FUBAR anyways
     assert_M(tx->__handle != NULL, err_buff);
 
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
     log_tx_configuration(tx, device_name);
+    bind_log_context(prev_context);
 }
 
 
@@ -371,7 +676,9 @@ void close_transmitter(dxwifi_transmitter* tx) {
 
     pcap_close(tx->__handle);
 
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
     log_info("DxWifi transmitter closed");
+    bind_log_context(prev_context);
 
 #if defined(DXWIFI_TESTS)
     pcap_dump_close(tx->dumper);
@@ -382,101 +689,438 @@ void close_transmitter(dxwifi_transmitter* tx) {
 int attach_preinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callback, void* user) {
     debug_assert(tx && callback);
 
-    return attach_handler(tx->__preinjection, callback, user);
+    return attach_handler(&tx->__preinjection, callback, NULL, user);
 }
 
 
 bool remove_preinject_handler(dxwifi_transmitter* tx, int index) {
     debug_assert(tx);
 
-    return remove_handler(tx->__preinjection, index);
+    return remove_handler(&tx->__preinjection, index);
+}
+
+
+int attach_pure_preinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callback, void* user) {
+    debug_assert(tx && callback);
+
+    return attach_handler(&tx->__pure_preinjection, callback, NULL, user);
+}
+
+
+bool remove_pure_preinject_handler(dxwifi_transmitter* tx, int index) {
+    debug_assert(tx);
+
+    return remove_handler(&tx->__pure_preinjection, index);
 }
 
 
 int attach_postinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callback, void* user) {
     debug_assert(tx && callback);
 
-    return attach_handler(tx->__postinjection, callback, user);
+    return attach_handler(&tx->__postinjection, callback, NULL, user);
 }
 
 
 bool remove_postinject_handler(dxwifi_transmitter* tx, int index) {
     debug_assert(tx);
 
-    return remove_handler(tx->__postinjection, index);
+    return remove_handler(&tx->__postinjection, index);
 }
 
 
-void start_transmission(dxwifi_transmitter* tx, int fd, dxwifi_tx_stats* out) {
-    debug_assert(tx && tx->__handle);
+int attach_pure_preinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user) {
+    debug_assert(tx && callback);
 
-    int status = 0;
+    return attach_handler(&tx->__pure_preinjection, NULL, callback, user);
+}
 
-    struct pollfd   request = {
-        .fd         = fd,
-        .events     = POLLIN, // Listen for read events only
-        .revents    = 0
-    };
 
-    dxwifi_tx_stats stats = {
-        .frame_count        = 0,
-        .total_bytes_read   = 0,
-        .total_bytes_sent   = 0,
-        .prev_bytes_read    = 0,
-        .prev_bytes_sent    = 0,
-        .tx_state           = DXWIFI_TX_NORMAL
-    };
+int attach_preinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user) {
+    debug_assert(tx && callback);
 
-    dxwifi_tx_frame data_frame;
+    return attach_handler(&tx->__preinjection, NULL, callback, user);
+}
 
-    setup_dxwifi_tx_frame(&data_frame);
 
-    construct_radiotap_header(data_frame.radiotap_hdr, tx->rtap_flags, tx->rtap_rate_mbps, tx->rtap_tx_flags);
+int attach_postinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user) {
+    debug_assert(tx && callback);
+
+    return attach_handler(&tx->__postinjection, NULL, callback, user);
+}
 
-    construct_ieee80211_header(data_frame.mac_hdr, tx->fctl, 0xffff, tx->address);
+
+/**
+ *  DESCRIPTION:    Injects each frame of the batch behind the remaining 
+ *                  preinject handlers, then runs the postinject handlers over
+ *                  the frames that went out
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      batch:      Frames whose payloads are ready
+ * 
+ *      stats:      Transmission stats
+ * 
+ *  NOTES: Stops early when the transmitter is deactivated, the frames left 
+ *  over are dropped without reaching any handler.
+ * 
+ */
+static void transmit_batch(dxwifi_transmitter* tx, frame_batch* batch, dxwifi_tx_stats* stats) {
+    size_t injected = 0;
+    for(; injected < batch->count && tx->__activated; ++injected) {
+        size_t i = injected;
+
+        stats->prev_bytes_read  = batch->stats[i].prev_bytes_read;
+        batch->stats[i]         = *stats;
+
+        if(!batch->prepared && tx->__session->src.fd >= 0 && tx->packetizer.record_frame) {
+            tx->packetizer.record_frame(&batch->frames[i], batch->payload_sizes[i], stats->prev_bytes_read, tx->packetizer.user_args);
+        }
+
+        dxwifi_tx_batch frame = batch_view(batch, i, 1);
+        uint64_t start = has_handlers(&tx->__preinjection) ? latency_start(tx->latency) : 0;
+        invoke_stages(&tx->__preinjection, &frame);
+        latency_end(tx->latency, DXWIFI_LATENCY_TX_PREINJECT, start);
+
+        start = latency_start(tx->latency);
+        int status = inject_packet(tx, &batch->frames[i], batch->payload_sizes[i]);
+        latency_end(tx->latency, DXWIFI_LATENCY_TX_INJECT, start);
+        trace_frame(tx->trace, DXWIFI_TRACE_TX_DATA, stats->frame_count, status, batch->frames[i].__frame, DXWIFI_TX_HEADER_SIZE + batch->payload_sizes[i] + IEEE80211_FCS_SIZE);
+        if(status > 0) {
+            metrics_add(tx->metrics, DXWIFI_METRIC_TX_FRAMES, 1);
+            metrics_add(tx->metrics, DXWIFI_METRIC_TX_BYTES_SENT, status);
+        }
+        else {
+            metrics_add(tx->metrics, DXWIFI_METRIC_TX_INJECT_ERRORS, 1);
+        }
+        metrics_add(tx->metrics, DXWIFI_METRIC_TX_BYTES_READ, stats->prev_bytes_read);
+
+        assert_continue(status > 0, "Injection failure: %s", pcap_statustostr(status));
+
+        stats->prev_bytes_sent   = status;
+        stats->total_bytes_read += stats->prev_bytes_read;
+        stats->total_bytes_sent += stats->prev_bytes_sent;
+        stats->frame_count      += 1;
+
+        // Postinject handlers see the stats after injection and the read size
+        batch->stats[i]         = *stats;
+        batch->payload_sizes[i] = stats->prev_bytes_read;
+    }
+
+    if(injected > 0) {
+        dxwifi_tx_batch sent = batch_view(batch, 0, injected);
+        uint64_t start = has_handlers(&tx->__postinjection) ? latency_start(tx->latency) : 0;
+        invoke_stages(&tx->__postinjection, &sent);
+        latency_end(tx->latency, DXWIFI_LATENCY_TX_POSTINJECT, start);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Allocates the batches frames are read into and starts the
+ *                  block workers when there's pure preinject work for them,
+ *                  see block_workers in transmitter.h
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      pool:       Pool to start
+ * 
+ *      workers:    Set if the workers were started
+ * 
+ *  RETURNS:
+ *      
+ *      frame_batch*:   A window of batches for the workers to prepare, or a
+ *                      single batch if the pure handlers run inline
+ * 
+ */
+static frame_batch* start_block_workers(dxwifi_transmitter* tx, block_pool* pool, bool* workers) {
+    size_t window = 1;
+
+    *workers = false;
+    if(tx->block_workers > 0 && has_handlers(&tx->__pure_preinjection)) {
+        // The pool limits the thread count, the window is sized for the threads it starts
+        unsigned nthreads = tx->block_workers < BLOCK_POOL_THREADS_MAX ? tx->block_workers : BLOCK_POOL_THREADS_MAX;
+        window = nthreads * BLOCK_POOL_WINDOW_DFLT;
+
+        *workers = init_block_pool(pool, tx->block_workers, window, prepare_batch, tx);
+        if(!*workers) {
+            log_warning("Failed to start block workers, preparing frames inline");
+            window = 1;
+        }
+    }
+
+    frame_batch* batches = calloc(window, sizeof(frame_batch));
+    assert_M(batches, "Failed to allocate %ld batches", window);
+
+    for(size_t i = 0; i < window; ++i) {
+        for(size_t j = 0; j < DXWIFI_TX_BATCH_MAX; ++j) {
+            dxwifi_tx_frame* frame = &batches[i].frames[j];
+
+            setup_dxwifi_tx_frame(frame);
+            construct_radiotap_header(frame->radiotap_hdr, tx->rtap_flags, tx->rtap_rate_mbps, tx->rtap_tx_flags);
+            construct_ieee80211_header(frame->mac_hdr, tx->fctl, 0xffff, tx->address);
+        }
+    }
+    if(*workers) {
+        log_info("Preparing frames on %d threads", pool->nthreads);
+    }
+    return batches;
+}
+
+
+/**
+ *  DESCRIPTION:    Sets up a transmission of @src and sends the preamble, or 
+ *                  the resume frame when resuming
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter, not transmitting
+ * 
+ *      src:        Source of the data to be sent
+ * 
+ *      resume:     Where an interrupted transmission left off, or NULL
+ * 
+ */
+static void begin_from(dxwifi_transmitter* tx, const tx_source* src, const dxwifi_resume_manifest* resume) {
+    debug_assert(tx && tx->__handle && !tx->__session);
+
+    dxwifi_tx_session* s = calloc(1, sizeof(dxwifi_tx_session));
+    assert_M(s, "Failed to allocate transmission state");
+
+    s->src = *src;
+
+    s->request.fd       = src->fd;
+    s->request.events   = POLLIN; // Listen for read events only
+    s->request.revents  = 0;
+
+    // Frames keep the numbers they had before the interruption
+    s->first_frame = resume ? resume->block : 0;
+
+    s->stats.frame_count        = s->first_frame;
+    s->stats.total_bytes_read   = 0;
+    s->stats.total_bytes_sent   = 0;
+    s->stats.prev_bytes_read    = 0;
+    s->stats.prev_bytes_sent    = 0;
+    s->stats.tx_state           = DXWIFI_TX_NORMAL;
+
+    setup_dxwifi_tx_frame(&s->control_frame);
+
+    construct_radiotap_header(s->control_frame.radiotap_hdr, tx->rtap_flags, tx->rtap_rate_mbps, tx->rtap_tx_flags);
+
+    construct_ieee80211_header(s->control_frame.mac_hdr, tx->fctl, 0xffff, tx->address);
+
+    s->batches = start_block_workers(tx, &s->pool, &s->workers);
+
+    tx->__session = s;
 
     log_info("Starting DxWiFi Transmission...");
 
     tx->__activated = true;
+    metrics_add(tx->metrics, DXWIFI_METRIC_TX_ACTIVE, 1);
+
+    if(resume) {
+        log_info("Resuming at block %d", resume->block);
+        send_resume_frame(tx, &s->control_frame, resume);
+    }
+    else {
+        send_control_frame(tx, &s->control_frame, DXWIFI_CONTROL_FRAME_PREAMBLE);
+    }
+}
+
+
+/**
+ *  DESCRIPTION:    Reads the next batch of frames that are ready and injects
+ *                  a batch
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Transmitter with a transmission in progress
+ * 
+ *      wait_ms:    How long to wait on the input when nothing else is left 
+ *                  to do, negative waits forever
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_tx_step_t:   DXWIFI_TX_STEP_WAIT if the input had nothing after
+ *                          waiting on it
+ * 
+ *  NOTES: Frames are read into batches of up to DXWIFI_TX_BATCH_MAX for as 
+ *  long as the input has data ready, input is only waited on for the first 
+ *  frame of a batch and only when nothing else is waiting to go out. With 
+ *  block workers, batches are read ahead into a window while the workers run
+ *  the pure handlers on them, and the oldest batch is injected once it's 
+ *  ready. That way a slow source never holds back frames that are ready.
+ * 
+ */
+static dxwifi_tx_step_t step(dxwifi_transmitter* tx, int wait_ms) {
+    dxwifi_tx_session* s = tx->__session;
+    debug_assert(s);
 
-    send_control_frame(tx, &data_frame, DXWIFI_CONTROL_FRAME_PREAMBLE);
+    bool in_flight  = s->workers && block_pool_depth(&s->pool) > 0;
+    bool stalled    = s->end_of_input || (s->workers && block_pool_full(&s->pool));
+    bool idle       = false;
 
-    do {
-        status = poll(&request, 1, tx->transmit_timeout * 1000);
+    if(!tx->__activated || (s->end_of_input && !in_flight)) {
+        return DXWIFI_TX_STEP_DONE;
+    }
+
+    frame_batch* batch = stalled ? NULL : &s->batches[s->workers ? s->batches_read % s->pool.capacity : 0];
+    if(batch) {
+        batch->count    = 0;
+        batch->prepared = false;
+    }
+    while(batch && batch->count < DXWIFI_TX_BATCH_MAX && !s->end_of_input && tx->__activated) {
+        bool wait = batch->count == 0 && !in_flight;
+
+        int status = 1;
+        if(!source_ready(tx, &s->src)) {
+            uint64_t start = latency_start(tx->latency);
+            status = poll(&s->request, 1, wait ? wait_ms : 0);
+            latency_end(tx->latency, DXWIFI_LATENCY_TX_WAIT, start);
+        }
 
         if(status == 0) {
-            log_info("Transmitter timeout occured");
-            stats.tx_state = DXWIFI_TX_TIMED_OUT;
-            tx->__activated = false;
+            idle = wait;
+            stalled = true;
+            break;
         } 
         else if (status < 0) {
             if(tx->__activated) {
                 log_error("Error occured: %s", strerror(errno));
-                stats.tx_state = DXWIFI_TX_ERROR;
+                s->stats.tx_state = DXWIFI_TX_ERROR;
             }
             else {
-                stats.tx_state = DXWIFI_TX_DEACTIVATED;
+                s->stats.tx_state = DXWIFI_TX_DEACTIVATED;
             }
+            // Nothing read yet means the source itself is bad, don't spin on it
+            s->end_of_input = s->blocks_read == 0;
+            stalled = true;
+            break;
+        }
+
+        size_t i = batch->count;
+        uint64_t start = latency_start(tx->latency);
+
+        // A batch is either all ready to go out or all read, never a mix
+        size_t bytes_read = 0;
+        size_t ready = (i == 0 || batch->prepared) ? replay_frame(tx, &s->src, &batch->frames[i], &bytes_read) : 0;
+        if(ready == 0 && batch->prepared) {
+            latency_end(tx->latency, DXWIFI_LATENCY_TX_READ, start);
+            break;
+        }
+        batch->prepared = ready > 0;
+
+        ssize_t nbytes = batch->prepared ? (ssize_t) bytes_read : read_block(tx, &s->src, batch->frames[i].payload);
+        latency_end(tx->latency, DXWIFI_LATENCY_TX_READ, start);
+        if(nbytes > 0) {
+            batch->payload_sizes[i]             = batch->prepared ? ready : (size_t) nbytes;
+            batch->stats[i]                     = s->stats;
+            batch->stats[i].prev_bytes_read     = nbytes;
+            batch->stats[i].frame_count         = s->first_frame + s->blocks_read++;
+            ++batch->count;
+        }
+        else if(nbytes == 0) {
+            s->end_of_input = true;
+        }
+        else if(s->src.fd < 0 || (errno != EAGAIN && errno != EINTR)) {
+            log_error("Failed to read input: %s", strerror(errno));
+            s->stats.tx_state = DXWIFI_TX_ERROR;
+            s->end_of_input = true;
         }
         else {
-            stats.prev_bytes_read = read(fd, data_frame.payload, tx->blocksize);
-            if(stats.prev_bytes_read > 0) {
+            stalled = true;
+            break;
+        }
+    }
 
-                size_t payload_size = invoke_handlers(tx->__preinjection, &data_frame, stats);
+    if(batch && batch->count > 0) {
+        if(s->workers) {
+            block_pool_submit(&s->pool, batch);
+            ++s->batches_read;
+        }
+        else {
+            prepare_batch(batch, tx);
+            transmit_batch(tx, batch, &s->stats);
+        }
+    }
 
-                status = inject_packet(tx, &data_frame, payload_size);
+    // Inject the oldest batch once nothing more can be read ahead
+    stalled = stalled || s->end_of_input || !tx->__activated;
+    if(stalled && s->workers && tx->__activated && block_pool_depth(&s->pool) > 0) {
+        transmit_batch(tx, block_pool_collect(&s->pool), &s->stats);
+    }
 
-                assert_continue(status > 0, "Injection failure: %s", pcap_statustostr(status));
+    if(!tx->__activated || (s->end_of_input && !(s->workers && block_pool_depth(&s->pool) > 0))) {
+        return DXWIFI_TX_STEP_DONE;
+    }
+    return idle ? DXWIFI_TX_STEP_WAIT : DXWIFI_TX_STEP_READY;
+}
 
-                stats.prev_bytes_sent   = status;
-                stats.total_bytes_read += stats.prev_bytes_read;
-                stats.total_bytes_sent += stats.prev_bytes_sent;
-                stats.frame_count      += 1;
 
-                invoke_handlers(tx->__postinjection, &data_frame, stats);
-            }
+/**
+ *  DESCRIPTION:    Transmits @src from the start, or from the manifest's block
+ *                  when resuming, and waits on the input for as long as the 
+ *                  transmit timeout
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         Initialized transmitter
+ * 
+ *      src:        Source of the data to be sent
+ * 
+ *      resume:     Where an interrupted transmission left off, or NULL
+ * 
+ *      out:        Pointer to an allocated stats object or NULL
+ * 
+ */
+static void transmit_from(dxwifi_transmitter* tx, const tx_source* src, const dxwifi_resume_manifest* resume, dxwifi_tx_stats* out) {
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
+
+    if(src->fd < 0 && tx->packetizer.read_block) {
+        log_warning("Packetizers read from a file descriptor, sending fixed blocks");
+    }
+
+    begin_from(tx, src, resume);
+
+    dxwifi_tx_step_t status = DXWIFI_TX_STEP_READY;
+    while(status != DXWIFI_TX_STEP_DONE) {
+        status = step(tx, tx->transmit_timeout * 1000);
+
+        if(status == DXWIFI_TX_STEP_WAIT) {
+            log_info("Transmitter timeout occured");
+            tx->__session->stats.tx_state = DXWIFI_TX_TIMED_OUT;
+            tx->__activated = false;
         }
-    } while(tx->__activated && stats.prev_bytes_read > 0);
+    }
+
+    end_transmission(tx, out);
+
+    bind_log_context(prev_context);
+}
+
+
+void end_transmission(dxwifi_transmitter* tx, dxwifi_tx_stats* out) {
+    debug_assert(tx && tx->__session);
+
+    dxwifi_tx_session* s = tx->__session;
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
+
+    if(s->workers) {
+        log_debug(
+            "Block Pool Stats\n"
+            "\tBatches Prepared:    %lu\n"
+            "\tBatches Injected:    %lu\n"
+            "\tWaits On Workers:    %lu\n",
+            s->pool.stats.submitted,
+            s->pool.stats.collected,
+            s->pool.stats.collect_waits
+        );
+        teardown_block_pool(&s->pool); // Frames still in flight are dropped
+    }
+    free(s->batches);
 
 #if defined(DXWIFI_TESTS)
     pcap_dump_flush(tx->dumper);
@@ -484,15 +1128,101 @@ void start_transmission(dxwifi_transmitter* tx, int fd, dxwifi_tx_stats* out) {
 
     log_info("DxWiFI Transmission stopped");
 
-    send_control_frame(tx, &data_frame, DXWIFI_CONTROL_FRAME_EOT);
+    send_control_frame(tx, &s->control_frame, DXWIFI_CONTROL_FRAME_EOT);
 
-    if(stats.tx_state == DXWIFI_TX_NORMAL && !tx->__activated) {
-        stats.tx_state = DXWIFI_TX_DEACTIVATED;
+    if(s->stats.tx_state == DXWIFI_TX_NORMAL && !tx->__activated) {
+        s->stats.tx_state = DXWIFI_TX_DEACTIVATED;
     }
 
     if(out) {
-        *out = stats;
+        *out = s->stats;
     }
+    metrics_add(tx->metrics, DXWIFI_METRIC_TX_ACTIVE, -1);
+
+    tx->__activated = false;
+    tx->__session   = NULL;
+    free(s);
+
+    bind_log_context(prev_context);
+}
+
+
+void begin_transmission(dxwifi_transmitter* tx, int fd, const dxwifi_resume_manifest* resume) {
+    tx_source src = { .fd = fd };
+
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
+    begin_from(tx, &src, resume);
+    bind_log_context(prev_context);
+}
+
+
+int transmission_fd(const dxwifi_transmitter* tx) {
+    debug_assert(tx && tx->__session);
+
+    return tx->__session->src.fd;
+}
+
+
+dxwifi_tx_step_t step_transmission(dxwifi_transmitter* tx) {
+    debug_assert(tx && tx->__session);
+
+    dxwifi_log_context* prev_context = bind_log_context(tx->log_context);
+    dxwifi_tx_step_t status = step(tx, 0);
+    bind_log_context(prev_context);
+
+    return status;
+}
+
+
+void start_transmission(dxwifi_transmitter* tx, int fd, dxwifi_tx_stats* out) {
+    tx_source src = { .fd = fd };
+
+    transmit_from(tx, &src, NULL, out);
+}
+
+
+void resume_transmission(dxwifi_transmitter* tx, int fd, const dxwifi_resume_manifest* manifest, dxwifi_tx_stats* out) {
+    debug_assert(manifest);
+
+    tx_source src = { .fd = fd };
+
+    transmit_from(tx, &src, manifest, out);
+}
+
+
+void start_transmission_buffer(dxwifi_transmitter* tx, const void* data, size_t size, dxwifi_tx_stats* out) {
+    debug_assert(data || size == 0);
+
+    struct iovec iov = {
+        .iov_base   = (void*) data,
+        .iov_len    = size
+    };
+    start_transmission_iov(tx, &iov, 1, out);
+}
+
+
+void start_transmission_iov(dxwifi_transmitter* tx, const struct iovec* iov, int iovcnt, dxwifi_tx_stats* out) {
+    debug_assert(iov || iovcnt == 0);
+
+    tx_source src = {
+        .fd         = -1,
+        .iov        = iov,
+        .iovcnt     = iovcnt > 0 ? iovcnt : 0,
+        .offset     = 0
+    };
+    transmit_from(tx, &src, NULL, out);
+}
+
+
+void start_transmission_pull(dxwifi_transmitter* tx, dxwifi_tx_pull_cb pull, void* user, dxwifi_tx_stats* out) {
+    debug_assert(pull);
+
+    tx_source src = {
+        .fd         = -1,
+        .pull       = pull,
+        .pull_user  = user
+    };
+    transmit_from(tx, &src, NULL, out);
 }
 
 
@@ -8,6 +8,9 @@
  * 
  *  NOTES: struct fields prefixed with a '__' denote private scope
  * 
+ *  Instances share no state, each transmitter may run on its own thread. Calls on 
+ *  one instance must come from one thread at a time, except stop_transmission.
+ * 
  */
 
 #ifndef LIBDXWIFI_TRANSMITTER_H
@@ -19,7 +22,14 @@
 
 #include <pcap.h>
 
+#include <sys/uio.h>
+
+#include <libdxwifi/dxwifi.h>
 #include <libdxwifi/details/ieee80211.h>
+#include <libdxwifi/details/trace.h>
+#include <libdxwifi/details/metrics.h>
+#include <libdxwifi/details/latency.h>
+#include <libdxwifi/details/logging.h>
 
 /************************
  *  Constants
@@ -40,6 +50,8 @@
 
 #define DXWIFI_TX_FRAME_HANDLER_MAX 8
 
+#define DXWIFI_TX_BATCH_MAX 32
+
 /************************
  *  Data structures
  ***********************/
@@ -105,8 +117,8 @@ typedef enum {
  */
 typedef struct {
     uint32_t            frame_count;        /* number of frames sent        */
-    uint32_t            total_bytes_read;   /* total bytes read from source */
-    uint32_t            total_bytes_sent;   /* total of bytes sent via pcap */
+    uint64_t            total_bytes_read;   /* total bytes read from source */
+    uint64_t            total_bytes_sent;   /* total of bytes sent via pcap */
     uint32_t            prev_bytes_read;    /* Size of last read            */
     uint32_t            prev_bytes_sent;    /* Size of last transmission    */
     dxwifi_tx_state_t   tx_state;           /* State of last transmission   */
@@ -142,6 +154,14 @@ typedef size_t (*dxwifi_tx_frame_cb)(
  *  to copy/read data on the frame before it is reused. Lastly, both preinject
  *  and postinject handlers can be used as event signals for the user space to
  *  perform arbitrary tasks like logging, sleep for transmission delay, etc. 
+ * 
+ *  Pure preinject handlers are a third kind, for CPU heavy work on a single 
+ *  frame like checksums, parity or encryption. Their result may only depend on
+ *  the frame itself, the frame_count and prev_bytes_read stats, and their own
+ *  thread safe parameters. With block_workers set they run on worker threads 
+ *  ahead of injection, otherwise inline, in both cases before the regular 
+ *  preinject handlers. Anything with side effects, like a delay, must be a 
+ *  regular preinject handler.
  */
 typedef struct {
     dxwifi_tx_frame_cb  callback;
@@ -149,6 +169,115 @@ typedef struct {
 } dxwifi_tx_frame_handler;
 
 
+/**
+ *  Frames are handed to batch handlers in groups, up to DXWIFI_TX_BATCH_MAX of
+ *  them. The transmitter batches the frames it can read without waiting on 
+ *  the input, so a slow source is handled one frame at a time. Each array has
+ *  count entries, entry i of each belongs to the same frame. A batch handler 
+ *  updates payload_sizes the same way a frame handler returns the new size.
+ * 
+ *  Regular preinject handlers are still handed one frame at a time, right 
+ *  before it's injected, so a delay or any other side effect keeps its timing.
+ *  Pure preinject and postinject handlers get the whole batch.
+ */
+typedef struct {
+    dxwifi_tx_frame*        frames;         /* Frames in transmission order */
+    size_t*                 payload_sizes;  /* Size of each frame's payload */
+    const dxwifi_tx_stats*  stats;          /* Stats as of each frame       */
+    size_t                  count;          /* Number of frames             */
+} dxwifi_tx_batch;
+
+
+typedef void (*dxwifi_tx_batch_cb)(
+        dxwifi_tx_batch* batch, /* Frames to handle                         */
+        void* user              /* User supplied parameters                 */
+        );
+
+
+/**
+ *  Handlers are attached by slot, which is what the attach functions return 
+ *  and what remove takes, and compiled into a dense list of stages in slot 
+ *  order whenever one is attached or removed. Frame handlers become a stage 
+ *  through an adapter that calls them on each frame of the batch.
+ */
+typedef struct {
+    dxwifi_tx_batch_cb  callback;
+    void*               user_args;
+} dxwifi_tx_stage;
+
+
+typedef struct {
+    dxwifi_tx_frame_handler handlers[DXWIFI_TX_FRAME_HANDLER_MAX];
+                                            /* Frame handlers by slot       */
+    dxwifi_tx_stage         batch_handlers[DXWIFI_TX_FRAME_HANDLER_MAX];
+                                            /* Batch handlers by slot       */
+    dxwifi_tx_stage         stages[DXWIFI_TX_FRAME_HANDLER_MAX];
+                                            /* Attached handlers, in order  */
+    size_t                  stage_count;    /* Number of stages             */
+} dxwifi_tx_pipeline;
+
+
+/**
+ *  Packetizers take over how the payload of each frame is read from the input
+ *  source. By default the transmitter fills each payload with the next 
+ *  blocksize bytes from the file descriptor. A packetizer can instead buffer 
+ *  the input and cut it along natural boundaries, prefix its own headers, or
+ *  repeat a payload. 
+ * 
+ *  read_block must return the number of payload bytes written (at most 
+ *  blocksize), 0 when the input is exhausted, or -1 with errno set. An errno
+ *  of EAGAIN tells the transmitter nothing is ready yet and to poll again. 
+ *  has_pending is checked before polling, a packetizer with buffered payloads
+ *  will be read from without waiting on the file descriptor. 
+ * 
+ *  A packetizer that keeps frames between transmissions, like a cache of an 
+ *  earlier pass over the same file, can hand them back ready to go out. 
+ *  record_frame is called with every frame read through read_block once the 
+ *  pure preinject handlers ran on it, in transmission order and before the 
+ *  regular preinject handlers. replay_frame is tried before read_block, it 
+ *  fills in the MAC header and payload, sets the bytes the payload was read 
+ *  from and returns the payload size, or 0 to have the frame read with 
+ *  read_block instead. Frames it hands back skip the pure preinject handlers.
+ *  Both are optional and only used with a file descriptor.
+ */
+typedef struct {
+    ssize_t (*read_block)(int fd, uint8_t* payload, size_t blocksize, void* user);
+    bool    (*has_pending)(void* user);
+    void    (*record_frame)(const dxwifi_tx_frame* frame, size_t payload_size, size_t bytes_read, void* user);
+    size_t  (*replay_frame)(dxwifi_tx_frame* frame, size_t* bytes_read, void* user);
+    void*   user_args;
+} dxwifi_tx_packetizer;
+
+
+/**
+ *  Pull sources hand the transmitter one payload at a time, see 
+ *  start_transmission_pull(). Same contract as a packetizer's read_block 
+ *  except there's no file descriptor to poll: the callback should block until
+ *  a payload is ready, and -1 ends the transmission with an error.
+ */
+typedef ssize_t (*dxwifi_tx_pull_cb)(
+        uint8_t* payload,   /* Payload section of the data frame            */
+        size_t blocksize,   /* Most bytes the payload can take              */
+        void* user          /* User supplied parameters                     */
+        );
+
+
+/**
+ *  What step_transmission() wants next. READY means there's more to do right
+ *  away, WAIT means the input has nothing ready and transmission_fd() should be
+ *  polled for POLLIN first, DONE means end_transmission() should be called.
+ */
+typedef enum {
+    DXWIFI_TX_STEP_READY,
+    DXWIFI_TX_STEP_WAIT,
+    DXWIFI_TX_STEP_DONE
+} dxwifi_tx_step_t;
+
+
+// State of a transmission in progress, private to transmitter.c
+typedef struct dxwifi_tx_session dxwifi_tx_session;
+
+
 /**
  *  Transmitter is responsible for handling file transmission. The transmitter
  *  must be intialized before use and torn down after. It is the user's 
@@ -166,13 +295,22 @@ typedef struct {
     uint8_t     rtap_rate_mbps;     /* Radiotap data rate                   */
     uint16_t    rtap_tx_flags;      /* Radiotap Tx flags                    */
     ieee80211_frame_control fctl;   /* Frame control settings               */
+    dxwifi_tx_packetizer packetizer;/* Optional, defaults to fixed blocks   */
+    unsigned    block_workers;      /* Threads running the pure handlers    */
+    dxwifi_log_context* log_context;/* Optional, NULL logs to the default   */
+    dxwifi_trace*   trace;          /* Optional, NULL records no frames     */
+    dxwifi_metrics* metrics;        /* Optional, NULL publishes nothing     */
+    dxwifi_latency* latency;        /* Optional, NULL times nothing         */
 
 
-    dxwifi_tx_frame_handler __preinjection[DXWIFI_TX_FRAME_HANDLER_MAX];
+    dxwifi_tx_pipeline  __pure_preinjection;
+                                    /* Called ahead of injection            */
+    dxwifi_tx_pipeline  __preinjection;
                                     /* Called before injection              */
-    dxwifi_tx_frame_handler __postinjection[DXWIFI_TX_FRAME_HANDLER_MAX];
+    dxwifi_tx_pipeline  __postinjection;
                                     /* Called after injection               */
     volatile bool   __activated;    /* Currently transmitting?              */
+    dxwifi_tx_session* __session;   /* Transmission in progress             */
     pcap_t*         __handle;       /* Session handle for Pcap              */
 
 #if defined(DXWIFI_TESTS)
@@ -257,6 +395,51 @@ int attach_preinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callback
 bool remove_preinject_handler(dxwifi_transmitter* tx, int index);
 
 
+/**
+ *  DESCRIPTION:    Attaches a frame handler to the first available slot in the 
+ *                  pure preinjection pipeline, see dxwifi_tx_frame_handler
+ * 
+ *  ARGUMENTS: 
+ * 
+ *      tx:         pointer to an allocated transmitter object
+ * 
+ *      callback:   function pointer to callback function, must be safe to 
+ *                  call from several threads at once
+ * 
+ *      user:       pointer to user allocated callback parameters
+ * 
+ *  RETURNS:
+ * 
+ *      int:        index to the handler for reference or -1 if the 
+ *                  pipeline is full
+ * 
+ *  NOTES: Pure handlers are called in the order they were attached on each 
+ *  frame, but different frames may be handled at the same time. Frames are
+ *  still injected in order.
+ * 
+ */
+int attach_pure_preinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callback, void* user);
+
+
+/**
+ *  DESCRIPTION:    Removes the specified frame handler from the pure 
+ *                  preinjection pipeline
+ * 
+ *  ARGUMENTS:
+ *  
+ *      tx:         pointer to an allocated transmitter object
+ * 
+ *      index:      index to the handler to be removed, a negative value 
+ *                  removes all pure preinject handlers
+ * 
+ *  RETURNS:       
+ * 
+ *      bool:       true if the handler was successfully removed
+ * 
+ */
+bool remove_pure_preinject_handler(dxwifi_transmitter* tx, int index);
+
+
 /**
  *  DESCRIPTION:    Attaches a frame handler to the first available slot in the 
  *                  postinjection pipeline
@@ -301,6 +484,30 @@ int attach_postinject_handler(dxwifi_transmitter* tx, dxwifi_tx_frame_cb callbac
 bool remove_postinject_handler(dxwifi_transmitter* tx, int index);
 
 
+/**
+ *  DESCRIPTION:    Batch handler versions of the attach functions above. A
+ *                  batch handler shares its pipeline's slots with the frame
+ *                  handlers and is removed with the same remove function.
+ * 
+ *  ARGUMENTS:
+ * 
+ *      tx:         pointer to an allocated transmitter object
+ * 
+ *      callback:   function pointer to batch callback function
+ * 
+ *      user:       pointer to user allocated callback parameters
+ * 
+ *  RETURNS:
+ * 
+ *      int:        index to the handler for reference or -1 if the 
+ *                  pipeline is full
+ * 
+ */
+int attach_pure_preinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user);
+int attach_preinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user);
+int attach_postinject_batch_handler(dxwifi_transmitter* tx, dxwifi_tx_batch_cb callback, void* user);
+
+
 /**
  *  DESCRIPTION:    Reads blocks of data from @fd and transmits data until 
  *                  transmission is stopped via stop_transmission(), timeout 
@@ -326,6 +533,171 @@ bool remove_postinject_handler(dxwifi_transmitter* tx, int index);
 void start_transmission(dxwifi_transmitter* transmitter, int fd, dxwifi_tx_stats* out);
 
 
+/**
+ *  DESCRIPTION:    Continues a transmission that was interrupted part way 
+ *                  through, see start_transmission() 
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Pointer to an allocated transmitter object
+ * 
+ *      fd:             File descriptor of the data to be sent, positioned at
+ *                      the manifest's offset
+ * 
+ *      manifest:       Where the transmission resumes, in host byte order
+ * 
+ *      out:            Pointer to an allocated stats object or NULL if stats
+ *                      aren't needed.
+ * 
+ *  NOTES: A resume control frame carrying the manifest is sent in place of the
+ *  preamble, and frames are numbered from the manifest's block so an ordered
+ *  receiver sees one continuous transmission. The frame count in @out starts
+ *  from the manifest's block as well.
+ * 
+ */
+void resume_transmission(dxwifi_transmitter* transmitter, int fd, const dxwifi_resume_manifest* manifest, dxwifi_tx_stats* out);
+
+
+/**
+ *  DESCRIPTION:    Transmits a buffer that's already in memory, see 
+ *                  start_transmission()
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Pointer to an allocated transmitter object
+ * 
+ *      data:           Data to be sent, must stay valid until this returns
+ * 
+ *      size:           Size of data in bytes
+ * 
+ *      out:            Pointer to an allocated stats object or NULL if stats
+ *                      aren't needed.
+ * 
+ *  NOTES: Payloads are copied straight out of @data into each frame, there is
+ *  no poll() or read() and the transmit timeout doesn't apply. Frames are cut
+ *  into fixed blocks, an attached packetizer reads from a file descriptor so 
+ *  it's not used.
+ * 
+ */
+void start_transmission_buffer(dxwifi_transmitter* transmitter, const void* data, size_t size, dxwifi_tx_stats* out);
+
+
+/**
+ *  DESCRIPTION:    Transmits an array of buffers as if they were one, see
+ *                  start_transmission_buffer()
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Pointer to an allocated transmitter object
+ * 
+ *      iov:            Buffers to be sent in order, must stay valid until 
+ *                      this returns
+ * 
+ *      iovcnt:         Number of buffers
+ * 
+ *      out:            Pointer to an allocated stats object or NULL if stats
+ *                      aren't needed.
+ * 
+ *  NOTES: A frame can span the end of one buffer and the start of the next, 
+ *  the receiver gets the same bytes as if the buffers were written to a file.
+ * 
+ */
+void start_transmission_iov(dxwifi_transmitter* transmitter, const struct iovec* iov, int iovcnt, dxwifi_tx_stats* out);
+
+
+/**
+ *  DESCRIPTION:    Transmits payloads filled in by a callback until it 
+ *                  returns 0, see dxwifi_tx_pull_cb
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Pointer to an allocated transmitter object
+ * 
+ *      pull:           Fills in the payload of each frame
+ * 
+ *      user:           Passed to pull
+ * 
+ *      out:            Pointer to an allocated stats object or NULL if stats
+ *                      aren't needed.
+ * 
+ *  NOTES: The callback writes straight into the frame, it's up to the caller
+ *  how payloads are framed. Like a packetizer, pull is only ever called from
+ *  the thread running the transmission.
+ * 
+ */
+void start_transmission_pull(dxwifi_transmitter* transmitter, dxwifi_tx_pull_cb pull, void* user, dxwifi_tx_stats* out);
+
+
+/**
+ *  DESCRIPTION:    Starts a transmission that's driven by step_transmission()
+ *                  instead of blocking, and sends the preamble, or the resume
+ *                  frame when @resume is set
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Pointer to an initialized transmitter that isn't 
+ *                      transmitting
+ * 
+ *      fd:             File descriptor of the data to be sent
+ * 
+ *      resume:         Where the transmission resumes, or NULL, see 
+ *                      resume_transmission()
+ * 
+ *  NOTES: Meant for an event loop driving more than one transmitter, receiver
+ *  or anything else with a file descriptor. The transmit timeout isn't used, 
+ *  time the transmission out by calling stop_transmission() from the loop.
+ * 
+ */
+void begin_transmission(dxwifi_transmitter* transmitter, int fd, const dxwifi_resume_manifest* resume);
+
+
+/**
+ *  DESCRIPTION:    File descriptor to poll for POLLIN when step_transmission()
+ *                  returns DXWIFI_TX_STEP_WAIT
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Transmitter started with begin_transmission()
+ * 
+ */
+int transmission_fd(const dxwifi_transmitter* transmitter);
+
+
+/**
+ *  DESCRIPTION:    Does a bounded amount of work without waiting on the input,
+ *                  reads the frames that are ready, at most a batch, and 
+ *                  injects at most a batch
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Transmitter started with begin_transmission()
+ * 
+ *  RETURNS:
+ * 
+ *      dxwifi_tx_step_t:   What to do next, see dxwifi_tx_step_t
+ * 
+ *  NOTES: Injection itself and the handlers can still block, a --delay 
+ *  handler sleeps between every frame for example.
+ * 
+ */
+dxwifi_tx_step_t step_transmission(dxwifi_transmitter* transmitter);
+
+
+/**
+ *  DESCRIPTION:    Sends the End-Of-Transmission frame and releases the 
+ *                  transmission's resources
+ * 
+ *  ARGUMENTS:
+ * 
+ *      transmitter:    Transmitter started with begin_transmission()
+ * 
+ *      out:            Pointer to an allocated stats object or NULL if stats
+ *                      aren't needed.
+ * 
+ */
+void end_transmission(dxwifi_transmitter* transmitter, dxwifi_tx_stats* out);
+
+
 /**
  *  DESCRIPTION:    Signals to the transmitter to stop transmitting packets
  * 
@@ -0,0 +1,83 @@
+"""
+    bench_compress.py
+
+    DESCRIPTION: Benchmarks the compression packetizer at each level against
+    plain file transmission. Reports tx CPU time, compression ratio, frames
+    sent and the resulting airtime at the link rate.
+
+    The flight computer is a BeagleBone-class board, a single core ARM with
+    little headroom. By default tx is pinned to a single core to mirror that,
+    absolute times still depend on the host, so compare levels relative to the
+    plain run. For numbers from the board itself, run this on the board.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import time
+import resource
+import argparse
+import tempfile
+import subprocess
+
+from test.savefile import read_savefile
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+RX          = f'./{INSTALL_DIR}/rx'
+
+
+def child_cpu_seconds():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def run(input_file, tx_opts, rx_opts, blocksize, core, repeat, workdir):
+    tx_out  = os.path.join(workdir, 'tx.raw')
+    rx_out  = os.path.join(workdir, 'rx.out')
+    pin     = (lambda: os.sched_setaffinity(0, {core})) if core >= 0 else None
+
+    cpu_start = child_cpu_seconds()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        subprocess.run(f'{TX} {input_file} -q -b {blocksize} {tx_opts} --savefile {tx_out}'.split(), preexec_fn=pin)
+    elapsed = (time.perf_counter() - start) / repeat
+    cpu     = (child_cpu_seconds() - cpu_start) / repeat
+
+    records = read_savefile(tx_out)[1]
+    airtime = sum(len(frame) for _, frame in records)
+
+    subprocess.run(f'{RX} {rx_out} -q -t 2 {rx_opts} --savefile {tx_out}'.split())
+    with open(input_file, 'rb') as a, open(rx_out, 'rb') as b:
+        intact = a.read() == b.read()
+
+    return elapsed, cpu, len(records), airtime, intact
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compression packetizer benchmark')
+    parser.add_argument('-i', '--input',        default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-g', '--group-blocks', default=16,     type=int,   help='Blocks compressed together')
+    parser.add_argument('-r', '--rate',         default=1.0,    type=float, help='Link rate in Mbps for the airtime estimate')
+    parser.add_argument('-c', '--core',         default=0,      type=int,   help='Core to pin tx to, -1 to not pin')
+    parser.add_argument('-n', '--repeat',       default=5,      type=int,   help='Runs averaged per mode')
+    args = parser.parse_args()
+
+    size = os.path.getsize(args.input)
+    print(f'Input: {args.input}, {size} bytes, {args.rate} Mbps link, tx pinned to core {args.core}\n')
+    print(f'{"mode":<12}{"wall ms":>10}{"cpu ms":>10}{"ratio":>8}{"frames":>10}{"air s":>10}{"intact":>8}')
+
+    modes = [('plain', '', '')] + [
+        (f'level {level}', f'--compress={level} --group-blocks {args.group_blocks}', '--compress') for level in range(1, 10)
+    ]
+    with tempfile.TemporaryDirectory() as workdir:
+        for name, tx_opts, rx_opts in modes:
+            elapsed, cpu, frames, airtime, intact = run(args.input, tx_opts, rx_opts, args.blocksize, args.core, args.repeat, workdir)
+            ratio = size / max(airtime, 1)
+            print(f'{name:<12}{elapsed * 1000:>10.1f}{cpu * 1000:>10.1f}{ratio:>8.2f}{frames:>10}{airtime * 8 / (args.rate * 1e6):>10.2f}{str(intact):>8}')
+
+
+if __name__ == '__main__':
+    main()
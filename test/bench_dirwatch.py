@@ -0,0 +1,111 @@
+"""
+    bench_dirwatch.py
+
+    DESCRIPTION: File storm benchmark for directory watch mode. Starts tx
+    watching a directory, then creates files as fast as possible, optionally
+    spread over subdirectories, the way a camera dumps a burst of shots. Tx
+    queues each file as it's reported for its transmit worker. Once that queue
+    is full (see --queue-size) the inotify queue backs up, and the kernel 
+    drops events once more than /proc/sys/fs/inotify/max_queued_events are 
+    queued. Lower either limit to force overflows and exercise the rescan.
+
+    Reports how long the storm took to create, how long tx took to drain it,
+    and how many files were reported against how many were created. The
+    dirwatch and job queue counters come from the summary tx logs when it 
+    stops watching.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import re
+import time
+import argparse
+import tempfile
+import subprocess
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+
+STATS = {
+    'events':       r'Events Read:\s+(\d+)',
+    'reported':     r'Files Reported:\s+(\d+)',
+    'overflows':    r'Queue Overflows:\s+(\d+)',
+    'rescanned':    r'Files Rescanned:\s+(\d+)',
+    'directories':  r'Directories:\s+(\d+)',
+    'pending':      r'Most Files Pending:\s+(\d+)',
+    'queued':       r'Files Queued:\s+(\d+)',
+    'duplicates':   r'Duplicates Dropped:\s+(\d+)',
+    'backlog':      r'Deepest Backlog:\s+(\d+)',
+    'blocked':      r'Blocked Pushes:\s+(\d+)',
+}
+
+
+def storm(watch_dir, count, subdirs, size):
+    dirs = [watch_dir] + [os.path.join(watch_dir, f'burst_{d}') for d in range(subdirs)]
+    data = os.urandom(size)
+    for d in dirs[1:]:
+        os.mkdir(d)
+    for i in range(count):
+        with open(os.path.join(dirs[i % len(dirs)], f'shot_{i:06d}.raw'), 'wb') as f:
+            f.write(data)
+
+
+def run(count, subdirs, size, blocksize, timeout, queue_size):
+    with tempfile.TemporaryDirectory() as workdir:
+        watch_dir   = os.path.join(workdir, 'watch')
+        tx_out      = os.path.join(workdir, 'tx.raw')
+        os.mkdir(watch_dir)
+
+        recursive   = '--recursive' if subdirs > 0 else ''
+        tx_command  = f'{TX} {watch_dir} -b {blocksize} --watch-timeout {timeout} --filter shot_*.raw --queue-size {queue_size} {recursive} --savefile {tx_out}'
+
+        proc = subprocess.Popen(tx_command.split(), stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        time.sleep(0.1) # Give tx time to get set up
+
+        start = time.perf_counter()
+        storm(watch_dir, count, subdirs, size)
+        created = time.perf_counter() - start
+
+        output, _ = proc.communicate()
+        drained = time.perf_counter() - start - timeout
+
+        stats = {}
+        for name, pattern in STATS.items():
+            match = re.search(pattern, output)
+            stats[name] = int(match.group(1)) if match else -1
+        return created, drained, stats
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Dirwatch file storm benchmark')
+    parser.add_argument('-n', '--count',        default=20000,  type=int,   help='Files to create')
+    parser.add_argument('-d', '--subdirs',      default=0,      type=int,   help='Subdirectories to spread the files over, watched recursively')
+    parser.add_argument('-s', '--size',         default=64,     type=int,   help='Size of each file')
+    parser.add_argument('-b', '--blocksize',    default=300,    type=int,   help='Tx blocksize')
+    parser.add_argument('-q', '--queue-size',   default=1024,   type=int,   help='Tx job queue size')
+    parser.add_argument('-t', '--timeout',      default=2,      type=int,   help='Seconds tx waits for more files once the storm is over')
+    args = parser.parse_args()
+
+    with open('/proc/sys/fs/inotify/max_queued_events') as f:
+        queue = int(f.read())
+
+    print(f'{args.count} files of {args.size} bytes over {args.subdirs + 1} directories, inotify queue holds {queue} events\n')
+
+    created, drained, stats = run(args.count, args.subdirs, args.size, args.blocksize, args.timeout, args.queue_size)
+
+    print(f'Storm created in:       {created:.2f} s ({args.count / created:.0f} files/s)')
+    print(f'Tx drained in:          {drained:.2f} s ({stats["reported"] / max(drained, 1e-9):.0f} files/s)')
+    print(f'Files reported:         {stats["reported"]} of {args.count}')
+    print(f'Inotify events read:    {stats["events"]}')
+    print(f'Queue overflows:        {stats["overflows"]}')
+    print(f'Files found by rescan:  {stats["rescanned"]}')
+    print(f'Directories watched:    {stats["directories"]}')
+    print(f'Most files pending:     {stats["pending"]}')
+    print(f'Files queued:           {stats["queued"]} ({stats["duplicates"]} duplicates dropped)')
+    print(f'Deepest backlog:        {stats["backlog"]} ({stats["blocked"]} blocked pushes)')
+
+
+if __name__ == '__main__':
+    main()
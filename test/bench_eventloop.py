@@ -0,0 +1,84 @@
+"""
+    bench_eventloop.py
+
+    DESCRIPTION: Benchmarks driving tx and rx with the step API from an epoll
+    loop (--event-loop) against the blocking calls. Idle runs leave tx waiting
+    on an empty stdin until it times out, so any CPU time spent there is the
+    cost of waiting. Load runs send a file several times, then capture the
+    result back with rx.
+
+    Both modes should cost about the same, the step API only moves the wait
+    out of the library and into the caller's loop.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import time
+import resource
+import argparse
+import tempfile
+import subprocess
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+RX          = f'./{INSTALL_DIR}/rx'
+
+
+def child_cpu_seconds():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def measure(command, repeat, stdin=None):
+    cpu_start = child_cpu_seconds()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        subprocess.run(command.split(), stdin=stdin, stdout=subprocess.DEVNULL)
+    elapsed = (time.perf_counter() - start) / repeat
+    cpu     = (child_cpu_seconds() - cpu_start) / repeat
+    return elapsed, cpu
+
+
+def idle(opts, timeout, repeat, workdir):
+    # Read end of a pipe nobody writes to, tx waits on it until it times out
+    read_fd, write_fd = os.pipe()
+    try:
+        return measure(f'{TX} -q -t {timeout} {opts} --savefile {workdir}/idle.raw', repeat, stdin=read_fd)
+    finally:
+        os.close(read_fd)
+        os.close(write_fd)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Event loop benchmark')
+    parser.add_argument('-i', '--input',        default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-t', '--retransmit',   default=9,      type=int,   help='Retransmissions of the file under load')
+    parser.add_argument('-w', '--wait',         default=2,      type=int,   help='Seconds tx sits idle')
+    parser.add_argument('-n', '--repeat',       default=3,      type=int,   help='Runs averaged per mode')
+    args = parser.parse_args()
+
+    print(f'Input: {args.input}, {args.retransmit + 1} passes under load, {args.wait}s idle\n')
+    print(f'{"run":<16}{"mode":<12}{"wall ms":>10}{"cpu ms":>10}')
+
+    with tempfile.TemporaryDirectory() as workdir:
+        for name, opts in [('blocking', ''), ('event loop', '--event-loop')]:
+            elapsed, cpu = idle(opts, args.wait, args.repeat, workdir)
+            print(f'{"tx idle":<16}{name:<12}{elapsed * 1000:>10.1f}{cpu * 1000:>10.2f}')
+
+        tx_out = f'{workdir}/load.raw'
+        for name, opts in [('blocking', ''), ('event loop', '--event-loop')]:
+            tx = f'{TX} {args.input} -q -b {args.blocksize} -c {args.retransmit} {opts} --savefile {tx_out}'
+            elapsed, cpu = measure(tx, args.repeat)
+            print(f'{"tx load":<16}{name:<12}{elapsed * 1000:>10.1f}{cpu * 1000:>10.2f}')
+
+        for name, opts in [('blocking', ''), ('event loop', '--event-loop')]:
+            rx = f'{RX} {workdir} -q -t 2 -c 1 --prefix rx --extension raw {opts} --savefile {tx_out}'
+            elapsed, cpu = measure(rx, args.repeat)
+            print(f'{"rx load":<16}{name:<12}{elapsed * 1000:>10.1f}{cpu * 1000:>10.2f}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,87 @@
+"""
+    bench_framecache.py
+
+    DESCRIPTION: Benchmarks retransmitting a file with and without the frame
+    cache. Reports tx CPU time per pass over the file, so the cost of reading,
+    packetizing and running the pure handlers on the file again can be 
+    compared against replaying it.
+
+    Tx is pinned to a single core by default to mirror the flight computer,
+    compare the cached runs relative to the uncached ones rather than by their
+    absolute times. On a development machine, with the defaults:
+
+        mode                cpu ms/pass
+        plain                      2.29
+        plain cached               1.71
+        pure handlers              7.60
+        pure handlers cached       2.32
+        compressed                13.44
+        compressed cached          2.71
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import time
+import resource
+import argparse
+import tempfile
+import subprocess
+
+from test.savefile import read_savefile
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+
+
+def child_cpu_seconds():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def run(input_file, tx_opts, blocksize, retransmits, core, repeat, workdir):
+    tx_out  = os.path.join(workdir, 'tx.raw')
+    pin     = (lambda: os.sched_setaffinity(0, {core})) if core >= 0 else None
+
+    cpu_start = child_cpu_seconds()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        subprocess.run(f'{TX} {input_file} -q -b {blocksize} -c {retransmits} {tx_opts} --savefile {tx_out}'.split(), preexec_fn=pin)
+    elapsed = (time.perf_counter() - start) / repeat
+    cpu     = (child_cpu_seconds() - cpu_start) / repeat
+
+    digest = hash(tuple(frame for _, frame in read_savefile(tx_out)[1]))
+
+    return elapsed, cpu, digest
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Frame cache benchmark')
+    parser.add_argument('-i', '--input',        default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-t', '--retransmit',   default=9,      type=int,   help='Retransmissions of the file')
+    parser.add_argument('-c', '--core',         default=0,      type=int,   help='Core to pin tx to, -1 to not pin')
+    parser.add_argument('-n', '--repeat',       default=5,      type=int,   help='Runs averaged per mode')
+    parser.add_argument('-w', '--busy-work',    default=4,      type=int,   help='Rounds of the stand in pure handler')
+    args = parser.parse_args()
+
+    passes = args.retransmit + 1
+    size = os.path.getsize(args.input)
+    print(f'Input: {args.input}, {size} bytes, {passes} passes, tx pinned to core {args.core}\n')
+    print(f'{"mode":<20}{"wall ms":>10}{"cpu ms":>10}{"cpu ms/pass":>13}{"same frames":>13}')
+
+    packetizers = [('plain', ''), ('pure handlers', f'--ordered --busy-work {args.busy_work}'), ('compressed', '--compress')]
+    with tempfile.TemporaryDirectory() as workdir:
+        for name, tx_opts in packetizers:
+            baseline = None
+            for cached in [False, True]:
+                opts = f'{tx_opts} --frame-cache' if cached else tx_opts
+                elapsed, cpu, digest = run(args.input, opts, args.blocksize, args.retransmit, args.core, args.repeat, workdir)
+                baseline = baseline if baseline is not None else digest
+                label = f'{name}{" cached" if cached else ""}'
+                print(f'{label:<20}{elapsed * 1000:>10.1f}{cpu * 1000:>10.1f}{cpu * 1000 / passes:>13.2f}{str(digest == baseline):>13}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,74 @@
+"""
+    bench_instances.py
+
+    DESCRIPTION: Benchmarks running several transmitters in one process. Tx
+    is run with 1 to 4 instances (--instances), each sending the input on its
+    own thread with its own savefile and log context. A test only pure handler
+    (--busy-work) stands in for per-frame CPU work so each instance has
+    something to keep a core busy with.
+
+    The transmitters share no state, so aggregate throughput should grow with
+    the number of instances until they run out of cores. On a host with fewer
+    cores than instances they take turns and the aggregate stays flat.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import time
+import argparse
+import tempfile
+import subprocess
+
+from test.savefile import read_savefile
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+
+
+def run(input_file, instances, rounds, blocksize, repeat, workdir):
+    tx_out = os.path.join(workdir, 'tx.raw')
+
+    start = time.perf_counter()
+    for _ in range(repeat):
+        subprocess.run(f'{TX} {input_file} -q -b {blocksize} --ordered --busy-work {rounds} --instances {instances} --savefile {tx_out}'.split())
+    elapsed = (time.perf_counter() - start) / repeat
+
+    # Data frames less the FCS, every instance should have sent the same thing
+    digests = set()
+    for instance in range(instances):
+        frames = tuple(frame[:-4] for _, frame in read_savefile(f'{tx_out}.{instance}')[1][1:-1])
+        digests.add(hash(frames))
+    return elapsed, len(digests) == 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Multi instance benchmark')
+    parser.add_argument('-i', '--input',            default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',        default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-w', '--work',             default=16,     type=int,   help='Times each payload is hashed')
+    parser.add_argument('-m', '--max-instances',    default=4,      type=int,   help='Most transmitters to run at once')
+    parser.add_argument('-n', '--repeat',           default=3,      type=int,   help='Runs averaged per count')
+    args = parser.parse_args()
+
+    cores   = len(os.sched_getaffinity(0))
+    size_mb = os.path.getsize(args.input) / (1024 * 1024)
+
+    print(f'Input: {args.input}, {args.work} hashes per payload, {cores} cores available\n')
+    if cores < args.max_instances:
+        print(f'Warning: fewer cores than instances, results past {cores} instances won\'t scale\n')
+
+    print(f'{"instances":<12}{"wall ms":>10}{"MiB/s":>10}{"scaling":>10}{"same frames":>13}')
+
+    with tempfile.TemporaryDirectory() as workdir:
+        baseline = None
+        for instances in range(1, args.max_instances + 1):
+            elapsed, same = run(args.input, instances, args.work, args.blocksize, args.repeat, workdir)
+            throughput = instances * size_mb / elapsed
+            baseline = baseline or throughput
+            print(f'{instances:<12}{elapsed * 1000:>10.1f}{throughput:>10.2f}{throughput / baseline:>10.2f}{str(same):>13}')
+
+
+if __name__ == '__main__':
+    main()
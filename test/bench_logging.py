@@ -0,0 +1,64 @@
+"""
+    bench_logging.py
+
+    DESCRIPTION: Benchmarks the background logger (--async-log) against 
+    logging inline. Tx is run at debug and trace verbosity, where every frame
+    is logged, with stderr going to a pipe that's read as fast as it fills. 
+    Time spent formatting is the same either way, the background logger takes
+    the writes off the transmitting thread and does them in batches.
+
+    Requires a test debug build, release builds compile trace logging out. 
+    See README.md
+
+"""
+
+import os
+import time
+import resource
+import argparse
+import tempfile
+import subprocess
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestDebug')
+TX          = f'./{INSTALL_DIR}/tx'
+
+
+def child_cpu_seconds():
+    usage = resource.getrusage(resource.RUSAGE_CHILDREN)
+    return usage.ru_utime + usage.ru_stime
+
+
+def measure(command, repeat):
+    lines = 0
+    cpu_start = child_cpu_seconds()
+    start = time.perf_counter()
+    for _ in range(repeat):
+        proc = subprocess.run(command.split(), stderr=subprocess.PIPE)
+        lines += proc.stderr.count(b'\n')
+    elapsed = (time.perf_counter() - start) / repeat
+    cpu     = (child_cpu_seconds() - cpu_start) / repeat
+    return elapsed, cpu, lines // repeat
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Async logging benchmark')
+    parser.add_argument('-i', '--input',        default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-n', '--repeat',       default=5,      type=int,   help='Runs averaged per mode')
+    args = parser.parse_args()
+
+    print(f'Input: {args.input}\n')
+    print(f'{"verbosity":<12}{"mode":<12}{"wall ms":>10}{"cpu ms":>10}{"lines":>10}')
+
+    with tempfile.TemporaryDirectory() as workdir:
+        tx_out = f'{workdir}/tx.raw'
+        for verbosity in ['-v', '-vv']:
+            for name, opts in [('inline', ''), ('async', '--async-log')]:
+                tx = f'{TX} {args.input} {verbosity} -b {args.blocksize} {opts} --savefile {tx_out}'
+                elapsed, cpu, lines = measure(tx, args.repeat)
+                level = 'debug' if verbosity == '-v' else 'trace'
+                print(f'{level:<12}{name:<12}{elapsed * 1000:>10.1f}{cpu * 1000:>10.2f}{lines:>10}')
+
+
+if __name__ == '__main__':
+    main()
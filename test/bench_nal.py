@@ -0,0 +1,85 @@
+"""
+    bench_nal.py
+
+    DESCRIPTION: Benchmarks the NAL unit packetizer against plain stream mode
+    by sending a recorded (or synthetic) H.264 stream through the savefile 
+    path with simulated frame loss. Reports packetizing throughput, frame 
+    overhead, and how many NAL units arrive intact vs corrupted.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import re
+import time
+import random
+import argparse
+import tempfile
+import subprocess
+
+from test.gennalus import gennalus
+from test.savefile import read_savefile, drop_frames
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+RX          = f'./{INSTALL_DIR}/rx'
+
+
+def split_units(stream):
+    '''Splits an Annex-B stream the same way the packetizer does'''
+    starts = [m.start() for m in re.finditer(b'\x00\x00\x01', stream)]
+    starts = [s - 1 if s > 0 and stream[s - 1] == 0 else s for s in starts]
+    bounds = ([0] if not starts or starts[0] != 0 else []) + starts + [len(stream)]
+    return [stream[a:b] for a, b in zip(bounds, bounds[1:]) if b > a]
+
+
+def run(stream, tx_opts, rx_opts, loss, blocksize, workdir):
+    tx_out  = os.path.join(workdir, 'tx.raw')
+    lossy   = os.path.join(workdir, 'lossy.raw')
+
+    start = time.perf_counter()
+    subprocess.run(f'{TX} -q -t 1 -b {blocksize} {tx_opts} --savefile {tx_out}'.split(), input=stream)
+    elapsed = time.perf_counter() - start
+
+    frames  = len(read_savefile(tx_out)[1])
+    rand    = random.Random(1)
+    dropped = drop_frames(tx_out, lossy, lambda i, f: rand.random() < loss)
+
+    rx_out  = subprocess.run(f'{RX} -q -t 5 {rx_opts} --savefile {lossy}'.split(), capture_output=True).stdout
+    return elapsed, frames, dropped, rx_out
+
+
+def main():
+    parser = argparse.ArgumentParser(description='NAL packetizer benchmark')
+    parser.add_argument('-i', '--input',        default=None,               help='Recorded Annex-B stream, synthetic if not set')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-k', '--key-repeat',   default=1,      type=int,   help='Extra copies of key units')
+    parser.add_argument('-l', '--loss',         default=0.02,   type=float, help='Simulated frame loss rate')
+    args = parser.parse_args()
+
+    if args.input:
+        with open(args.input, 'rb') as f:
+            stream = f.read()
+    else:
+        stream = b''.join(gennalus(numgops=50))
+
+    sent = set(split_units(stream))
+    print(f'Input: {len(stream)} bytes, {len(split_units(stream))} NAL units, {args.loss:.1%} frame loss\n')
+    print(f'{"mode":<12}{"tx ms":>10}{"frames":>10}{"dropped":>10}{"intact":>10}{"corrupt":>10}')
+
+    modes = [
+        ('plain',       '',                                 ''),
+        ('nal',         '--nal',                            '--nal'),
+        ('nal+repeat',  f'--nal --key-repeat {args.key_repeat}', '--nal'),
+    ]
+    with tempfile.TemporaryDirectory() as workdir:
+        for name, tx_opts, rx_opts in modes:
+            elapsed, frames, dropped, rx_out = run(stream, tx_opts, rx_opts, args.loss, args.blocksize, workdir)
+            units   = split_units(rx_out)
+            intact  = sum(1 for u in units if u in sent)
+            print(f'{name:<12}{elapsed * 1000:>10.1f}{frames:>10}{dropped:>10}{intact:>10}{len(units) - intact:>10}')
+
+
+if __name__ == '__main__':
+    main()
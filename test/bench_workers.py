@@ -0,0 +1,70 @@
+"""
+    bench_workers.py
+
+    DESCRIPTION: Benchmarks preparing frames on block workers. A test only
+    pure handler (--busy-work) stands in for CPU heavy per-frame work like
+    checksums or encryption, tx is then run with 1 to 4 workers, each pinned
+    to as many cores, and compared against running the handler inline.
+
+    Wall time is what scales, CPU time stays about the same or grows a little
+    with the hand off between threads. On a host with fewer cores than workers
+    the extra workers share cores and won't speed anything up.
+
+    Requires a test build, see README.md
+
+"""
+
+import os
+import time
+import argparse
+import tempfile
+import subprocess
+
+from test.savefile import read_savefile
+
+INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestRel')
+TX          = f'./{INSTALL_DIR}/tx'
+
+
+def run(input_file, workers, cores, rounds, blocksize, repeat, workdir):
+    tx_out  = os.path.join(workdir, 'tx.raw')
+    pin     = lambda: os.sched_setaffinity(0, cores)
+
+    start = time.perf_counter()
+    for _ in range(repeat):
+        subprocess.run(f'{TX} {input_file} -q -b {blocksize} --ordered --busy-work {rounds} -j {workers} --savefile {tx_out}'.split(), preexec_fn=pin)
+    elapsed = (time.perf_counter() - start) / repeat
+
+    # Data frames less the FCS, control frames and FCS bytes are left over buffer contents
+    frames = tuple(frame[:-4] for _, frame in read_savefile(tx_out)[1][1:-1])
+    return elapsed, hash(frames)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Block worker benchmark')
+    parser.add_argument('-i', '--input',        default='test/images/daisy.bmp',    help='File to transmit')
+    parser.add_argument('-b', '--blocksize',    default=1024,   type=int,   help='Tx blocksize')
+    parser.add_argument('-w', '--work',         default=64,     type=int,   help='Times each payload is hashed')
+    parser.add_argument('-m', '--max-workers',  default=4,      type=int,   help='Most workers to try')
+    parser.add_argument('-n', '--repeat',       default=3,      type=int,   help='Runs averaged per mode')
+    args = parser.parse_args()
+
+    available = sorted(os.sched_getaffinity(0))
+    print(f'Input: {args.input}, {args.work} hashes per payload, {len(available)} cores available\n')
+    if len(available) < args.max_workers:
+        print(f'Warning: fewer cores than workers, results past {len(available)} workers won\'t scale\n')
+
+    print(f'{"mode":<14}{"cores":>6}{"wall ms":>10}{"speedup":>10}{"same frames":>13}')
+
+    with tempfile.TemporaryDirectory() as workdir:
+        baseline, digest = run(args.input, 0, {available[0]}, args.work, args.blocksize, args.repeat, workdir)
+        print(f'{"inline":<14}{1:>6}{baseline * 1000:>10.1f}{1.0:>10.2f}{"True":>13}')
+
+        for workers in range(1, args.max_workers + 1):
+            cores = set(available[:workers])
+            elapsed, frames = run(args.input, workers, cores, args.work, args.blocksize, args.repeat, workdir)
+            print(f'{f"{workers} workers":<14}{len(cores):>6}{elapsed * 1000:>10.1f}{baseline / elapsed:>10.2f}{str(frames == digest):>13}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,148 @@
+"""
+    genjpeg.py
+
+    DESCRIPTION: Generates small grayscale baseline JPEGs with restart markers
+    for testing the JPEG packetizer. The blocks only carry a DC value and the
+    occasional AC coefficient, which is enough to exercise the entropy coded
+    segment without needing an image library.
+
+"""
+
+import random
+import struct
+import argparse
+
+# Annex K luminance DC table
+DC_COUNTS   = [0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0]
+DC_SYMBOLS  = list(range(12))
+
+# Minimal AC table, end of block and a single size 1 coefficient
+AC_COUNTS   = [0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
+AC_SYMBOLS  = [0x00, 0x01]
+
+RST0 = 0xd0
+
+
+def huffman_codes(counts, symbols):
+    '''Returns {symbol: (code, length)} for a canonical Huffman table'''
+    codes, code, k = {}, 0, 0
+    for length, count in enumerate(counts, start=1):
+        for _ in range(count):
+            codes[symbols[k]] = (code, length)
+            code += 1
+            k += 1
+        code <<= 1
+    return codes
+
+
+DC_CODES = huffman_codes(DC_COUNTS, DC_SYMBOLS)
+AC_CODES = huffman_codes(AC_COUNTS, AC_SYMBOLS)
+
+
+class BitWriter:
+    '''Packs entropy coded bits with byte stuffing'''
+
+    def __init__(self):
+        self.out    = bytearray()
+        self.bits   = 0
+        self.nbits  = 0
+
+    def put(self, code, length):
+        self.bits   = (self.bits << length) | code
+        self.nbits += length
+        while self.nbits >= 8:
+            byte = (self.bits >> (self.nbits - 8)) & 0xff
+            self.out.append(byte)
+            if byte == 0xff:
+                self.out.append(0x00)
+            self.nbits -= 8
+            self.bits  &= (1 << self.nbits) - 1
+
+    def align(self):
+        if self.nbits > 0:
+            pad = 8 - self.nbits
+            self.put((1 << pad) - 1, pad)
+        return bytes(self.out)
+
+
+def encode_value(writer, codes, value):
+    '''Writes the Huffman code of the value's category followed by its bits'''
+    size = abs(value).bit_length()
+    writer.put(*codes[size])
+    if size > 0:
+        writer.put(value if value > 0 else value + (1 << size) - 1, size)
+
+
+def segment(marker, payload):
+    return struct.pack('!BBH', 0xff, marker, len(payload) + 2) + payload
+
+
+def header(width, height, restart_interval):
+    '''SOI through the SOS segment'''
+    dqt = segment(0xdb, bytes([0x00]) + bytes([1] * 64))
+    sof = segment(0xc0, struct.pack('!BHHB', 8, height, width, 1) + bytes([1, 0x11, 0]))
+    dht = segment(0xc4, bytes([0x00] + DC_COUNTS + DC_SYMBOLS + [0x10] + AC_COUNTS + AC_SYMBOLS))
+    dri = segment(0xdd, struct.pack('!H', restart_interval)) if restart_interval else b''
+    sos = segment(0xda, bytes([1, 1, 0x00, 0, 63, 0]))
+    return b'\xff\xd8' + dqt + sof + dht + dri + sos
+
+
+def intervals(width, height, restart_interval, seed):
+    '''Returns the entropy coded data of each restart interval'''
+    rand    = random.Random(seed)
+    mcus    = ((width + 7) // 8) * ((height + 7) // 8)
+    step    = restart_interval if restart_interval else mcus
+    out     = []
+    for first in range(0, mcus, step):
+        writer, pred = BitWriter(), 0
+        for _ in range(first, min(first + step, mcus)):
+            dc = rand.randint(-200, 200)
+            encode_value(writer, DC_CODES, dc - pred)
+            pred = dc
+            if rand.random() < 0.5:
+                writer.put(*AC_CODES[0x01])
+                writer.put(rand.randint(0, 1), 1)
+            writer.put(*AC_CODES[0x00])
+        out.append(writer.align())
+    return out
+
+
+def neutral_interval(mcus):
+    '''Entropy coded data of a flat gray restart interval'''
+    writer = BitWriter()
+    for _ in range(mcus):
+        writer.put(*DC_CODES[0])
+        writer.put(*AC_CODES[0x00])
+    return writer.align()
+
+
+def join_intervals(data):
+    '''Joins the intervals with restart markers'''
+    out = bytearray(data[0])
+    for k, interval in enumerate(data[1:]):
+        out += bytes([0xff, RST0 + k % 8]) + interval
+    return bytes(out)
+
+
+def genjpeg(width=256, height=192, restart_interval=4, seed=0):
+    '''Returns (header, intervals) of a baseline JPEG, the complete file is
+    header + join_intervals(intervals) + EOI'''
+    return header(width, height, restart_interval), intervals(width, height, restart_interval, seed)
+
+
+def jpeg_bytes(hdr, data):
+    return hdr + join_intervals(data) + b'\xff\xd9'
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Generate a grayscale baseline JPEG with restart markers into a file"
+    )
+    parser.add_argument('-f', '--file',     default='test.jpg',         help='Output file')
+    parser.add_argument('-W', '--width',    default=256,    type=int,   help='Image width')
+    parser.add_argument('-H', '--height',   default=192,    type=int,   help='Image height')
+    parser.add_argument('-r', '--restart',  default=4,      type=int,   help='MCUs per restart interval, 0 to disable')
+    parser.add_argument('-s', '--seed',     default=0,      type=int,   help='Random seed')
+    args = parser.parse_args()
+    with open(args.file, 'wb') as f:
+        f.write(jpeg_bytes(*genjpeg(args.width, args.height, args.restart, args.seed)))
@@ -0,0 +1,50 @@
+"""
+    gennalus.py
+
+    DESCRIPTION: Generates a synthetic Annex-B H.264 byte stream for testing
+    the NAL unit packetizer. Unit bodies never contain zero bytes so there is 
+    no start code emulation to worry about.
+
+"""
+
+import random
+import argparse
+
+NALU_SLICE  = 1
+NALU_IDR    = 5
+NALU_SPS    = 7
+NALU_PPS    = 8
+
+
+def nalu(nal_type, size, rand, long_start_code=False):
+    '''Build a single NAL unit including its start code'''
+    start_code  = b'\x00\x00\x00\x01' if long_start_code else b'\x00\x00\x01'
+    header      = bytes([0x60 | nal_type])
+    body        = bytes(rand.randint(1, 255) for _ in range(size))
+    return start_code + header + body
+
+
+def gennalus(numgops=4, gop_length=10, idr_size=6000, slice_size=800, seed=0):
+    '''Returns a list of NAL units grouped into GOPs of SPS, PPS, IDR, slices'''
+    rand    = random.Random(seed)
+    units   = []
+    for _ in range(numgops):
+        units.append(nalu(NALU_SPS, 12, rand, long_start_code=True))
+        units.append(nalu(NALU_PPS, 4,  rand, long_start_code=True))
+        units.append(nalu(NALU_IDR, rand.randint(idr_size // 2, idr_size), rand, long_start_code=True))
+        for _ in range(gop_length - 1):
+            units.append(nalu(NALU_SLICE, rand.randint(slice_size // 4, slice_size), rand))
+    return units
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description="Generate a synthetic Annex-B H.264 stream into a file"
+    )
+    parser.add_argument('-f', '--file',     default='test.h264',        help='Output file')
+    parser.add_argument('-g', '--gops',     default=4,      type=int,   help='Number of GOPs')
+    parser.add_argument('-l', '--length',   default=10,     type=int,   help='Frames per GOP')
+    parser.add_argument('-s', '--seed',     default=0,      type=int,   help='Random seed')
+    args = parser.parse_args()
+    with open(args.file, 'wb') as f:
+        f.write(b''.join(gennalus(args.gops, args.length, seed=args.seed)))
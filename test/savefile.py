@@ -0,0 +1,85 @@
+"""
+    savefile.py
+
+    DESCRIPTION: Minimal reader/writer for the pcap savefiles produced by test
+    builds of tx. Used to simulate frame loss between tx and rx. Also reads
+    the pcapng files dxwifi-trace writes.
+
+"""
+
+import struct
+
+GLOBAL_HEADER   = struct.Struct('<IHHiIII')
+RECORD_HEADER   = struct.Struct('<IIII')
+BLOCK_HEADER    = struct.Struct('<II')
+PACKET_BLOCK    = struct.Struct('<IIIII')
+
+
+def read_savefile(filename):
+    '''Returns the global header and a list of (record header, frame) tuples'''
+    with open(filename, 'rb') as f:
+        data = f.read()
+    header  = data[:GLOBAL_HEADER.size]
+    records = []
+    offset  = GLOBAL_HEADER.size
+    while offset + RECORD_HEADER.size <= len(data):
+        record  = data[offset:offset + RECORD_HEADER.size]
+        caplen  = RECORD_HEADER.unpack(record)[2]
+        offset += RECORD_HEADER.size
+        records.append((record, data[offset:offset + caplen]))
+        offset += caplen
+    return header, records
+
+
+def write_savefile(filename, header, records):
+    with open(filename, 'wb') as f:
+        f.write(header)
+        for record, frame in records:
+            f.write(record)
+            f.write(frame)
+
+
+def drop_frames(src, dst, should_drop):
+    '''Copies the savefile dropping every frame where should_drop(index, frame) is true'''
+    header, records = read_savefile(src)
+    kept = [r for i, r in enumerate(records) if not should_drop(i, r[1])]
+    write_savefile(dst, header, kept)
+    return len(records) - len(kept)
+
+
+def delay_frames(src, dst, micros):
+    '''Copies the savefile with every frame captured micros later than it was dumped'''
+    header, records = read_savefile(src)
+    delayed = []
+    for record, frame in records:
+        sec, usec, caplen, length = RECORD_HEADER.unpack(record)
+        usec += micros
+        delayed.append((RECORD_HEADER.pack(sec + usec // 1000000, usec % 1000000, caplen, length), frame))
+    write_savefile(dst, header, delayed)
+
+
+def read_pcapng(filename):
+    '''Returns a list of (timestamp, original length, frame, comment) tuples from the enhanced packet blocks'''
+    with open(filename, 'rb') as f:
+        data = f.read()
+    packets = []
+    offset  = 0
+    while offset + BLOCK_HEADER.size <= len(data):
+        block_type, block_length = BLOCK_HEADER.unpack_from(data, offset)
+        assert struct.unpack_from('<I', data, offset + block_length - 4)[0] == block_length
+        if block_type == 6:
+            _, ts_high, ts_low, caplen, length = PACKET_BLOCK.unpack_from(data, offset + BLOCK_HEADER.size)
+            body    = offset + BLOCK_HEADER.size + PACKET_BLOCK.size
+            frame   = data[body:body + caplen]
+            options = body + (caplen + 3) // 4 * 4
+            comment = None
+            while True:
+                code, size = struct.unpack_from('<HH', data, options)
+                if code == 0:
+                    break
+                if code == 1:
+                    comment = data[options + 4:options + 4 + size].decode()
+                options += 4 + (size + 3) // 4 * 4
+            packets.append(((ts_high << 32) | ts_low, length, frame, comment))
+        offset += block_length
+    return packets
@@ -8,18 +8,52 @@
 '''
 
 import os
+import re
+import struct
 import shutil
+import signal
 import filecmp
 import unittest
 import subprocess
-from time import sleep
+from time import sleep, time
 from test.genbytes import genbytes
+from test.gennalus import gennalus
+from test.genjpeg import genjpeg, jpeg_bytes, neutral_interval
+from test.savefile import read_savefile, write_savefile, drop_frames, delay_frames, read_pcapng
 
 
+TEST_IMAGE  = 'test/images/daisy.bmp'
 INSTALL_DIR = os.environ.get('DXWIFI_INSTALL_DIR', default='bin/TestDebug')
 TEMP_DIR    = '__temp'
 TX          = f'./{INSTALL_DIR}/tx'
 RX          = f'./{INSTALL_DIR}/rx'
+TRACE       = f'./{INSTALL_DIR}/dxwifi-trace'
+STAT        = f'./{INSTALL_DIR}/dxwifi-stat'
+MAC_HDR_LEN = 24
+UNIT_HDR_LEN= 10
+FCS_LEN     = 4
+
+
+def unit_header(frame):
+    '''Unpacks the (seq, unit, flags, type) unit header from a captured frame'''
+    rtap_len = struct.unpack_from('<H', frame, 2)[0]
+    return struct.unpack_from('!IIBB', frame, rtap_len + MAC_HDR_LEN)
+
+
+def unit_payload(frame):
+    '''Returns the unit data of a captured frame, less the unit header and FCS'''
+    rtap_len = struct.unpack_from('<H', frame, 2)[0]
+    return frame[rtap_len + MAC_HDR_LEN + UNIT_HDR_LEN:-FCS_LEN]
+
+
+def parse_latency(stderr):
+    '''Returns {stage: {field: value}} from the latency summary tx and rx log at exit, times in microseconds'''
+    stages = {}
+    for line in stderr.decode().splitlines():
+        if 'Latency' in line:
+            fields = line.split('Latency')[1].split()
+            stages[fields[0]] = dict((k, float(v.rstrip('us'))) for k, v in (f.split('=') for f in fields[1:]))
+    return stages
 
 
 class TestTxRx(unittest.TestCase):
@@ -153,6 +187,691 @@ class TestTxRx(unittest.TestCase):
         self.assertEqual(all(results), True)
 
 
+    def test_directory_transmission_sorted_and_filtered(self):
+        '''Tx sends matching regular files in name order, skipping links and directories'''
+
+        names = ['test_c.raw', 'test_a.raw', 'test_b10.raw', 'test_b2.raw']
+        for name in names:
+            genbytes(f'{TEMP_DIR}/{name}', 3, 1024)
+        genbytes(f'{TEMP_DIR}/other.raw', 3, 1024)
+        os.mkdir(f'{TEMP_DIR}/test_dir.raw')
+        os.symlink(os.path.abspath(f'{TEMP_DIR}/test_a.raw'), f'{TEMP_DIR}/test_link.raw')
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        rx_dir     = f'{TEMP_DIR}/rx'
+        tx_command = f'{TX} {TEMP_DIR} -q --filter test_*.raw --include-all --no-listen -b 1024 --savefile {tx_out}'
+        rx_command = f'{RX} {rx_dir} -q -t 2 --prefix rx --extension raw --savefile {tx_out}'
+
+        subprocess.run(tx_command.split())
+
+        os.mkdir(rx_dir)
+        subprocess.run(rx_command.split())
+
+        self.assertEqual(len(os.listdir(rx_dir)), len(names))
+        for x, name in enumerate(sorted(names)):
+            self.assertTrue(filecmp.cmp(f'{TEMP_DIR}/{name}', f'{rx_dir}/rx_{x}.raw', shallow=False))
+
+
+    def test_sent_index_skips_sent_files(self):
+        '''Tx skips files whose contents it already sent, or sends them last with --resend'''
+
+        src_dir    = f'{TEMP_DIR}/src'
+        index      = f'{TEMP_DIR}/sent.idx'
+        os.mkdir(src_dir)
+
+        def transmit_and_receive(run, tx_args):
+            tx_out = f'{TEMP_DIR}/tx_{run}.raw'
+            rx_dir = f'{TEMP_DIR}/rx_{run}'
+            os.mkdir(rx_dir)
+            subprocess.run(f'{TX} {tx_args} -q -b 1024 --sent-index {index} --savefile {tx_out}'.split())
+            subprocess.run(f'{RX} {rx_dir} -q -c 1 -t 2 --prefix rx --extension raw --savefile {tx_out}'.split())
+            return [f'{rx_dir}/rx_{x}.raw' for x in range(len(os.listdir(rx_dir)))]
+
+        # genbytes output only depends on the size, so every file gets its own
+        genbytes(f'{src_dir}/test_a.raw', 3, 1024)
+        genbytes(f'{src_dir}/test_b.raw', 4, 1024)
+        received = transmit_and_receive(0, f'{src_dir}/test_a.raw {src_dir}/test_b.raw')
+        self.assertEqual(len(received), 2)
+
+        # A copy of a sent file under a new name isn't sent again
+        shutil.copyfile(f'{src_dir}/test_a.raw', f'{src_dir}/test_c.raw')
+        genbytes(f'{src_dir}/test_d.raw', 5, 1024)
+        received = transmit_and_receive(1, f'{src_dir} --include-all --no-listen')
+        self.assertEqual(len(received), 1)
+        self.assertTrue(filecmp.cmp(f'{src_dir}/test_d.raw', received[0], shallow=False))
+
+        # Resending puts the new file ahead of everything already sent
+        genbytes(f'{src_dir}/test_e.raw', 6, 1024)
+        received = transmit_and_receive(2, f'{src_dir} --include-all --no-listen --resend')
+        self.assertEqual(len(received), 5)
+        self.assertTrue(filecmp.cmp(f'{src_dir}/test_e.raw', received[0], shallow=False))
+        for name, copy in zip(['test_a.raw', 'test_b.raw', 'test_c.raw', 'test_d.raw'], received[1:]):
+            self.assertTrue(filecmp.cmp(f'{src_dir}/{name}', copy, shallow=False))
+
+
+    def test_checkpoint_resumes_interrupted_file(self):
+        '''An interrupted file resumes from the journal and rx continues the same file'''
+
+        data = os.urandom(60 * 1024)
+        with open(f'{TEMP_DIR}/test.raw', 'wb') as f:
+            f.write(data)
+
+        journal    = f'{TEMP_DIR}/tx.journal'
+        tx_out     = [f'{TEMP_DIR}/tx_{x}.raw' for x in range(2)]
+        tx_command = f'{TX} {TEMP_DIR}/test.raw -q -b 1024 --checkpoint {journal} --checkpoint-interval 4 --savefile'
+
+        # Interrupted part way through, takes at least 600ms to send in full
+        proc = subprocess.Popen(f'{tx_command} {tx_out[0]} -u 10'.split())
+        sleep(0.3)
+        proc.send_signal(signal.SIGINT)
+        self.assertEqual(proc.wait(timeout=10), 0)
+
+        subprocess.run(f'{tx_command} {tx_out[1]}'.split())
+
+        header, first  = read_savefile(tx_out[0])
+        _,      second = read_savefile(tx_out[1])
+        control_frames = 2 # Preamble or resume, and EOT
+        self.assertGreater(len(first) - control_frames, 0)
+        self.assertEqual(len(first) + len(second) - 2 * control_frames, 60)
+
+        # Both runs back to back, as the receiver would hear them
+        write_savefile(f'{TEMP_DIR}/tx.raw', header, first + second)
+
+        rx_dir = f'{TEMP_DIR}/rx'
+        os.mkdir(rx_dir)
+        subprocess.run(f'{RX} {rx_dir} -q -c 1 -t 2 --prefix rx --extension raw --savefile {TEMP_DIR}/tx.raw'.split())
+
+        self.assertEqual(os.listdir(rx_dir), ['rx_0.raw'])
+        with open(f'{rx_dir}/rx_0.raw', 'rb') as f:
+            self.assertEqual(f.read(), data)
+
+        # Finished, so the next run starts over
+        subprocess.run(f'{tx_command} {tx_out[1]}'.split())
+        _, third = read_savefile(tx_out[1])
+        self.assertEqual(len(third) - control_frames, 60)
+
+
+    def test_frame_cache_retransmission(self):
+        '''Retransmissions replayed from the frame cache are identical to packetizing the file again'''
+
+        # Built frames are replayed past the pure handlers, units are restamped and run through them again
+        modes = [('', ''), ('--ordered -j 2 --busy-work 2', '--ordered'), ('--compress', '--compress'), ('--compress --ordered', '--compress --ordered')]
+        for tx_opts, rx_opts in modes:
+            tx_out     = [f'{TEMP_DIR}/tx_{x}.raw' for x in range(2)]
+            tx_command = f'{TX} {TEST_IMAGE} -q -b 1024 -c 2 {tx_opts} --savefile'
+
+            subprocess.run(f'{tx_command} {tx_out[0]}'.split())
+            subprocess.run(f'{tx_command} {tx_out[1]} --frame-cache=1'.split())
+
+            _, uncached = read_savefile(tx_out[0])
+            _, cached   = read_savefile(tx_out[1])
+
+            self.assertGreater(len(cached), 3)
+            self.assertEqual(len(uncached), len(cached))
+            self.assertEqual([frame for _, frame in uncached], [frame for _, frame in cached])
+
+            rx_dir = f'{TEMP_DIR}/rx'
+            os.mkdir(rx_dir)
+            subprocess.run(f'{RX} {rx_dir} -q -c 1 -t 2 {rx_opts} --prefix rx --extension bmp --savefile {tx_out[1]}'.split())
+
+            received = sorted(os.listdir(rx_dir))
+            self.assertEqual(received, [f'rx_{x}.bmp' for x in range(3)])
+            for name in received:
+                self.assertTrue(filecmp.cmp(TEST_IMAGE, f'{rx_dir}/{name}', shallow=False))
+            shutil.rmtree(rx_dir)
+
+        # Pure handlers only run on the pass that fills the cache
+        tx_command = f'{TX} {TEST_IMAGE} -b 1024 -c 2 --ordered --busy-work 2 --latency --savefile {tx_out[0]}'
+        uncached = parse_latency(subprocess.run(tx_command.split(), stderr=subprocess.PIPE).stderr)
+        cached   = parse_latency(subprocess.run(f'{tx_command} --frame-cache'.split(), stderr=subprocess.PIPE).stderr)
+        self.assertEqual(cached['tx.prepare']['samples'] * 3, uncached['tx.prepare']['samples'])
+
+
+    def test_block_workers_keep_frame_order(self):
+        '''Frames prepared by block workers go out in order, the same as without workers'''
+
+        tx_out     = [f'{TEMP_DIR}/tx_{x}.raw' for x in range(2)]
+        rx_out     = f'{TEMP_DIR}/rx.bmp'
+        tx_command = f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --busy-work 4 --savefile'
+
+        subprocess.run(f'{tx_command} {tx_out[0]}'.split())
+        subprocess.run(f'{tx_command} {tx_out[1]} -j 4'.split())
+
+        _, inline   = read_savefile(tx_out[0])
+        _, workers  = read_savefile(tx_out[1])
+
+        self.assertGreater(len(workers), 2)
+        self.assertEqual([frame for _, frame in inline], [frame for _, frame in workers])
+
+        subprocess.run(f'{RX} {rx_out} -q -t 2 --ordered --savefile {tx_out[1]}'.split())
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        # More workers than the pool runs are refused up front
+        for workers in ['17', '100000', '-1', '4x']:
+            result = subprocess.run(f'{tx_command} {tx_out[1]} -j {workers}'.split(), capture_output=True, timeout=10)
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn(b'must be in the range(0, 16)', result.stderr)
+
+
+    def test_mapped_files_match_read_files(self):
+        '''Files sent out of memory with --mmap go out the same as files that are read'''
+
+        tx_out     = [f'{TEMP_DIR}/tx_{x}.raw' for x in range(2)]
+        rx_out     = f'{TEMP_DIR}/rx.bmp'
+        tx_command = f'{TX} {TEST_IMAGE} -q -b 1000 -c 1 --ordered --savefile'
+
+        subprocess.run(f'{tx_command} {tx_out[0]}'.split())
+        subprocess.run(f'{tx_command} {tx_out[1]} --mmap'.split())
+
+        _, read     = read_savefile(tx_out[0])
+        _, mapped   = read_savefile(tx_out[1])
+
+        self.assertGreater(len(mapped), 4)
+        self.assertEqual([frame for _, frame in read], [frame for _, frame in mapped])
+
+        subprocess.run(f'{RX} {rx_out} -q -t 2 --ordered --savefile {tx_out[1]}'.split())
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        # Files in a watched directory may still be written, truncating a mapping raises SIGBUS
+        result = subprocess.run(f'{TX} {TEMP_DIR} -q --mmap --savefile {tx_out[0]}'.split(), capture_output=True, timeout=10)
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn(b'directory mode', result.stderr)
+
+
+    def test_event_loop_matches_blocking(self):
+        '''Transmissions and captures driven by the step API from an epoll loop match the blocking calls'''
+
+        tx_out     = [f'{TEMP_DIR}/tx_{x}.raw' for x in range(2)]
+        rx_out     = f'{TEMP_DIR}/rx.bmp'
+        tx_command = f'{TX} {TEST_IMAGE} -q -b 1024 -c 1 --ordered --savefile'
+
+        subprocess.run(f'{tx_command} {tx_out[0]}'.split())
+        subprocess.run(f'{tx_command} {tx_out[1]} --event-loop'.split())
+
+        _, blocking = read_savefile(tx_out[0])
+        _, stepped  = read_savefile(tx_out[1])
+
+        self.assertGreater(len(stepped), 4)
+        self.assertEqual([frame for _, frame in blocking], [frame for _, frame in stepped])
+
+        # The second pass starts a new file, a single output file only gets the first
+        subprocess.run(f'{RX} {rx_out} -q -t 2 --ordered --event-loop --savefile {tx_out[1]}'.split())
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        # A stream that stalls makes the loop wait on stdin until the timeout
+        test_data = bytes(range(256)) * 8
+        stream_out = f'{TEMP_DIR}/stream.raw'
+
+        tx_proc = subprocess.Popen(f'{TX} -q -t 1 -b 512 --event-loop --savefile {stream_out}'.split(), stdin=subprocess.PIPE)
+        for chunk in range(0, len(test_data), 1024):
+            tx_proc.stdin.write(test_data[chunk:chunk + 1024])
+            tx_proc.stdin.flush()
+            sleep(0.1)
+        self.assertEqual(tx_proc.wait(timeout=5), 0)
+        tx_proc.stdin.close()
+
+        rx_proc = subprocess.run(f'{RX} -q -t 2 --event-loop --savefile {stream_out}'.split(), stdout=subprocess.PIPE)
+        self.assertEqual(rx_proc.stdout, test_data)
+
+
+    def test_custom_sink_callbacks(self):
+        '''A custom sink gets the payloads in order, the gaps of an ordered capture and where a resumed file picks up'''
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+        rx_out      = [f'{TEMP_DIR}/rx_{x}.raw' for x in range(3)]
+
+        def events(log):
+            return re.findall(r'Sink (\w+(?: \w+)?)(?:: (.*))?$', log.decode(), re.MULTILINE)
+
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --savefile {tx_out}'.split())
+        header, records = read_savefile(tx_out)
+        self.assertGreater(len(records) - 2, 16)
+
+        # Nothing missing, blocks land in the order they were sent
+        rx = subprocess.run(f'{RX} {rx_out[0]} -t 2 --ordered --sink-events --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        self.assertEqual(rx.returncode, 0)
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out[0], shallow=False))
+
+        log = events(rx.stderr)
+        self.assertEqual(log[0], ('file start', 'preamble'))
+        self.assertEqual(log[-1], ('file end', ''))
+        self.assertEqual([name for name, _ in log[1:-1]], ['block'] * (len(records) - 2))
+
+        # A burst of three and a lone loss, the sink fills nothing in
+        dropped = {4, 5, 6, 12}
+        write_savefile(lossy, header, [r for i, r in enumerate(records) if i not in dropped])
+
+        rx = subprocess.run(f'{RX} {rx_out[1]} -t 2 --ordered --sink-events --savefile {lossy}'.split(), stderr=subprocess.PIPE)
+        self.assertEqual(rx.returncode, 0)
+        self.assertEqual([detail for name, detail in events(rx.stderr) if name == 'gap'], ['3 blocks', '1 blocks'])
+
+        with open(TEST_IMAGE, 'rb') as f:
+            image = f.read()
+        blocks = [image[i:i + 1024] for i in range(0, len(image), 1024)]
+        with open(rx_out[1], 'rb') as f:
+            self.assertEqual(f.read(), b''.join(b for i, b in enumerate(blocks, 1) if i not in dropped))
+
+        # An interrupted file, then the rest of it resumed from the journal
+        data = os.urandom(60 * 1024)
+        with open(f'{TEMP_DIR}/test.raw', 'wb') as f:
+            f.write(data)
+
+        parts      = [f'{TEMP_DIR}/part_{x}.raw' for x in range(2)]
+        tx_command = f'{TX} {TEMP_DIR}/test.raw -q -b 1024 --checkpoint {TEMP_DIR}/tx.journal --checkpoint-interval 4 --savefile'
+
+        proc = subprocess.Popen(f'{tx_command} {parts[0]} -u 10'.split())
+        sleep(0.3)
+        proc.send_signal(signal.SIGINT)
+        self.assertEqual(proc.wait(timeout=10), 0)
+        subprocess.run(f'{tx_command} {parts[1]}'.split())
+
+        header, first  = read_savefile(parts[0])
+        _,      second = read_savefile(parts[1])
+        write_savefile(tx_out, header, first + second)
+
+        rx = subprocess.run(f'{RX} {rx_out[2]} -t 2 --sink-events --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        self.assertEqual(rx.returncode, 0)
+
+        starts = [detail for name, detail in events(rx.stderr) if name == 'file start']
+        resumed = len(first) - 2 # Less the preamble and EOT
+        self.assertEqual(starts, ['preamble', f'resume at block {resumed} (byte {resumed * 1024})'])
+        with open(rx_out[2], 'rb') as f:
+            self.assertEqual(f.read(), data)
+
+
+    def test_async_logging_matches_sync(self):
+        '''Messages written by the background logger match the ones written inline and stay off stdout'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        tx_command = f'{TX} {" ".join([TEST_IMAGE] * 40)} -b 1024 --savefile {tx_out}'
+
+        sync_log    = subprocess.run(tx_command.split(), stderr=subprocess.PIPE).stderr
+        async_log   = subprocess.run(f'{tx_command} --async-log'.split(), stderr=subprocess.PIPE).stderr
+
+        # Each file sent is opened, started and stopped
+        self.assertGreaterEqual(sync_log.count(b'[ INFO ]'), 120)
+        self.assertEqual(sync_log, async_log)
+
+        # A debug line per frame, few enough files that the ring never fills
+        tx_command = f'{TX} {" ".join([TEST_IMAGE] * 4)} -v -b 1024 --savefile {tx_out}'
+
+        sync_log    = subprocess.run(tx_command.split(), stderr=subprocess.PIPE).stderr
+        async_log   = subprocess.run(f'{tx_command} --async-log'.split(), stderr=subprocess.PIPE).stderr
+
+        self.assertGreater(sync_log.count(b'[ DEBUG ]'), 1000)
+        self.assertEqual(sync_log, async_log)
+
+        # Logging at debug verbosity used to put stray newlines in the stream
+        test_data = bytes(range(256)) * 8
+        subprocess.run(f'{TX} -q -b 512 --savefile {tx_out}'.split(), input=test_data)
+
+        for opts in ['', '--async-log']:
+            rx_proc = subprocess.run(f'{RX} -vv -t 2 {opts} --savefile {tx_out}'.split(), stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+            self.assertEqual(rx_proc.stdout, test_data)
+
+
+    def test_async_logging_reports_drops(self):
+        '''Messages that don't fit in the ring are counted, reported as they're dropped and totalled at exit'''
+
+        tx_out = f'{TEMP_DIR}/tx.raw'
+
+        # Nothing's read until the ring is long full, the flusher is stuck on the pipe meanwhile
+        tx_proc = subprocess.Popen(f'{TX} {" ".join([TEST_IMAGE] * 10)} -v -b 1024 --async-log --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        sleep(1)
+        _, log = tx_proc.communicate(timeout=60)
+        self.assertEqual(tx_proc.returncode, 0)
+
+        reported = [int(n) for n in re.findall(rb'^\[ WARN \]\[ generic \] : Log ring full, dropped (\d+) messages$', log, re.MULTILINE)]
+        total = re.findall(rb'^\[ WARN \]\[ tx \] : (\d+) of (\d+) messages dropped by the async logger$', log, re.MULTILINE)
+
+        self.assertGreater(len(reported), 0)
+        self.assertEqual(len(total), 1)
+        self.assertEqual(sum(reported), int(total[0][0]))
+
+        # Everything that wasn't dropped made it out
+        written = len(re.findall(rb'^\[ \w+ \]\[ \w+ \] : ', log, re.MULTILINE)) - len(reported) - 1
+        self.assertEqual(written + sum(reported), int(total[0][1]))
+
+
+    def test_log_modules_and_levels(self):
+        '''Messages are tagged with the module of the file that logged them and only go out at or above its level'''
+
+        tx_out = f'{TEMP_DIR}/tx.raw'
+        rx_out = f'{TEMP_DIR}/rx.bmp'
+
+        def tagged(log):
+            '''Returns the (level, module) of every message'''
+            return [m.groups() for m in re.finditer(r'^\[ (\w+) \]\[ (\w+) \]', log.decode(), re.MULTILINE)]
+
+        def messages(log, text):
+            return [line for line in log.decode().splitlines() if text in line]
+
+        # Default verbosity is info, debug statements are checked and skipped
+        tx_log = subprocess.run(f'{TX} {TEST_IMAGE} -b 1024 --savefile {tx_out}'.split(), stderr=subprocess.PIPE).stderr
+        self.assertIn(('INFO', 'transmitter'), tagged(tx_log))
+        self.assertIn(('INFO', 'tx'), tagged(tx_log))
+        self.assertFalse([level for level, _ in tagged(tx_log) if level in ('DEBUG', 'TRACE')])
+
+        # Every build keeps debug logging, trace stays off at debug verbosity
+        tx_log = subprocess.run(f'{TX} {TEST_IMAGE} -v -b 1024 --savefile {tx_out}'.split(), stderr=subprocess.PIPE).stderr
+        self.assertTrue(messages(tx_log, 'Frame: '))
+        self.assertTrue(all(line.startswith('[ DEBUG ][ tx ]') for line in messages(tx_log, 'Frame: ')))
+        self.assertTrue(all(line.startswith('[ DEBUG ][ transmitter ]') for line in messages(tx_log, 'Preamble Frame Sent')))
+        self.assertNotIn('TRACE', [level for level, _ in tagged(tx_log)])
+
+        rx_log = subprocess.run(f'{RX} {rx_out} -v -t 2 --savefile {tx_out}'.split(), stderr=subprocess.PIPE).stderr
+        self.assertIn(('DEBUG', 'receiver'), tagged(rx_log))
+        self.assertIn(('DEBUG', 'rx'), tagged(rx_log))
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        # Files that don't name a module log under the generic one
+        tx_log = subprocess.run(f'{TX} {TEST_IMAGE} --trace {TEMP_DIR}/missing/tx.trace --savefile {tx_out}'.split(), stderr=subprocess.PIPE).stderr
+        self.assertTrue(messages(tx_log, 'Failed to open frame trace'))
+        self.assertTrue(all(line.startswith('[ ERROR ][ generic ]') for line in messages(tx_log, 'Failed to open frame trace')))
+
+
+    def test_log_sampling_and_rate_limits(self):
+        '''Per-frame debug messages are sampled or capped and the rest are counted in a summary'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        tx_command = f'{TX} {TEST_IMAGE} -v -b 512 --savefile {tx_out}'
+
+        def frame_lines(log):
+            return sum(1 for line in log.splitlines() if b'Frame: ' in line)
+
+        full_log    = subprocess.run(tx_command.split(), stderr=subprocess.PIPE).stderr
+        sampled_log = subprocess.run(f'{tx_command} --log-sample 10'.split(), stderr=subprocess.PIPE).stderr
+        capped_log  = subprocess.run(f'{tx_command} --log-rate 5'.split(), stderr=subprocess.PIPE).stderr
+
+        frames = frame_lines(full_log)
+        self.assertGreater(frames, 100)
+        self.assertNotIn(b'suppressed', full_log)
+
+        self.assertEqual(frame_lines(sampled_log), (frames + 9) // 10)
+        self.assertIn(b'suppressed by sampling or rate limits', sampled_log)
+        self.assertLessEqual(frame_lines(capped_log), 10) # Run may straddle a second
+        self.assertIn(b'suppressed by sampling or rate limits', capped_log)
+
+        # Sampling only drops messages, never frames
+        rx_out = f'{TEMP_DIR}/rx.bmp'
+        rx_proc = subprocess.run(f'{RX} {rx_out} -v -t 2 --log-sample 10 --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+        self.assertIn(b'suppressed by sampling or rate limits', rx_proc.stderr)
+
+        # Negative, overflowing or malformed counts are refused up front
+        for program in [f'{TX} {TEST_IMAGE}', f'{RX} {rx_out}']:
+            for option in ['--log-sample', '--log-rate']:
+                for value in ['-1', '4294967296', '10x']:
+                    result = subprocess.run(f'{program} {option} {value} --savefile {tx_out}'.split(), capture_output=True, timeout=10)
+                    self.assertNotEqual(result.returncode, 0)
+                    self.assertIn(b'must be in the range(0, 2147483647)', result.stderr)
+
+
+    def test_frame_trace_decodes_to_text_and_pcapng(self):
+        '''Every injected and captured frame is traced and decodes back into the frames that were sent'''
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        rx_out      = f'{TEMP_DIR}/rx.bmp'
+        tx_trace    = f'{TEMP_DIR}/tx.trace'
+        rx_trace    = f'{TEMP_DIR}/rx.trace'
+        pcapng      = f'{TEMP_DIR}/trace.pcapng'
+
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 512 --trace {tx_trace} --trace-bytes 4096 --savefile {tx_out}'.split())
+        subprocess.run(f'{RX} {rx_out} -q -t 2 --trace {rx_trace} --savefile {tx_out}'.split())
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        _, frames = read_savefile(tx_out)
+
+        text = subprocess.run(f'{TRACE} -q {tx_trace}'.split(), stdout=subprocess.PIPE).stdout.decode().splitlines()
+        self.assertEqual(len(text), len(frames))
+        self.assertIn('tx control Preamble', text[0])
+        self.assertIn('tx data frame=0 length=552', text[1])
+        self.assertIn('tx control EOT', text[-1])
+
+        # Full frames were kept, so the pcapng holds exactly what was injected
+        subprocess.run(f'{TRACE} -q --pcapng -o {pcapng} {tx_trace}'.split())
+        packets = read_pcapng(pcapng)
+        self.assertEqual([frame for _, frame in frames], [frame for _, _, frame, _ in packets])
+        self.assertEqual([p[3] for p in packets[1:3]], ['tx data frame=0', 'tx data frame=1'])
+
+        # Only the first bytes of the frames by default
+        subprocess.run(f'{TRACE} -q --pcapng -o {pcapng} {rx_trace}'.split())
+        packets = read_pcapng(pcapng)
+        self.assertEqual(len(packets), len(frames))
+        self.assertTrue(all(frame == sent[:64] and length == len(sent) for (_, length, frame, _), (_, sent) in zip(packets, frames)))
+        self.assertEqual(sorted(p[0] for p in packets), [p[0] for p in packets])
+
+        # A small ring keeps the latest frames
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 512 --trace {tx_trace} --trace-records 100 --savefile {tx_out}'.split())
+        text = subprocess.run(f'{TRACE} -q {tx_trace}'.split(), stdout=subprocess.PIPE).stdout.decode().splitlines()
+        self.assertEqual(len(text), 128)
+        self.assertTrue(text[-1].startswith(f'{len(frames) - 1} '))
+
+        # Rings that can't be created are refused up front
+        for records in ['0', '-1', '4611686018427387904']:
+            tx = subprocess.run(f'{TX} {TEST_IMAGE} -q --trace {tx_trace} --trace-records {records} --savefile {tx_out}'.split(), stderr=subprocess.DEVNULL, timeout=10)
+            self.assertNotEqual(tx.returncode, 0)
+        rx = subprocess.run(f'{RX} {rx_out} -q --trace {rx_trace} --trace-bytes -1 --savefile {tx_out}'.split(), stderr=subprocess.DEVNULL, timeout=10)
+        self.assertNotEqual(rx.returncode, 0)
+
+        # So are traces cut short
+        with open(tx_trace, 'r+b') as f:
+            f.truncate(100)
+        self.assertNotEqual(subprocess.run(f'{TRACE} -q {tx_trace}'.split(), stderr=subprocess.DEVNULL).returncode, 0)
+
+
+    def test_live_metrics_read_by_stat(self):
+        '''A running tx publishes its counters where dxwifi-stat can read them, and removes them on exit'''
+
+        name       = f'test-{os.getpid()}'
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        test_data  = bytes(range(256)) * 400
+
+        tx_proc = subprocess.Popen(f'{TX} -q -b 1024 -t 10 --metrics {name} --savefile {tx_out}'.split(), stdin=subprocess.PIPE)
+        tx_proc.stdin.write(test_data)
+        tx_proc.stdin.flush()
+
+        # Tx is still waiting on stdin, the blocks written so far are published
+        values = {}
+        for _ in range(50):
+            sleep(0.1)
+            stat = subprocess.run(f'{STAT} -q -a {name}'.split(), stdout=subprocess.PIPE)
+            values = dict((k, int(v)) for k, v in (line.split() for line in stat.stdout.decode().splitlines()))
+            if values.get('tx.frames') == len(test_data) // 1024:
+                break
+        self.assertEqual(values['tx.frames'], len(test_data) // 1024)
+        self.assertEqual(values['tx.bytes_read'], len(test_data))
+        self.assertEqual(values['tx.control_frames'], 1)
+        self.assertEqual(values['tx.active'], 1)
+        self.assertEqual(values['tx.inject_errors'], 0)
+        self.assertNotIn('rx.frames', values)
+
+        rows = subprocess.run(f'{STAT} -q {name} 1 2'.split(), stdout=subprocess.PIPE).stdout.decode().splitlines()
+        self.assertEqual(rows[0].split(), ['frames', 'ctrl', 'read', 'sent', 'errors', 'active'])
+        self.assertEqual(len(rows), 3)
+        self.assertEqual(rows[2].split(), ['0', '0', '0', '0', '0', '1'])
+
+        # A live segment is never taken over
+        other = subprocess.run(f'{TX} -b 1024 --metrics {name} --savefile {TEMP_DIR}/other.raw'.split(), input=test_data, stderr=subprocess.PIPE, timeout=10)
+        self.assertNotEqual(other.returncode, 0)
+        self.assertIn(f'in use by process {tx_proc.pid}'.encode(), other.stderr)
+
+        tx_proc.stdin.close()
+        tx_proc.wait()
+        self.assertFalse(os.path.exists(f'/dev/shm/dxwifi.{name}'))
+        self.assertNotEqual(subprocess.run(f'{STAT} -q -a {name}'.split()).returncode, 0)
+
+        # One left behind by a process that's gone is
+        dead = subprocess.Popen(['true'])
+        dead.wait()
+        with open(f'/dev/shm/dxwifi.{name}', 'wb') as f:
+            f.write(struct.pack('=8sIIIiQ32x', b'DXMETRC', 1, 1, 0, dead.pid, 0) + bytes(64 * 8))
+
+        stale = subprocess.run(f'{TX} -q -b 1024 --metrics {name} --savefile {TEMP_DIR}/other.raw'.split(), input=test_data, timeout=10)
+        self.assertEqual(stale.returncode, 0)
+        self.assertFalse(os.path.exists(f'/dev/shm/dxwifi.{name}'))
+
+
+    def test_latency_histograms_logged_at_exit(self):
+        '''Tx and rx time every stage of their hot paths and log the percentiles when they finish'''
+
+        tx_out = f'{TEMP_DIR}/tx.raw'
+        rx_out = f'{TEMP_DIR}/rx.bmp'
+
+        tx = subprocess.run(f'{TX} {TEST_IMAGE} -b 1024 --ordered --latency --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        _, frames = read_savefile(tx_out)
+        data_frames = len(frames) - 2 # Less the preamble and EOT
+
+        stages = parse_latency(tx.stderr)
+        self.assertEqual(stages['tx.inject']['samples'], data_frames)
+        self.assertGreaterEqual(stages['tx.read']['samples'], data_frames)
+        for summary in stages.values():
+            self.assertLessEqual(summary['p50'], summary['p90'])
+            self.assertLessEqual(summary['p90'], summary['p99'])
+            self.assertLessEqual(summary['p99'], summary['p99.9'])
+            self.assertLessEqual(summary['p99.9'], summary['max'])
+            self.assertLessEqual(summary['mean'], summary['max'])
+
+        rx = subprocess.run(f'{RX} {rx_out} -t 2 --ordered --latency --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        stages = parse_latency(rx.stderr)
+        self.assertEqual(stages['rx.copy']['samples'], data_frames)
+        self.assertEqual(stages['rx.write']['samples'], data_frames)
+        self.assertEqual(stages['rx.heap']['samples'], 2 * data_frames)
+        self.assertIn('rx.dispatch', stages)
+        self.assertNotIn('tx.inject', stages)
+
+        # Nothing is timed unless it's asked for
+        rx = subprocess.run(f'{RX} {rx_out} -t 2 --ordered --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        self.assertEqual(parse_latency(rx.stderr), {})
+
+
+    def test_send_times_measure_one_way_latency(self):
+        '''Frames stamped with their send time let rx measure how long they took to arrive and to be written out'''
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        delayed     = f'{TEMP_DIR}/delayed.raw'
+        rx_out      = f'{TEMP_DIR}/rx.bmp'
+        delay_us    = 5000
+
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --send-times 4 --savefile {tx_out}'.split())
+        _, frames = read_savefile(tx_out)
+        data_frames = len(frames) - 2 # Less the preamble and EOT
+
+        # Unstamped frames and control frames keep the broadcast address in addr3
+        addr3 = lambda frame: frame[struct.unpack_from('<H', frame, 2)[0] + 16:][:6]
+        stamped = [frame for _, frame in frames if addr3(frame) != b'\xff' * 6]
+        self.assertEqual(len(stamped), (data_frames + 3) // 4)
+
+        # The savefile's timestamps stand in for when the frames went through the air
+        delay_frames(tx_out, delayed, delay_us)
+
+        rx = subprocess.run(f'{RX} {rx_out} -t 2 --ordered --latency --savefile {delayed}'.split(), stderr=subprocess.PIPE)
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+        stages = parse_latency(rx.stderr)
+        self.assertEqual(stages['rx.transit']['samples'], len(stamped))
+        self.assertGreaterEqual(stages['rx.transit']['mean'], delay_us)
+        self.assertLess(stages['rx.transit']['max'], delay_us + 1000)
+        self.assertEqual(stages['rx.hold']['samples'], data_frames)
+        self.assertEqual(stages['rx.delivery']['samples'], len(stamped))
+        self.assertGreaterEqual(stages['rx.delivery']['mean'], stages['rx.transit']['mean'])
+
+        # Without send times there's nothing to measure the transit of
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --savefile {tx_out}'.split())
+        rx = subprocess.run(f'{RX} {rx_out} -t 2 --ordered --latency --savefile {tx_out}'.split(), stderr=subprocess.PIPE)
+        stages = parse_latency(rx.stderr)
+        self.assertNotIn('rx.transit', stages)
+        self.assertIn('rx.hold', stages)
+
+        # Negative, overflowing or malformed intervals are refused up front
+        for value in ['-1', '4294967297', '4x']:
+            result = subprocess.run(f'{TX} {TEST_IMAGE} --send-times {value} --savefile {tx_out}'.split(), capture_output=True, timeout=10)
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn(b'must be in the range(0, 2147483647)', result.stderr)
+
+
+    def test_link_summary_counts_losses_bursts_and_duplicates(self):
+        '''rx estimates the link quality while it captures and writes the totals to a summary file at exit'''
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+        rx_out      = f'{TEMP_DIR}/rx.bmp'
+        summary     = f'{TEMP_DIR}/link.txt'
+
+        subprocess.run(f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --savefile {tx_out}'.split())
+        header, records = read_savefile(tx_out)
+        data_frames = len(records) - 2 # Less the preamble and EOT
+        self.assertGreater(data_frames, 24)
+
+        # A burst of three, two lone losses and two frames captured twice
+        dropped     = {4, 5, 6, 12, 20}
+        duplicated  = {8, 16}
+        lossy_records = []
+        for index, record in enumerate(records):
+            if index not in dropped:
+                lossy_records.append(record)
+            if index in duplicated:
+                lossy_records.append(record)
+        write_savefile(lossy, header, lossy_records)
+
+        rx = subprocess.run(f'{RX} {rx_out} -t 2 --ordered --link-summary {summary} --savefile {lossy}'.split(), stderr=subprocess.PIPE)
+        self.assertEqual(rx.returncode, 0)
+        self.assertIn(b'Link quality: ', rx.stderr)
+
+        with open(summary) as f:
+            link = dict(line.split() for line in f)
+
+        self.assertEqual(int(link['frames']), data_frames - len(dropped) + len(duplicated))
+        self.assertEqual(int(link['unique']), data_frames - len(dropped))
+        self.assertEqual(int(link['duplicates']), len(duplicated))
+        self.assertEqual(int(link['lost']), len(dropped))
+        self.assertEqual(int(link['bursts']), 3)
+        self.assertEqual(int(link['burst_max']), 3)
+        self.assertEqual(int(link['bursts_1-1']), 2)
+        self.assertEqual(int(link['bursts_2-3']), 1)
+        self.assertAlmostEqual(float(link['loss_rate']), len(dropped) / data_frames, places=5)
+        self.assertGreater(int(link['goodput_bytes']), 0)
+
+        # Without frame numbers nothing can be told lost or copied
+        subprocess.run(f'{RX} {rx_out} -q -t 2 --link-summary {summary} --savefile {lossy}'.split())
+        with open(summary) as f:
+            link = dict(line.split() for line in f)
+        self.assertEqual(int(link['frames']), len(lossy_records) - 2)
+        self.assertEqual(int(link['lost']), 0)
+        self.assertEqual(int(link['duplicates']), 0)
+
+        # Negative, overflowing or malformed intervals are refused up front
+        for value in ['-1', '4294967306', '10s']:
+            result = subprocess.run(f'{RX} {rx_out} --link-report {value} --savefile {lossy}'.split(), capture_output=True, timeout=10)
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn(b'must be in the range(0, 2147483647)', result.stderr)
+
+
+    def test_instances_match_single_transmitter(self):
+        '''Transmitters running side by side on separate threads each send what a lone transmitter sends'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        rx_out     = f'{TEMP_DIR}/rx.bmp'
+        tx_command = f'{TX} {TEST_IMAGE} -q -b 1024 --ordered --busy-work 4 --savefile'
+
+        subprocess.run(f'{tx_command} {tx_out}'.split())
+        subprocess.run(f'{tx_command} {tx_out} --instances 3'.split())
+
+        _, single = read_savefile(tx_out)
+        self.assertGreater(len(single), 4)
+
+        for instance in range(3):
+            _, frames = read_savefile(f'{tx_out}.{instance}')
+            self.assertEqual([frame for _, frame in single], [frame for _, frame in frames])
+
+            subprocess.run(f'{RX} {rx_out} -q -t 2 --ordered --savefile {tx_out}.{instance}'.split())
+            self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+            os.remove(rx_out)
+
+
     def test_watch_directory(self):
         '''Tx can watch for new files in a directory and transmit them'''
 
@@ -183,5 +902,375 @@ class TestTxRx(unittest.TestCase):
         self.assertEqual(all(results), True)
 
 
+    def test_watch_directory_recursive_and_moved(self):
+        '''Tx picks up files moved into the directory and files in new subdirectories'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        rx_dir     = f'{TEMP_DIR}/rx'
+        tx_command = f'{TX} {TEMP_DIR} -q --watch-timeout 1 --recursive --filter test_*.raw -b 1024 --savefile {tx_out}'
+        rx_command = f'{RX} {rx_dir} -q -c 1 -t 2 --prefix rx --extension raw --savefile {tx_out}'
+
+        proc = subprocess.Popen(tx_command.split())
+
+        sleep(0.05) # Give tx time to get set up
+
+        sent = []
+
+        # Written under a name that doesn't match the filter, then renamed
+        for x in range(3):
+            data = os.urandom(3000)
+            with open(f'{TEMP_DIR}/staging_{x}.tmp', 'wb') as f:
+                f.write(data)
+            os.rename(f'{TEMP_DIR}/staging_{x}.tmp', f'{TEMP_DIR}/test_moved_{x}.raw')
+            sent.append(data)
+
+        # Nested subdirectories created after tx started
+        os.makedirs(f'{TEMP_DIR}/sub/nested')
+        for x in range(3):
+            data = os.urandom(3000)
+            with open(f'{TEMP_DIR}/sub/nested/test_{x}.raw', 'wb') as f:
+                f.write(data)
+            sent.append(data)
+
+        proc.wait()
+
+        os.mkdir(rx_dir)
+        subprocess.run(rx_command.split())
+
+        received = []
+        for name in os.listdir(rx_dir):
+            with open(f'{rx_dir}/{name}', 'rb') as f:
+                received.append(f.read())
+
+        self.assertEqual(sorted(sent), sorted(received))
+
+
+    def test_watch_directory_drains_on_sigint(self):
+        '''Files queued while tx is busy are sent once each before tx exits on SIGINT'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        rx_dir     = f'{TEMP_DIR}/rx'
+        tx_command = f'{TX} {TEMP_DIR} -q -u 2 --filter test_*.raw -b 1024 --savefile {tx_out}'
+        rx_command = f'{RX} {rx_dir} -q -c 1 -t 2 --prefix rx --extension raw --savefile {tx_out}'
+
+        proc = subprocess.Popen(tx_command.split())
+
+        sleep(0.05) # Give tx time to get set up
+
+        # Takes at least 600ms to send, everything after it lands in the backlog
+        big = os.urandom(300 * 1024)
+        with open(f'{TEMP_DIR}/test_big.raw', 'wb') as f:
+            f.write(big)
+        sleep(0.05)
+
+        # Rewritten while still queued, should only be sent once
+        for x in range(2):
+            if x > 0:
+                os.remove(f'{TEMP_DIR}/test_rewritten.raw')
+            rewritten = os.urandom(3000)
+            with open(f'{TEMP_DIR}/test_rewritten.raw', 'wb') as f:
+                f.write(rewritten)
+
+        other = os.urandom(3000)
+        with open(f'{TEMP_DIR}/test_other.raw', 'wb') as f:
+            f.write(other)
+
+        sleep(0.1)
+        proc.send_signal(signal.SIGINT)
+        self.assertEqual(proc.wait(timeout=10), 0)
+
+        os.mkdir(rx_dir)
+        subprocess.run(rx_command.split())
+
+        received = []
+        for name in os.listdir(rx_dir):
+            with open(f'{rx_dir}/{name}', 'rb') as f:
+                received.append(f.read())
+
+        self.assertEqual(sorted([big, rewritten, other]), sorted(received))
+
+
+    def test_watch_directory_follow(self):
+        '''Files are sent while being written, in the same frames as once they're done'''
+
+        tx_out     = f'{TEMP_DIR}/tx.raw'
+        ref_out    = f'{TEMP_DIR}/ref.raw'
+        tx_command = f'{TX} {TEMP_DIR} -q --follow --filter test_*.raw -b 1024 --savefile {tx_out}'
+
+        proc = subprocess.Popen(tx_command.split())
+
+        sleep(0.05) # Give tx time to get set up
+
+        # Writes don't line up with blocks
+        data = os.urandom(12000)
+        with open(f'{TEMP_DIR}/test_growing.raw', 'wb') as f:
+            for offset in range(0, len(data), 1500):
+                f.write(data[offset:offset + 1500])
+                f.flush()
+                sleep(0.05)
+            closed = time()
+
+        sleep(0.1)
+        proc.send_signal(signal.SIGINT)
+        self.assertEqual(proc.wait(timeout=10), 0)
+
+        subprocess.run(f'{TX} {TEMP_DIR}/test_growing.raw -q -b 1024 --savefile {ref_out}'.split())
+
+        _, followed = read_savefile(tx_out)
+        _, reference = read_savefile(ref_out)
+
+        # Sending started well before the file was closed
+        first_sent = struct.unpack('<II', followed[0][0][:8])
+        self.assertLess(first_sent[0] + first_sent[1] / 1e6, closed - 0.1)
+
+        self.assertEqual([frame for _, frame in reference], [frame for _, frame in followed])
+
+
+    def test_nal_stream_transmission(self):
+        '''NAL packetized stream is reassembled byte for byte'''
+
+        test_data   = b''.join(gennalus())
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+
+        tx_command = f'{TX} -q -t 1 -b 512 --nal --key-repeat 2 --savefile {tx_out}'
+        rx_command = f'{RX} -q -t 5 --nal --savefile {tx_out}'
+
+        tx_proc = subprocess.Popen(tx_command.split(), stdin=subprocess.PIPE)
+        tx_proc.communicate(test_data)
+        tx_proc.wait()
+
+        rx_proc = subprocess.Popen(rx_command.split(), stdout=subprocess.PIPE)
+        rx_out  = rx_proc.communicate()[0]
+        rx_proc.wait()
+
+        self.assertEqual(test_data, rx_out)
+
+
+    def test_nal_incomplete_units_dropped(self):
+        '''Rx drops NAL units with a missing fragment instead of emitting them'''
+
+        units       = gennalus()
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+
+        tx_command = f'{TX} -q -t 1 -b 512 --nal --savefile {tx_out}'
+        rx_command = f'{RX} -q -t 5 --nal --savefile {lossy}'
+
+        tx_proc = subprocess.Popen(tx_command.split(), stdin=subprocess.PIPE)
+        tx_proc.communicate(b''.join(units))
+        tx_proc.wait()
+
+        # Lose the second fragment of the first IDR slice (unit 2)
+        fragments = []
+        def second_idr_fragment(index, frame):
+            seq, unit, flags, nal_type = unit_header(frame)
+            if unit == 2:
+                fragments.append(index)
+            return unit == 2 and len(fragments) == 2
+
+        self.assertEqual(drop_frames(tx_out, lossy, second_idr_fragment), 1)
+
+        rx_proc = subprocess.Popen(rx_command.split(), stdout=subprocess.PIPE)
+        rx_out  = rx_proc.communicate()[0]
+        rx_proc.wait()
+
+        self.assertEqual(b''.join(units[:2] + units[3:]), rx_out)
+
+
+    def test_jpeg_transmission(self):
+        '''JPEG sent on restart interval boundaries is rebuilt byte for byte'''
+
+        test_data   = jpeg_bytes(*genjpeg())
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+
+        tx_command = f'{TX} -q -t 1 -b 300 --jpeg --key-repeat 1 --savefile {tx_out}'
+        rx_command = f'{RX} -q -t 5 --jpeg --savefile {tx_out}'
+
+        tx_proc = subprocess.Popen(tx_command.split(), stdin=subprocess.PIPE)
+        tx_proc.communicate(test_data)
+        tx_proc.wait()
+
+        rx_proc = subprocess.Popen(rx_command.split(), stdout=subprocess.PIPE)
+        rx_out  = rx_proc.communicate()[0]
+        rx_proc.wait()
+
+        self.assertEqual(test_data, rx_out)
+
+
+    def test_jpeg_lost_intervals_substituted(self):
+        '''Rx replaces the restart intervals of a lost frame with gray strips'''
+
+        restart     = 4
+        hdr, data   = genjpeg(restart_interval=restart)
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+
+        tx_command = f'{TX} -q -t 1 -b 300 --jpeg --savefile {tx_out}'
+        rx_command = f'{RX} -q -t 5 --jpeg --savefile {lossy}'
+
+        tx_proc = subprocess.Popen(tx_command.split(), stdin=subprocess.PIPE)
+        tx_proc.communicate(jpeg_bytes(hdr, data))
+        tx_proc.wait()
+
+        # Lose the fifth frame carrying restart intervals
+        _, records  = read_savefile(tx_out)
+        interval_frames = [i for i, (_, frame) in enumerate(records) if unit_header(frame)[3] == 1]
+        lost_index  = interval_frames[4]
+        _, unit, _, _ = unit_header(records[lost_index][1])
+        payload     = unit_payload(records[lost_index][1])
+
+        first = unit - 1
+        count = 1 + sum(payload[i] == 0xff and 0xd0 <= payload[i + 1] <= 0xd7 for i in range(len(payload) - 1))
+
+        self.assertEqual(drop_frames(tx_out, lossy, lambda index, frame: index == lost_index), 1)
+
+        rx_proc = subprocess.Popen(rx_command.split(), stdout=subprocess.PIPE)
+        rx_out  = rx_proc.communicate()[0]
+        rx_proc.wait()
+
+        expected = data[:first] + [neutral_interval(restart)] * count + data[first + count:]
+        self.assertEqual(jpeg_bytes(hdr, expected), rx_out)
+
+
+    def test_jpeg_without_restart_markers(self):
+        '''JPEGs without restart markers are sent as plain fragments'''
+
+        test_data   = jpeg_bytes(*genjpeg(restart_interval=0))
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+
+        tx_command = f'{TX} -q -t 1 -b 300 --jpeg --savefile {tx_out}'
+        rx_command = f'{RX} -q -t 5 --jpeg --savefile {tx_out}'
+
+        tx_proc = subprocess.Popen(tx_command.split(), stdin=subprocess.PIPE)
+        tx_proc.communicate(test_data)
+        tx_proc.wait()
+
+        rx_proc = subprocess.Popen(rx_command.split(), stdout=subprocess.PIPE)
+        rx_out  = rx_proc.communicate()[0]
+        rx_proc.wait()
+
+        self.assertEqual(test_data, rx_out)
+
+
+    def test_compressed_file_transmission(self):
+        '''Compressed file transmission is decompressed byte for byte'''
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        rx_out      = f'{TEMP_DIR}/rx.bmp'
+
+        tx_command = f'{TX} {TEST_IMAGE} -q -b 1024 --compress=5 --savefile {tx_out}'
+        rx_command = f'{RX} {rx_out} -q -t 2 --compress --savefile {tx_out}'
+
+        subprocess.run(tx_command.split())
+        subprocess.run(rx_command.split())
+
+        self.assertTrue(filecmp.cmp(TEST_IMAGE, rx_out, shallow=False))
+
+
+    def test_compressed_lost_group_filled(self):
+        '''A lost frame only costs its own group, which rx fills with noise'''
+
+        group_blocks    = 4
+        blocksize       = 1024
+        group_size      = group_blocks * blocksize
+        lost_group      = 3
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+        rx_out      = f'{TEMP_DIR}/rx.bmp'
+
+        tx_command = f'{TX} {TEST_IMAGE} -q -b {blocksize} --compress --group-blocks {group_blocks} --savefile {tx_out}'
+        rx_command = f'{RX} {rx_out} -q -t 2 --compress --add-noise --savefile {lossy}'
+
+        subprocess.run(tx_command.split())
+
+        # Lose the first fragment of a group in the middle of the file
+        self.assertEqual(drop_frames(tx_out, lossy, lambda index, frame: unit_header(frame)[1:3] == (lost_group, 0x01)), 1)
+
+        subprocess.run(rx_command.split())
+
+        with open(TEST_IMAGE, 'rb') as f:
+            expected = bytearray(f.read())
+        with open(rx_out, 'rb') as f:
+            received = f.read()
+
+        expected[lost_group * group_size:(lost_group + 1) * group_size] = b'\xff' * group_size
+        self.assertEqual(bytes(expected), received)
+
+
+    def test_delta_series_transmission(self):
+        '''Files that mostly repeat the previous one are sent as deltas and rebuilt exactly'''
+
+        with open(TEST_IMAGE, 'rb') as f:
+            base = f.read()
+
+        # Overwrite a region, then shift everything after a small insertion
+        second  = base[:5000] + bytes(1000) + base[6000:20000] + b'inserted' + base[20000:]
+        third   = second[:40000] + bytes(range(256)) * 4 + second[41024:]
+        series  = [base, second, third]
+
+        test_files = [f'{TEMP_DIR}/test_{x}.bmp' for x in range(len(series))]
+        for file, data in zip(test_files, series):
+            with open(file, 'wb') as f:
+                f.write(data)
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        rx_out      = [f'{TEMP_DIR}/rx_{x}.bmp' for x in range(len(series))]
+        tx_command  = f'{TX} {" ".join(test_files)} -q -b 1024 --delta --savefile {tx_out}'
+        rx_command  = f'{RX} {TEMP_DIR} -q -c 1 -t 2 --delta --prefix rx --extension bmp --savefile {tx_out}'
+
+        subprocess.run(tx_command.split())
+        subprocess.run(rx_command.split())
+
+        for src, copy in zip(test_files, rx_out):
+            self.assertTrue(filecmp.cmp(src, copy, shallow=False))
+
+        # Only the first file goes out in full, the others are a few frames each
+        types = [unit_header(frame)[3] for _, frame in read_savefile(tx_out)[1] if len(frame) > 100]
+        self.assertEqual(types.count(0), len(base) // (1024 - UNIT_HDR_LEN - 16) + 1)
+        self.assertLess(types.count(1), 10)
+
+
+    def test_delta_lost_frame_keeps_reference(self):
+        '''A lost delta frame leaves the previous file's bytes in its place'''
+
+        with open(TEST_IMAGE, 'rb') as f:
+            base = f.read()
+        second = bytearray(base)
+        for offset in (1000, 3000, 5000):
+            second[offset:offset + 600] = bytes(600)
+
+        test_files = [f'{TEMP_DIR}/test_{x}.bmp' for x in range(2)]
+        for file, data in zip(test_files, [base, second]):
+            with open(file, 'wb') as f:
+                f.write(data)
+
+        tx_out      = f'{TEMP_DIR}/tx.raw'
+        lossy       = f'{TEMP_DIR}/lossy.raw'
+        rx_out      = [f'{TEMP_DIR}/rx_{x}.bmp' for x in range(2)]
+        tx_command  = f'{TX} {" ".join(test_files)} -q -b 300 --delta --savefile {tx_out}'
+        rx_command  = f'{RX} {TEMP_DIR} -q -c 1 -t 2 --delta --prefix rx --extension bmp --savefile {lossy}'
+
+        subprocess.run(tx_command.split())
+
+        # Lose a delta frame in the middle of the second change
+        is_delta    = lambda frame: len(frame) > 100 and unit_header(frame)[3] == 1
+        offsets     = [struct.unpack_from('!IIII', unit_payload(frame))[2] for _, frame in read_savefile(tx_out)[1] if is_delta(frame)]
+        lost        = next(i for i in range(len(offsets) - 1) if offsets[i] <= 3300 < offsets[i + 1])
+        lost_start  = offsets[lost]
+        lost_end    = offsets[lost + 1]
+
+        self.assertEqual(drop_frames(tx_out, lossy, lambda index, frame: is_delta(frame) and unit_header(frame)[1] == lost), 1)
+
+        subprocess.run(rx_command.split())
+
+        expected = bytearray(second)
+        expected[lost_start:lost_end] = base[lost_start:lost_end]
+
+        self.assertTrue(filecmp.cmp(test_files[0], rx_out[0], shallow=False))
+        with open(rx_out[1], 'rb') as f:
+            self.assertEqual(bytes(expected), f.read())
+
+
 if __name__ == '__main__':
     unittest.main()